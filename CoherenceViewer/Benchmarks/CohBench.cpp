@@ -0,0 +1,1003 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_bench - time the parts of the coherence engine on synthetic data and write the results
+as JSON, so that runs on different commits can be compared.
+
+Usage:
+    coh_bench [options]
+
+    Each of these takes a comma-separated list; every combination is run.
+    --channels <n,...>      total channels, split evenly between the groups (default 2,8,32)
+    --fs <Hz,...>           sample rate (default 1000)
+    --seg <s,...>           segment length (default 4)
+    --win <s,...>           window length (default 2)
+    --freqs <n,...>         number of frequencies, 1 Hz apart from 1 Hz (default 40)
+    --threads <n,...>       threads that addTrial is split over (default 1)
+
+    --step <s>              step length (default 0.1)
+    --min-time <s>          minimum time to spend on each measurement (default 1)
+    --min-iters <n>         minimum iterations of each measurement (default 3)
+    --only <name,...>       only run these benchmarks (names as below)
+    --label <text>          stored in the output, e.g. a commit hash
+    --out <file.json>       where to write the results (default coh_bench.json)
+
+Benchmarks, each timed per iteration:
+    generateWavelet         constructing a one-by-one-channel CumulativeTFR, which is almost
+                            all wavelet generation
+    addTrial                addTrial for every channel of one segment. With more than one thread,
+                            the channels are split between threads, each with its own TFR, the
+                            way independent channels could be transformed in parallel.
+    getMeanCoherence        getMeanCoherence for every channel combination of one segment
+    reduceFrame             CoherenceFrame::reduce over every channel combination: the average,
+                            per-channel averages and min/max envelopes the publish stage
+                            computes so that the canvas doesn't have to
+    synchronizerPushPull    a writer thread copying a segment into an AtomicallyShared buffer
+                            and pushing it, while a reader pulls and reads it (timed per push)
+    enqueueArray            CircularArray::enqueueArray of one segment of every channel,
+                            in 1024-sample blocks
+    ringEnqueue             the same with SampleRing::enqueueArray
+    ringRead                reading back one segment of every channel from a SampleRing through
+                            getSpan. The extras give the same read through CircularArray's and
+                            SampleRing's operator[].
+    pipeline                16 segments through the plugin's calculation stages: transform
+                            (computeSpectrum for every channel), accumulate (addSpectrum and
+                            getMeanCoherence) and publish (AtomicallyShared push), pipelined
+                            on three threads with bounded SlotQueues between them as in
+                            CoherenceNode. The extras give the time per segment when the
+                            stages run one after another, and each stage's own time.
+
+Measurements that don't depend on a parameter (e.g. threads for getMeanCoherence) are only
+run for the first value in its list.
+*/
+
+#include "AtomicSynchronizer.h"
+#include "CircularArray.h"
+#include "CoherenceFrame.h"
+#include "CumulativeTFR.h"
+#include "FFTArray.h"
+#include "SampleRing.h"
+#include "SlotQueue.h"
+#include "StageTimings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int BLOCK_SIZE = 1024; // samples per enqueued block, like a typical GUI buffer
+    const int PIPELINE_SEGMENTS = 16; // per iteration of the pipeline benchmark
+    const int PIPELINE_QUEUE_SIZE = 3; // as in CoherenceNode
+
+    struct Config
+    {
+        int channels;
+        int fs;
+        double segLen;
+        double winLen;
+        int nFreqs;
+        int threads;
+
+        int getGroup1() const { return (channels + 1) / 2; }
+        int getGroup2() const { return channels / 2; }
+        int getSegSamples() const { return int(segLen * fs); }
+    };
+
+    struct Options
+    {
+        std::vector<int> channels = { 2, 8, 32 };
+        std::vector<int> fs = { 1000 };
+        std::vector<double> segLen = { 4 };
+        std::vector<double> winLen = { 2 };
+        std::vector<int> nFreqs = { 40 };
+        std::vector<int> threads = { 1 };
+
+        double stepLen = 0.1;
+        double minTime = 1;
+        int minIters = 3;
+        std::set<std::string> only;
+        std::string label;
+        std::string outPath = "coh_bench.json";
+
+        bool shouldRun(const std::string& name) const
+        {
+            return only.empty() || only.count(name) > 0;
+        }
+    };
+
+    // durations of each iteration of one measurement, in microseconds
+    struct Stats
+    {
+        explicit Stats(std::vector<double> us)
+            : samples(std::move(us))
+        {
+            std::sort(samples.begin(), samples.end());
+        }
+
+        int getCount() const { return int(samples.size()); }
+
+        double getMean() const
+        {
+            double sum = 0;
+            for (double x : samples)
+            {
+                sum += x;
+            }
+            return samples.empty() ? 0 : sum / samples.size();
+        }
+
+        double getPercentile(double p) const
+        {
+            if (samples.empty())
+            {
+                return 0;
+            }
+            size_t i = size_t(std::ceil(p / 100 * samples.size()));
+            return samples[std::min(samples.size() - 1, i > 0 ? i - 1 : 0)];
+        }
+
+        double getMin() const { return samples.empty() ? 0 : samples.front(); }
+        double getMax() const { return samples.empty() ? 0 : samples.back(); }
+
+    private:
+        std::vector<double> samples;
+    };
+
+    struct Result
+    {
+        std::string name;
+        Config config;
+        Stats stats;
+        std::vector<std::pair<std::string, double>> extra; // benchmark-specific values
+    };
+
+    // Runs f (which returns its own duration in microseconds) until both the minimum time
+    // and the minimum number of iterations have been reached.
+    Stats measure(const Options& options, const std::function<double()>& f)
+    {
+        std::vector<double> us;
+        double totalUs = 0;
+        while (us.size() < size_t(options.minIters) || totalUs < options.minTime * 1e6)
+        {
+            us.push_back(f());
+            totalUs += us.back();
+        }
+        return Stats(std::move(us));
+    }
+
+    // Reproducible noise, long enough that each channel can start at a different offset
+    class NoiseSource
+    {
+    public:
+        explicit NoiseSource(int segSamples)
+            : segSamples(segSamples)
+            , noise     (2 * size_t(segSamples))
+        {
+            std::mt19937 gen(12345);
+            std::normal_distribution<float> dist(0, 50);
+            for (float& x : noise)
+            {
+                x = dist(gen);
+            }
+        }
+
+        const float* getChannel(int chan) const
+        {
+            return &noise[(size_t(chan) * 7919) % segSamples];
+        }
+
+        void fill(FFTArray& dest, int chan) const
+        {
+            const float* src = getChannel(chan);
+            int n = std::min(segSamples, dest.getLength());
+            for (int i = 0; i < n; ++i)
+            {
+                dest.set(i, double(src[i]));
+            }
+        }
+
+    private:
+        int segSamples;
+        std::vector<float> noise;
+    };
+
+    int getNumTimes(const Config& config, double stepLen)
+    {
+        // same as CoherenceNode::resetTFR
+        int nSamplesWin = int(config.winLen * config.fs);
+        return int((config.getSegSamples() - nSamplesWin) / double(config.fs) * (1 / stepLen)) + 1;
+    }
+
+    std::unique_ptr<CumulativeTFR> makeTFR(const Config& config, const Options& options, int ng1, int ng2)
+    {
+        return std::unique_ptr<CumulativeTFR>(new CumulativeTFR(ng1, ng2, config.nFreqs,
+            getNumTimes(config, options.stepLen), config.fs, float(config.winLen), float(options.stepLen),
+            1, 1, config.segLen, 0));
+    }
+
+    Result benchGenerateWavelet(const Config& config, const Options& options)
+    {
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            auto tfr = makeTFR(config, options, 1, 1);
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        return { "generateWavelet", config, stats, {} };
+    }
+
+    Result benchAddTrial(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        int nThreads = std::max(1, std::min(config.threads, config.channels));
+
+        // each thread gets a contiguous range of channels and its own TFR and buffer
+        struct Worker
+        {
+            int firstChan;
+            int nChans;
+            std::unique_ptr<CumulativeTFR> tfr;
+            FFTArray buffer;
+            CumulativeTFR::TrialTimes times;
+        };
+
+        std::vector<Worker> workers(nThreads);
+        for (int w = 0; w < nThreads; ++w)
+        {
+            workers[w].firstChan = config.channels * w / nThreads;
+            workers[w].nChans = config.channels * (w + 1) / nThreads - workers[w].firstChan;
+            workers[w].tfr = makeTFR(config, options, workers[w].nChans, 0);
+            workers[w].buffer.resize(config.getSegSamples());
+        }
+
+        auto runWorker = [&](Worker& worker)
+        {
+            for (int c = 0; c < worker.nChans; ++c)
+            {
+                noise.fill(worker.buffer, worker.firstChan + c);
+                worker.tfr->addTrial(worker.buffer, c, &worker.times);
+            }
+        };
+
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            if (nThreads == 1)
+            {
+                runWorker(workers[0]);
+            }
+            else
+            {
+                std::vector<std::thread> threads;
+                for (Worker& worker : workers)
+                {
+                    threads.emplace_back(runWorker, std::ref(worker));
+                }
+                for (std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+            }
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        // breakdown summed over all threads, per channel
+        CumulativeTFR::TrialTimes total;
+        for (const Worker& worker : workers)
+        {
+            total.fftUs += worker.times.fftUs;
+            total.multiplyUs += worker.times.multiplyUs;
+            total.ifftUs += worker.times.ifftUs;
+        }
+        double nTrials = double(stats.getCount()) * config.channels;
+
+        return { "addTrial", config, stats, {
+            { "per_channel_us", stats.getMean() / config.channels },
+            { "fft_per_channel_us", total.fftUs / nTrials },
+            { "multiply_per_channel_us", total.multiplyUs / nTrials },
+            { "ifft_per_channel_us", total.ifftUs / nTrials },
+            { "real_time_factor", stats.getMean() / (config.segLen * 1e6) } } };
+    }
+
+    Result benchGetMeanCoherence(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        int ng1 = config.getGroup1();
+        int ng2 = config.getGroup2();
+        auto tfr = makeTFR(config, options, ng1, ng2);
+
+        FFTArray buffer(config.getSegSamples());
+        for (int chan = 0; chan < config.channels; ++chan)
+        {
+            noise.fill(buffer, chan);
+            tfr->addTrial(buffer, chan);
+        }
+
+        std::vector<double> dest(config.nFreqs);
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            for (int i = 0, comb = 0; i < ng1; ++i)
+            {
+                for (int j = 0; j < ng2; ++j, ++comb)
+                {
+                    tfr->getMeanCoherence(i, ng1 + j, dest.data(), comb);
+                }
+            }
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        int nCombs = std::max(1, ng1 * ng2);
+        return { "getMeanCoherence", config, stats, {
+            { "combinations", double(ng1 * ng2) },
+            { "per_combination_us", stats.getMean() / nCombs } } };
+    }
+
+    Result benchReduceFrame(const Config& config, const Options& options)
+    {
+        int ng1 = config.getGroup1();
+        int ng2 = config.getGroup2();
+        CoherenceFrame frame;
+        frame.resize(ng1, ng2, config.nFreqs);
+
+        std::mt19937 gen(12345);
+        std::uniform_real_distribution<double> dist(0, 1);
+        for (std::vector<double>& comb : frame.coherence)
+        {
+            for (double& coh : comb)
+            {
+                coh = dist(gen);
+            }
+        }
+
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            frame.reduce();
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        int nCombs = std::max(1, ng1 * ng2);
+        return { "reduceFrame", config, stats, {
+            { "combinations", double(ng1 * ng2) },
+            { "per_combination_us", stats.getMean() / nCombs },
+            { "checksum", frame.average.empty() ? 0 : frame.average.front() } } };
+    }
+
+    Result benchSynchronizer(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        typedef std::vector<std::vector<float>> Segment;
+
+        int segSamples = config.getSegSamples();
+        AtomicallyShared<Segment> shared(config.channels, std::vector<float>(segSamples));
+
+        std::atomic<bool> stop(false);
+        std::atomic<long long> nPulled(0);
+        std::atomic<long long> nRead(0);
+        double checksum = 0;
+
+        std::thread reader([&]()
+        {
+            AtomicScopedReadPtr<Segment> readPtr(shared);
+            while (!stop)
+            {
+                if (!shared.hasUpdate())
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                readPtr.pullUpdate();
+                ++nPulled;
+                if (readPtr.isValid())
+                {
+                    // touch every channel, as the calculation thread would
+                    for (const std::vector<float>& chan : *readPtr)
+                    {
+                        checksum += chan.front() + chan.back();
+                    }
+                    ++nRead;
+                }
+            }
+        });
+
+        AtomicScopedWritePtr<Segment> writePtr(shared);
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            for (int chan = 0; chan < config.channels; ++chan)
+            {
+                const float* src = noise.getChannel(chan);
+                std::copy(src, src + segSamples, (*writePtr)[chan].begin());
+            }
+            writePtr.pushUpdate();
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        stop = true;
+        reader.join();
+
+        return { "synchronizerPushPull", config, stats, {
+            { "pulls", double(nPulled) },
+            { "pushes_seen_fraction", double(nRead) / std::max(1, stats.getCount()) },
+            { "dropped_fraction", double(shared.getNumDropped()) / std::max<uint64_t>(1, shared.getNumPushed()) },
+            { "checksum", checksum } } };
+    }
+
+    Result benchEnqueueArray(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        int segSamples = config.getSegSamples();
+        std::vector<CircularArray<float>> arrays(config.channels, CircularArray<float>(segSamples));
+
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            for (int chan = 0; chan < config.channels; ++chan)
+            {
+                const float* src = noise.getChannel(chan);
+                for (int i = 0; i < segSamples; i += BLOCK_SIZE)
+                {
+                    arrays[chan].enqueueArray(src + i, std::min(BLOCK_SIZE, segSamples - i));
+                }
+            }
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        double samplesPerUs = double(segSamples) * config.channels / std::max(stats.getMean(), 1e-9);
+        return { "enqueueArray", config, stats, {
+            { "block_size", double(BLOCK_SIZE) },
+            { "msamples_per_second", samplesPerUs } } };
+    }
+
+    Result benchRingEnqueue(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        int segSamples = config.getSegSamples();
+        std::vector<SampleRing<float>> rings(config.channels, SampleRing<float>(segSamples));
+
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            for (int chan = 0; chan < config.channels; ++chan)
+            {
+                const float* src = noise.getChannel(chan);
+                for (int i = 0; i < segSamples; i += BLOCK_SIZE)
+                {
+                    rings[chan].enqueueArray(src + i, std::min(BLOCK_SIZE, segSamples - i));
+                }
+            }
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        double samplesPerUs = double(segSamples) * config.channels / std::max(stats.getMean(), 1e-9);
+        return { "ringEnqueue", config, stats, {
+            { "block_size", double(BLOCK_SIZE) },
+            { "capacity", double(rings.front().getCapacity()) },
+            { "msamples_per_second", samplesPerUs } } };
+    }
+
+    Result benchRingRead(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        int segSamples = config.getSegSamples();
+        std::vector<SampleRing<float>> rings(config.channels, SampleRing<float>(segSamples));
+        std::vector<CircularArray<float>> arrays(config.channels, CircularArray<float>(segSamples));
+        for (int chan = 0; chan < config.channels; ++chan)
+        {
+            // a partial block first, so that the data wraps
+            const float* src = noise.getChannel(chan);
+            rings[chan].enqueueArray(src, segSamples / 3);
+            rings[chan].enqueueArray(src, segSamples);
+            arrays[chan].enqueueArray(src, segSamples / 3);
+            arrays[chan].enqueueArray(src, segSamples);
+        }
+
+        // sums, so that the reads can't be optimized away
+        double checksum = 0;
+        auto timeRead = [&](const std::function<double(int)>& readChannel)
+        {
+            return measure(options, [&]()
+            {
+                auto start = StageTimings::now();
+                for (int chan = 0; chan < config.channels; ++chan)
+                {
+                    checksum += readChannel(chan);
+                }
+                return StageTimings::elapsedUs(start, StageTimings::now());
+            });
+        };
+
+        Stats stats = timeRead([&](int chan)
+        {
+            SampleRing<float>::Span span = rings[chan].getSpan(0, segSamples);
+            double sum = 0;
+            for (int i = 0; i < span.nFirst; ++i)
+            {
+                sum += span.first[i];
+            }
+            for (int i = 0; i < span.nSecond; ++i)
+            {
+                sum += span.second[i];
+            }
+            return sum;
+        });
+
+        Stats ringIndexStats = timeRead([&](int chan)
+        {
+            double sum = 0;
+            for (int i = 0; i < segSamples; ++i)
+            {
+                sum += rings[chan][i];
+            }
+            return sum;
+        });
+
+        Stats arrayIndexStats = timeRead([&](int chan)
+        {
+            double sum = 0;
+            for (int i = 0; i < segSamples; ++i)
+            {
+                sum += arrays[chan][i];
+            }
+            return sum;
+        });
+
+        return { "ringRead", config, stats, {
+            { "sample_ring_index_us", ringIndexStats.getMean() },
+            { "circular_array_index_us", arrayIndexStats.getMean() },
+            { "checksum", checksum } } };
+    }
+
+    Result benchPipeline(const Config& config, const Options& options, const NoiseSource& noise)
+    {
+        typedef std::vector<std::vector<std::complex<double>>> Spectra;
+        typedef std::vector<std::vector<double>> Coherence;
+
+        int ng1 = config.getGroup1();
+        int ng2 = config.getGroup2();
+        auto tfr = makeTFR(config, options, ng1, ng2);
+
+        FFTArray buffer(config.getSegSamples());
+        FFTArray workBuffer(tfr->getNfft());
+        AtomicallyShared<Coherence> shared(ng1 * ng2, std::vector<double>(config.nFreqs));
+        AtomicScopedWritePtr<Coherence> writePtr(shared);
+
+        auto transform = [&](Spectra& dest)
+        {
+            for (int chan = 0; chan < config.channels; ++chan)
+            {
+                noise.fill(buffer, chan);
+                tfr->computeSpectrum(buffer, workBuffer, dest[chan].data());
+            }
+        };
+
+        auto accumulate = [&](const Spectra& spectra, Coherence& dest)
+        {
+            for (int chan = 0; chan < config.channels; ++chan)
+            {
+                tfr->addSpectrum(spectra[chan].data(), chan);
+            }
+            for (int i = 0, comb = 0; i < ng1; ++i)
+            {
+                for (int j = 0; j < ng2; ++j, ++comb)
+                {
+                    tfr->getMeanCoherence(i, ng1 + j, dest[comb].data(), comb);
+                }
+            }
+        };
+
+        auto publish = [&](const Coherence& coherence)
+        {
+            *writePtr = coherence;
+            writePtr.pushUpdate();
+        };
+
+        Spectra spectraTemplate(config.channels, std::vector<std::complex<double>>(tfr->getSpectrumSize()));
+        Coherence coherenceTemplate(ng1 * ng2, std::vector<double>(config.nFreqs));
+
+        // one after another, timing each stage
+        Spectra spectra = spectraTemplate;
+        Coherence coherence = coherenceTemplate;
+        double stageUs[3] = { 0, 0, 0 };
+        Stats sequential = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+            for (int s = 0; s < PIPELINE_SEGMENTS; ++s)
+            {
+                auto t0 = StageTimings::now();
+                transform(spectra);
+                auto t1 = StageTimings::now();
+                accumulate(spectra, coherence);
+                auto t2 = StageTimings::now();
+                publish(coherence);
+                auto t3 = StageTimings::now();
+                stageUs[0] += StageTimings::elapsedUs(t0, t1);
+                stageUs[1] += StageTimings::elapsedUs(t1, t2);
+                stageUs[2] += StageTimings::elapsedUs(t2, t3);
+            }
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+        double nSequential = double(sequential.getCount()) * PIPELINE_SEGMENTS;
+
+        // pipelined: this thread transforms, two more accumulate and publish
+        SlotQueue<Spectra> spectrumQueue(PIPELINE_QUEUE_SIZE);
+        SlotQueue<Coherence> coherenceQueue(PIPELINE_QUEUE_SIZE);
+        spectrumQueue.map([&](Spectra& slot) { slot = spectraTemplate; });
+        coherenceQueue.map([&](Coherence& slot) { slot = coherenceTemplate; });
+
+        Stats stats = measure(options, [&]()
+        {
+            auto start = StageTimings::now();
+
+            std::thread accumulator([&]()
+            {
+                for (int s = 0; s < PIPELINE_SEGMENTS; ++s)
+                {
+                    Spectra* in;
+                    while ((in = spectrumQueue.getReadSlot()) == nullptr)
+                    {
+                        std::this_thread::yield();
+                    }
+                    Coherence* out;
+                    while ((out = coherenceQueue.getWriteSlot()) == nullptr)
+                    {
+                        std::this_thread::yield();
+                    }
+                    accumulate(*in, *out);
+                    spectrumQueue.finishRead();
+                    coherenceQueue.finishWrite();
+                }
+            });
+
+            std::thread publisher([&]()
+            {
+                for (int s = 0; s < PIPELINE_SEGMENTS; ++s)
+                {
+                    Coherence* in;
+                    while ((in = coherenceQueue.getReadSlot()) == nullptr)
+                    {
+                        std::this_thread::yield();
+                    }
+                    publish(*in);
+                    coherenceQueue.finishRead();
+                }
+            });
+
+            for (int s = 0; s < PIPELINE_SEGMENTS; ++s)
+            {
+                Spectra* out;
+                while ((out = spectrumQueue.getWriteSlot()) == nullptr)
+                {
+                    std::this_thread::yield();
+                }
+                transform(*out);
+                spectrumQueue.finishWrite();
+            }
+
+            accumulator.join();
+            publisher.join();
+            return StageTimings::elapsedUs(start, StageTimings::now());
+        });
+
+        double perSegment = stats.getMean() / PIPELINE_SEGMENTS;
+        double sequentialPerSegment = sequential.getMean() / PIPELINE_SEGMENTS;
+        double slowestStage = *std::max_element(stageUs, stageUs + 3) / nSequential;
+        return { "pipeline", config, stats, {
+            { "segments_per_iteration", double(PIPELINE_SEGMENTS) },
+            { "per_segment_us", perSegment },
+            { "sequential_per_segment_us", sequentialPerSegment },
+            { "speedup", sequentialPerSegment / std::max(perSegment, 1e-9) },
+            { "transform_us", stageUs[0] / nSequential },
+            { "accumulate_us", stageUs[1] / nSequential },
+            { "publish_us", stageUs[2] / nSequential },
+            { "slowest_stage_us", slowestStage } } };
+    }
+
+    void printResult(const Result& result)
+    {
+        const Config& c = result.config;
+        std::cout << std::left << std::setw(22) << result.name << std::right
+            << " ch=" << std::setw(3) << c.channels
+            << " fs=" << std::setw(5) << c.fs
+            << " seg=" << c.segLen << " win=" << c.winLen
+            << " nf=" << std::setw(3) << c.nFreqs
+            << " thr=" << std::setw(2) << c.threads
+            << std::fixed << std::setprecision(3)
+            << "  mean " << std::setw(10) << result.stats.getMean() / 1000 << " ms"
+            << "  p95 " << std::setw(10) << result.stats.getPercentile(95) / 1000 << " ms"
+            << "  (" << result.stats.getCount() << " iters)"
+            << std::defaultfloat << std::endl;
+    }
+
+    std::string jsonString(const std::string& s)
+    {
+        std::string out = "\"";
+        for (char ch : s)
+        {
+            if (ch == '"' || ch == '\\')
+            {
+                out += '\\';
+                out += ch;
+            }
+            else if (static_cast<unsigned char>(ch) < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                out += buf;
+            }
+            else
+            {
+                out += ch;
+            }
+        }
+        return out + "\"";
+    }
+
+    std::string getCompiler()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    bool writeJson(const std::string& path, const Options& options, const std::vector<Result>& results)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+
+        out << std::setprecision(9);
+        out << "{\n"
+            << "  \"meta\": {\n"
+            << "    \"label\": " << jsonString(options.label) << ",\n"
+            << "    \"time\": " << std::time(nullptr) << ",\n"
+            << "    \"fft_backend\": " << jsonString(FFTArray::getBackendName()) << ",\n"
+            << "    \"compiler\": " << jsonString(getCompiler()) << ",\n"
+#ifdef NDEBUG
+            << "    \"assertions\": false,\n"
+#else
+            << "    \"assertions\": true,\n"
+#endif
+            << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "    \"step_len\": " << options.stepLen << ",\n"
+            << "    \"min_time\": " << options.minTime << "\n"
+            << "  },\n"
+            << "  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            const Config& c = r.config;
+            out << (i > 0 ? "," : "") << "\n    {\n"
+                << "      \"name\": " << jsonString(r.name) << ",\n"
+                << "      \"params\": { \"channels\": " << c.channels << ", \"fs\": " << c.fs
+                << ", \"seg_len\": " << c.segLen << ", \"win_len\": " << c.winLen
+                << ", \"n_freqs\": " << c.nFreqs << ", \"threads\": " << c.threads << " },\n"
+                << "      \"iterations\": " << r.stats.getCount() << ",\n"
+                << "      \"us\": { \"mean\": " << r.stats.getMean()
+                << ", \"min\": " << r.stats.getMin()
+                << ", \"p50\": " << r.stats.getPercentile(50)
+                << ", \"p95\": " << r.stats.getPercentile(95)
+                << ", \"max\": " << r.stats.getMax() << " }";
+
+            for (const auto& value : r.extra)
+            {
+                out << ",\n      " << jsonString(value.first) << ": " << value.second;
+            }
+            out << "\n    }";
+        }
+        out << "\n  ]\n}\n";
+
+        return bool(out);
+    }
+
+    template<typename T>
+    bool parseList(const std::string& list, std::vector<T>& dest)
+    {
+        dest.clear();
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (item.empty())
+            {
+                continue;
+            }
+            std::stringstream itemStream(item);
+            T value;
+            if (!(itemStream >> value) || value <= 0)
+            {
+                return false;
+            }
+            dest.push_back(value);
+        }
+        return !dest.empty();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        bool ok = true;
+        if      (arg == "--channels")  { ok = parseList(value, options.channels); }
+        else if (arg == "--fs")        { ok = parseList(value, options.fs); }
+        else if (arg == "--seg")       { ok = parseList(value, options.segLen); }
+        else if (arg == "--win")       { ok = parseList(value, options.winLen); }
+        else if (arg == "--freqs")     { ok = parseList(value, options.nFreqs); }
+        else if (arg == "--threads")   { ok = parseList(value, options.threads); }
+        else if (arg == "--step")      { options.stepLen = std::atof(value.c_str()); ok = options.stepLen > 0; }
+        else if (arg == "--min-time")  { options.minTime = std::atof(value.c_str()); }
+        else if (arg == "--min-iters") { options.minIters = std::max(1, std::atoi(value.c_str())); }
+        else if (arg == "--label")     { options.label = value; }
+        else if (arg == "--out")       { options.outPath = value; }
+        else if (arg == "--only")
+        {
+            std::stringstream ss(value);
+            std::string name;
+            while (std::getline(ss, name, ','))
+            {
+                options.only.insert(name);
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+
+        if (!ok)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "FFT backend: " << FFTArray::getBackendName() << std::endl;
+
+    std::vector<Result> results;
+    auto add = [&](Result result)
+    {
+        printResult(result);
+        results.push_back(std::move(result));
+    };
+
+    for (int fs : options.fs)
+    {
+        for (double segLen : options.segLen)
+        {
+            NoiseSource noise(int(segLen * fs));
+
+            for (double winLen : options.winLen)
+            {
+                if (winLen > segLen)
+                {
+                    std::cerr << "Skipping window length " << winLen << " s, longer than segment length "
+                        << segLen << " s" << std::endl;
+                    continue;
+                }
+
+                for (int nFreqs : options.nFreqs)
+                {
+                    Config config = { options.channels.front(), fs, segLen, winLen, nFreqs, options.threads.front() };
+                    if (options.shouldRun("generateWavelet"))
+                    {
+                        add(benchGenerateWavelet(config, options));
+                    }
+
+                    for (int channels : options.channels)
+                    {
+                        config.channels = channels;
+                        config.threads = options.threads.front();
+                        if (options.shouldRun("getMeanCoherence"))
+                        {
+                            add(benchGetMeanCoherence(config, options, noise));
+                        }
+                        if (options.shouldRun("reduceFrame"))
+                        {
+                            add(benchReduceFrame(config, options));
+                        }
+
+                        for (int threads : options.threads)
+                        {
+                            config.threads = threads;
+                            if (options.shouldRun("addTrial"))
+                            {
+                                add(benchAddTrial(config, options, noise));
+                            }
+                        }
+
+                        config.threads = options.threads.front();
+                        if (options.shouldRun("pipeline"))
+                        {
+                            add(benchPipeline(config, options, noise));
+                        }
+                    }
+                }
+            }
+
+            // these only depend on the amount of data
+            for (int channels : options.channels)
+            {
+                Config config = { channels, fs, segLen, options.winLen.front(), options.nFreqs.front(),
+                    options.threads.front() };
+
+                if (options.shouldRun("synchronizerPushPull"))
+                {
+                    add(benchSynchronizer(config, options, noise));
+                }
+                if (options.shouldRun("enqueueArray"))
+                {
+                    add(benchEnqueueArray(config, options, noise));
+                }
+                if (options.shouldRun("ringEnqueue"))
+                {
+                    add(benchRingEnqueue(config, options, noise));
+                }
+                if (options.shouldRun("ringRead"))
+                {
+                    add(benchRingRead(config, options, noise));
+                }
+            }
+        }
+    }
+
+    if (!writeJson(options.outPath, options, results))
+    {
+        std::cerr << "Failed to write " << options.outPath << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << results.size() << " results to " << options.outPath << std::endl;
+    return 0;
+}
@@ -23,10 +23,204 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "CoherenceNode.h"
 #include "CoherenceNodeEditor.h"
+
+namespace
+{
+    // bands until the user sets their own (for the default 1 - 40 Hz)
+    const char* const DEFAULT_BANDS = "theta 4-8, beta 13-30, gamma 30-40";
+
+    // surrogate thresholds are this percentile of the surrogates
+    const double SURROGATE_PERCENTILE = 95;
+    // surrogate rounds are put off (or abandoned) while the latest segment's real-time factor is above this
+    const float SURROGATE_MAX_REAL_TIME_FACTOR = 0.8f;
+    // and checked for again this often
+    const int SURROGATE_PAUSE_CHECK_MS = 100;
+
+    // longest queue mode holds up process() waiting for a free segment slot before it drops the segment
+    const int MAX_HANDOFF_WAIT_MS = 10;
+
+    // Writes segments into slots taken from the segment pool; subclasses hand full ones on
+    class PooledSegmentSink : public SegmentSink
+    {
+    public:
+        PooledSegmentSink(SlotPool<SegmentData>& pool, int& slot, int& numTrials, std::atomic<int>& numDropped)
+            : pool          (pool)
+            , numDropped    (numDropped)
+            , slot          (slot)
+            , numTrials     (numTrials)
+        {}
+
+        FFTArray* getSegmentBuffer(int chan) override
+        {
+            if (slot == NO_SLOT)
+            {
+                slot = acquireSlot();
+                if (slot == NO_SLOT)
+                {
+                    // not trying again partway through the segment, which would leave a gap in it
+                    slot = DROPPING;
+                }
+            }
+
+            // without a slot, the segmenter only keeps track of positions and the segment is lost
+            return slot >= 0 ? &pool[slot].chans.getReference(chan) : nullptr;
+        }
+
+        void segmentComplete(int64_t startSample, int64_t lastTimestamp) override
+        {
+            if (slot == DROPPING)
+            {
+                ++numDropped;
+                slot = NO_SLOT;
+                numTrials++;
+                return;
+            }
+            if (slot == NO_SLOT)
+            {
+                return;
+            }
+            SegmentData& segment = pool[slot];
+            segment.timestamp = lastTimestamp;
+            segment.index = numTrials;
+            segment.ingestTicks = Time::getHighResolutionTicks();
+            handOff(slot);
+            slot = NO_SLOT;
+            numTrials++;
+        }
+
+    protected:
+        static const int NO_SLOT = -1;
+        static const int DROPPING = -2; // no slot for the segment in progress
+
+        // Returns NO_SLOT if there isn't one
+        virtual int acquireSlot()
+        {
+            return pool.acquire();
+        }
+
+        virtual void handOff(int fullSlot) = 0;
+
+        SlotPool<SegmentData>& pool;
+        std::atomic<int>& numDropped;
+
+    private:
+        int& slot;
+        int& numTrials;
+    };
+
+    // Replaces the segment waiting for the calculation, if it hasn't started on it yet, and
+    // gives that one back to the pool
+    class LatestSegmentSink : public PooledSegmentSink
+    {
+    public:
+        LatestSegmentSink(SlotPool<SegmentData>& pool, int& slot, int& numTrials,
+            std::atomic<int>& latest, std::atomic<int>& numDropped)
+            : PooledSegmentSink (pool, slot, numTrials, numDropped)
+            , latest            (latest)
+        {}
+
+    protected:
+        void handOff(int fullSlot) override
+        {
+            int replaced = latest.exchange(fullSlot);
+            if (replaced != -1)
+            {
+                // the calculation never got to it, and now never will
+                pool.release(replaced);
+                ++numDropped;
+            }
+        }
+
+    private:
+        std::atomic<int>& latest;
+    };
+
+    // Queues every segment, waiting (briefly) for the calculation to free a slot if they're all
+    // taken; a segment still without one is dropped
+    class QueuedSegmentSink : public PooledSegmentSink
+    {
+    public:
+        QueuedSegmentSink(SlotPool<SegmentData>& pool, int& slot, int& numTrials, SlotQueue<int>& queue,
+            WaitableEvent& slotFreed, Thread& reader, std::atomic<int>& numWaits, std::atomic<int>& numDropped)
+            : PooledSegmentSink (pool, slot, numTrials, numDropped)
+            , queue             (queue)
+            , slotFreed         (slotFreed)
+            , reader            (reader)
+            , numWaits          (numWaits)
+        {}
+
+    protected:
+        int acquireSlot() override
+        {
+            int freeSlot = pool.acquire();
+            if (freeSlot == NO_SLOT)
+            {
+                ++numWaits;
+            }
+            // only while there's a calculation thread to free a slot, and not for long: this
+            // holds up the whole signal chain
+            const uint32 deadline = Time::getMillisecondCounter() + MAX_HANDOFF_WAIT_MS;
+            while (freeSlot == NO_SLOT && reader.isThreadRunning())
+            {
+                int remainingMs = int(deadline - Time::getMillisecondCounter());
+                if (remainingMs <= 0)
+                {
+                    break;
+                }
+                slotFreed.wait(remainingMs);
+                freeSlot = pool.acquire();
+            }
+            return freeSlot;
+        }
+
+        void handOff(int fullSlot) override
+        {
+            // the queue has room for every slot in the pool
+            *queue.getWriteSlot() = fullSlot;
+            queue.finishWrite();
+        }
+
+    private:
+        SlotQueue<int>& queue;
+        WaitableEvent& slotFreed;
+        Thread& reader;
+        std::atomic<int>& numWaits;
+    };
+
+    // Next free slot of a pipeline queue, waiting for the stage after it to free one.
+    // Returns nullptr if the thread is asked to exit first.
+    template<typename T>
+    T* waitForWriteSlot(SlotQueue<T>& queue, Thread& thread)
+    {
+        T* slot;
+        while ((slot = queue.getWriteSlot()) == nullptr)
+        {
+            if (thread.threadShouldExit())
+            {
+                return nullptr;
+            }
+            thread.wait(1);
+        }
+        return slot;
+    }
+}
+
 /********** node ************/
 CoherenceNode::CoherenceNode()
     : GenericProcessor  ("Coherence")
     , Thread            ("Coherence Calc")
+    , segmentPoolSize   (6)
+    , ingestSlot        (-1)
+    , segmentHandoff    (HANDOFF_LATEST)
+    , latestSegment     (-1)
+    , numProcessed      (0)
+    , numHandoffWaits   (0)
+    , numSegmentsDropped (0)
+    , spectrumQueue     (PIPELINE_QUEUE_SIZE)
+    , coherenceQueue    (PIPELINE_QUEUE_SIZE)
+    , accumulateStage   ("Coherence Accumulate", *this, &CoherenceNode::runAccumulateStage)
+    , publishStage      ("Coherence Publish", *this, &CoherenceNode::runPublishStage)
+    , meanCoherence     (MAX_COHERENCE_READERS)
     , segLen            (4)
     , freqStep          (1)
     , freqStart         (1)
@@ -36,22 +230,98 @@ CoherenceNode::CoherenceNode()
     , interpRatio       (2)
     , nGroup1Chans      (0)
     , nGroup2Chans      (0)
+    , nGroupCombs       (0)
     , Fs                (0)
     , alpha             (0)
-    , numArtifacts      (0)
+    , averageWindow     (0)
+    , jackknife         (false)
+    , recordFreqValues  (true)
     , ready             (false)
     , group1Channels    ({})
     , group2Channels    ({})
-    , nSamplesWait      (0)
+    , outputMode        (OUTPUT_NONE)
+    , outputBandStart   (4)
+    , outputBandEnd     (8)
+    , triggerSource     (TRIGGER_OFF)
+    , triggerBand       (-1)
+    , triggerBandStart  (4)
+    , triggerBandEnd    (8)
+    , triggerRise       (0.6f)
+    , triggerFall       (0.5f)
+    , triggerRefractory (1)
+    , triggerEventChannel   (0)
+    , triggerArmed      (false)
+    , lastTriggerTimestamp  (-1)
+    , triggerFifo       (TRIGGER_QUEUE_SIZE)
+    , numTriggersDropped    (0)
+    , triggerEventChannelPtr    (nullptr)
+    , triggerOffTimestamp   (-1)
+    , triggerOffChannel (0)
+    , lastEmittedTrigger    ({ -1, 0, 0 })
+    , lastEmittedLatency    (0)
+    , numTriggers       (0)
+    , adaptQuality      (false)
+    , displayedCombination  (-1)
+    , baselineMode      (BASELINE_OFF)
+    , baselineSegments  (0)
+    , baselineCompatible    (false)
+    , surrogates        (false)
+    , numSurrogateRounds    (0)
+    , surrogateRoundActive  (false)
+    , surrogatesPaused      (false)
+    , numSurrogateShifts    (0)
+    , nextSurrogateShift    (0)
+    , numSurrogateShiftsDone    (0)
+    , numSurrogateWorkersBusy   (0)
+    , lastRealTimeFactor    (0)
 {
-    setProcessorType(PROCESSOR_TYPE_SINK);
+    setProcessorType(PROCESSOR_TYPE_FILTER);
+
+    std::vector<CoherenceBand> defaultBands;
+    std::string error;
+    CoherenceBands::parse(DEFAULT_BANDS, defaultBands, error);
+    bands.setBands(defaultBands);
 }
 
 CoherenceNode::~CoherenceNode()
-{}
+{
+    accumulateStage.stopThread(1000);
+    publishStage.stopThread(1000);
+    stopSurrogateWorkers(1000);
+}
 
 void CoherenceNode::createEventChannels() 
-{}
+{
+    const DataChannel* in = getNumInputs() > 0 ? getDataChannel(getTimingChannel()) : nullptr;
+    float sampleRate = in ? in->getSampleRate() : CoreServices::getGlobalSampleRate();
+
+    EventChannel* chan = new EventChannel(EventChannel::TTL, 8, 1, sampleRate, this);
+    chan->setName("Coherence trigger");
+    chan->setDescription("Turns on when band coherence rises above the trigger threshold");
+    chan->setIdentifier("coherence.trigger");
+
+    // event-related metadata
+    eventMetaDataDescriptors.clearQuick();
+
+    MetaDataDescriptor* sourceTimestampDesc = new MetaDataDescriptor(MetaDataDescriptor::INT64, 1,
+        "Source Timestamp", "Timestamp of the last sample of the data that produced this event",
+        "coherence.source.timestamp");
+    chan->addEventMetaData(sourceTimestampDesc);
+    eventMetaDataDescriptors.add(sourceTimestampDesc);
+
+    MetaDataDescriptor* coherenceDesc = new MetaDataDescriptor(MetaDataDescriptor::FLOAT, 1,
+        "Coherence", "Band coherence that crossed the threshold", "coherence.value");
+    chan->addEventMetaData(coherenceDesc);
+    eventMetaDataDescriptors.add(coherenceDesc);
+
+    MetaDataDescriptor* latencyDesc = new MetaDataDescriptor(MetaDataDescriptor::FLOAT, 1,
+        "Latency", "Milliseconds from the last sample arriving to the event being emitted",
+        "coherence.latency");
+    chan->addEventMetaData(latencyDesc);
+    eventMetaDataDescriptors.add(latencyDesc);
+
+    triggerEventChannelPtr = eventChannelArray.add(chan);
+}
 
 AudioProcessorEditor* CoherenceNode::createEditor()
 {
@@ -61,21 +331,23 @@ AudioProcessorEditor* CoherenceNode::createEditor()
 
 void CoherenceNode::process(AudioSampleBuffer& continuousBuffer)
 {  
-    // Upkeep coherence file
-    checkCohFile();
+    // Start or stop writing the coherence file
+    updateRecordingState();
 
-    ///// Add incoming data to data buffer. Let thread get the ok to start at 8seconds of data ////
-    AtomicScopedWritePtr<Array<FFTWArrayType>> dataWriter(dataBuffer);
-    // Check writer
-    if (!dataWriter.isValid())
-    {
-        jassertfalse; // atomic sync data writer broken
-    }
+    // Output channels are written on every buffer, whatever happens to the input below
+    writeOutputChannels(continuousBuffer);
 
-    //for loop over active channels and update buffer with new data
+    emitTriggerEvents();
+
+    ScopedStageTimer ingestTimer(timings[StageTimings::INGEST]);
+
+    ///// Add incoming data to the segment being collected; the thread gets it once it's full ////
+    // Get read pointers of incoming data for each grouped channel
     Array<int> activeInputs = getActiveInputs();
     int nActiveInputs = activeInputs.size();
     int nSamples = 0;
+    int64 firstTimestamp = 0;
+    int nGrouped = 0;
     for (int activeChan = 0; activeChan < nActiveInputs; ++activeChan)
     {
         int chan = activeInputs[activeChan];
@@ -83,180 +355,718 @@ void CoherenceNode::process(AudioSampleBuffer& continuousBuffer)
         if (groupNum != -1)
         {
             int groupIt = (groupNum == 1 ? getGroupIt(groupNum, chan) : getGroupIt(groupNum, chan) + nGroup1Chans);
-            
-            nSamples = getNumSamples(chan); // all channels the same?
-            if (nSamples == 0)
+            segmentInputs[groupIt] = continuousBuffer.getReadPointer(chan);
+            nSamples = getNumSamples(chan); // all channels the same
+            firstTimestamp = int64(getTimestamp(chan));
+            ++nGrouped;
+        }
+    }
+
+    if (nSamples == 0 || nGrouped != int(segmentInputs.size()))
+    {
+        return;
+    }
+
+    if (segmentHandoff == HANDOFF_QUEUE)
+    {
+        QueuedSegmentSink sink(segmentPool, ingestSlot, numTrials, segmentQueue, segmentFreed, *this,
+            numHandoffWaits, numSegmentsDropped);
+        segmenter.addBlock(segmentInputs.data(), nSamples, firstTimestamp, sink);
+    }
+    else
+    {
+        LatestSegmentSink sink(segmentPool, ingestSlot, numTrials, latestSegment, numSegmentsDropped);
+        segmenter.addBlock(segmentInputs.data(), nSamples, firstTimestamp, sink);
+    }
+}
+
+void CoherenceNode::run()
+{  
+    while (!threadShouldExit())
+    {
+        //// Check for new filled data buffer and transform it ////
+        int segmentSlot = -1;
+        if (segmentHandoff == HANDOFF_QUEUE)
+        {
+            if (const int* queued = segmentQueue.getReadSlot())
             {
-                continue;
+                segmentSlot = *queued;
+                segmentQueue.finishRead();
             }
+        }
+        else
+        {
+            segmentSlot = latestSegment.exchange(-1);
+        }
 
-            // Get read pointer of incoming data to move to the stored data buffer
-            const float* rpIn = continuousBuffer.getReadPointer(chan);
+        if (segmentSlot != -1)
+        {
+            SpectrumSlot* slot = waitForWriteSlot(spectrumQueue, *this);
+            if (slot == nullptr)
+            {
+                segmentPool.release(segmentSlot);
+                break;
+            }
+            const SegmentData* segment = &segmentPool[segmentSlot];
 
-            if (nSamplesWaited < nSamplesWait)
+            int qualityLevel = adaptQuality ? governor.getLevel() : int(QualityGovernor::FULL_QUALITY);
+            CumulativeTFR::Subsample subsample = QualityGovernor::getSubsample(qualityLevel);
+            selectUsedPairs(*slot, qualityLevel);
+
+            Array<int> activeInputs = getActiveInputs();
+            int nActiveInputs = activeInputs.size();
+            auto tStart = StageTimings::now();
+            CumulativeTFR::TrialTimes trialTimes;
+            for (int activeChan = 0; activeChan < nActiveInputs; ++activeChan)
             {
-                for (int n = 0; n < nSamples; n++)
+                int chan = activeInputs[activeChan];
+                // get buffer and send it to TFR
+                // Check to make sure channel is in one of our groups
+                int groupNum = getChanGroup(chan);
+                if (groupNum != -1)
                 {
-                    if (std::abs(dataWriter->getReference(groupIt).getAsReal(n - 1) - rpIn[n]) > artifactThreshold)
-                    {     
-                        // Artifact after a previous artifact, reset again. Then wait to let signals settle.
-                        discardCurBuffer(nSamplesWaited + n);
-                        break;
+                    int groupIt = (groupNum == 1 ? getGroupIt(groupNum, chan) : getGroupIt(groupNum, chan) + nGroup1Chans);
+                    if (slot->chanUsed[groupIt])
+                    {
+                        TFR->computeSpectrum(segment->chans.getReference(groupIt), transformBuffer,
+                            slot->spectra[groupIt].data(), &trialTimes, subsample);
                     }
                 }
-                nSamplesWaited += nSamples;
-                break;             
+                else
+                {
+                    // channel isn't part of group 1 or 2
+                    jassertfalse; // ungrouped channel
+                }
+            }
+
+            timings[StageTimings::FFT].add(trialTimes.fftUs);
+            timings[StageTimings::WAVELET_MULTIPLY].add(trialTimes.multiplyUs);
+            timings[StageTimings::IFFT].add(trialTimes.ifftUs);
+
+            slot->timestamp = segment->timestamp;
+            slot->index = segment->index;
+            slot->ingestTicks = segment->ingestTicks;
+            slot->computeUs = StageTimings::elapsedUs(tStart, StageTimings::now());
+            slot->qualityLevel = qualityLevel;
+            spectrumQueue.finishWrite();
+            accumulateStage.notify();
+
+            segmentPool.release(segmentSlot);
+            segmentFreed.signal();
+        }
+    }
+}
+
+void CoherenceNode::runAccumulateStage(Thread& thread)
+{
+    while (!thread.threadShouldExit())
+    {
+        SpectrumSlot* in = spectrumQueue.getReadSlot();
+        if (in == nullptr)
+        {
+            thread.wait(10);
+            continue;
+        }
+
+        CoherenceSlot* out = waitForWriteSlot(coherenceQueue, thread);
+        if (out == nullptr)
+        {
+            break;
+        }
+
+        // Add this segment's spectra to the running averages, then calc coherence at each
+        // combination of interest (at the resolution the transform stage chose)
+        auto tCross = StageTimings::now();
+        CumulativeTFR::Subsample subsample = QualityGovernor::getSubsample(in->qualityLevel);
+        int nChans = nGroup1Chans + nGroup2Chans;
+        for (int chan = 0; chan < nChans; ++chan)
+        {
+            if (in->chanUsed[chan])
+            {
+                TFR->addSpectrum(in->spectra[chan].data(), chan, subsample);
             }
+        }
 
-            // Handle overflow
-            if (nSamplesAdded + nSamples >= segLen * Fs)
+        // (a segment skipped while a round is running just isn't among the surrogates)
+        if (surrogates && in->qualityLevel == QualityGovernor::FULL_QUALITY)
+        {
+            const ScopedTryLock surrogateScope(surrogateLock);
+            if (surrogateScope.isLocked())
             {
-                nSamples = segLen * Fs - nSamplesAdded;
+                surrogate.addSegment(in->spectra);
             }
+        }
 
-            // Add to buffer the new samples.
-            for (int n = 0; n < nSamples; n++)
+        {
+            // bands, and baseline statistics or z-scores, in the same pass while each
+            // combination's coherence is at hand. baselineLock is only taken around the baseline
+            // itself, and not at all while it's off, so the canvas never waits for the calculation.
+            int mode = baselineMode;
+            if (mode != BASELINE_OFF)
             {
-                if (std::abs(dataWriter->getReference(groupIt).getAsReal(n - 1) - rpIn[n]) < artifactThreshold)
+                const ScopedLock baselineScope(baselineLock);
+                if (baseline.getNumPairs() != nGroupCombs || baseline.getNumFreqs() != nFreqs)
                 {
-                    dataWriter->getReference(groupIt).set(nSamplesAdded + n, rpIn[n]);
+                    mode = BASELINE_OFF;
                 }
-                else // Large change. Most likely an artifact. Discard buffer and restart data collection.
+            }
+            out->hasZScore = mode == BASELINE_ZSCORE;
+            out->hasJackknife = TFR->hasJackknife();
+
+            for (int itX = 0, comb = 0; itX < nGroup1Chans; itX++)
+            {
+                for (int itY = 0; itY < nGroup2Chans; itY++, comb++)
                 {
-                    discardCurBuffer(nSamplesAdded + n);
-                    return;
+                    double* coherence = out->coherence[comb].data();
+                    double* stdDev = out->stdDev[comb].data();
+                    bool used = in->combUsed[comb];
+                    if (used)
+                    {
+                        TFR->getMeanCoherence(itX, itY + nGroup1Chans, coherence, comb, subsample, stdDev);
+                        bands.reduce(coherence, out->bandCoherence[comb].data());
+                    }
+                    else
+                    {
+                        // an earlier segment's average, which mustn't count as new data
+                        TFR->getCurrentCoherence(itX, itY + nGroup1Chans, coherence, comb, subsample, stdDev);
+                    }
+                    out->numAveraged[comb] = TFR->getEffectiveSegments(comb);
+
+                    // (a baseline replaced meanwhile has the same layout: see setBaselineMode and loadBaseline)
+                    if (mode == BASELINE_COLLECT && used)
+                    {
+                        const ScopedLock baselineScope(baselineLock);
+                        baseline.addSegment(comb, coherence);
+                    }
+                    else if (mode == BASELINE_ZSCORE)
+                    {
+                        const ScopedLock baselineScope(baselineLock);
+                        baseline.getZScores(comb, coherence, out->zScore[comb].data());
+                    }
+
+                    if (out->hasJackknife)
+                    {
+                        TFR->getJackknifeCoherence(itX, itY + nGroup1Chans, comb, out->corrected[comb].data(),
+                            out->ciLower[comb].data(), out->ciUpper[comb].data(), subsample);
+                    }
                 }
             }
-        }       
+
+            if (mode == BASELINE_COLLECT)
+            {
+                const ScopedLock baselineScope(baselineLock);
+                baselineSegments = baseline.getMinSegments();
+            }
+        }
+
+        double crossUs = StageTimings::elapsedUs(tCross, StageTimings::now());
+        timings[StageTimings::CROSS_SPECTRA].add(crossUs);
+
+        out->timestamp = in->timestamp;
+        out->index = in->index;
+        out->ingestTicks = in->ingestTicks;
+        out->computeUs = in->computeUs + crossUs;
+        out->qualityLevel = in->qualityLevel;
+
+        spectrumQueue.finishRead();
+        notify(); // transform stage may be waiting for a free slot
+        coherenceQueue.finishWrite();
+        publishStage.notify();
+    }
+}
+
+void CoherenceNode::runPublishStage(Thread& thread)
+{
+    MultiReaderWritePtr<CoherenceFrame> coherenceWriter(meanCoherence);
+    if (!coherenceWriter.isValid())
+    {
+        jassertfalse; // atomic sync coherence writer broken
+        return;
+    }
+
+    while (!thread.threadShouldExit())
+    {
+        CoherenceSlot* update = coherenceQueue.getReadSlot();
+        if (update == nullptr)
+        {
+            thread.wait(10);
+            continue;
+        }
+
+        auto tPublish = StageTimings::now();
+
+        if (outputMode != OUTPUT_NONE)
+        {
+            publishOutput(*update);
+        }
+
+        if (triggerSource != TRIGGER_OFF)
+        {
+            checkTrigger(*update);
+        }
+
+        // Hand off to the recorder thread (just a copy, no formatting or disk access here)
+        if (recorder.isRecording())
+        {
+            recorder.pushUpdate(update->timestamp, update->index, update->coherence, update->stdDev,
+                update->bandCoherence);
+        }
+
+        // Update coherence for the display (same sizes, so no allocation), along with the
+        // summaries across combinations so that readers don't have to loop over them
+        coherenceWriter->coherence = update->hasZScore ? update->zScore : update->coherence;
+        coherenceWriter->isZScore = update->hasZScore;
+        coherenceWriter->stdDev = update->stdDev;
+        coherenceWriter->numAveraged = update->numAveraged;
+        coherenceWriter->hasJackknife = update->hasJackknife;
+        if (update->hasJackknife)
+        {
+            coherenceWriter->corrected = update->corrected;
+            coherenceWriter->ciLower = update->ciLower;
+            coherenceWriter->ciUpper = update->ciUpper;
+        }
+        coherenceWriter->reduce();
+        coherenceWriter.pushUpdate();
+
+        auto tEnd = StageTimings::now();
+        double publishUs = StageTimings::elapsedUs(tPublish, tEnd);
+        timings[StageTimings::PUBLISH].add(publishUs);
+        timings[StageTimings::SEGMENT_TOTAL].add(update->computeUs + publishUs);
+        timings[StageTimings::END_TO_END].add(
+            Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - update->ingestTicks) * 1e6);
+
+        double realTimeFactor = StageTimings::getRealTimeFactor((update->computeUs + publishUs) / 1000, segLen);
+        lastRealTimeFactor = float(realTimeFactor);
+        if (adaptQuality)
+        {
+            QualityGovernor::Change change;
+            if (governor.addSegment(realTimeFactor, update->qualityLevel, update->timestamp, change))
+            {
+                logQualityChange(change);
+            }
+        }
+
+        ++numProcessed;
+        coherenceQueue.finishRead();
+        accumulateStage.notify();
+    }
+}
+
+void CoherenceNode::selectUsedPairs(SpectrumSlot& slot, int level)
+{
+    // Everything is needed if anything shows or outputs an average (or the recording would
+    // hold stale values), and while collecting a baseline, so it has every combination's segments
+    int displayed = displayedCombination;
+    bool allUsed = level < QualityGovernor::USED_PAIRS_ONLY || displayed < 0 || outputMode != OUTPUT_NONE
+        || triggerSource == TRIGGER_AVERAGE || recorder.isRecording() || baselineMode == BASELINE_COLLECT;
+
+    slot.chanUsed.assign(slot.chanUsed.size(), allUsed);
+    slot.combUsed.assign(slot.combUsed.size(), allUsed);
+    if (allUsed)
+    {
+        return;
+    }
+
+    for (int comb : { displayed, triggerSource })
+    {
+        if (comb >= 0 && comb < nGroupCombs)
+        {
+            slot.combUsed[comb] = true;
+            slot.chanUsed[comb / nGroup2Chans] = true;
+            slot.chanUsed[nGroup1Chans + comb % nGroup2Chans] = true;
+        }
+    }
+}
+
+void CoherenceNode::logQualityChange(const QualityGovernor::Change& change)
+{
+    String entry = Time::getCurrentTime().toString(true, true, true, true)
+        + " (timestamp " + String(change.timestamp) + "): real-time factor "
+        + String(change.realTimeFactor, 2) + ", " + QualityGovernor::getLevelName(change.fromLevel)
+        + " -> " + QualityGovernor::getLevelName(change.toLevel);
+
+    const ScopedLock lock(qualityLogLock);
+    if (qualityLog.size() == QUALITY_LOG_SIZE)
+    {
+        qualityLog.remove(0);
+    }
+    qualityLog.add(entry);
+}
+
+void CoherenceNode::updateDataBufferSize(int newSize)
+{
+    int totalChans = nGroup1Chans + nGroup2Chans;
+
+    // no writers or readers can exist here
+    // so this can't be called during acquisition
+    auto resizeSegment = [=](SegmentData& segment)
+    {
+        segment.chans.resize(totalChans);
+
+        for (int i = 0; i < totalChans; i++)
+        {
+            segment.chans.getReference(i).resize(newSize);
+        }
+    };
+    segmentPool.resize(jmax(segmentPoolSize, int(MIN_SEGMENT_POOL_SIZE)));
+    segmentPool.map(resizeSegment);
+    segmentQueue.resize(segmentPool.getSize());
+    latestSegment = -1;
+    ingestSlot = -1;
+
+    if (CoherenceEditor* editor = static_cast<CoherenceEditor*>(getEditor()))
+    {
+        editor->updateSegmentMemory();
+    }
+}
+
+size_t CoherenceNode::getSegmentPoolMemory() const
+{
+    size_t bytes = 0;
+    for (int slot = 0; slot < segmentPool.getSize(); ++slot)
+    {
+        for (const FFTArray& chan : segmentPool[slot].chans)
+        {
+            bytes += chan.getMemorySize();
+        }
+    }
+    return bytes;
+}
+
+void CoherenceNode::updateMeanCoherenceSize()
+{
+    meanCoherence.map([=](CoherenceFrame& frame)
+    {
+        frame.resize(nGroup1Chans, nGroup2Chans, nFreqs);
+    });
+}
+
+int CoherenceNode::getNumOutputChannels() const
+{
+    switch (outputMode)
+    {
+    case OUTPUT_AVERAGE:
+        return 1;
+    case OUTPUT_ALL_COMBS:
+        return nGroupCombs;
+    case OUTPUT_BANDS:
+        return nGroupCombs * bands.getNumBands();
+    default:
+        return 0;
+    }
+}
+
+void CoherenceNode::updateOutputChannels()
+{
+    // reset dataChannelArray to # of inputs
+    int numInputs = getNumInputs();
+    int numChannels = dataChannelArray.size();
+    jassert(numChannels >= numInputs);
+    dataChannelArray.removeLast(numChannels - numInputs);
+
+    int numOutputChannels = numInputs > 0 ? getNumOutputChannels() : 0;
+    const DataChannel* baseChan = getDataChannel(getTimingChannel());
+
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        // Copy an input channel so the new channel shares its source (and thus its
+        // timestamps and sample counts), then describe what it actually holds.
+        DataChannel* newChan = new DataChannel(*baseChan);
+        newChan->setBitVolts(1.0f / 1000);
+
+        String bandName = String(outputBandStart) + "-" + String(outputBandEnd) + " Hz";
+        if (outputMode == OUTPUT_AVERAGE)
+        {
+            newChan->setName("COH AVG");
+            newChan->setDescription("Average coherence (x 1000) across all combinations, " + bandName);
+        }
+        else
+        {
+            int comb = i;
+            String nameSuffix;
+            if (outputMode == OUTPUT_BANDS)
+            {
+                const CoherenceBand& band = bands.getBands()[i % bands.getNumBands()];
+                comb = i / bands.getNumBands();
+                nameSuffix = " " + String(band.name);
+                bandName = String(band.name) + " (" + String(band.low) + "-" + String(band.high) + " Hz)";
+            }
+
+            int chanX = group1Channels[comb / nGroup2Chans];
+            int chanY = group2Channels[comb % nGroup2Chans];
+            newChan->setName("COH " + String(chanX + 1) + "x" + String(chanY + 1) + nameSuffix);
+            newChan->setDescription("Coherence (x 1000) between channels " + String(chanX + 1)
+                + " and " + String(chanY + 1) + ", " + bandName);
+        }
+        newChan->setIdentifier("coherence.band");
+        newChan->addToHistoricString(getName());
+        dataChannelArray.add(newChan);
+    }
+
+    settings.numOutputs = dataChannelArray.size();
+
+    // no readers or writers exist here (not acquiring)
+    outputCoherence.reset();
+    outputCoherence.map([=](std::vector<float>& vec)
+    {
+        vec.assign(numOutputChannels, 0.0f);
+    });
+    heldOutput.assign(numOutputChannels, 0.0f);
+}
+
+void CoherenceNode::publishOutput(const CoherenceSlot& update)
+{
+    AtomicScopedWritePtr<std::vector<float>> outputWriter(outputCoherence);
+    if (!outputWriter.isValid())
+    {
+        jassertfalse; // atomic sync output writer broken
+        return;
+    }
+
+    const std::vector<std::vector<double>>& coherence = update.coherence;
+    int nCombs = jmin(nGroupCombs, int(coherence.size()));
+    std::vector<float>& dest = *outputWriter;
+    std::fill(dest.begin(), dest.end(), 0.0f);
+
+    if (outputMode == OUTPUT_BANDS)
+    {
+        // already reduced by the accumulate stage
+        int nBands = bands.getNumBands();
+        for (int comb = 0, i = 0; comb < nCombs; ++comb)
+        {
+            for (int band = 0; band < nBands && i < int(dest.size()); ++band, ++i)
+            {
+                dest[i] = float(update.bandCoherence[comb][band]);
+            }
+        }
+        outputWriter.pushUpdate();
+        return;
+    }
+
+    for (int comb = 0; comb < nCombs; ++comb)
+    {
+        float bandMean = float(getBandCoherence(coherence[comb], outputBandStart, outputBandEnd));
+
+        if (outputMode == OUTPUT_AVERAGE && dest.size() > 0)
+        {
+            dest[0] += bandMean / nCombs;
+        }
+        else if (comb < int(dest.size()))
+        {
+            dest[comb] = bandMean;
+        }
+    }
+
+    outputWriter.pushUpdate();
+}
+
+double CoherenceNode::getBandCoherence(const std::vector<double>& combCoherence,
+    float bandStart, float bandEnd) const
+{
+    int n = jmin(nFreqs, int(combCoherence.size()));
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    // frequency bins inside the band (or the closest one, if the band falls between bins)
+    int fStart = jlimit(0, n - 1, int(std::ceil((bandStart - freqStart) / freqStep)));
+    int fEnd = jlimit(fStart, n - 1, int(std::floor((bandEnd - freqStart) / freqStep)));
+
+    double bandSum = 0;
+    for (int f = fStart; f <= fEnd; ++f)
+    {
+        bandSum += combCoherence[f];
+    }
+    return bandSum / (fEnd - fStart + 1);
+}
+
+void CoherenceNode::checkTrigger(const CoherenceSlot& update)
+{
+    const std::vector<std::vector<double>>& coherence = update.coherence;
+    int nCombs = jmin(nGroupCombs, int(coherence.size()));
+    if (nCombs == 0 || triggerSource >= nCombs)
+    {
+        return;
+    }
+
+    // one of the bands (already reduced by the accumulate stage) or the trigger's own range
+    bool useBand = triggerBand >= 0 && triggerBand < bands.getNumBands();
+    auto getCombValue = [&](int comb)
+    {
+        return useBand ? update.bandCoherence[comb][triggerBand]
+            : getBandCoherence(coherence[comb], triggerBandStart, triggerBandEnd);
+    };
+
+    double value = 0;
+    if (triggerSource == TRIGGER_AVERAGE)
+    {
+        for (int comb = 0; comb < nCombs; ++comb)
+        {
+            value += getCombValue(comb) / nCombs;
+        }
+    }
+    else
+    {
+        value = getCombValue(triggerSource);
+    }
+
+    if (value < triggerFall)
+    {
+        triggerArmed = true;
+        return;
+    }
+
+    bool refractoryOver = lastTriggerTimestamp < 0
+        || update.timestamp - lastTriggerTimestamp >= int64(triggerRefractory * Fs);
+
+    if (!triggerArmed || value < triggerRise || !refractoryOver)
+    {
+        return;
     }
 
-    nSamplesAdded += nSamples;
+    triggerArmed = false;
+    lastTriggerTimestamp = update.timestamp;
 
-    // channel buf is full. Update buffer.
-    if (nSamplesAdded >= segLen * Fs)
+    int start1, size1, start2, size2;
+    triggerFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
     {
-        dataWriter.pushUpdate();
-        // Reset samples added
-        nSamplesAdded = 0;
-        //updateDataBufferSize();
-        numTrials++;
+        // process() isn't keeping up; shouldn't happen at one update per segment
+        ++numTriggersDropped;
+        return;
     }
+
+    TriggerEvent& event = triggerQueue[start1];
+    event.sourceTimestamp = update.timestamp;
+    event.ingestTicks = update.ingestTicks;
+    event.coherence = float(value);
+    triggerFifo.finishedWrite(1);
 }
 
-void CoherenceNode::run()
-{  
-    AtomicScopedReadPtr<Array<FFTWArrayType>> dataReader(dataBuffer);
-    AtomicScopedWritePtr<std::vector<std::vector<double>>> coherenceWriter(meanCoherence);
-    
-    while (!threadShouldExit())
+void CoherenceNode::emitTriggerEvents()
+{
+    if (!triggerEventChannelPtr || getNumInputs() == 0)
     {
-        //// Check for new filled data buffer and run stats ////        
-        if (dataBuffer.hasUpdate())
-        {
-            dataReader.pullUpdate();
-            Array<int> activeInputs = getActiveInputs();
-            int nActiveInputs = activeInputs.size();
-            auto tstart = std::chrono::high_resolution_clock::now();
-            for (int activeChan = 0; activeChan < nActiveInputs; ++activeChan)
-            {
-                int chan = activeInputs[activeChan];
-                // get buffer and send it to TFR
-                // Check to make sure channel is in one of our groups
-                int groupNum = getChanGroup(chan);
-                if (groupNum != -1)
-                {
-                    int groupIt = (groupNum == 1 ? getGroupIt(groupNum, chan) : getGroupIt(groupNum, chan) + nGroup1Chans);
-                    auto t1 = std::chrono::high_resolution_clock::now();
-                    TFR->addTrial(dataReader->getReference(groupIt), groupIt);
-                    auto t2 = std::chrono::high_resolution_clock::now();
-                    std::cout << "add trials took "
-                        << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
-                        << " milliseconds" << std::endl;
-                }
-                else
-                {
-                    // channel isn't part of group 1 or 2
-                    jassertfalse; // ungrouped channel
-                }
-            }
-            
-            
-            //// Get and send updated coherence  ////
-            if (!coherenceWriter.isValid())
-            {
-                jassertfalse; // atomic sync coherence writer broken
-            }
-            
-            // Calc coherence at each combination of interest
-            for (int itX = 0, comb = 0; itX < nGroup1Chans; itX++)
-            {
-                for (int itY = 0; itY < nGroup2Chans; itY++, comb++)
-                {
-                    TFR->getMeanCoherence(itX, itY + nGroup1Chans, coherenceWriter->at(comb).data(), comb);
-                    if (CoreServices::getRecordingStatus())
-                    {
-                           for (int i = 0; i < coherenceWriter->at(comb).size(); i++)
-                        {
-                            const char * buffer = (String(coherenceWriter->at(comb)[i]) + ",").toRawUTF8();
-                            cohFile << buffer;
+        return;
+    }
 
-                        }
-                        cohFile << "\n";
-                    }
+    int timingChan = getTimingChannel();
+    int64 bufferTimestamp = int64(getTimestamp(timingChan));
+    int nSamples = getNumSamples(timingChan);
+    int eventChan = triggerEventChannel;
 
-                }
-             }
-            cohFile << "\n";
-            
+    auto createMetaData = [this](const TriggerEvent& event, float latencyMs)
+    {
+        MetaDataValueArray mdArray;
 
-            // Update coherence and reset data buffer
-            
-            coherenceWriter.pushUpdate();
-            auto tend = std::chrono::high_resolution_clock::now();
-            std::cout << "combs took "
-                << std::chrono::duration_cast<std::chrono::milliseconds>(tend - tstart).count()
-                << " milliseconds" << std::endl;
-        }
+        MetaDataValue* sourceTimestampVal = new MetaDataValue(*eventMetaDataDescriptors[0]);
+        sourceTimestampVal->setValue(event.sourceTimestamp);
+        mdArray.add(sourceTimestampVal);
+
+        MetaDataValue* coherenceVal = new MetaDataValue(*eventMetaDataDescriptors[1]);
+        coherenceVal->setValue(event.coherence);
+        mdArray.add(coherenceVal);
+
+        MetaDataValue* latencyVal = new MetaDataValue(*eventMetaDataDescriptors[2]);
+        latencyVal->setValue(latencyMs);
+        mdArray.add(latencyVal);
+
+        return mdArray;
+    };
+
+    // turn off the current event, if it ends in this buffer
+    if (triggerOffTimestamp >= 0 && triggerOffTimestamp < bufferTimestamp + nSamples)
+    {
+        int sampleNumOff = int(jmax(triggerOffTimestamp - bufferTimestamp, int64(0)));
+        uint8 ttlDataOff = 0;
+        TTLEventPtr eventOff = TTLEvent::createTTLEvent(triggerEventChannelPtr, bufferTimestamp + sampleNumOff,
+            &ttlDataOff, sizeof(uint8), createMetaData(lastEmittedTrigger, lastEmittedLatency), triggerOffChannel);
+        addEvent(triggerEventChannelPtr, eventOff, sampleNumOff);
+        triggerOffTimestamp = -1;
     }
-}
 
-void CoherenceNode::updateDataBufferSize(int newSize)
-{
-    int totalChans = nGroup1Chans + nGroup2Chans;
+    int numReady = triggerFifo.getNumReady();
+    if (numReady == 0)
+    {
+        return;
+    }
 
-    // no writers or readers can exist here
-    // so this can't be called during acquisition
-    dataBuffer.map([=](Array<FFTWArrayType>& arr)
+    int start1, size1, start2, size2;
+    triggerFifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    for (int i = 0; i < size1 + size2; ++i)
     {
-        arr.resize(totalChans);
+        const TriggerEvent& event = triggerQueue[i < size1 ? start1 + i : start2 + i - size1];
 
-        for (int i = 0; i < totalChans; i++)
+        // as early as possible: the first sample of this buffer
+        int64 emitTicks = Time::getHighResolutionTicks();
+        float latencyMs = float(Time::highResolutionTicksToSeconds(emitTicks - event.ingestTicks) * 1000);
+
+        if (triggerOffTimestamp >= 0)
         {
-            arr.getReference(i).resize(newSize);
+            // previous event still on; end it first
+            uint8 ttlDataOff = 0;
+            TTLEventPtr eventOff = TTLEvent::createTTLEvent(triggerEventChannelPtr, bufferTimestamp,
+                &ttlDataOff, sizeof(uint8), createMetaData(lastEmittedTrigger, lastEmittedLatency), triggerOffChannel);
+            addEvent(triggerEventChannelPtr, eventOff, 0);
         }
-    });
+
+        uint8 ttlDataOn = 1 << eventChan;
+        TTLEventPtr eventOn = TTLEvent::createTTLEvent(triggerEventChannelPtr, bufferTimestamp,
+            &ttlDataOn, sizeof(uint8), createMetaData(event, latencyMs), eventChan);
+        addEvent(triggerEventChannelPtr, eventOn, 0);
+
+        triggerLatency.add(latencyMs);
+        ++numTriggers;
+
+        lastEmittedTrigger = event;
+        lastEmittedLatency = latencyMs;
+        triggerOffChannel = eventChan;
+        triggerOffTimestamp = bufferTimestamp
+            + int64(TRIGGER_EVENT_DURATION_MS * triggerEventChannelPtr->getSampleRate() / 1000);
+    }
+
+    triggerFifo.finishedRead(size1 + size2);
 }
 
-void CoherenceNode::updateMeanCoherenceSize()
+int CoherenceNode::getTimingChannel()
+{
+    int numInputs = getNumInputs();
+    return (group1Channels.size() > 0 && group1Channels[0] < numInputs) ? group1Channels[0] : 0;
+}
+
+void CoherenceNode::writeOutputChannels(AudioSampleBuffer& continuousBuffer)
 {
-    meanCoherence.map([=](std::vector<std::vector<double>>& vec)
+    int numOutputChannels = int(heldOutput.size());
+    int numInputs = getNumInputs();
+    if (numOutputChannels == 0 || numInputs == 0)
     {
-        // Update meanCoherence size to new num combinations
-        vec.resize(nGroupCombs);
+        return;
+    }
 
-        // Update meanCoherence to new num freq at each existing combination
-        for (int comb = 0; comb < nGroupCombs; comb++)
+    // pick up new values, if any; otherwise keep holding the last ones
+    if (outputCoherence.hasUpdate())
+    {
+        AtomicScopedReadPtr<std::vector<float>> outputReader(outputCoherence);
+        if (outputReader.isValid())
         {
-            vec[comb].resize(nFreqs);
+            int n = jmin(numOutputChannels, int(outputReader->size()));
+            std::copy(outputReader->begin(), outputReader->begin() + n, heldOutput.begin());
         }
-    });
+    }
+
+    int nSamples = getNumSamples(numInputs); // shares the source of an input channel
+    for (int i = 0; i < numOutputChannels && numInputs + i < continuousBuffer.getNumChannels(); ++i)
+    {
+        // scale to the channel's bitVolts, so coherence of 1 reads as 1000
+        FloatVectorOperations::fill(continuousBuffer.getWritePointer(numInputs + i),
+            heldOutput[i] * 1000, nSamples);
+    }
 }
 
 void CoherenceNode::updateSettings()
 {
-    // Array of samples per channel and if ready to go
-    nSamplesAdded = 0;
-    
     // (Start - end freq) / stepsize
     //freqStep = 1.0/float(winLen*interpRatio);
     freqStep = 1; // for debugging
@@ -301,6 +1111,8 @@ void CoherenceNode::updateSettings()
         
         updateMeanCoherenceSize();
     }
+
+    updateOutputChannels();
 }
 
 void CoherenceNode::setParameter(int parameterIndex, float newValue)
@@ -325,6 +1137,54 @@ void CoherenceNode::setParameter(int parameterIndex, float newValue)
         break;
     case ARTIFACT_THRESHOLD:
         artifactThreshold = static_cast<float>(newValue);
+        segmenter.setArtifactThreshold(artifactThreshold);
+        break;
+    case OUTPUT_MODE:
+        outputMode = static_cast<int>(newValue);
+        break;
+    case OUTPUT_BAND_START:
+        outputBandStart = static_cast<float>(newValue);
+        break;
+    case OUTPUT_BAND_END:
+        outputBandEnd = static_cast<float>(newValue);
+        break;
+    case TRIGGER_SOURCE:
+        triggerSource = static_cast<int>(newValue);
+        break;
+    case TRIGGER_BAND_START:
+        triggerBandStart = static_cast<float>(newValue);
+        break;
+    case TRIGGER_BAND_END:
+        triggerBandEnd = static_cast<float>(newValue);
+        break;
+    case TRIGGER_RISE:
+        triggerRise = static_cast<float>(newValue);
+        break;
+    case TRIGGER_FALL:
+        triggerFall = static_cast<float>(newValue);
+        break;
+    case TRIGGER_REFRACTORY:
+        triggerRefractory = static_cast<float>(newValue);
+        break;
+    case TRIGGER_EVENT_CHANNEL:
+        triggerEventChannel = static_cast<int>(newValue);
+        break;
+    case SEGMENT_HANDOFF:
+        // not during acquisition; the calculation thread picks it up when it starts
+        segmentHandoff = static_cast<int>(newValue);
+        break;
+    case SEGMENT_POOL_SIZE:
+        // takes effect when the TFR is reset
+        segmentPoolSize = jmax(static_cast<int>(newValue), int(MIN_SEGMENT_POOL_SIZE));
+        break;
+    case ADAPT_QUALITY:
+        adaptQuality = newValue != 0;
+        break;
+    case QUALITY_THRESHOLD:
+        governor.setThreshold(newValue);
+        break;
+    case TRIGGER_BAND:
+        triggerBand = static_cast<int>(newValue);
         break;
     }
 }
@@ -380,6 +1240,200 @@ void CoherenceNode::updateAlpha(float a)
     alpha = a;
 }
 
+void CoherenceNode::updateAverageWindow(int numSegments)
+{
+    averageWindow = jmax(numSegments, 0);
+}
+
+void CoherenceNode::updateJackknife(bool enabled)
+{
+    jackknife = enabled;
+}
+
+bool CoherenceNode::updateBands(const String& text, String& error)
+{
+    std::vector<CoherenceBand> newBands;
+    std::string parseError;
+    if (!CoherenceBands::parse(text.toStdString(), newBands, parseError))
+    {
+        error = parseError;
+        return false;
+    }
+
+    bands.setBands(newBands);
+    if (TFR != nullptr)
+    {
+        // (otherwise when it's created)
+        bands.setFreqs(getLayout().freqs);
+    }
+    return true;
+}
+
+void CoherenceNode::updateRecordFreqValues(bool record)
+{
+    recordFreqValues = record;
+}
+
+void CoherenceNode::updateSurrogates(bool enabled)
+{
+    surrogates = enabled;
+}
+
+void CoherenceNode::startSurrogateWorkers()
+{
+    stopSurrogateWorkers(1000);
+
+    surrogatesPaused = false;
+
+    // cores left over by this thread, the other pipeline stages and the processing thread
+    int numWorkers = jlimit(1, int(MAX_SURROGATE_WORKERS), SystemStats::getNumCpus() - 4);
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        PipelineStage* worker = surrogateWorkers.add(new PipelineStage("Coherence Surrogates " + String(i + 1),
+            *this, i == 0 ? &CoherenceNode::runSurrogateRounds : &CoherenceNode::runSurrogateHelper));
+        worker->startThread(SURROGATE_PRIORITY);
+    }
+}
+
+void CoherenceNode::signalSurrogateWorkersToExit()
+{
+    for (PipelineStage* worker : surrogateWorkers)
+    {
+        worker->signalThreadShouldExit();
+        worker->notify();
+    }
+}
+
+void CoherenceNode::stopSurrogateWorkers(int timeoutMs)
+{
+    signalSurrogateWorkersToExit();
+    for (PipelineStage* worker : surrogateWorkers)
+    {
+        worker->stopThread(timeoutMs);
+    }
+    surrogateWorkers.clear();
+}
+
+void CoherenceNode::runSurrogateRounds(Thread& thread)
+{
+    AtomicScopedWritePtr<SurrogateThresholds> thresholdWriter(surrogateThreshold);
+    if (!thresholdWriter.isValid())
+    {
+        jassertfalse; // atomic sync surrogate threshold writer broken
+        return;
+    }
+
+    int waitMs = SURROGATE_INTERVAL_MS;
+    while (!thread.threadShouldExit())
+    {
+        thread.wait(waitMs);
+        if (thread.threadShouldExit())
+        {
+            break;
+        }
+
+        // never compete with a calculation that is falling behind (the published thresholds stay
+        // as they were, and the store keeps taking segments)
+        if (lastRealTimeFactor > SURROGATE_MAX_REAL_TIME_FACTOR)
+        {
+            surrogatesPaused = true;
+            waitMs = SURROGATE_PAUSE_CHECK_MS;
+            continue;
+        }
+        surrogatesPaused = false;
+
+        int64 roundStart = Time::getHighResolutionTicks();
+        bool complete;
+        {
+            const ScopedLock surrogateScope(surrogateLock);
+            // (any shift needs at least 2 segments)
+            if (surrogate.getNumStored() < jmax(2, jmin(int(MIN_SURROGATE_SEGMENTS), surrogate.getStoreSize())))
+            {
+                waitMs = SURROGATE_INTERVAL_MS;
+                continue;
+            }
+
+            // share the shifts out to the helpers, calculate some here, and wait for the rest
+            numSurrogateShifts = surrogate.beginRound();
+            numSurrogateShiftsDone = 0;
+            nextSurrogateShift = 1;
+            surrogateRoundActive = true;
+            for (int i = 1; i < surrogateWorkers.size(); ++i)
+            {
+                surrogateWorkers[i]->notify();
+            }
+
+            computeSurrogateShifts(thread);
+            while (surrogateRoundActive && numSurrogateShiftsDone < numSurrogateShifts && !thread.threadShouldExit())
+            {
+                thread.wait(10);
+            }
+
+            // make sure no helper is still looking at this round before the lock is released
+            surrogateRoundActive = false;
+            while (numSurrogateWorkersBusy > 0)
+            {
+                thread.wait(1);
+            }
+
+            complete = numSurrogateShiftsDone == numSurrogateShifts;
+            if (complete)
+            {
+                surrogate.getThresholds(SURROGATE_PERCENTILE, thresholdWriter->values);
+                thresholdWriter->numSegments = surrogate.getNumRoundSegments();
+            }
+        }
+
+        if (!complete)
+        {
+            // exiting, or abandoned because the calculation fell behind
+            surrogatesPaused = true;
+            waitMs = SURROGATE_PAUSE_CHECK_MS;
+            continue;
+        }
+        thresholdWriter.pushUpdate();
+        ++numSurrogateRounds;
+
+        // at most half the time spent on rounds
+        double roundMs = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - roundStart) * 1000;
+        waitMs = jmax(int(SURROGATE_INTERVAL_MS), int(roundMs));
+    }
+}
+
+void CoherenceNode::runSurrogateHelper(Thread& thread)
+{
+    while (!thread.threadShouldExit())
+    {
+        computeSurrogateShifts(thread);
+        thread.wait(100);
+    }
+}
+
+void CoherenceNode::computeSurrogateShifts(Thread& thread)
+{
+    // (busy before checking for a round, so the round can't end without seeing this)
+    ++numSurrogateWorkersBusy;
+    while (surrogateRoundActive && !thread.threadShouldExit())
+    {
+        // never compete with a calculation that is falling behind: the round is abandoned, so
+        // the store isn't held from the accumulate stage for as long as that lasts
+        if (lastRealTimeFactor > SURROGATE_MAX_REAL_TIME_FACTOR)
+        {
+            surrogateRoundActive = false;
+            break;
+        }
+
+        int shift = nextSurrogateShift++;
+        if (shift > numSurrogateShifts)
+        {
+            break;
+        }
+        surrogate.computeShifts(shift, shift + 1);
+        ++numSurrogateShiftsDone;
+    }
+    --numSurrogateWorkersBusy;
+}
+
 void CoherenceNode::updateReady(bool isReady)
 {
     ready = isReady;
@@ -391,10 +1445,8 @@ void CoherenceNode::resetTFR()
     {
         ready = true;
 
-        nSamplesAdded = 0;
         updateDataBufferSize(segLen*Fs);
         updateMeanCoherenceSize();
-        numArtifacts = 0;
 
         freqStep = 1; // for debugging
         nFreqs = int((freqEnd - freqStart) / freqStep) + 1;
@@ -414,7 +1466,44 @@ void CoherenceNode::resetTFR()
         }
 
         TFR = new CumulativeTFR(nGroup1Chans, nGroup2Chans, nFreqs, nTimes, Fs, winLen, stepLen,
-            freqStep, freqStart, segLen, alpha);
+            freqStep, freqStart, segLen, alpha, averageWindow, jackknife ? JACKKNIFE_GROUPS : 0);
+        bands.setFreqs(getLayout().freqs);
+        resetSegmenter();
+        updatePipelineSize();
+
+        updateRecorderLayout();
+
+        // surrogates for the same number of segments as the last-N average, if it has one
+        {
+            const ScopedLock surrogateScope(surrogateLock);
+            int storeSize = !surrogates ? 0
+                : averageWindow > 0 ? jmin(averageWindow, int(MAX_SURROGATE_SEGMENTS))
+                : int(MAX_SURROGATE_SEGMENTS);
+            surrogate.resize(nGroup1Chans, nGroup2Chans, nFreqs, nTimes, storeSize);
+        }
+        surrogateThreshold.reset();
+        surrogateThreshold.map([=](SurrogateThresholds& thresholds)
+        {
+            thresholds.values.assign(nGroupCombs, std::vector<double>(nFreqs));
+            thresholds.numSegments = 0;
+        });
+        numSurrogateRounds = 0;
+
+        // a baseline only applies to coherence calculated the same way (one being collected
+        // starts over)
+        CoherenceFileHeader layout = getLayout();
+        const ScopedLock baselineScope(baselineLock);
+        baselineCompatible = baseline.isCompatible(layout);
+        if (!baselineCompatible && baselineMode == BASELINE_COLLECT)
+        {
+            baseline.reset(layout);
+            baselineSegments = 0;
+            baselineCompatible = true;
+        }
+        else if (!baselineCompatible)
+        {
+            baselineMode = BASELINE_OFF;
+        }
     }
     else
     {
@@ -422,12 +1511,37 @@ void CoherenceNode::resetTFR()
     }
 }
 
-void CoherenceNode::discardCurBuffer(int nSamples)
+void CoherenceNode::updatePipelineSize()
+{
+    int nChans = nGroup1Chans + nGroup2Chans;
+    int spectrumSize = TFR->getSpectrumSize();
+    spectrumQueue.map([=](SpectrumSlot& slot)
+    {
+        slot.spectra.assign(nChans, std::vector<std::complex<double>>(spectrumSize));
+        slot.chanUsed.assign(nChans, true);
+        slot.combUsed.assign(nGroupCombs, true);
+    });
+    coherenceQueue.map([=](CoherenceSlot& slot)
+    {
+        slot.coherence.assign(nGroupCombs, std::vector<double>(nFreqs));
+        slot.stdDev.assign(nGroupCombs, std::vector<double>(nFreqs));
+        slot.numAveraged.assign(nGroupCombs, 0);
+        slot.bandCoherence.assign(nGroupCombs, std::vector<double>(bands.getNumBands()));
+        slot.zScore.assign(nGroupCombs, std::vector<double>(nFreqs));
+        slot.corrected.assign(nGroupCombs, std::vector<double>(nFreqs));
+        slot.ciLower.assign(nGroupCombs, std::vector<double>(nFreqs));
+        slot.ciUpper.assign(nGroupCombs, std::vector<double>(nFreqs));
+    });
+    spectrumQueue.clear();
+    coherenceQueue.clear();
+    transformBuffer.resize(TFR->getNfft());
+}
+
+void CoherenceNode::resetSegmenter()
 {
-    numArtifacts += float(nSamples) / (segLen * Fs);
-    nSamplesWait = 1 * Fs * -1; // Wait a bit after artifact before we start taking in new data (1sec to be exact)
-    nSamplesAdded = 0;
-    nSamplesWaited = 0;
+    // wait 1 second after an artifact to let the signals settle
+    segmenter.reset(nGroup1Chans + nGroup2Chans, int(segLen * Fs), int(Fs), artifactThreshold);
+    segmentInputs.assign(nGroup1Chans + nGroup2Chans, nullptr);
 }
 
 
@@ -446,8 +1560,49 @@ bool CoherenceNode::enable()
     {       
         // Start coherence calculation thread
         numTrials = 0;
-        numArtifacts = 0;
+        resetSegmenter();
+
+        // (the previous run's stages were stopped in disable)
+        spectrumQueue.clear();
+        coherenceQueue.clear();
+
+        // and don't start on a segment left over from the last run
+        segmentPool.releaseAll();
+        segmentQueue.clear();
+        latestSegment = -1;
+        ingestSlot = -1;
+        numSegmentsDropped = 0;
+        numProcessed = 0;
+        numHandoffWaits = 0;
+
+        // each run starts at full quality
+        governor.reset();
+        {
+            const ScopedLock lock(qualityLogLock);
+            qualityLog.clear();
+        }
+
+        // disarmed until coherence first drops below the fall threshold, so the
+        // inflated estimates from the first few segments don't trigger
+        triggerArmed = false;
+        lastTriggerTimestamp = -1;
+        triggerOffTimestamp = -1;
+        triggerFifo.reset();
+        triggerLatency.reset();
+        numTriggers = 0;
+        numTriggersDropped = 0;
+
+        timings.reset();
+        recorder.setTimingRing(&timings[StageTimings::RECORD]);
+
         startThread(COH_PRIORITY);
+        accumulateStage.startThread(COH_PRIORITY);
+        publishStage.startThread(COH_PRIORITY);
+        recorder.startThread();
+        if (surrogates)
+        {
+            startSurrogateWorkers();
+        }
         //editor->enable();
     }
     return isEnabled;
@@ -458,41 +1613,156 @@ bool CoherenceNode::disable()
     CoherenceEditor* editor = static_cast<CoherenceEditor*>(getEditor());
     editor->disable();
 
+    // all asked to exit before waiting on any, so they drain together
     signalThreadShouldExit();
+    accumulateStage.signalThreadShouldExit();
+    publishStage.signalThreadShouldExit();
+    signalSurrogateWorkersToExit();
+    notify();
+    accumulateStage.notify();
+    publishStage.notify();
+
+    // and stopped before returning: resetTFR and updatePipelineSize replace what they use
+    stopThread(1000);
+    accumulateStage.stopThread(1000);
+    publishStage.stopThread(1000);
+    stopSurrogateWorkers(1000);
+
+    // finishes writing any queued coherence and closes the file
+    recorder.stopRecording();
+    recorder.stopThread(1000);
 
     return true;
 }
 
-void CoherenceNode::checkCohFile()
+void CoherenceNode::updateRecordingState()
 {
-    if (CoreServices::getRecordingStatus())
+    bool shouldRecord = CoreServices::getRecordingStatus();
+    if (shouldRecord == recorder.isRecording())
     {
-        if (!cohFile.is_open())
+        return;
+    }
+
+    if (shouldRecord)
+    {
+        File recordingDir = CoreServices::RecordNode::getRecordingPath();
+        String fileName = "SEG" + String(segLen) + "_WIN" + String(winLen);
+
+        int expNum = CoreServices::RecordNode::getExperimentNumber();
+        if (expNum > 1)
         {
-            auto now = std::chrono::system_clock::now();
-            std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+            fileName += "_" + String(expNum);
+        }
 
-            File file = CoreServices::RecordNode::getRecordingPath();
-            String recordingDir(file.getFullPathName());
-            // change path to recordingDir
-            //const char * path = ("C:\\Users\\Ephys\\Desktop\\coh-params\\" + String(segLen) + "_" + String(winLen) + "_" + String(now_time) + ".txt").toRawUTF8();
-            int expNum = CoreServices::RecordNode::getExperimentNumber();
-            if (expNum > 1)
-            {
-                path = (recordingDir + "\\SEG" + String(segLen) + "_WIN" + String(winLen) + "_" + String(expNum) + ".txt").toRawUTF8();
-            }
-            else
-            {
-                path = (recordingDir + "\\SEG" + String(segLen) + "_WIN" + String(winLen) + ".txt").toRawUTF8();
-            }
+        recorder.startRecording(recordingDir.getChildFile(fileName + ".coh"));
+    }
+    else
+    {
+        recorder.stopRecording();
+    }
+}
+
+void CoherenceNode::updateRecorderLayout()
+{
+    CoherenceFileHeader header = getLayout();
+    header.hasStdDev = true;
+    header.hasFreqValues = recordFreqValues;
+    header.bands = bands.getBands();
+    recorder.setLayout(header);
+}
+
+CoherenceFileHeader CoherenceNode::getLayout() const
+{
+    CoherenceFileHeader header;
+    header.sampleRate = Fs;
+    header.segLen = segLen;
+    header.winLen = winLen;
+    header.stepLen = stepLen;
+    header.alpha = alpha;
+    header.averageWindow = averageWindow;
+
+    for (int f = 0; f < nFreqs; f++)
+    {
+        header.freqs.push_back(freqStart + f * freqStep);
+    }
 
-            cohFile.open(path);
+    for (int itX = 0; itX < nGroup1Chans; itX++)
+    {
+        for (int itY = 0; itY < nGroup2Chans; itY++)
+        {
+            header.pairs.emplace_back(group1Channels[itX], group2Channels[itY]);
         }
     }
-    else if (cohFile.is_open())
+
+    return header;
+}
+
+bool CoherenceNode::setBaselineMode(int mode)
+{
+    if (mode == BASELINE_COLLECT)
+    {
+        // (the new baseline is allocated before the accumulate stage is held up)
+        CoherenceBaseline fresh;
+        fresh.reset(getLayout());
+
+        const ScopedLock baselineScope(baselineLock);
+        baseline.swap(fresh);
+        baselineSegments = 0;
+        baselineCompatible = true;
+    }
+    else if (mode == BASELINE_ZSCORE && getBaselineSegments() < 2)
+    {
+        return false;
+    }
+    baselineMode = mode;
+    return true;
+}
+
+uint64 CoherenceNode::getBaselineSegments() const
+{
+    return ready && baselineCompatible ? baselineSegments.load() : 0;
+}
+
+bool CoherenceNode::saveBaseline(const File& file, String& error)
+{
+    // copy, so the accumulate stage doesn't wait for the disk (sized first, so the copy under
+    // the lock doesn't allocate when the baseline matches the current layout)
+    CoherenceBaseline copy;
+    copy.reset(getLayout());
+    {
+        const ScopedLock baselineScope(baselineLock);
+        copy = baseline;
+    }
+
+    if (!copy.save(file.getFullPathName().toStdString()))
+    {
+        error = copy.getError();
+        return false;
+    }
+    return true;
+}
+
+bool CoherenceNode::loadBaseline(const File& file, String& error)
+{
+    CoherenceBaseline loaded;
+    if (!loaded.load(file.getFullPathName().toStdString()))
+    {
+        error = loaded.getError();
+        return false;
+    }
+
+    if (!ready || !loaded.isCompatible(getLayout()))
     {
-        cohFile.close();
+        error = file.getFileName() + " was collected with different channels, frequencies or settings "
+            "(segment, window and step length, sample rate and averaging). Reset with the same ones first.";
+        return false;
     }
+
+    const ScopedLock baselineScope(baselineLock);
+    baseline.swap(loaded);
+    baselineSegments = baseline.getMinSegments();
+    baselineCompatible = true;
+    return true;
 }
 
 
@@ -506,7 +1776,15 @@ Array<int> CoherenceNode::getActiveInputs()
         return Array<int>();
     }
 
-    Array<int> activeChannels = ed->getActiveChannels();
+    // leave out our own output channels
+    Array<int> activeChannels;
+    for (int chan : ed->getActiveChannels())
+    {
+        if (chan < numInputs)
+        {
+            activeChannels.add(chan);
+        }
+    }
     return activeChannels;
 }
 
@@ -535,6 +1813,26 @@ void CoherenceNode::saveCustomParametersToXml(XmlElement* parentElement)
 
     // ------ Save Other Params ------ //
     mainNode->setAttribute("alpha", alpha);
+    mainNode->setAttribute("averageWindow", averageWindow);
+    mainNode->setAttribute("jackknife", jackknife);
+    mainNode->setAttribute("surrogates", surrogates);
+    mainNode->setAttribute("bands", String(CoherenceBands::toString(bands.getBands())));
+    mainNode->setAttribute("recordFreqValues", recordFreqValues);
+    mainNode->setAttribute("outputMode", outputMode);
+    mainNode->setAttribute("outputBandStart", outputBandStart);
+    mainNode->setAttribute("outputBandEnd", outputBandEnd);
+    mainNode->setAttribute("triggerSource", triggerSource);
+    mainNode->setAttribute("triggerBand", triggerBand);
+    mainNode->setAttribute("triggerBandStart", triggerBandStart);
+    mainNode->setAttribute("triggerBandEnd", triggerBandEnd);
+    mainNode->setAttribute("triggerRise", triggerRise);
+    mainNode->setAttribute("triggerFall", triggerFall);
+    mainNode->setAttribute("triggerRefractory", triggerRefractory);
+    mainNode->setAttribute("triggerEventChannel", triggerEventChannel);
+    mainNode->setAttribute("segmentHandoff", segmentHandoff);
+    mainNode->setAttribute("segmentPoolSize", segmentPoolSize);
+    mainNode->setAttribute("adaptQuality", adaptQuality);
+    mainNode->setAttribute("qualityThreshold", governor.getThreshold());
 }
 
 void CoherenceNode::loadCustomParametersFromXml()
@@ -580,6 +1878,27 @@ void CoherenceNode::loadCustomParametersFromXml()
             }
             // Load other params
             alpha = mainNode->getDoubleAttribute("alpha");
+            averageWindow = jmax(mainNode->getIntAttribute("averageWindow", 0), 0);
+            jackknife = mainNode->getBoolAttribute("jackknife", false);
+            surrogates = mainNode->getBoolAttribute("surrogates", false);
+            String bandError;
+            updateBands(mainNode->getStringAttribute("bands", DEFAULT_BANDS), bandError);
+            recordFreqValues = mainNode->getBoolAttribute("recordFreqValues", true);
+            outputMode = mainNode->getIntAttribute("outputMode", OUTPUT_NONE);
+            outputBandStart = mainNode->getDoubleAttribute("outputBandStart", 4);
+            outputBandEnd = mainNode->getDoubleAttribute("outputBandEnd", 8);
+            triggerSource = mainNode->getIntAttribute("triggerSource", TRIGGER_OFF);
+            triggerBand = mainNode->getIntAttribute("triggerBand", -1);
+            triggerBandStart = mainNode->getDoubleAttribute("triggerBandStart", 4);
+            triggerBandEnd = mainNode->getDoubleAttribute("triggerBandEnd", 8);
+            triggerRise = mainNode->getDoubleAttribute("triggerRise", 0.6);
+            triggerFall = mainNode->getDoubleAttribute("triggerFall", 0.5);
+            triggerRefractory = mainNode->getDoubleAttribute("triggerRefractory", 1);
+            triggerEventChannel = mainNode->getIntAttribute("triggerEventChannel", 0);
+            segmentHandoff = mainNode->getIntAttribute("segmentHandoff", HANDOFF_LATEST);
+            segmentPoolSize = jmax(mainNode->getIntAttribute("segmentPoolSize", 6), int(MIN_SEGMENT_POOL_SIZE));
+            adaptQuality = mainNode->getBoolAttribute("adaptQuality", false);
+            governor.setThreshold(mainNode->getDoubleAttribute("qualityThreshold", 0.8));
         }
         
         //Start TFR
@@ -38,15 +38,76 @@ in units of z-score.
 
 //#include "CoherenceVisualizer.h"
 //
-#include "AtomicSynchronizer.h"
-#include "CumulativeTFR.h"
+#include "Core/AtomicSynchronizer.h"
+#include "Core/CoherenceBands.h"
+#include "Core/CoherenceBaseline.h"
+#include "Core/CoherenceFrame.h"
+#include "Core/CumulativeTFR.h"
+#include "CoherenceRecorder.h"
+#include "Core/LatencyHistogram.h"
+#include "Core/MultiReaderSynchronizer.h"
+#include "Core/QualityGovernor.h"
+#include "Core/Segmenter.h"
+#include "Core/SlotPool.h"
+#include "Core/SlotQueue.h"
+#include "Core/StageTimings.h"
+#include "Core/SurrogateCoherence.h"
 
-#include <time.h>
 #include <vector>
-#include <chrono>
-#include <ctime> 
 #include <iostream>
-#include<fstream>
+#include <atomic>
+
+// One segment of data for each grouped channel, handed from process() to the calculation thread
+// as an index into the segment pool
+struct SegmentData
+{
+    Array<FFTArray> chans;
+    int64 timestamp = 0; // timestamp of the last sample in the segment
+    uint32 index = 0;    // number of segments completed before this one
+    int64 ingestTicks = 0; // high resolution ticks when the last sample was received
+};
+
+// Spectra of one segment, handed from the transform stage to the accumulate stage
+struct SpectrumSlot
+{
+    std::vector<std::vector<std::complex<double>>> spectra; // # grouped channels x (# freqs * # times)
+    int64 timestamp = 0;
+    uint32 index = 0;
+    int64 ingestTicks = 0;
+    double computeUs = 0; // time spent on this segment so far
+    int qualityLevel = QualityGovernor::FULL_QUALITY; // what the transform stage computed
+    std::vector<bool> chanUsed; // # grouped channels; unused ones weren't transformed
+    std::vector<bool> combUsed; // # combinations; unused ones keep their earlier averages
+};
+
+// Coherence after one segment, handed from the accumulate stage to the publish stage
+struct CoherenceSlot
+{
+    std::vector<std::vector<double>> coherence; // # combinations x # freqs
+    std::vector<std::vector<double>> stdDev;    // of the coherence over the times of interest
+    std::vector<double> numAveraged;            // # combinations: effective segments in each average
+    std::vector<std::vector<double>> bandCoherence; // # combinations x # bands
+    std::vector<std::vector<double>> zScore;    // of the coherence against the baseline, if hasZScore
+    bool hasZScore = false;
+    // jackknife bias-corrected coherence and its 95% confidence interval, if hasJackknife
+    std::vector<std::vector<double>> corrected;
+    std::vector<std::vector<double>> ciLower;
+    std::vector<std::vector<double>> ciUpper;
+    bool hasJackknife = false;
+    int64 timestamp = 0;
+    uint32 index = 0;
+    int64 ingestTicks = 0;
+    double computeUs = 0;
+    int qualityLevel = QualityGovernor::FULL_QUALITY;
+};
+
+// Trigger detected by the publish stage, waiting for process() to emit its TTL event
+struct TriggerEvent
+{
+    int64 sourceTimestamp; // timestamp of the last sample of the segment that produced it
+    int64 ingestTicks;
+    float coherence;
+};
 
 class CoherenceNode : public GenericProcessor, public Thread
 {
@@ -70,7 +131,7 @@ public:
     bool enable() override;
     bool disable() override;
 
-    // thread function - coherence calculation
+    // thread function - transform stage of the coherence calculation
     void run() override;
 
     // Handle changing channels/groups
@@ -90,9 +151,81 @@ public:
 
 private:
 
-    AtomicallyShared<Array<FFTWArrayType>> dataBuffer;
-    // # Freqs x # Combinations
-    AtomicallyShared<std::vector<std::vector<double>>> meanCoherence;
+    // Segment buffers, shared by process() (which fills one at a time) and the transform stage
+    // (which works on one at a time); full ones wait in between according to the hand-off mode.
+    // The pool size sets how many can wait; it takes effect when the TFR is reset.
+    SlotPool<SegmentData> segmentPool;
+    int segmentPoolSize;
+    static const int MIN_SEGMENT_POOL_SIZE = 3; // filling, waiting and being transformed
+    int ingestSlot; // pool slot process() is filling, -1 if none yet, -2 if the segment has none (processing thread)
+
+    // Bytes held by the segment pool, shown in the editor
+    size_t getSegmentPoolMemory() const;
+
+    // How segments get from process() to the calculation
+    enum SegmentHandoff
+    {
+        HANDOFF_LATEST = 1, // (combo box ids) through latestSegment: the calculation always gets the newest
+                            // segment, and one it falls behind on is dropped (and counted)
+        HANDOFF_QUEUE       // through segmentQueue: if the pool runs out, process() waits (up to
+                            // MAX_HANDOFF_WAIT_MS) for the calculation to free a slot before dropping one
+    };
+
+    int segmentHandoff;
+    std::atomic<int> latestSegment; // latest mode: pool slot of the newest full segment, or -1
+    SlotQueue<int> segmentQueue;    // queue mode: pool slots of full segments, oldest first
+    WaitableEvent segmentFreed;     // signalled by the transform stage when it frees a slot
+
+    // Segments that came out of the pipeline, and (queue mode) segments process() had to wait for
+    std::atomic<int> numProcessed;
+    std::atomic<int> numHandoffWaits;
+
+    // Segments the calculation fell behind on and never saw
+    std::atomic<int> numSegmentsDropped;
+    int getNumDropped() const { return numSegmentsDropped; }
+
+    // The calculation is a pipeline of three stages on their own threads, so that successive
+    // segments overlap: transform (this thread's run(): FFTs and wavelet convolution of each
+    // channel) -> accumulate (running averages, cross-spectra and coherence) -> publish (band
+    // outputs, trigger, recorder and display). The queues between them are bounded; a stage
+    // waits when the next one is full, so the running averages still see every segment in order.
+    class PipelineStage : public Thread
+    {
+    public:
+        using Body = void (CoherenceNode::*)(Thread&);
+
+        PipelineStage(const String& name, CoherenceNode& node, Body body)
+            : Thread    (name)
+            , node      (node)
+            , body      (body)
+        {}
+
+        void run() override { (node.*body)(*this); }
+
+    private:
+        CoherenceNode& node;
+        const Body body;
+    };
+
+    static const int PIPELINE_QUEUE_SIZE = 3;
+    SlotQueue<SpectrumSlot> spectrumQueue;
+    SlotQueue<CoherenceSlot> coherenceQueue;
+    FFTArray transformBuffer; // for the inverse FFTs of the transform stage
+
+    PipelineStage accumulateStage;
+    PipelineStage publishStage;
+
+    void runAccumulateStage(Thread& thread);
+    void runPublishStage(Thread& thread);
+
+    // Size the queues' slots for the current TFR (no stage may be running)
+    void updatePipelineSize();
+    // Coherence of each combination, latest after each segment, with the average, per-channel
+    // averages and min/max envelopes across combinations already reduced by the publish stage.
+    // Each consumer (the canvas, and any other display or publisher) reads it with its own
+    // MultiReaderReadPtr, without copying.
+    static const int MAX_COHERENCE_READERS = 4;
+    MultiReaderShared<CoherenceFrame> meanCoherence;
 
     ScopedPointer<CumulativeTFR> TFR;
     Array<bool> CHANNEL_READY;
@@ -120,7 +253,7 @@ private:
     // returns the region for the requested channel
     int getChanGroup(int chan);
 
-    // Append FFTWArrays to data buffer
+    // Append FFTArrays to data buffer
     void updateDataBufferSize(int newSize);
     void updateMeanCoherenceSize();
 
@@ -140,35 +273,227 @@ private:
     float Fs;
 
     float alpha;
+    int averageWindow; // average over this many of the latest segments (0: all of them)
+    bool jackknife;    // keep jackknife groups for bias-corrected coherence (not exponential)
+
+    // Segments are split between this many groups for the jackknife
+    static const int JACKKNIFE_GROUPS = 10;
 
-    int nSamplesAdded; // holds how many samples were added for each channel
     AudioBuffer<float> channelData; // Holds the segment buffer for each channel.
-    int nSamplesWait; // How many seconds to wait after an artifact is seen.
-    int nSamplesWaited; // Holds how many samples we've waited after an artifact. (wait 1 second before getting data again)
+
+    // Cuts incoming data into segments and drops those with artifacts
+    Segmenter segmenter;
+    std::vector<const float*> segmentInputs; // read pointer for each grouped channel, in TFR order
+    void resetSegmenter();
 
     // Total Combinations
     int nGroupCombs;
 
     // from 0 to 10
     static const int COH_PRIORITY = 5;
-    const char * path; 
 
     // Get iterator for this channel in it's respective group
     int getGroupIt(int group, int chan);
 
     void updateGroup(Array<int> group1Channels, Array<int> group2Channels);
     void updateAlpha(float alpha);
+    void updateAverageWindow(int numSegments);
+    void updateJackknife(bool enabled);
     void resetTFR();
     void updateReady(bool isReady);
 
     // Artifact checking
-    void discardCurBuffer(int nSamples);
     float artifactThreshold;
     int numTrials;
-    float numArtifacts;
 
-    std::ofstream cohFile;
-    void checkCohFile();
+    // Frequency bands (see CoherenceBands), reduced from each combination's coherence by the
+    // accumulate stage in the same pass. They're always recorded (alone, unless recordFreqValues
+    // is set), and can be output or trigger events without going back to the frequencies.
+    // Changed only while not acquiring.
+    CoherenceBands bands;
+    bool recordFreqValues;
+
+    // Returns false (with the reason in error) if the text isn't a valid list of bands
+    bool updateBands(const String& text, String& error);
+    void updateRecordFreqValues(bool record);
+
+    // Band-averaged coherence published as extra continuous channels, held between updates
+    enum OutputMode
+    {
+        OUTPUT_NONE = 1,    // (combo box ids)
+        OUTPUT_AVERAGE,     // one channel, average across all combinations, in the output band
+        OUTPUT_ALL_COMBS,   // one channel per combination, in the output band
+        OUTPUT_BANDS        // one channel per combination and band (combination-major)
+    };
+
+    int outputMode;
+    float outputBandStart;
+    float outputBandEnd;
+    AtomicallyShared<std::vector<float>> outputCoherence;
+    std::vector<float> heldOutput; // values currently written to the output channels
+
+    // Number of extra channels for the current output mode
+    int getNumOutputChannels() const;
+    // Add/remove output channels after dataChannelArray has been rebuilt from the inputs
+    void updateOutputChannels();
+    // Band-average the latest coherence (or take its bands) and publish it to process() (publish stage)
+    void publishOutput(const CoherenceSlot& update);
+    // Mean of one combination's coherence over the frequencies in [bandStart, bandEnd]
+    double getBandCoherence(const std::vector<double>& combCoherence, float bandStart, float bandEnd) const;
+    // Fill the output channels with the latest published values (processing thread)
+    void writeOutputChannels(AudioSampleBuffer& continuousBuffer);
+
+    // Closed-loop trigger: a TTL event when band coherence of the chosen combination (or the
+    // average) rises above triggerRise, re-armed once it falls below triggerFall and the
+    // refractory period has passed. Detection happens in the publish stage; process()
+    // emits the events and measures latency from the segment's last sample arriving.
+    enum TriggerSource
+    {
+        TRIGGER_OFF = -2,
+        TRIGGER_AVERAGE = -1
+        // >= 0: combination index
+    };
+
+    int triggerSource;
+    int triggerBand; // one of the bands, or -1 for [triggerBandStart, triggerBandEnd]
+    float triggerBandStart;
+    float triggerBandEnd;
+    float triggerRise;
+    float triggerFall;
+    float triggerRefractory; // seconds
+    int triggerEventChannel; // TTL line, 0-based
+
+    // detector state (publish stage)
+    bool triggerArmed;
+    int64 lastTriggerTimestamp;
+
+    // publish stage -> processing thread
+    static const int TRIGGER_QUEUE_SIZE = 16;
+    TriggerEvent triggerQueue[TRIGGER_QUEUE_SIZE];
+    AbstractFifo triggerFifo;
+    std::atomic<int> numTriggersDropped;
+
+    // processing thread
+    const EventChannel* triggerEventChannelPtr;
+    OwnedArray<MetaDataDescriptor> eventMetaDataDescriptors;
+    int64 triggerOffTimestamp; // when to turn the current event off, or -1
+    int triggerOffChannel;
+    TriggerEvent lastEmittedTrigger; // metadata for the off event
+    float lastEmittedLatency;
+    static const int TRIGGER_EVENT_DURATION_MS = 10;
+
+    // ingest-to-emit latency of each event
+    LatencyHistogram triggerLatency;
+    std::atomic<int> numTriggers;
+
+    // Run the detector on a new coherence update (publish stage)
+    void checkTrigger(const CoherenceSlot& update);
+    // Emit queued events and turn finished ones off (processing thread)
+    void emitTriggerEvents();
+
+    // Input channel whose source provides timestamps for output channels and events
+    int getTimingChannel();
+
+    // Time spent in each stage of the pipeline, shown in the canvas
+    StageTimings timings;
+
+    // Optionally lower the resolution while the calculation can't keep up (see QualityGovernor).
+    // The transform stage picks the level for each segment, the publish stage feeds back its
+    // real-time factor, and changes are logged with the time and segment timestamp.
+    bool adaptQuality;
+    QualityGovernor governor;
+    std::atomic<int> displayedCombination; // set by the canvas; -1 for the average
+
+    CriticalSection qualityLogLock;
+    StringArray qualityLog; // most recent changes, oldest first
+    static const int QUALITY_LOG_SIZE = 20;
+
+    // Which channels and combinations a segment computed at level needs (transform stage)
+    void selectUsedPairs(SpectrumSlot& slot, int level);
+    // Log a change of level (publish stage)
+    void logQualityChange(const QualityGovernor::Change& change);
+
+    // Writes coherence to a binary file in the recording directory while recording
+    CoherenceRecorder recorder;
+    void updateRecordingState();
+    void updateRecorderLayout();
+
+    // Frequencies, pairs and settings of the coherence the current TFR produces
+    CoherenceFileHeader getLayout() const;
+
+    // Baseline for showing coherence as a z-score. While collecting, the accumulate stage adds
+    // each segment's coherence to it; in z-score mode it converts each combination's coherence
+    // in the same pass, and the display shows the z-scores (the outputs, trigger and recording
+    // stay in coherence). baselineLock is held only while the baseline itself is used or replaced;
+    // its segment count and whether it matches the current layout are published atomically, so
+    // the canvas reads them without the lock.
+    enum BaselineMode
+    {
+        BASELINE_OFF,
+        BASELINE_COLLECT,
+        BASELINE_ZSCORE
+    };
+
+    std::atomic<int> baselineMode;
+    CoherenceBaseline baseline;
+    CriticalSection baselineLock;
+    std::atomic<uint64> baselineSegments; // baseline.getMinSegments()
+    std::atomic<bool> baselineCompatible; // with the current layout
+
+    // Collecting starts a new baseline. Z-score mode needs a baseline of at least 2 segments
+    // with the current layout; returns false if there isn't one.
+    bool setBaselineMode(int mode);
+    // Fewest segments any combination's baseline has, or 0 if it doesn't match the current layout
+    uint64 getBaselineSegments() const;
+    bool saveBaseline(const File& file, String& error);
+    // Replaces the baseline if the file's has the current layout
+    bool loadBaseline(const File& file, String& error);
+
+    // Optional significance thresholds from surrogates (see SurrogateCoherence), calculated in
+    // the background. The accumulate stage copies each full-quality segment's spectra into the
+    // store, but skips it rather than wait while a round holds surrogateLock. Rounds run every
+    // SURROGATE_INTERVAL_MS (or as long as the last one took, if more) on low-priority workers,
+    // one per spare core, which take shifts one at a time. While the calculation is falling
+    // behind, no round starts and a running one is abandoned, releasing the lock. The first
+    // worker runs the rounds and publishes the thresholds.
+    bool surrogates;
+    SurrogateCoherence surrogate;
+    CriticalSection surrogateLock;
+    struct SurrogateThresholds
+    {
+        std::vector<std::vector<double>> values; // # combinations x # freqs
+        int numSegments = 0; // that the surrogates are over (see SurrogateCoherence::scaleThreshold)
+    };
+    AtomicallyShared<SurrogateThresholds> surrogateThreshold;
+    std::atomic<int> numSurrogateRounds; // published since the TFR was reset
+    std::atomic<bool> surrogatesPaused;  // put off while the calculation is behind (thresholds are stale)
+    OwnedArray<PipelineStage> surrogateWorkers;
+
+    // the current round
+    std::atomic<bool> surrogateRoundActive;
+    std::atomic<int> numSurrogateShifts;
+    std::atomic<int> nextSurrogateShift;
+    std::atomic<int> numSurrogateShiftsDone;
+    std::atomic<int> numSurrogateWorkersBusy;
+
+    // of the latest segment (publish stage)
+    std::atomic<float> lastRealTimeFactor;
+
+    static const int SURROGATE_PRIORITY = 1;
+    static const int SURROGATE_INTERVAL_MS = 2000;
+    static const int MIN_SURROGATE_SEGMENTS = 20;
+    static const int MAX_SURROGATE_SEGMENTS = 64; // store size, unless the last-N window is shorter
+    static const int MAX_SURROGATE_WORKERS = 8;
+
+    void updateSurrogates(bool enabled);
+    // (Re)starts the workers for a new acquisition
+    void startSurrogateWorkers();
+    void signalSurrogateWorkersToExit();
+    void stopSurrogateWorkers(int timeoutMs);
+    void runSurrogateRounds(Thread& thread);
+    void runSurrogateHelper(Thread& thread);
+    // Calculates shifts of the current round until there are none left
+    void computeSurrogateShifts(Thread& thread);
 
     enum Parameter
     {
@@ -177,7 +502,22 @@ private:
         START_FREQ,
         END_FREQ,
         STEP_LENGTH,
-        ARTIFACT_THRESHOLD
+        ARTIFACT_THRESHOLD,
+        OUTPUT_MODE,
+        OUTPUT_BAND_START,
+        OUTPUT_BAND_END,
+        TRIGGER_SOURCE,
+        TRIGGER_BAND_START,
+        TRIGGER_BAND_END,
+        TRIGGER_RISE,
+        TRIGGER_FALL,
+        TRIGGER_REFRACTORY,
+        TRIGGER_EVENT_CHANNEL,
+        SEGMENT_HANDOFF,
+        SEGMENT_POOL_SIZE,
+        ADAPT_QUALITY,
+        QUALITY_THRESHOLD,
+        TRIGGER_BAND
     };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoherenceNode);
@@ -56,6 +56,23 @@ CoherenceEditor::CoherenceEditor(CoherenceNode* p)
     { x + 75, y + 25, w + 35, h + 27 });
     addAndMakeVisible(stepEditable);
 
+    // Segment buffers
+    x += 120;
+    y = 0;
+    poolLabel = createLabel("poolLabel", "Segment Buffers:", { x + 5, y + 25, w + 70, h + 27 });
+    addAndMakeVisible(poolLabel);
+
+    poolEditable = createEditable("poolEditable", String(processor->segmentPoolSize),
+        "Number of segment buffers shared by processing and the calculation (at least "
+        + String(CoherenceNode::MIN_SEGMENT_POOL_SIZE) + "); more lets more segments wait when the "
+        "calculation falls behind, at the cost of memory", { x + 75, y + 25, w + 35, h + 27 });
+    addAndMakeVisible(poolEditable);
+
+    y += 35;
+    poolMemory = createLabel("poolMemory", "", { x + 5, y + 25, w + 105, h + 27 });
+    addAndMakeVisible(poolMemory);
+    updateSegmentMemory();
+
     // Frequencies of interest
     //y = 0;
     //x += 105;
@@ -159,6 +176,21 @@ void CoherenceEditor::labelTextChanged(Label* labelThatHasChanged)
             processor->setParameter(CoherenceNode::STEP_LENGTH, static_cast<float>(newVal));
         }
     }
+    if (labelThatHasChanged == poolEditable)
+    {
+        int newVal;
+        if (updateIntLabel(labelThatHasChanged, CoherenceNode::MIN_SEGMENT_POOL_SIZE, 64,
+            processor->segmentPoolSize, &newVal))
+        {
+            processor->setParameter(CoherenceNode::SEGMENT_POOL_SIZE, static_cast<int>(newVal));
+        }
+    }
+}
+
+void CoherenceEditor::updateSegmentMemory()
+{
+    double megabytes = processor->getSegmentPoolMemory() / (1024.0 * 1024.0);
+    poolMemory->setText("Buffer memory: " + String(megabytes, 1) + " MB", dontSendNotification);
 }
 
 bool CoherenceEditor::updateIntLabel(Label* label, int min, int max, int defaultValue, int* out)
@@ -47,6 +47,9 @@ public:
 
     Visualizer* createNewCanvas() override;
 
+    // Refreshes the segment pool memory readout (after the pool is resized)
+    void updateSegmentMemory();
+
 private:
     CoherenceNode* processor;
 
@@ -58,6 +61,10 @@ private:
 
     ScopedPointer<Label> stepLabel;
     ScopedPointer<Label> stepEditable;
+
+    ScopedPointer<Label> poolLabel;
+    ScopedPointer<Label> poolEditable;
+    ScopedPointer<Label> poolMemory;
     /*
     ScopedPointer<Label> foiLabel;
 
@@ -0,0 +1,216 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CoherenceRecorder.h"
+
+#include <iostream>
+
+CoherenceRecorder::CoherenceRecorder()
+    : Thread            ("Coherence Recorder")
+    , slots             (NUM_SLOTS)
+    , fifo              (NUM_SLOTS)
+    , recording         (false)
+    , openRequested     (false)
+    , closeRequested    (false)
+    , numDropped        (0)
+    , writeTimes        (nullptr)
+{}
+
+CoherenceRecorder::~CoherenceRecorder()
+{
+    stopThread(1000);
+}
+
+void CoherenceRecorder::setLayout(const CoherenceFileHeader& newHeader)
+{
+    jassert(!isThreadRunning());
+
+    header = newHeader;
+    for (Slot& slot : slots)
+    {
+        slot.values.assign(header.getValuesPerRecord(), 0.0f);
+    }
+    fifo.reset();
+}
+
+void CoherenceRecorder::startRecording(const File& file)
+{
+    {
+        const ScopedLock fileScopedLock(fileLock);
+        pendingFile = file;
+    }
+    numDropped = 0;
+    recording = true;
+    openRequested = true;
+    notify();
+}
+
+void CoherenceRecorder::stopRecording()
+{
+    recording = false;
+    closeRequested = true;
+    notify();
+}
+
+bool CoherenceRecorder::isRecording() const
+{
+    return recording;
+}
+
+bool CoherenceRecorder::pushUpdate(int64 timestamp, uint32 segmentIndex,
+    const std::vector<std::vector<double>>& coherence, const std::vector<std::vector<double>>& stdDev,
+    const std::vector<std::vector<double>>& bandCoherence)
+{
+    if (!recording)
+    {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+    {
+        // writer has fallen behind; don't wait for it
+        ++numDropped;
+        return false;
+    }
+
+    Slot& slot = slots[start1];
+    slot.timestamp = timestamp;
+    slot.segmentIndex = segmentIndex;
+
+    if (header.hasFreqValues)
+    {
+        copyPlane(coherence, slot.values.data(), header.getNumFreqs());
+        if (header.hasStdDev)
+        {
+            copyPlane(stdDev, slot.values.data() + header.getValuesPerPlane(), header.getNumFreqs());
+        }
+    }
+    copyPlane(bandCoherence, slot.values.data() + header.getBandOffset(), header.getNumBands());
+
+    fifo.finishedWrite(1);
+    return true;
+}
+
+void CoherenceRecorder::copyPlane(const std::vector<std::vector<double>>& src, float* dest, int nValues) const
+{
+    int nCombs = jmin(header.getNumPairs(), int(src.size()));
+    for (int comb = 0; comb < nCombs; ++comb)
+    {
+        const std::vector<double>& combValues = src[comb];
+        float* combDest = dest + size_t(comb) * nValues;
+        int n = jmin(nValues, int(combValues.size()));
+        for (int i = 0; i < n; ++i)
+        {
+            combDest[i] = float(combValues[i]);
+        }
+    }
+}
+
+int CoherenceRecorder::getNumDropped() const
+{
+    return numDropped;
+}
+
+void CoherenceRecorder::setTimingRing(TimingRing* ring)
+{
+    jassert(!isThreadRunning());
+    writeTimes = ring;
+}
+
+void CoherenceRecorder::run()
+{
+    while (!threadShouldExit())
+    {
+        bool closeFile = closeRequested.exchange(false);
+        bool openFile = openRequested.exchange(false);
+
+        if (closeFile || openFile)
+        {
+            // finish off the previous file, if any
+            writePending();
+            writer.close();
+        }
+
+        if (openFile && recording)
+        {
+            openPendingFile();
+        }
+
+        writePending();
+
+        wait(50);
+    }
+
+    writePending();
+    writer.close();
+}
+
+void CoherenceRecorder::writePending()
+{
+    int numReady = fifo.getNumReady();
+    if (numReady == 0)
+    {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    if (writer.isOpen())
+    {
+        auto tStart = StageTimings::now();
+
+        for (int i = start1; i < start1 + size1; ++i)
+        {
+            writer.writeRecord(slots[i].timestamp, slots[i].segmentIndex, 0, slots[i].values.data());
+        }
+
+        for (int i = start2; i < start2 + size2; ++i)
+        {
+            writer.writeRecord(slots[i].timestamp, slots[i].segmentIndex, 0, slots[i].values.data());
+        }
+
+        if (writeTimes)
+        {
+            writeTimes->add(StageTimings::elapsedUs(tStart, StageTimings::now()));
+        }
+    }
+
+    fifo.finishedRead(size1 + size2);
+}
+
+void CoherenceRecorder::openPendingFile()
+{
+    File file;
+    {
+        const ScopedLock fileScopedLock(fileLock);
+        file = pendingFile;
+    }
+
+    if (!writer.open(file.getFullPathName().toStdString(), header))
+    {
+        std::cerr << "Coherence: could not open " << file.getFullPathName() << " for writing" << std::endl;
+    }
+}
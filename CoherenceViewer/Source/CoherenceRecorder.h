@@ -0,0 +1,121 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COHERENCE_RECORDER_H_INCLUDED
+#define COHERENCE_RECORDER_H_INCLUDED
+
+/*
+
+Coherence Recorder - writes coherence updates to a chunked binary .coh file (see CoherenceFileFormat.h)
+on its own thread, so that the coherence calculation thread never formats text or touches the disk.
+Each chunk reaches the disk once it is full, and the chunk index is written when recording stops.
+
+The calculation thread hands each update to pushUpdate(), which copies it into one of a fixed
+number of preallocated slots managed by a lock-free FIFO. If the writer falls so far behind that
+every slot is full, the update is dropped (and counted) rather than blocking the caller.
+
+*/
+
+#include <BasicJuceHeader.h>
+#include "Core/CoherenceFileFormat.h"
+#include "Core/StageTimings.h"
+
+#include <atomic>
+#include <vector>
+
+class CoherenceRecorder : public Thread
+{
+public:
+    CoherenceRecorder();
+    ~CoherenceRecorder();
+
+    // Set the layout written to the header of each new file and (re)allocate the slots.
+    // Must not be called while the thread is running.
+    void setLayout(const CoherenceFileHeader& newHeader);
+
+    // Begin writing to a new file / finish the current file. Safe to call from any one
+    // thread (in practice, the processing thread); the file itself is opened and closed
+    // on the recorder thread.
+    void startRecording(const File& file);
+    void stopRecording();
+
+    bool isRecording() const;
+
+    // Queue an update for writing. coherence and stdDev are # combinations x # frequencies
+    // (written if the layout's hasFreqValues is set, and stdDev only if hasStdDev is too), and
+    // bandCoherence is # combinations x # bands.
+    // Called from the coherence calculation thread; never blocks or allocates.
+    // Returns false if the update had to be dropped.
+    bool pushUpdate(int64 timestamp, uint32 segmentIndex,
+        const std::vector<std::vector<double>>& coherence, const std::vector<std::vector<double>>& stdDev,
+        const std::vector<std::vector<double>>& bandCoherence);
+
+    // Number of updates dropped because the queue was full, since the last startRecording
+    int getNumDropped() const;
+
+    // Ring to add the time taken by each batch of writes to (recorder thread is its only writer).
+    // Must not be called while the thread is running.
+    void setTimingRing(TimingRing* ring);
+
+    void run() override;
+
+private:
+    // write everything in the FIFO to the current file
+    void writePending();
+
+    // copy # combinations x nValues values into a slot's values, as floats
+    void copyPlane(const std::vector<std::vector<double>>& src, float* dest, int nValues) const;
+
+    void openPendingFile();
+
+    static const int NUM_SLOTS = 64;
+
+    CoherenceFileHeader header;
+
+    // preallocated record storage
+    struct Slot
+    {
+        int64 timestamp;
+        uint32 segmentIndex;
+        std::vector<float> values;
+    };
+
+    std::vector<Slot> slots;
+    AbstractFifo fifo;
+
+    CoherenceFileWriter writer;
+
+    TimingRing* writeTimes;
+
+    CriticalSection fileLock; // guards pendingFile only
+    File pendingFile;
+
+    std::atomic<bool> recording;
+    std::atomic<bool> openRequested;
+    std::atomic<bool> closeRequested;
+    std::atomic<int> numDropped;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoherenceRecorder);
+};
+
+#endif // COHERENCE_RECORDER_H_INCLUDED
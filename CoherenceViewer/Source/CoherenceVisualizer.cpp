@@ -35,6 +35,10 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
     ;
     juce::Rectangle<int> bounds;
     curComb = 0;
+    curChannelAvg = -1;
+    lastCoherenceVersion = 0;
+    lastHistoryVersion = 0;
+    showingZScore = false;
 
     const int TEXT_HT = 18;
 
@@ -67,14 +71,23 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
     yPos += TEXT_HT + 5;
     // ------- Combination Choice ------- //
     combinationBox = new ComboBox("Combination Selection Box");
-    combinationBox->setTooltip("Combination to graph");
+    combinationBox->setTooltip("Combination to graph, or the average across all combinations (with the "
+        "lowest and highest combination shown in grey) or across every combination of one channel");
     combinationBox->setBounds(bounds = { col1 + 500, yPos, 90, TEXT_HT });
     combinationBox->addListener(this);
     canvas->addAndMakeVisible(combinationBox);
     canvasBounds = canvasBounds.getUnion(bounds);
     updateCombList();
 
-    combinationGroupSet->addGroup({ combinationLabel, combinationBox });
+    heatmapButton = new ToggleButton("Heatmap");
+    heatmapButton->setBounds(bounds = { col1 + 600, yPos, 90, TEXT_HT });
+    heatmapButton->setTooltip("Show every combination at every frequency at once, instead of one line");
+    heatmapButton->setToggleState(false, dontSendNotification);
+    heatmapButton->addListener(this);
+    canvas->addAndMakeVisible(heatmapButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    combinationGroupSet->addGroup({ combinationLabel, combinationBox, heatmapButton });
 
     yPos = 90;
     //xPos = 15;
@@ -109,6 +122,13 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
     
     static const String linearTip = "Linear weighting of coherence.";
     static const String expTip = "Exponential weighting of coherence. Set alpha using -1/alpha weighting.";
+    static const String windowTip = "Equal weighting of the last N segments only, so older segments drop out "
+        "entirely. Keeps N copies of the spectra, so memory grows with N x combinations x frequencies x times.";
+    static const String jackknifeTip = "Jackknife over groups of segments (linear or last N weighting only): "
+        "plots the bias-corrected coherence of a single combination and its 95% confidence interval.";
+    static const String surrogateTip = "Tests coherence against surrogates (channel pairs from segments "
+        "shifted in time) in the background: plots the 95th percentile of a single combination's surrogates "
+        "from the last 64 segments (or the last N, if shorter), scaled to the number of segments averaged.";
     static const String resetTip = "Clears and resets the algorithm. Must be done after changes are made on this page!";
 
     // Column 2
@@ -184,7 +204,53 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
     canvas->addAndMakeVisible(alphaE);
     canvasBounds = canvasBounds.getUnion(bounds);
 
-    columnTwoSet->addGroup({ linearButton, expButton, alpha, alphaE });
+    // ------- Sliding Window ------- //
+    yPos += 20;
+    windowButton = new ToggleButton("Last");
+    windowButton->setBounds(bounds = { col2, yPos, 60, TEXT_HT });
+    windowButton->setToggleState(false, dontSendNotification);
+    windowButton->addListener(this);
+    windowButton->setTooltip(windowTip);
+    canvas->addAndMakeVisible(windowButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    windowE = new Label("windowE", "20");
+    windowE->setEditable(true);
+    windowE->addListener(this);
+    windowE->setBounds(bounds = { col2 + 65, yPos, 30, TEXT_HT });
+    windowE->setColour(Label::backgroundColourId, Colours::grey);
+    windowE->setColour(Label::textColourId, Colours::white);
+    windowE->setTooltip(windowTip);
+    canvas->addAndMakeVisible(windowE);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    windowUnit = new Label("windowUnit", "segments");
+    windowUnit->setBounds(bounds = { col2 + 95, yPos, 60, TEXT_HT });
+    canvas->addAndMakeVisible(windowUnit);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    // ------- Jackknife ------- //
+    yPos += 20;
+    jackknifeButton = new ToggleButton("Jackknife CI");
+    jackknifeButton->setBounds(bounds = { col2, yPos, 100, TEXT_HT });
+    jackknifeButton->setToggleState(false, dontSendNotification);
+    jackknifeButton->addListener(this);
+    jackknifeButton->setTooltip(jackknifeTip);
+    canvas->addAndMakeVisible(jackknifeButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    // ------- Surrogates ------- //
+    yPos += 20;
+    surrogateButton = new ToggleButton("Surrogate threshold");
+    surrogateButton->setBounds(bounds = { col2, yPos, 200, TEXT_HT });
+    surrogateButton->setToggleState(false, dontSendNotification);
+    surrogateButton->addListener(this);
+    surrogateButton->setTooltip(surrogateTip);
+    canvas->addAndMakeVisible(surrogateButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    columnTwoSet->addGroup({ linearButton, expButton, alpha, alphaE, windowButton, windowE, windowUnit,
+        jackknifeButton, surrogateButton });
 
     // ------- Artifact Threshold ------- //
     static const String artifactTip = "Checks the current power value minus the last power value. If the change is too large it is considered an artifact and the current buffer will be reset.";
@@ -230,6 +296,80 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
 
     columnTwoSet->addGroup({ artifactDesc, artifactEq, artifactE });
 
+    // ------- Segment Hand-off ------- //
+    static const String handoffTip = "How finished segments get to the calculation. Latest: the calculation "
+        "always takes the newest segment, and any it falls behind on are dropped (and counted). Queue: every "
+        "segment is calculated; if every segment buffer (set in the editor) is already waiting, "
+        "processing waits for the calculation to catch up.";
+    static const String segmentCountTip = "Segments that have been through the calculation, and segments "
+        "dropped because it fell behind (or, in queue mode, how often processing had to wait for it).";
+
+    yPos += 20;
+    segmentCount = new Label("segmentCount", "");
+    segmentCount->setBounds(bounds = { col2 - 20, yPos, 200, TEXT_HT });
+    segmentCount->setTooltip(segmentCountTip);
+    canvas->addAndMakeVisible(segmentCount);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 40;
+    handoffLabel = new Label("handoffLabel", "Segment Hand-off");
+    handoffLabel->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    handoffLabel->setTooltip(handoffTip);
+    canvas->addAndMakeVisible(handoffLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    handoffBox = new ComboBox("Segment Hand-off Box");
+    handoffBox->addItem("Latest (drops if behind)", CoherenceNode::HANDOFF_LATEST);
+    handoffBox->addItem("Queue (never drops)", CoherenceNode::HANDOFF_QUEUE);
+    handoffBox->setSelectedId(processor->segmentHandoff, dontSendNotification);
+    handoffBox->setTooltip(handoffTip);
+    handoffBox->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    handoffBox->addListener(this);
+    canvas->addAndMakeVisible(handoffBox);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    columnTwoSet->addGroup({ segmentCount, handoffLabel, handoffBox });
+
+    // ------- Quality Governor ------- //
+    static const String adaptQualityTip = "While a segment takes longer to calculate than the given fraction "
+        "of its length, lower the resolution step by step: every other time of interest, then also every other "
+        "frequency, then only the combinations that are displayed or used by the trigger. Full quality is "
+        "restored once there's headroom again. Each change is logged.";
+
+    yPos += 40;
+    adaptQualityButton = new ToggleButton("Lower quality if behind");
+    adaptQualityButton->setBounds(bounds = { col2, yPos, 160, TEXT_HT });
+    adaptQualityButton->setToggleState(processor->adaptQuality, dontSendNotification);
+    adaptQualityButton->addListener(this);
+    adaptQualityButton->setTooltip(adaptQualityTip);
+    canvas->addAndMakeVisible(adaptQualityButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    qualityThresholdLabel = new Label("qualityThresholdLabel", "Real-time factor above:");
+    qualityThresholdLabel->setBounds(bounds = { col2 + 15, yPos, 135, TEXT_HT });
+    qualityThresholdLabel->setTooltip(adaptQualityTip);
+    canvas->addAndMakeVisible(qualityThresholdLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    qualityThresholdEditable = new Label("qualityThresholdEditable", String(processor->governor.getThreshold()));
+    qualityThresholdEditable->setEditable(true);
+    qualityThresholdEditable->addListener(this);
+    qualityThresholdEditable->setBounds(bounds = { col2 + 150, yPos, 35, TEXT_HT });
+    qualityThresholdEditable->setColour(Label::backgroundColourId, Colours::grey);
+    qualityThresholdEditable->setColour(Label::textColourId, Colours::white);
+    canvas->addAndMakeVisible(qualityThresholdEditable);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    qualityStatus = new Label("qualityStatus", "");
+    qualityStatus->setBounds(bounds = { col2 - 20, yPos, 200, TEXT_HT });
+    canvas->addAndMakeVisible(qualityStatus);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    columnTwoSet->addGroup({ adaptQualityButton, qualityThresholdLabel, qualityThresholdEditable, qualityStatus });
+
     // ------- Frequencies of Interest ------- //
     yPos += 40;
     //xPos += 20;
@@ -281,6 +421,146 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
 
     columnTwoSet->addGroup({ foiLabel, fstartLabel, fstartEditable, fendLabel, fendEditable });
 
+    // ------- Output Channels ------- //
+    static const String outputTip = "Adds continuous channels holding the mean coherence (x 1000) in the "
+        "given band (or in each of the bands below), updated each time the coherence is recalculated.";
+
+    yPos += 40;
+    outputLabel = new Label("outputLabel", "Output Channels");
+    outputLabel->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    outputLabel->setTooltip(outputTip);
+    canvas->addAndMakeVisible(outputLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    outputModeBox = new ComboBox("Output Mode Box");
+    outputModeBox->addItem("None", CoherenceNode::OUTPUT_NONE);
+    outputModeBox->addItem("Average of combinations", CoherenceNode::OUTPUT_AVERAGE);
+    outputModeBox->addItem("Each combination", CoherenceNode::OUTPUT_ALL_COMBS);
+    outputModeBox->addItem("Each combination x band", CoherenceNode::OUTPUT_BANDS);
+    outputModeBox->setSelectedId(processor->outputMode, dontSendNotification);
+    outputModeBox->setTooltip(outputTip);
+    outputModeBox->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    outputModeBox->addListener(this);
+    canvas->addAndMakeVisible(outputModeBox);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    outputBandLabel = new Label("outputBandLabel", "Band(Hz):");
+    outputBandLabel->setBounds(bounds = { col2, yPos, 70, TEXT_HT });
+    canvas->addAndMakeVisible(outputBandLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    outputBandStartEditable = new Label("outputBandStartEditable", String(processor->outputBandStart));
+    outputBandStartEditable->setEditable(true);
+    outputBandStartEditable->addListener(this);
+    outputBandStartEditable->setBounds(bounds = { col2 + 75, yPos, 35, TEXT_HT });
+    outputBandStartEditable->setColour(Label::backgroundColourId, Colours::grey);
+    outputBandStartEditable->setColour(Label::textColourId, Colours::white);
+    canvas->addAndMakeVisible(outputBandStartEditable);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    outputBandEndEditable = new Label("outputBandEndEditable", String(processor->outputBandEnd));
+    outputBandEndEditable->setEditable(true);
+    outputBandEndEditable->addListener(this);
+    outputBandEndEditable->setBounds(bounds = { col2 + 115, yPos, 35, TEXT_HT });
+    outputBandEndEditable->setColour(Label::backgroundColourId, Colours::grey);
+    outputBandEndEditable->setColour(Label::textColourId, Colours::white);
+    canvas->addAndMakeVisible(outputBandEndEditable);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    columnTwoSet->addGroup({ outputLabel, outputModeBox, outputBandLabel,
+        outputBandStartEditable, outputBandEndEditable });
+
+    // ------- Bands ------- //
+    static const String bandsTip = "Frequency bands, as a comma-separated list of [name] low-high (Hz), "
+        "e.g. theta 4-8, beta 13-30. The coherence in each band is recorded, and can be output or "
+        "trigger events.";
+    static const String recordFreqValuesTip = "Records the coherence at each frequency as well as in each "
+        "band. Without it, recordings hold only the bands.";
+
+    yPos += 40;
+    bandsLabel = new Label("bandsLabel", "Bands");
+    bandsLabel->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    bandsLabel->setTooltip(bandsTip);
+    canvas->addAndMakeVisible(bandsLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    bandsEditable = new Label("bandsEditable", CoherenceBands::toString(processor->bands.getBands()));
+    bandsEditable->setEditable(true);
+    bandsEditable->addListener(this);
+    bandsEditable->setBounds(bounds = { col2, yPos, 180, TEXT_HT });
+    bandsEditable->setColour(Label::backgroundColourId, Colours::grey);
+    bandsEditable->setColour(Label::textColourId, Colours::white);
+    bandsEditable->setTooltip(bandsTip);
+    canvas->addAndMakeVisible(bandsEditable);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    recordFreqValuesButton = new ToggleButton("Record every frequency");
+    recordFreqValuesButton->setBounds(bounds = { col2, yPos, 170, TEXT_HT });
+    recordFreqValuesButton->setToggleState(processor->recordFreqValues, dontSendNotification);
+    recordFreqValuesButton->addListener(this);
+    recordFreqValuesButton->setTooltip(recordFreqValuesTip);
+    canvas->addAndMakeVisible(recordFreqValuesButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    columnTwoSet->addGroup({ bandsLabel, bandsEditable, recordFreqValuesButton });
+
+    // ------- Baseline ------- //
+    static const String baselineTip = "Collect: gathers the mean and variance of the coherence after each "
+        "segment at every combination and frequency. Show z-score: plots how many standard deviations the "
+        "coherence is from the baseline mean instead (outputs, trigger and recording stay in coherence). "
+        "A saved baseline can be loaded in a later session with the same channels and settings.";
+
+    yPos += 40;
+    baselineLabel = new Label("baselineLabel", "Baseline");
+    baselineLabel->setBounds(bounds = { col2, yPos, 150, TEXT_HT });
+    baselineLabel->setTooltip(baselineTip);
+    canvas->addAndMakeVisible(baselineLabel);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    collectBaselineButton = new ToggleButton("Collect");
+    collectBaselineButton->setBounds(bounds = { col2, yPos, 70, TEXT_HT });
+    collectBaselineButton->addListener(this);
+    collectBaselineButton->setTooltip(baselineTip);
+    canvas->addAndMakeVisible(collectBaselineButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    zScoreButton = new ToggleButton("Show z-score");
+    zScoreButton->setBounds(bounds = { col2 + 75, yPos, 100, TEXT_HT });
+    zScoreButton->addListener(this);
+    zScoreButton->setTooltip(baselineTip);
+    canvas->addAndMakeVisible(zScoreButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 25;
+    saveBaselineButton = new TextButton("Save");
+    saveBaselineButton->setBounds(bounds = { col2, yPos, 70, TEXT_HT });
+    saveBaselineButton->addListener(this);
+    saveBaselineButton->setTooltip("Save the baseline to a file");
+    canvas->addAndMakeVisible(saveBaselineButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    loadBaselineButton = new TextButton("Load");
+    loadBaselineButton->setBounds(bounds = { col2 + 75, yPos, 70, TEXT_HT });
+    loadBaselineButton->addListener(this);
+    loadBaselineButton->setTooltip("Load a saved baseline (reset with the same channels and settings first)");
+    canvas->addAndMakeVisible(loadBaselineButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    yPos += 20;
+    baselineStatus = new Label("baselineStatus", "");
+    baselineStatus->setBounds(bounds = { col2, yPos, 180, TEXT_HT });
+    canvas->addAndMakeVisible(baselineStatus);
+    canvasBounds = canvasBounds.getUnion(bounds);
+    updateBaselineState();
+
+    columnTwoSet->addGroup({ baselineLabel, collectBaselineButton, zScoreButton, saveBaselineButton,
+        loadBaselineButton, baselineStatus });
+
     // ------- Plot ------- //
     // col 3
     int col3 = 330;
@@ -293,6 +573,117 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
 
     canvas->addAndMakeVisible(cohPlot);
     canvasBounds = canvasBounds.getUnion(bounds);
+
+    heatmap = new CoherenceHeatmap();
+    heatmap->setBounds(bounds);
+    canvas->addChildComponent(heatmap);
+
+    historyView = new CoherenceHistoryView();
+    historyView->setBounds(bounds = { col3 + 610, 90, 420, 500 });
+    historyView->clear(combinationBox->getText());
+    canvas->addAndMakeVisible(historyView);
+    canvasBounds = canvasBounds.getUnion(bounds);
+    updateCombList(); // again, now that the heatmap can take the combination names
+
+    // ------- Coherence Trigger ------- //
+    static const String triggerTip = "Emits a TTL event when band coherence rises above Rise. "
+        "Re-arms once it falls below Fall and the refractory period has passed.";
+
+    triggerSet = new VerticalGroupSet("Trigger");
+    canvas->addAndMakeVisible(triggerSet, 0);
+
+    auto addLabel = [&](Label* label, juce::Rectangle<int> labelBounds)
+    {
+        label->setBounds(labelBounds);
+        canvas->addAndMakeVisible(label);
+        canvasBounds = canvasBounds.getUnion(labelBounds);
+    };
+
+    auto addEditable = [&](Label* label, juce::Rectangle<int> labelBounds)
+    {
+        label->setEditable(true);
+        label->addListener(this);
+        label->setColour(Label::backgroundColourId, Colours::grey);
+        label->setColour(Label::textColourId, Colours::white);
+        addLabel(label, labelBounds);
+    };
+
+    yPos = 610;
+    triggerLabel = new Label("triggerLabel", "Coherence Trigger");
+    triggerLabel->setFont(Font(14, Font::bold));
+    triggerLabel->setTooltip(triggerTip);
+    addLabel(triggerLabel, { col3, yPos, 130, TEXT_HT });
+
+    triggerSourceBox = new ComboBox("Trigger Source Box");
+    triggerSourceBox->setTooltip("Combination (or average) whose coherence triggers events");
+    triggerSourceBox->setBounds(bounds = { col3 + 135, yPos, 150, TEXT_HT });
+    triggerSourceBox->addListener(this);
+    canvas->addAndMakeVisible(triggerSourceBox);
+    canvasBounds = canvasBounds.getUnion(bounds);
+    updateTriggerSourceList();
+
+    triggerChanLabel = new Label("triggerChanLabel", "TTL line:");
+    addLabel(triggerChanLabel, { col3 + 295, yPos, 55, TEXT_HT });
+    triggerChanEditable = new Label("triggerChanEditable", String(processor->triggerEventChannel + 1));
+    addEditable(triggerChanEditable, { col3 + 350, yPos, 30, TEXT_HT });
+
+    triggerBandBox = new ComboBox("Trigger Band Box");
+    triggerBandBox->setTooltip("Band whose coherence triggers events: one of the bands, or the range below");
+    triggerBandBox->setBounds(bounds = { col3 + 390, yPos, 150, TEXT_HT });
+    triggerBandBox->addListener(this);
+    canvas->addAndMakeVisible(triggerBandBox);
+    canvasBounds = canvasBounds.getUnion(bounds);
+    updateTriggerBandList();
+
+    yPos += 25;
+    triggerBandLabel = new Label("triggerBandLabel", "Band(Hz):");
+    addLabel(triggerBandLabel, { col3, yPos, 60, TEXT_HT });
+    triggerBandStartEditable = new Label("triggerBandStartEditable", String(processor->triggerBandStart));
+    addEditable(triggerBandStartEditable, { col3 + 65, yPos, 35, TEXT_HT });
+    triggerBandEndEditable = new Label("triggerBandEndEditable", String(processor->triggerBandEnd));
+    addEditable(triggerBandEndEditable, { col3 + 105, yPos, 35, TEXT_HT });
+
+    triggerRiseLabel = new Label("triggerRiseLabel", "Rise:");
+    triggerRiseLabel->setTooltip(triggerTip);
+    addLabel(triggerRiseLabel, { col3 + 150, yPos, 35, TEXT_HT });
+    triggerRiseEditable = new Label("triggerRiseEditable", String(processor->triggerRise));
+    addEditable(triggerRiseEditable, { col3 + 185, yPos, 35, TEXT_HT });
+
+    triggerFallLabel = new Label("triggerFallLabel", "Fall:");
+    triggerFallLabel->setTooltip(triggerTip);
+    addLabel(triggerFallLabel, { col3 + 230, yPos, 35, TEXT_HT });
+    triggerFallEditable = new Label("triggerFallEditable", String(processor->triggerFall));
+    addEditable(triggerFallEditable, { col3 + 265, yPos, 35, TEXT_HT });
+
+    triggerRefractoryLabel = new Label("triggerRefractoryLabel", "Refractory(s):");
+    addLabel(triggerRefractoryLabel, { col3 + 310, yPos, 85, TEXT_HT });
+    triggerRefractoryEditable = new Label("triggerRefractoryEditable", String(processor->triggerRefractory));
+    addEditable(triggerRefractoryEditable, { col3 + 395, yPos, 35, TEXT_HT });
+
+    yPos += 30;
+    triggerLatencyView = new LatencyHistogramView(processor->triggerLatency, "Trigger latency (last sample in to event out)");
+    triggerLatencyView->setBounds(bounds = { col3, yPos, 600, 120 });
+    canvas->addAndMakeVisible(triggerLatencyView);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    // ------- Stage Timings ------- //
+    yPos += 135;
+    timingView = new StageTimingView(processor->timings);
+    timingView->setBounds(bounds = { col3, yPos, 600, 200 });
+    canvas->addAndMakeVisible(timingView);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    saveTimingsButton = new TextButton("Save CSV");
+    saveTimingsButton->setTooltip("Save the recent durations of each stage and their percentiles to a CSV file");
+    saveTimingsButton->setBounds(bounds = { col3 + 515, yPos + 3, 80, TEXT_HT });
+    saveTimingsButton->addListener(this);
+    canvas->addAndMakeVisible(saveTimingsButton);
+    canvasBounds = canvasBounds.getUnion(bounds);
+
+    triggerSet->addGroup({ triggerLabel, triggerSourceBox, triggerChanLabel, triggerChanEditable,
+        triggerBandBox, triggerBandLabel, triggerBandStartEditable, triggerBandEndEditable, triggerRiseLabel,
+        triggerRiseEditable, triggerFallLabel, triggerFallEditable, triggerRefractoryLabel,
+        triggerRefractoryEditable, triggerLatencyView, timingView });
     
     // some extra padding
     canvasBounds.setBottom(canvasBounds.getBottom() + 10);
@@ -302,6 +693,7 @@ CoherenceVisualizer::CoherenceVisualizer(CoherenceNode* n)
     channelGroupSet->setBounds(canvasBounds);
     combinationGroupSet->setBounds(canvasBounds);
     columnTwoSet->setBounds(canvasBounds);
+    triggerSet->setBounds(canvasBounds);
     viewport->setViewedComponent(canvas, false);
     viewport->setScrollBarsShown(true, true);
     addAndMakeVisible(viewport);
@@ -328,13 +720,26 @@ void CoherenceVisualizer::update()
     updateElectrodeButtons(numInputs, numButtons);
     
     float alpha = processor->alpha;
-    if (alpha != 0.0)
+    if (processor->averageWindow > 0)
+    {
+        linearButton->setToggleState(false, dontSendNotification);
+        expButton->setToggleState(false, dontSendNotification);
+
+        windowButton->setToggleState(true, dontSendNotification);
+        windowE->setText(String(processor->averageWindow), dontSendNotification);
+    }
+    else if (alpha != 0.0)
     {
         linearButton->setToggleState(false, dontSendNotification);
 
         expButton->setToggleState(true, dontSendNotification);
         alphaE->setText(String(alpha), dontSendNotification);
     }
+    jackknifeButton->setToggleState(processor->jackknife, dontSendNotification);
+    surrogateButton->setToggleState(processor->surrogates, dontSendNotification);
+    bandsEditable->setText(CoherenceBands::toString(processor->bands.getBands()), dontSendNotification);
+    recordFreqValuesButton->setToggleState(processor->recordFreqValues, dontSendNotification);
+    updateTriggerBandList();
 }
 
 void CoherenceVisualizer::updateElectrodeButtons(int numInputs, int numButtons)
@@ -373,18 +778,90 @@ void CoherenceVisualizer::updateCombList()
 {
     combinationBox->clear(dontSendNotification);
     combinationBox->addItem("Average across all combinations", 1);
+    StringArray combinationNames;
     for (int i = 0, comb = 2; i < group1Channels.size(); i++)
     {
         for (int j = 0; j < group2Channels.size(); j++, ++comb)
         {
             // using 1-based comb ids since 0 is reserved for "nothing selected"
-            combinationBox->addItem(String(group1Channels[i] + 1) + " x " + String(group2Channels[j] + 1), comb);
+            combinationNames.add(String(group1Channels[i] + 1) + " x " + String(group2Channels[j] + 1));
+            combinationBox->addItem(combinationNames[comb - 2], comb);
         }
     }
+    // then the per-channel averages, group 1 channels first
+    int channelAvgId = group1Channels.size() * group2Channels.size() + 2;
+    if (group1Channels.size() > 1 || group2Channels.size() > 1)
+    {
+        combinationBox->addSeparator();
+    }
+    for (int i = 0; i < group1Channels.size() && group2Channels.size() > 1; i++)
+    {
+        combinationBox->addItem(String(group1Channels[i] + 1) + " x all", channelAvgId + i);
+    }
+    channelAvgId += group1Channels.size();
+    for (int j = 0; j < group2Channels.size() && group1Channels.size() > 1; j++)
+    {
+        combinationBox->addItem("all x " + String(group2Channels[j] + 1), channelAvgId + j);
+    }
     if (group1Channels.size() > 0 && group2Channels.size() > 0)
     {
         combinationBox->setSelectedId(1);
     }  
+
+    // (not created yet when called from the constructor)
+    if (heatmap)
+    {
+        heatmap->setCombinationNames(combinationNames);
+    }
+    if (triggerSourceBox)
+    {
+        updateTriggerSourceList();
+    }
+}
+
+void CoherenceVisualizer::updateTriggerSourceList()
+{
+    // ids are source + 3, since sources start at -2 and 0 is reserved for "nothing selected"
+    triggerSourceBox->clear(dontSendNotification);
+    triggerSourceBox->addItem("Off", CoherenceNode::TRIGGER_OFF + 3);
+    triggerSourceBox->addItem("Average of combinations", CoherenceNode::TRIGGER_AVERAGE + 3);
+    for (int i = 0, comb = 0; i < group1Channels.size(); i++)
+    {
+        for (int j = 0; j < group2Channels.size(); j++, ++comb)
+        {
+            triggerSourceBox->addItem(String(group1Channels[i] + 1) + " x " + String(group2Channels[j] + 1), comb + 3);
+        }
+    }
+
+    int source = processor->triggerSource;
+    if (source >= group1Channels.size() * group2Channels.size())
+    {
+        // combination no longer exists
+        source = CoherenceNode::TRIGGER_OFF;
+        processor->setParameter(CoherenceNode::TRIGGER_SOURCE, source);
+    }
+    triggerSourceBox->setSelectedId(source + 3, dontSendNotification);
+}
+
+void CoherenceVisualizer::updateTriggerBandList()
+{
+    // ids are band + 2, since the range is -1 and 0 is reserved for "nothing selected"
+    triggerBandBox->clear(dontSendNotification);
+    triggerBandBox->addItem("Band(Hz) range", 1);
+    const std::vector<CoherenceBand>& bands = processor->bands.getBands();
+    for (int b = 0; b < int(bands.size()); ++b)
+    {
+        triggerBandBox->addItem(bands[b].name, b + 2);
+    }
+
+    int band = processor->triggerBand;
+    if (band >= int(bands.size()))
+    {
+        // band no longer exists
+        band = -1;
+        processor->setParameter(CoherenceNode::TRIGGER_BAND, band);
+    }
+    triggerBandBox->setSelectedId(band + 2, dontSendNotification);
 }
 
 void CoherenceVisualizer::updateGroupState()
@@ -424,9 +901,10 @@ void CoherenceVisualizer::paint(Graphics& g)
 void CoherenceVisualizer::refresh() 
 {
     // If we have any artifacts let the user know
-    if (processor->numArtifacts > 0)
+    double numDiscarded = processor->segmenter.getNumDiscarded();
+    if (numDiscarded > 0)
     {
-        artifactCount->setText(String("Buffers Handled: " + String(processor->numTrials) + " & Buffers Discarded: " + String(ceil(processor->numArtifacts))), dontSendNotification);
+        artifactCount->setText(String("Buffers Handled: " + String(processor->numTrials) + " & Buffers Discarded: " + String(ceil(numDiscarded))), dontSendNotification);
         if (!viewport->isParentOf(artifactCount))
         {
             addAndMakeVisible(artifactCount);
@@ -437,65 +915,202 @@ void CoherenceVisualizer::refresh()
         removeChildComponent(getIndexOfChildComponent(artifactCount));
     }
 
+    // Let the user know if the calculation is falling behind
+    int numSegmentsDropped = processor->getNumDropped();
+    String segmentText = "Segments processed: " + String(processor->numProcessed.load());
+    if (processor->segmentHandoff == CoherenceNode::HANDOFF_QUEUE)
+    {
+        segmentText += ", waited for: " + String(processor->numHandoffWaits.load());
+    }
+    segmentText += ", dropped: " + String(numSegmentsDropped);
+    segmentCount->setText(segmentText, dontSendNotification);
+    segmentCount->setColour(Label::backgroundColourId, numSegmentsDropped > 0 ? Colours::red : Colours::transparentBlack);
+
+    // Current quality level, with the recent changes in the tooltip
+    int qualityLevel = processor->adaptQuality ? processor->governor.getLevel() : int(QualityGovernor::FULL_QUALITY);
+    qualityStatus->setText("Quality: " + String(QualityGovernor::getLevelName(qualityLevel))
+        + " (" + String(processor->governor.getNumChanges()) + " changes)", dontSendNotification);
+    qualityStatus->setColour(Label::backgroundColourId,
+        qualityLevel != QualityGovernor::FULL_QUALITY ? Colours::orange : Colours::transparentBlack);
+    {
+        const ScopedLock lock(processor->qualityLogLock);
+        qualityStatus->setTooltip(processor->qualityLog.joinIntoString("\n"));
+
+        // and each new change on the status bar (entries are timestamped, so never repeat)
+        String latest = processor->qualityLog[processor->qualityLog.size() - 1];
+        if (latest.isNotEmpty() && latest != lastQualityChangeShown)
+        {
+            CoreServices::sendStatusMessage("Coherence quality: " + latest);
+            lastQualityChangeShown = latest;
+        }
+    }
+
     // Update plot if frequency has changed.
     if (freqStart != processor->freqStart || freqEnd != processor->freqEnd)
     {
         freqStart = processor->freqStart;
         freqEnd = processor->freqEnd;
-        cohPlot->setRange(freqStart, freqEnd, 0, 100, true);
+        updateValueRange();
     }
 
+    updateBaselineState();
+
     freqStep = processor->freqStep;
     Colour col = (processor->ready) ? Colours::green : Colours::red;
     resetTFR->setColour(TextButton::buttonColourId, col);
 
-    // Get data from processor thread, then plot
-    if (processor->meanCoherence.hasUpdate())
+    String triggerSummary = "Events: " + String(processor->numTriggers.load());
+    int numDropped = processor->numTriggersDropped;
+    if (numDropped > 0)
     {
-        AtomicScopedReadPtr<std::vector<std::vector<double>>> coherenceReader(processor->meanCoherence);
-        coherenceReader.pullUpdate();
+        triggerSummary += ", dropped: " + String(numDropped);
+    }
+    triggerLatencyView->setSummary(triggerSummary);
+    triggerLatencyView->repaint();
 
-        coh.resize(coherenceReader->size());
-        
-        for (int comb = 0; comb < processor->nGroup1Chans * processor->nGroup2Chans; comb++)
+    timingView->setSegmentLength(processor->segLen);
+    timingView->repaint();
+
+    // latest surrogate thresholds, kept until the next round (flagged while rounds are put off)
+    surrogateButton->setButtonText(processor->surrogates && processor->surrogatesPaused
+        ? "Surrogate threshold (paused)" : "Surrogate threshold");
+    if (processor->surrogateThreshold.hasUpdate())
+    {
+        AtomicScopedReadPtr<CoherenceNode::SurrogateThresholds> thresholdReader(processor->surrogateThreshold);
+        if (thresholdReader.isValid())
         {
-            int vecSize = coherenceReader->at(comb).size();
-            coh[comb].resize(vecSize);
-            for (int i = 0; i < vecSize; i++)
-            {
-                coh[comb][i] = coherenceReader->at(comb)[i] * 100;
-            }
+            surrogateThreshold = *thresholdReader;
         }
     }
 
-    if (coh.size() > 0)
+    // Get data from processor thread, then plot
+    MultiReaderReadPtr<CoherenceFrame> coherenceReader(processor->meanCoherence);
+    // (invalid before the first update, or if every reader place is taken)
+    if (coherenceReader.isValid() && coherenceReader.getVersion() != lastCoherenceVersion)
     {
-        XYline cohLine(0, 1, 1, Colours::yellow);
-        if (curComb >= 0)
+        lastCoherenceVersion = coherenceReader.getVersion();
+        const CoherenceFrame& frame = *coherenceReader;
+
+        if (frame.isZScore != showingZScore)
         {
-            cohLine = XYline(freqStart, freqStep, coh[curComb], 1, Colours::yellow);
+            // the history's older values are in the other units
+            showingZScore = frame.isZScore;
+            updateValueRange();
+            historyView->clear(combinationBox->getText());
         }
-        else
+
+        // The selected line; the publish stage has already reduced the summaries
+        const std::vector<double>* shown = &frame.average;
+        const std::vector<double>* shownStdDev = nullptr; // (only for a combination's coherence)
+        int jackknifeComb = -1; // combination whose jackknife is drawn
+        int thresholdComb = -1; // and surrogate threshold
+        int nGroup1 = frame.group1Average.size();
+        if (curChannelAvg >= 0 && curChannelAvg < nGroup1)
+        {
+            shown = &frame.group1Average[curChannelAvg];
+        }
+        else if (curChannelAvg >= nGroup1 && curChannelAvg < nGroup1 + int(frame.group2Average.size()))
+        {
+            shown = &frame.group2Average[curChannelAvg - nGroup1];
+        }
+        else if (curComb >= 0 && curComb < frame.getNumCombinations())
         {
-            // Average across all combinations
-            std::vector<float> averageCoh(coh[0].size()) ;
-            for (int comb = 0; comb < processor->nGroup1Chans * processor->nGroup2Chans; comb++)
+            shown = &frame.coherence[curComb];
+            if (!frame.isZScore)
             {
-                for (int i = 0; i < averageCoh.size(); i++)
+                shownStdDev = &frame.stdDev[curComb];
+                jackknifeComb = frame.hasJackknife ? curComb : -1;
+                // (none since the TFR was reset, or not yet the same size as the frame)
+                if (processor->numSurrogateRounds > 0 && curComb < int(surrogateThreshold.values.size())
+                    && int(surrogateThreshold.values[curComb].size()) == frame.getNumFreqs())
                 {
-                    averageCoh[i] = coh[comb][i] + averageCoh[i];
+                    thresholdComb = curComb;
+
+                    // the surrogates are over the stored segments, which a linear or exponential
+                    // average (or a long last-N one) outnumbers
+                    const std::vector<double>& thresholds = surrogateThreshold.values[curComb];
+                    double averaged = curComb < int(frame.numAveraged.size()) ? frame.numAveraged[curComb] : 0;
+                    scaledThreshold.resize(thresholds.size());
+                    for (size_t f = 0; f < thresholds.size(); ++f)
+                    {
+                        scaledThreshold[f] = SurrogateCoherence::scaleThreshold(thresholds[f],
+                            surrogateThreshold.numSegments, averaged);
+                    }
                 }
             }
-            for (int i = 0; i < averageCoh.size(); i++)
+        }
+
+        // (the version is also reset to redraw after a change of view, which isn't a new update)
+        if (lastCoherenceVersion != lastHistoryVersion)
+        {
+            historyView->addUpdate(*shown, freqStart, freqStep);
+            lastHistoryVersion = lastCoherenceVersion;
+        }
+
+        if (heatmap->isVisible())
+        {
+            heatmap->update(frame, freqStart, freqStep);
+            return;
+        }
+
+        // Copy only what's shown
+
+        // coherence is plotted in percent, z-scores as they are
+        float scale = showingZScore ? 1.0f : 100.0f;
+        auto scaleInto = [scale](const std::vector<double>& src, std::vector<float>& dest)
+        {
+            int n = src.size();
+            dest.resize(n);
+            for (int i = 0; i < n; i++)
             {
-                averageCoh[i] /= coh.size();
+                dest[i] = src[i] * scale;
             }
-            cohLine = XYline(freqStart, freqStep, averageCoh, 1, Colours::yellow);
-        }
-        
+        };
+
+        scaleInto(*shown, coh);
+        bool showEnvelope = shown == &frame.average && frame.getNumCombinations() > 1;
 
         cohPlot->clearplot();
-        cohPlot->plotxy(cohLine);
+        if (showEnvelope)
+        {
+            scaleInto(frame.minimum, cohMin);
+            scaleInto(frame.maximum, cohMax);
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMin, 1, Colours::grey));
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMax, 1, Colours::grey));
+        }
+        else if (jackknifeComb >= 0)
+        {
+            // bias-corrected coherence and the edges of its 95% confidence interval
+            scaleInto(frame.ciLower[jackknifeComb], cohMin);
+            scaleInto(frame.ciUpper[jackknifeComb], cohMax);
+            scaleInto(frame.corrected[jackknifeComb], cohCorrected);
+            Colour bandColour = Colours::orange.withAlpha(0.4f);
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMin, 1, bandColour));
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMax, 1, bandColour));
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohCorrected, 1, Colours::orange));
+        }
+        else if (shownStdDev != nullptr)
+        {
+            // edges of the band within one standard deviation over the segment's times
+            int n = coh.size();
+            cohMin.resize(n);
+            cohMax.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                float halfWidth = float((*shownStdDev)[i]) * scale;
+                cohMin[i] = coh[i] - halfWidth;
+                cohMax[i] = coh[i] + halfWidth;
+            }
+            Colour bandColour = Colours::yellow.withAlpha(0.4f);
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMin, 1, bandColour));
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohMax, 1, bandColour));
+        }
+        if (thresholdComb >= 0)
+        {
+            scaleInto(scaledThreshold, cohThreshold);
+            cohPlot->plotxy(XYline(freqStart, freqStep, cohThreshold, 1, Colours::red));
+        }
+        cohPlot->plotxy(XYline(freqStart, freqStep, coh, 1, Colours::yellow));
         cohPlot->repaint();
     }
 }
@@ -510,6 +1125,95 @@ void CoherenceVisualizer::labelTextChanged(Label* labelThatHasChanged)
             processor->setParameter(processor->ARTIFACT_THRESHOLD, newVal);
         }
     }
+    // trigger and quality settings don't affect the TFR
+    else if (labelThatHasChanged == qualityThresholdEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, 0.01f, FLT_MAX, 0.8f, &newVal))
+        {
+            processor->setParameter(CoherenceNode::QUALITY_THRESHOLD, newVal);
+        }
+    }
+    else if (labelThatHasChanged == triggerChanEditable)
+    {
+        int newVal;
+        if (updateIntLabel(labelThatHasChanged, 1, 8, 1, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_EVENT_CHANNEL, newVal - 1);
+        }
+    }
+    else if (labelThatHasChanged == triggerBandStartEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, 0, processor->triggerBandEnd, 4, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_BAND_START, newVal);
+        }
+    }
+    else if (labelThatHasChanged == triggerBandEndEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, processor->triggerBandStart, FLT_MAX, 8, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_BAND_END, newVal);
+        }
+    }
+    else if (labelThatHasChanged == triggerRiseEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, processor->triggerFall, 1, 0.6f, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_RISE, newVal);
+        }
+    }
+    else if (labelThatHasChanged == triggerFallEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, 0, processor->triggerRise, 0.5f, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_FALL, newVal);
+        }
+    }
+    else if (labelThatHasChanged == triggerRefractoryEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, 0, FLT_MAX, 1, &newVal))
+        {
+            processor->setParameter(CoherenceNode::TRIGGER_REFRACTORY, newVal);
+        }
+    }
+    // the bands change the output channels (in that mode) and the recording's layout
+    else if (labelThatHasChanged == bandsEditable)
+    {
+        String error;
+        if (!processor->updateBands(bandsEditable->getText(), error))
+        {
+            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Coherence", error);
+        }
+        bandsEditable->setText(CoherenceBands::toString(processor->bands.getBands()), dontSendNotification);
+        updateTriggerBandList();
+        processor->updateReady(false);
+        CoreServices::updateSignalChain(processor->getEditor());
+    }
+    // nor does the output band; only the channel descriptions need updating
+    else if (labelThatHasChanged == outputBandStartEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, 0, processor->outputBandEnd, 4, &newVal))
+        {
+            processor->setParameter(CoherenceNode::OUTPUT_BAND_START, newVal);
+            CoreServices::updateSignalChain(processor->getEditor());
+        }
+    }
+    else if (labelThatHasChanged == outputBandEndEditable)
+    {
+        float newVal;
+        if (updateFloatLabel(labelThatHasChanged, processor->outputBandStart, FLT_MAX, 8, &newVal))
+        {
+            processor->setParameter(CoherenceNode::OUTPUT_BAND_END, newVal);
+            CoreServices::updateSignalChain(processor->getEditor());
+        }
+    }
     else
     {
         processor->updateReady(false);
@@ -530,6 +1234,19 @@ void CoherenceVisualizer::labelTextChanged(Label* labelThatHasChanged)
         }
     }
 
+    if (labelThatHasChanged == windowE)
+    {
+        int newVal;
+        if (updateIntLabel(labelThatHasChanged, 1, INT_MAX, 20, &newVal))
+        {
+            if (windowButton->getToggleState())
+            {
+                processor->updateAverageWindow(newVal);
+                processor->updateReady(false);
+            }
+        }
+    }
+
     if (labelThatHasChanged == fstartEditable)
     {
         int newVal;
@@ -552,15 +1269,136 @@ void CoherenceVisualizer::comboBoxChanged(ComboBox* comboBoxThatHasChanged)
 {
     if (comboBoxThatHasChanged == combinationBox)
     {
-        curComb = static_cast<int>(combinationBox->getSelectedId() - 2);
+        // ids: 1 = average, then each combination, then each channel's average
+        int id = combinationBox->getSelectedId();
+        int nCombinations = group1Channels.size() * group2Channels.size();
+        curComb = id >= 2 && id < nCombinations + 2 ? id - 2 : -1;
+        curChannelAvg = id >= nCombinations + 2 ? id - nCombinations - 2 : -1;
+        // (a channel's average needs its combinations, so count it as needing them all)
+        processor->displayedCombination = heatmapButton->getToggleState() ? -1 : curComb;
+        lastCoherenceVersion = 0; // copy the new selection on the next refresh
+        lastHistoryVersion = 0;
+        historyView->clear(combinationBox->getText());
+    }
+    else if (comboBoxThatHasChanged == outputModeBox)
+    {
+        processor->setParameter(CoherenceNode::OUTPUT_MODE, outputModeBox->getSelectedId());
+        CoreServices::updateSignalChain(processor->getEditor());
+    }
+    else if (comboBoxThatHasChanged == handoffBox)
+    {
+        processor->setParameter(CoherenceNode::SEGMENT_HANDOFF, handoffBox->getSelectedId());
+    }
+    else if (comboBoxThatHasChanged == triggerSourceBox)
+    {
+        processor->setParameter(CoherenceNode::TRIGGER_SOURCE, triggerSourceBox->getSelectedId() - 3);
+    }
+    else if (comboBoxThatHasChanged == triggerBandBox)
+    {
+        processor->setParameter(CoherenceNode::TRIGGER_BAND, triggerBandBox->getSelectedId() - 2);
     }
 }
 
 void CoherenceVisualizer::buttonClicked(Button* buttonClicked)
 {
+    if (buttonClicked == saveTimingsButton)
+    {
+        // doesn't change any settings
+        FileChooser chooser("Save stage timings", File::getSpecialLocation(File::userHomeDirectory), "*.csv");
+        if (chooser.browseForFileToSave(true))
+        {
+            File file = chooser.getResult().withFileExtension("csv");
+            if (!processor->timings.writeCsv(file.getFullPathName().toStdString(), processor->segLen))
+            {
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Coherence",
+                    "Could not write " + file.getFullPathName());
+            }
+        }
+        return;
+    }
+
+    // the baseline can change while acquiring, and doesn't change any settings
+    if (buttonClicked == collectBaselineButton)
+    {
+        processor->setBaselineMode(collectBaselineButton->getToggleState()
+            ? CoherenceNode::BASELINE_COLLECT : CoherenceNode::BASELINE_OFF);
+        updateBaselineState();
+        return;
+    }
+
+    if (buttonClicked == zScoreButton)
+    {
+        if (!processor->setBaselineMode(zScoreButton->getToggleState()
+            ? CoherenceNode::BASELINE_ZSCORE : CoherenceNode::BASELINE_OFF))
+        {
+            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Coherence",
+                "Collect a baseline of at least 2 segments, or load one recorded with the current "
+                "channels and settings, before showing z-scores.");
+        }
+        updateBaselineState();
+        return;
+    }
+
+    if (buttonClicked == saveBaselineButton)
+    {
+        FileChooser chooser("Save baseline", File::getSpecialLocation(File::userHomeDirectory), "*.cohbsl");
+        if (chooser.browseForFileToSave(true))
+        {
+            String error;
+            if (!processor->saveBaseline(chooser.getResult().withFileExtension("cohbsl"), error))
+            {
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Coherence", error);
+            }
+        }
+        return;
+    }
+
+    if (buttonClicked == loadBaselineButton)
+    {
+        FileChooser chooser("Load baseline", File::getSpecialLocation(File::userHomeDirectory), "*.cohbsl");
+        if (chooser.browseForFileToOpen())
+        {
+            String error;
+            if (!processor->loadBaseline(chooser.getResult(), error))
+            {
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Coherence", error);
+            }
+            updateBaselineState();
+        }
+        return;
+    }
+
+    if (buttonClicked == adaptQualityButton)
+    {
+        processor->setParameter(CoherenceNode::ADAPT_QUALITY, adaptQualityButton->getToggleState() ? 1.0f : 0.0f);
+        return;
+    }
+
+    if (buttonClicked == heatmapButton)
+    {
+        // display only: the heatmap needs every combination, and the line just its own
+        bool showHeatmap = heatmapButton->getToggleState();
+        heatmap->setVisible(showHeatmap);
+        cohPlot->setVisible(!showHeatmap);
+        combinationBox->setEnabled(!showHeatmap);
+        processor->displayedCombination = showHeatmap ? -1 : curComb;
+        lastCoherenceVersion = 0;
+        return;
+    }
+
     if (buttonClicked == resetTFR)
     {
+        int numOutputsBefore = processor->getNumOutputChannels();
         processor->resetTFR();
+
+        // output channels per combination are named after it, so the combinations may have
+        // changed their names as well as how many there are
+        int mode = processor->outputMode;
+        if (processor->getNumOutputChannels() != numOutputsBefore
+            || mode == CoherenceNode::OUTPUT_ALL_COMBS || mode == CoherenceNode::OUTPUT_BANDS)
+        {
+            CoreServices::updateSignalChain(processor->getEditor());
+        }
     }
     // Button was clicked that wasn't reseting the TFR, something important has changed. Tell node that we need to reset.
     else
@@ -607,14 +1445,44 @@ void CoherenceVisualizer::buttonClicked(Button* buttonClicked)
     if (buttonClicked == linearButton)
     {
         expButton->setToggleState(false, dontSendNotification);
+        windowButton->setToggleState(false, dontSendNotification);
 
         processor->updateAlpha(0);
+        processor->updateAverageWindow(0);
     }
     
     if (buttonClicked == expButton)
     {
         linearButton->setToggleState(false, dontSendNotification);
+        windowButton->setToggleState(false, dontSendNotification);
         processor->updateAlpha(alphaE->getText().getFloatValue());
+        processor->updateAverageWindow(0);
+    }
+
+    if (buttonClicked == windowButton)
+    {
+        linearButton->setToggleState(false, dontSendNotification);
+        expButton->setToggleState(false, dontSendNotification);
+        processor->updateAlpha(0);
+        processor->updateAverageWindow(windowE->getText().getIntValue());
+    }
+
+    if (buttonClicked == jackknifeButton)
+    {
+        processor->updateJackknife(jackknifeButton->getToggleState());
+        processor->updateReady(false);
+    }
+
+    if (buttonClicked == surrogateButton)
+    {
+        processor->updateSurrogates(surrogateButton->getToggleState());
+        processor->updateReady(false);
+    }
+
+    if (buttonClicked == recordFreqValuesButton)
+    {
+        processor->updateRecordFreqValues(recordFreqValuesButton->getToggleState());
+        processor->updateReady(false);
     }
 
     if (group1Buttons.contains((ElectrodeButton*)buttonClicked))
@@ -765,6 +1633,23 @@ void CoherenceVisualizer::beginAnimation()
     linearButton->setEnabled(false);
     expButton->setEnabled(false);
     alphaE->setEditable(false);
+    windowButton->setEnabled(false);
+    windowE->setEditable(false);
+    jackknifeButton->setEnabled(false);
+    surrogateButton->setEnabled(false);
+    bandsEditable->setEditable(false);
+    recordFreqValuesButton->setEnabled(false);
+    outputModeBox->setEnabled(false);
+    handoffBox->setEnabled(false);
+    outputBandStartEditable->setEditable(false);
+    outputBandEndEditable->setEditable(false);
+    triggerSourceBox->setEnabled(false);
+    triggerBandBox->setEnabled(false);
+    for (Label* label : { triggerChanEditable.get(), triggerBandStartEditable.get(), triggerBandEndEditable.get(),
+        triggerRiseEditable.get(), triggerFallEditable.get(), triggerRefractoryEditable.get() })
+    {
+        label->setEditable(false);
+    }
 }
 void CoherenceVisualizer::endAnimation() 
 {
@@ -784,6 +1669,46 @@ void CoherenceVisualizer::endAnimation()
     linearButton->setEnabled(true);
     expButton->setEnabled(true);
     alphaE->setEditable(false);
+    windowButton->setEnabled(true);
+    windowE->setEditable(true);
+    jackknifeButton->setEnabled(true);
+    surrogateButton->setEnabled(true);
+    bandsEditable->setEditable(true);
+    recordFreqValuesButton->setEnabled(true);
+    outputModeBox->setEnabled(true);
+    handoffBox->setEnabled(true);
+    outputBandStartEditable->setEditable(true);
+    outputBandEndEditable->setEditable(true);
+    triggerSourceBox->setEnabled(true);
+    triggerBandBox->setEnabled(true);
+    for (Label* label : { triggerChanEditable.get(), triggerBandStartEditable.get(), triggerBandEndEditable.get(),
+        triggerRiseEditable.get(), triggerFallEditable.get(), triggerRefractoryEditable.get() })
+    {
+        label->setEditable(true);
+    }
+}
+
+void CoherenceVisualizer::updateValueRange()
+{
+    double low = showingZScore ? -Z_SCORE_RANGE : 0;
+    double high = showingZScore ? Z_SCORE_RANGE : 1;
+    double plotScale = showingZScore ? 1 : 100; // (coherence in percent)
+
+    cohPlot->setRange(freqStart, freqEnd, low * plotScale, high * plotScale, true);
+    cohPlot->setTitle(showingZScore ? "Z-score at Selected Combination" : "Coherence at Selected Combination");
+    heatmap->setRange(low, high, showingZScore ? "Z-score at Every Combination" : "Coherence at Every Combination");
+    historyView->setRange(low, high);
+}
+
+void CoherenceVisualizer::updateBaselineState()
+{
+    int mode = processor->baselineMode;
+    collectBaselineButton->setToggleState(mode == CoherenceNode::BASELINE_COLLECT, dontSendNotification);
+    zScoreButton->setToggleState(mode == CoherenceNode::BASELINE_ZSCORE, dontSendNotification);
+
+    uint64 numSegments = processor->getBaselineSegments();
+    baselineStatus->setText("Baseline: " + String(numSegments) + " segments"
+        + (mode == CoherenceNode::BASELINE_COLLECT ? " (collecting)" : ""), dontSendNotification);
 }
 
 bool CoherenceVisualizer::updateFloatLabel(Label* label, float min, float max,
@@ -828,6 +1753,460 @@ bool CoherenceVisualizer::updateIntLabel(Label* label, int min, int max, int def
 }
 
 
+/************ StageTimingView ****************/
+
+StageTimingView::StageTimingView(const StageTimings& t)
+    : timings       (t)
+    , segmentSeconds(0)
+{}
+
+StageTimingView::~StageTimingView() {}
+
+void StageTimingView::setSegmentLength(double seconds)
+{
+    segmentSeconds = seconds;
+}
+
+void StageTimingView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black);
+
+    const int rowHt = 16;
+    const int colWidths[] = { 130, 70, 70, 70, 70, 70, 70 };
+
+    auto drawRow = [&](int y, std::initializer_list<String> cells)
+    {
+        int col = 0;
+        int x = 5;
+        for (const String& cell : cells)
+        {
+            g.drawText(cell, x, y, colWidths[col] - 5, rowHt,
+                col == 0 ? Justification::left : Justification::right);
+            x += colWidths[col++];
+        }
+    };
+
+    g.setFont(Font(13, Font::bold));
+    g.setColour(Colours::white);
+    g.drawText("Stage timings (last " + String(TimingRing::CAPACITY) + " of each)", 5, 2, 300, rowHt,
+        Justification::left);
+    drawRow(2 + rowHt, { "Stage", "Count", "Mean", "50%", "95%", "99%", "Max (ms)" });
+
+    g.setFont(Font(13));
+    int y = 2 + 2 * rowHt;
+    for (int stage = 0; stage < StageTimings::NUM_STAGES; ++stage, y += rowHt)
+    {
+        TimingStats stats = TimingStats::fromRing(timings[stage]);
+        g.setColour(stage == StageTimings::SEGMENT_TOTAL ? Colours::yellow : Colours::lightgrey);
+        drawRow(y, { StageTimings::getStageName(stage), String(int64(stats.count)), String(stats.mean, 2),
+            String(stats.p50, 2), String(stats.p95, 2), String(stats.p99, 2), String(stats.max, 2) });
+    }
+
+    // how much of the segment duration the calculation takes
+    TimingStats segmentStats = TimingStats::fromRing(timings[StageTimings::SEGMENT_TOTAL]);
+    double rtf50 = StageTimings::getRealTimeFactor(segmentStats.p50, segmentSeconds);
+    double rtf95 = StageTimings::getRealTimeFactor(segmentStats.p95, segmentSeconds);
+    g.setColour(rtf95 >= 1 ? Colours::red : Colours::white);
+    g.drawText("Real-time factor (compute / segment length): " + String(rtf50, 3) + " median, "
+        + String(rtf95, 3) + " 95%", 5, y + 2, getWidth() - 10, rowHt, Justification::left);
+}
+
+
+/************ CoherenceColourMap ****************/
+
+CoherenceColourMap::CoherenceColourMap()
+    : low   (0)
+    , high  (1)
+{
+    ColourGradient gradient(Colours::darkblue, 0, 0, Colours::red, 1, 0, false);
+    gradient.addColour(0.35, Colours::cyan);
+    gradient.addColour(0.65, Colours::yellow);
+    for (int i = 0; i < NUM_COLOURS; ++i)
+    {
+        colours[i] = gradient.getColourAtPosition(double(i) / (NUM_COLOURS - 1)).getPixelARGB();
+    }
+}
+
+void CoherenceColourMap::setRange(double newLow, double newHigh)
+{
+    jassert(newHigh > newLow);
+    low = newLow;
+    high = newHigh;
+}
+
+void CoherenceColourMap::drawBar(Graphics& g, juce::Rectangle<int> bar) const
+{
+    for (int y = 0; y < bar.getHeight(); ++y)
+    {
+        int i = (NUM_COLOURS - 1) - y * (NUM_COLOURS - 1) / jmax(1, bar.getHeight() - 1);
+        g.setColour(Colour(colours[i]));
+        g.fillRect(bar.getX(), bar.getY() + y, bar.getWidth(), 1);
+    }
+
+    const int textHt = 16;
+    g.setColour(Colours::lightgrey);
+    g.drawText(String(roundToInt(high)), bar.getRight() + 2, bar.getY(), 25, textHt, Justification::left);
+    g.drawText(String(roundToInt(low)), bar.getRight() + 2, bar.getBottom() - textHt, 25, textHt,
+        Justification::left);
+}
+
+
+/************ CoherenceHeatmap ****************/
+
+CoherenceHeatmap::CoherenceHeatmap()
+    : title     ("Coherence at Every Combination")
+    , freqStart (0)
+    , freqStep  (1)
+{
+    setOpaque(true);
+}
+
+CoherenceHeatmap::~CoherenceHeatmap() {}
+
+void CoherenceHeatmap::setCombinationNames(const StringArray& names)
+{
+    combinationNames = names;
+    repaint();
+}
+
+void CoherenceHeatmap::setRange(double low, double high, const String& newTitle)
+{
+    colourMap.setRange(low, high);
+    title = newTitle;
+    image = Image(); // every cell's colour changes
+    repaint();
+}
+
+juce::Rectangle<int> CoherenceHeatmap::getMapArea() const
+{
+    // title above, combination names to the left, frequencies below, colour bar to the right
+    return getLocalBounds().withTrimmedTop(22).withTrimmedLeft(55).withTrimmedBottom(20).withTrimmedRight(50);
+}
+
+void CoherenceHeatmap::update(const CoherenceFrame& frame, float newFreqStart, float newFreqStep)
+{
+    int nFreqs = frame.getNumFreqs();
+    int nCombs = frame.getNumCombinations();
+    if (nFreqs == 0 || nCombs == 0)
+    {
+        return;
+    }
+
+    bool redrawAll = image.isNull() || image.getWidth() != nFreqs || image.getHeight() != nCombs
+        || newFreqStart != freqStart || newFreqStep != freqStep;
+    if (image.isNull() || image.getWidth() != nFreqs || image.getHeight() != nCombs)
+    {
+        image = Image(Image::ARGB, nFreqs, nCombs, false);
+        levels.assign(size_t(nFreqs) * nCombs, 0);
+    }
+    freqStart = newFreqStart;
+    freqStep = newFreqStep;
+
+    int firstChanged = nCombs;
+    int lastChanged = -1;
+    {
+        Image::BitmapData pixels(image, Image::BitmapData::writeOnly);
+        std::vector<uint8> rowLevels(nFreqs);
+        for (int comb = 0; comb < nCombs; ++comb)
+        {
+            const std::vector<double>& coh = frame.coherence[comb];
+            for (int f = 0; f < nFreqs; ++f)
+            {
+                rowLevels[f] = uint8(colourMap.getIndex(coh[f]));
+            }
+
+            uint8* drawn = &levels[size_t(comb) * nFreqs];
+            if (!redrawAll && std::equal(rowLevels.begin(), rowLevels.end(), drawn))
+            {
+                continue;
+            }
+
+            std::copy(rowLevels.begin(), rowLevels.end(), drawn);
+            for (int f = 0; f < nFreqs; ++f)
+            {
+                *reinterpret_cast<PixelARGB*>(pixels.getPixelPointer(f, comb)) = colourMap[rowLevels[f]];
+            }
+            firstChanged = jmin(firstChanged, comb);
+            lastChanged = comb;
+        }
+    }
+
+    if (redrawAll)
+    {
+        repaint();
+    }
+    else if (lastChanged >= 0)
+    {
+        // just the band of rows that changed
+        juce::Rectangle<int> area = getMapArea();
+        float rowHeight = float(area.getHeight()) / nCombs;
+        int top = area.getY() + int(std::floor(firstChanged * rowHeight));
+        int bottom = area.getY() + int(std::ceil((lastChanged + 1) * rowHeight));
+        repaint(area.getX(), top, area.getWidth(), bottom - top);
+    }
+}
+
+void CoherenceHeatmap::paint(Graphics& g)
+{
+    g.fillAll(Colours::black);
+
+    const int textHt = 16;
+    juce::Rectangle<int> area = getMapArea();
+    g.setFont(Font(13));
+    g.setColour(Colours::white);
+    g.drawText(title, 0, 2, getWidth(), textHt, Justification::centred);
+
+    if (image.isNull())
+    {
+        g.setColour(Colours::grey);
+        g.drawText("(waiting for data)", area, Justification::centred);
+        return;
+    }
+
+    // nearest neighbour, so cells stay sharp
+    g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+    g.drawImage(image, area.toFloat(), RectanglePlacement::stretchToFit);
+
+    // combination names, as many as fit
+    int nCombs = image.getHeight();
+    float rowHeight = float(area.getHeight()) / nCombs;
+    int every = jmax(1, int(std::ceil(textHt / rowHeight)));
+    g.setColour(Colours::lightgrey);
+    for (int comb = 0; comb < nCombs && comb < combinationNames.size(); comb += every)
+    {
+        int y = area.getY() + int(comb * rowHeight + rowHeight / 2) - textHt / 2;
+        g.drawText(combinationNames[comb], 0, y, area.getX() - 4, textHt, Justification::right);
+    }
+
+    // first, middle and last frequency
+    int nFreqs = image.getWidth();
+    float colWidth = float(area.getWidth()) / nFreqs;
+    for (int f : { 0, nFreqs / 2, nFreqs - 1 })
+    {
+        int x = area.getX() + int(f * colWidth + colWidth / 2);
+        g.drawText(String(freqStart + f * freqStep, 1) + " Hz", x - 40, area.getBottom() + 2, 80, textHt,
+            Justification::centred);
+    }
+
+    colourMap.drawBar(g, { area.getRight() + 8, area.getY(), 12, area.getHeight() });
+}
+
+
+/************ CoherenceHistoryView ****************/
+
+CoherenceHistoryView::CoherenceHistoryView()
+    : nFreqs    (0)
+    , numUpdates(0)
+    , nextColumn(0)
+    , freqStart (0)
+    , freqStep  (1)
+{
+    setOpaque(true);
+}
+
+CoherenceHistoryView::~CoherenceHistoryView() {}
+
+juce::Rectangle<int> CoherenceHistoryView::getMapArea() const
+{
+    // title above, frequencies to the left, time below, colour bar to the right
+    return getLocalBounds().withTrimmedTop(22).withTrimmedLeft(55).withTrimmedBottom(20).withTrimmedRight(50);
+}
+
+void CoherenceHistoryView::clear(const String& newTitle)
+{
+    title = newTitle;
+    numUpdates = 0;
+    nextColumn = 0;
+    history.reset();
+    image = Image();
+    setTooltip("");
+    repaint();
+}
+
+void CoherenceHistoryView::setRange(double low, double high)
+{
+    colourMap.setRange(low, high);
+}
+
+void CoherenceHistoryView::addUpdate(const std::vector<double>& coherence, float newFreqStart, float newFreqStep)
+{
+    int n = int(coherence.size());
+    if (n == 0)
+    {
+        return;
+    }
+
+    if (n != nFreqs || newFreqStart != freqStart || newFreqStep != freqStep)
+    {
+        // different frequencies; the old rows don't line up with the new ones
+        nFreqs = n;
+        freqStart = newFreqStart;
+        freqStep = newFreqStep;
+        history.resize(HISTORY_LENGTH * nFreqs);
+        clear(title);
+    }
+
+    if (image.isNull())
+    {
+        image = Image(Image::ARGB, HISTORY_LENGTH, nFreqs, true);
+    }
+
+    std::vector<float> row(coherence.begin(), coherence.end());
+    history.enqueueArray(row.data(), nFreqs);
+
+    {
+        Image::BitmapData pixels(image, Image::BitmapData::writeOnly);
+        for (int f = 0; f < nFreqs; ++f)
+        {
+            *reinterpret_cast<PixelARGB*>(pixels.getPixelPointer(nextColumn, nFreqs - 1 - f))
+                = colourMap[colourMap.getIndex(coherence[f])];
+        }
+    }
+    nextColumn = (nextColumn + 1) % HISTORY_LENGTH;
+    numUpdates = jmin(numUpdates + 1, int(HISTORY_LENGTH));
+
+    repaint(getMapArea());
+}
+
+void CoherenceHistoryView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black);
+
+    const int textHt = 16;
+    juce::Rectangle<int> area = getMapArea();
+    g.setFont(Font(13));
+    g.setColour(Colours::white);
+    g.drawText("History: " + title, 0, 2, getWidth(), textHt, Justification::centred);
+
+    if (image.isNull() || numUpdates == 0)
+    {
+        g.setColour(Colours::grey);
+        g.drawText("(waiting for data)", area, Justification::centred);
+        return;
+    }
+
+    // oldest column first: from nextColumn to the end, then from the start to nextColumn
+    // (until the history is full, that's just the columns written so far, drawn at the right)
+    g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+    float colWidth = float(area.getWidth()) / HISTORY_LENGTH;
+    int oldest = numUpdates < HISTORY_LENGTH ? 0 : nextColumn;
+    int nFirst = numUpdates < HISTORY_LENGTH ? numUpdates : HISTORY_LENGTH - nextColumn;
+    float x = area.getRight() - numUpdates * colWidth;
+    g.drawImage(image, roundToInt(x), area.getY(), roundToInt(nFirst * colWidth), area.getHeight(),
+        oldest, 0, nFirst, nFreqs);
+    if (nFirst < numUpdates)
+    {
+        x += nFirst * colWidth;
+        g.drawImage(image, roundToInt(x), area.getY(), area.getRight() - roundToInt(x), area.getHeight(),
+            0, 0, numUpdates - nFirst, nFreqs);
+    }
+
+    g.setColour(Colours::lightgrey);
+    g.drawText(String(freqStart + (nFreqs - 1) * freqStep, 1) + " Hz", 0, area.getY(), area.getX() - 4,
+        textHt, Justification::right);
+    g.drawText(String(freqStart, 1) + " Hz", 0, area.getBottom() - textHt, area.getX() - 4, textHt,
+        Justification::right);
+    g.drawText(String(HISTORY_LENGTH) + " updates ago", area.getX(), area.getBottom() + 2, 150, textHt,
+        Justification::left);
+    g.drawText("now", area.getRight() - 60, area.getBottom() + 2, 60, textHt, Justification::right);
+
+    colourMap.drawBar(g, { area.getRight() + 8, area.getY(), 12, area.getHeight() });
+}
+
+void CoherenceHistoryView::mouseMove(const MouseEvent& event)
+{
+    juce::Rectangle<int> area = getMapArea();
+    if (numUpdates == 0 || !area.contains(event.getPosition()))
+    {
+        setTooltip("");
+        return;
+    }
+
+    // updates ago, and frequency bin (lowest at the bottom)
+    int age = int((area.getRight() - event.x) * HISTORY_LENGTH / float(area.getWidth()));
+    int f = jlimit(0, nFreqs - 1, int((area.getBottom() - event.y) * nFreqs / float(area.getHeight())));
+    if (age >= numUpdates)
+    {
+        setTooltip("");
+        return;
+    }
+
+    // the history's rows are oldest first, and it's always full-length
+    float coherence = history[(HISTORY_LENGTH - 1 - age) * nFreqs + f];
+    setTooltip(String(age) + " updates ago, " + String(freqStart + f * freqStep, 1) + " Hz: "
+        + String(coherence, 3));
+}
+
+
+/************ LatencyHistogramView ****************/
+
+LatencyHistogramView::LatencyHistogramView(const LatencyHistogram& h, const String& t)
+    : histogram (h)
+    , title     (t)
+{}
+
+LatencyHistogramView::~LatencyHistogramView() {}
+
+void LatencyHistogramView::setSummary(const String& newSummary)
+{
+    summary = newSummary;
+}
+
+void LatencyHistogramView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black);
+
+    const int textHt = 16;
+    g.setColour(Colours::white);
+    g.setFont(Font(13));
+
+    uint32 count = histogram.getCount();
+    String stats = summary;
+    if (count > 0)
+    {
+        stats += String("   median ") + String(histogram.getPercentile(0.5), 1) + " ms"
+            + ", 95% " + String(histogram.getPercentile(0.95), 1) + " ms"
+            + ", max " + String(histogram.getMax(), 1) + " ms"
+            + ", mean " + String(histogram.getMean(), 1) + " ms";
+    }
+    g.drawText(title, 5, 2, getWidth() - 10, textHt, Justification::left);
+    g.drawText(stats, 5, 2 + textHt, getWidth() - 10, textHt, Justification::left);
+
+    // bars from 0 to the last occupied bin (at least 20 bins), plus overflow
+    int numBins = histogram.getNumBins();
+    int lastBin = 0;
+    uint32 maxCount = 0;
+    for (int bin = 0; bin <= numBins; ++bin)
+    {
+        uint32 binCount = histogram.getBinCount(bin);
+        if (binCount > 0)
+        {
+            lastBin = bin;
+            maxCount = jmax(maxCount, binCount);
+        }
+    }
+
+    int numShown = jmax(20, jmin(lastBin, numBins - 1) + 1);
+    bool showOverflow = histogram.getBinCount(numBins) > 0;
+
+    juce::Rectangle<int> plotArea(5, 2 * textHt + 6, getWidth() - 10, getHeight() - 3 * textHt - 10);
+    float barWidth = float(plotArea.getWidth()) / (numShown + (showOverflow ? 1 : 0));
+
+    for (int i = 0; i < numShown + (showOverflow ? 1 : 0) && maxCount > 0; ++i)
+    {
+        int bin = i < numShown ? i : numBins;
+        float height = plotArea.getHeight() * float(histogram.getBinCount(bin)) / maxCount;
+        g.setColour(bin == numBins ? Colours::red : Colours::yellow);
+        g.fillRect(plotArea.getX() + i * barWidth, plotArea.getBottom() - height, jmax(1.0f, barWidth - 1), height);
+    }
+
+    g.setColour(Colours::grey);
+    g.drawText("0", plotArea.getX(), plotArea.getBottom(), 40, textHt, Justification::left);
+    g.drawText(String(numShown * histogram.getBinWidth(), 0) + " ms" + (showOverflow ? " +" : ""),
+        plotArea.getRight() - 80, plotArea.getBottom(), 80, textHt, Justification::right);
+}
+
+
 /************ VerticalGroupSet ****************/
 
 VerticalGroupSet::VerticalGroupSet(Colour backgroundColor)
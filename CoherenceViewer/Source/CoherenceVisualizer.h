@@ -24,7 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef COHERENCE_VIS_H_INCLUDED
 #define COHERENCE_VIS_H_INCLUDED
 
-#include "AtomicSynchronizer.h"
+#include "Core/AtomicSynchronizer.h"
+#include "Core/SampleRing.h"
 #include "CoherenceNode.h"
 #include <VisualizerWindowHeaders.h>
 //#include "../../Processors/Visualization/MatlabLikePlot.h"
@@ -47,6 +48,140 @@ private:
     static const int CORNER_SIZE = 8;
 };
 
+// Bar chart of a LatencyHistogram with its percentiles
+class LatencyHistogramView : public Component
+{
+public:
+    LatencyHistogramView(const LatencyHistogram& histogram, const String& title);
+    ~LatencyHistogramView();
+
+    // extra text drawn under the title, e.g. event counts
+    void setSummary(const String& newSummary);
+
+    void paint(Graphics& g) override;
+
+private:
+    const LatencyHistogram& histogram;
+    String title;
+    String summary;
+};
+
+// Table of per-stage timing percentiles and the real-time factor
+class StageTimingView : public Component
+{
+public:
+    StageTimingView(const StageTimings& timings);
+    ~StageTimingView();
+
+    void setSegmentLength(double seconds);
+
+    void paint(Graphics& g) override;
+
+private:
+    const StageTimings& timings;
+    double segmentSeconds;
+};
+
+// Colours for values from low to high (coherence: 0 to 1), computed once
+class CoherenceColourMap
+{
+public:
+    CoherenceColourMap();
+
+    static const int NUM_COLOURS = 256;
+
+    void setRange(double newLow, double newHigh);
+
+    int getIndex(double value) const
+    {
+        return jlimit(0, NUM_COLOURS - 1, roundToInt((value - low) / (high - low) * (NUM_COLOURS - 1)));
+    }
+
+    const PixelARGB& operator[](int index) const { return colours[index]; }
+
+    // Vertical bar, high at the top (the ends are labelled as whole numbers)
+    void drawBar(Graphics& g, juce::Rectangle<int> bar) const;
+
+private:
+    PixelARGB colours[NUM_COLOURS];
+    double low;
+    double high;
+};
+
+// Coherence of every combination (rows) at every frequency (columns), kept in a cached image.
+// Each cell is quantized to an index into the colour map; an update only rewrites and repaints
+// the rows where some index changed.
+class CoherenceHeatmap : public Component
+{
+public:
+    CoherenceHeatmap();
+    ~CoherenceHeatmap();
+
+    // Row labels, one per combination (e.g. "1 x 5")
+    void setCombinationNames(const StringArray& names);
+
+    // Colour scale and title, e.g. for z-scores instead of coherence; redraws on the next update
+    void setRange(double low, double high, const String& newTitle);
+
+    void update(const CoherenceFrame& frame, float freqStart, float freqStep);
+
+    void paint(Graphics& g) override;
+
+private:
+    juce::Rectangle<int> getMapArea() const;
+
+    CoherenceColourMap colourMap;
+
+    Image image;                // # freqs wide x # combinations high
+    std::vector<uint8> levels;  // colour table index each cell was last drawn with
+    StringArray combinationNames;
+    String title;
+    float freqStart;
+    float freqStep;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoherenceHeatmap);
+};
+
+// Coherence of one line (a combination or a summary) over the last HISTORY_LENGTH updates,
+// newest on the right. Values are kept in a SampleRing of whole rows; the image has one
+// column per update, written in a rolling position, and is drawn in two pieces from the oldest
+// column so that nothing already drawn has to be redrawn or moved. Hovering shows the value.
+class CoherenceHistoryView : public Component, public SettableTooltipClient
+{
+public:
+    CoherenceHistoryView();
+    ~CoherenceHistoryView();
+
+    static const int HISTORY_LENGTH = 240;
+
+    // Forgets everything, e.g. when a different line is selected
+    void clear(const String& newTitle);
+
+    // Colour scale of later updates (coherence: 0 to 1); clear first
+    void setRange(double low, double high);
+
+    void addUpdate(const std::vector<double>& coherence, float freqStart, float freqStep);
+
+    void paint(Graphics& g) override;
+    void mouseMove(const MouseEvent& event) override;
+
+private:
+    juce::Rectangle<int> getMapArea() const;
+
+    CoherenceColourMap colourMap;
+
+    SampleRing<float> history; // HISTORY_LENGTH rows of # freqs, oldest first
+    int nFreqs;
+    int numUpdates;     // rows filled so far, up to HISTORY_LENGTH
+    int nextColumn;     // image column the next update goes in
+    Image image;        // HISTORY_LENGTH wide x # freqs high, lowest frequency at the bottom
+    String title;
+    float freqStart;
+    float freqStep;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoherenceHistoryView);
+};
+
 class CoherenceVisualizer : public Visualizer
     , public ComboBox::Listener
     , public Button::Listener
@@ -77,6 +212,10 @@ public:
 private:
     // Update list of combinations to choose to graph.
     void updateCombList();
+    // Update list of trigger sources (off, average, each combination)
+    void updateTriggerSourceList();
+    // Update list of trigger bands (the range, each of the processor's bands)
+    void updateTriggerBandList();
     // Update state of buttons based on grouping changing from non clicking ways
     void updateGroupState();
     // Update buttons based on inputs (checks if you have too many or too few buttons for the number of inputs).
@@ -104,6 +243,7 @@ private:
     ScopedPointer<VerticalGroupSet> combinationGroupSet;
     ScopedPointer<Label> combinationLabel;
     ScopedPointer<ComboBox> combinationBox;
+    ScopedPointer<ToggleButton> heatmapButton;
     
     ScopedPointer<VerticalGroupSet> columnTwoSet;
 
@@ -111,11 +251,23 @@ private:
     ScopedPointer<ToggleButton> expButton;
     ScopedPointer<Label> alpha;
     ScopedPointer<Label> alphaE;
+    ScopedPointer<ToggleButton> windowButton;
+    ScopedPointer<Label> windowE;
+    ScopedPointer<Label> windowUnit;
+    ScopedPointer<ToggleButton> jackknifeButton;
+    ScopedPointer<ToggleButton> surrogateButton;
     
     ScopedPointer<Label> artifactDesc;
     ScopedPointer<Label> artifactEq;
     ScopedPointer<Label> artifactE;
     ScopedPointer<Label> artifactCount;
+    ScopedPointer<Label> segmentCount;
+    ScopedPointer<Label> handoffLabel;
+    ScopedPointer<ComboBox> handoffBox;
+    ScopedPointer<ToggleButton> adaptQualityButton;
+    ScopedPointer<Label> qualityThresholdLabel;
+    ScopedPointer<Label> qualityThresholdEditable;
+    ScopedPointer<Label> qualityStatus;
     
     ScopedPointer<TextButton> resetTFR;
     ScopedPointer<TextButton> clearGroups;
@@ -127,6 +279,43 @@ private:
     ScopedPointer<Label> fendLabel;
     ScopedPointer<Label> fendEditable;
 
+    ScopedPointer<Label> outputLabel;
+    ScopedPointer<ComboBox> outputModeBox;
+    ScopedPointer<Label> outputBandLabel;
+    ScopedPointer<Label> outputBandStartEditable;
+    ScopedPointer<Label> outputBandEndEditable;
+
+    ScopedPointer<Label> bandsLabel;
+    ScopedPointer<Label> bandsEditable;
+    ScopedPointer<ToggleButton> recordFreqValuesButton;
+
+    ScopedPointer<Label> baselineLabel;
+    ScopedPointer<ToggleButton> collectBaselineButton;
+    ScopedPointer<ToggleButton> zScoreButton;
+    ScopedPointer<TextButton> saveBaselineButton;
+    ScopedPointer<TextButton> loadBaselineButton;
+    ScopedPointer<Label> baselineStatus;
+
+    ScopedPointer<VerticalGroupSet> triggerSet;
+    ScopedPointer<Label> triggerLabel;
+    ScopedPointer<ComboBox> triggerSourceBox;
+    ScopedPointer<ComboBox> triggerBandBox;
+    ScopedPointer<Label> triggerChanLabel;
+    ScopedPointer<Label> triggerChanEditable;
+    ScopedPointer<Label> triggerBandLabel;
+    ScopedPointer<Label> triggerBandStartEditable;
+    ScopedPointer<Label> triggerBandEndEditable;
+    ScopedPointer<Label> triggerRiseLabel;
+    ScopedPointer<Label> triggerRiseEditable;
+    ScopedPointer<Label> triggerFallLabel;
+    ScopedPointer<Label> triggerFallEditable;
+    ScopedPointer<Label> triggerRefractoryLabel;
+    ScopedPointer<Label> triggerRefractoryEditable;
+    ScopedPointer<LatencyHistogramView> triggerLatencyView;
+
+    ScopedPointer<StageTimingView> timingView;
+    ScopedPointer<TextButton> saveTimingsButton;
+
 
 
     Array<int> group1Channels;
@@ -134,14 +323,42 @@ private:
 
     float freqStep;
     int nCombs;
-    int curComb;
+    int curComb;        // combination shown, or -1 for a summary across combinations
+    int curChannelAvg;  // channel whose combinations are averaged (group 1 then group 2), or -1
 
     int freqStart;
     int freqEnd;
 
     ScopedPointer<MatlabLikePlot> cohPlot;
+    ScopedPointer<CoherenceHeatmap> heatmap; // in place of cohPlot when heatmapButton is on
+    ScopedPointer<CoherenceHistoryView> historyView; // of the line in cohPlot
     std::vector<double> coherence;
-    std::vector<std::vector<float>> coh;
+    // what's plotted (x 100): the selected combination or summary, and when showing the
+    // average, the lowest and highest combination at each frequency (or for a combination,
+    // the edges of its standard deviation band or jackknife confidence interval, along with
+    // the bias-corrected coherence)
+    std::vector<float> coh;
+    std::vector<float> cohMin;
+    std::vector<float> cohMax;
+    std::vector<float> cohCorrected;
+    std::vector<float> cohThreshold; // surrogate threshold of a combination
+
+    // latest surrogate thresholds from the processor, and those of the shown combination scaled
+    // to the segments in its average
+    CoherenceNode::SurrogateThresholds surrogateThreshold;
+    std::vector<double> scaledThreshold;
+    uint64 lastCoherenceVersion; // of meanCoherence, last copied into coh (0 to copy again)
+    uint64 lastHistoryVersion;   // of meanCoherence, last added to historyView
+    String lastQualityChangeShown; // entry of the processor's quality log last posted to the status bar
+
+    // Whether the plots show z-scores against the baseline (from the latest frame) or coherence
+    bool showingZScore;
+    static const int Z_SCORE_RANGE = 4; // plotted from -this to this
+
+    // Sets the plots' scales and titles for coherence or z-scores
+    void updateValueRange();
+    // Reflects the processor's baseline mode and size
+    void updateBaselineState();
 
     bool updateIntLabel(Label* label, int min, int max, int defaultValue, int* out);
     bool updateFloatLabel(Label* label, float min, float max,
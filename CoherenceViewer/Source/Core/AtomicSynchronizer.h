@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ATOMIC_SYNCHRONIZER_H_INCLUDED
 
 #include <atomic>
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <cassert>
@@ -82,6 +83,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *      * The reset() method brings you back to the state where no writes have been performed yet.
 *        Must be called when no read or write pointers exist.
 *
+*      * getNumPushed() and getNumDropped() count the updates pushed since the last reset, and
+*        those that were replaced by a newer update before the reader pulled them. A reader
+*        that can't keep up never sees the dropped updates, so a rising drop count is how to
+*        tell that it has fallen behind.
+*
 *  - Using an AtomicSynchronizer directly works similarly; the main difference is that you
 *    are responsible for allocating and accessing the data, and the AtomicSynchronizer just
 *    tells you which index to use (0, 1, or 2) as the reader or writer.
@@ -95,7 +101,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *        This works how you would expect and also has a pullUpdate() method. Remember to check
 *        whether it is valid before using if you're not using hasUpdate().
 *
-*      * AtomicSynchronizer has hasUpdate() and reset() methods as well.
+*      * AtomicSynchronizer has hasUpdate(), reset(), getNumPushed() and getNumDropped() methods as well.
 *
 *      * ScopedLockout is just a try-lock for both readers and writers; it will be "valid"
 *        iff no read or write indices exist at the point of construction. By constructing
@@ -285,6 +291,9 @@ public:
         writerIndex = 2;
         readerIndex = -1;
 
+        numPushed = 0;
+        numDropped = 0;
+
         return true;
     }
 
@@ -293,6 +302,18 @@ public:
         return readyToReadIndex != -1;
     }
 
+    // Updates pushed since the last reset (any thread)
+    uint64_t getNumPushed() const
+    {
+        return numPushed.load(std::memory_order_relaxed);
+    }
+
+    // Updates that were overwritten by a newer push before being read (any thread)
+    uint64_t getNumDropped() const
+    {
+        return numDropped.load(std::memory_order_relaxed);
+    }
+
 private:
 
     // Registers a writer and updates the writer index. If a writer already exists,
@@ -341,8 +362,14 @@ private:
         assert(writerIndex != -1);
 
         writerIndex = readyToReadIndex.exchange(writerIndex, std::memory_order_relaxed);
+        numPushed.fetch_add(1, std::memory_order_relaxed);
 
-        if (writerIndex == -1)
+        if (writerIndex != -1)
+        {
+            // the reader never pulled the previous update, and now never will
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
         {
             // attempt to pull an index from readyToWriteIndex
             writerIndex = readyToWriteIndex.exchange(-1, std::memory_order_relaxed);
@@ -398,6 +425,10 @@ private:
 
     std::atomic<int> nWriters;
     std::atomic<int> nReaders;
+
+    // incremented by the writer only
+    std::atomic<uint64_t> numPushed;
+    std::atomic<uint64_t> numDropped;
 };
 
 
@@ -447,6 +478,16 @@ public:
         return sync.hasUpdate();
     }
 
+    uint64_t getNumPushed() const
+    {
+        return sync.getNumPushed();
+    }
+
+    uint64_t getNumDropped() const
+    {
+        return sync.getNumDropped();
+    }
+
 
     class ScopedWritePtr
     {
@@ -25,11 +25,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define CIRCULAR_ARRAY_H_INCLUDED
 
 /*
-Extends (by ownership) the JUCE array type to use circular (modular) indices.
-@see Array
+Extends (by ownership) std::vector to use circular (modular) indices.
 */
 
-#include <BasicJuceHeader.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
 
 template <typename ElementType>
 class CircularArray
@@ -43,7 +44,7 @@ public:
     */
     CircularArray(int length) : start(0), isReset(true)
     {
-        array.resize(jmax(0, length));
+        array.resize(std::max(0, length));
     }
 
     ~CircularArray() {}
@@ -52,8 +53,7 @@ public:
     void reset()
     {
         int length = size();
-        array.clearQuick();
-        array.insertMultiple(0, ElementType(), length);
+        array.assign(length, ElementType());
         start = 0;
         isReset = true;
     }
@@ -69,7 +69,7 @@ public:
     /** Returns number of elements in the array. */
     int size() const
     {
-        return array.size();
+        return int(array.size());
     }
 
     /** Changes the size of the array by adding empty elements to or removing from the end
@@ -77,7 +77,7 @@ public:
     */
     void resize(const int targetNumItems)
     {
-        jassert(targetNumItems >= 0);
+        assert(targetNumItems >= 0);
         int length = size();
         if (targetNumItems == 0)
         {
@@ -112,7 +112,7 @@ public:
     {
         if (size() > 0)
         {
-            array.set(circToLinInd(indexToChange), newValue);
+            array[circToLinInd(indexToChange)] = newValue;
             if (newValue != ElementType())
             {
                 isReset = false;
@@ -139,20 +139,14 @@ public:
     void enqueueArray(const ElementType* newValues, int numberOfElements)
     {
         int length = size();
-        int n = jmin(numberOfElements, length);
+        int n = std::min(numberOfElements, length);
         int nToSkip = numberOfElements - n;
-        int nFirstSegment = jmin(n, length - start);
-        int nSecondSegment = n - nFirstSegment;
+        int nFirstSegment = std::min(n, length - start);
 
-        for (int i = 0; i < nFirstSegment; ++i)
-        {
-            array.set(start + i, newValues[nToSkip + i]);
-        }
-
-        for (int i = 0; i < nSecondSegment; ++i)
-        {
-            array.set(i, newValues[nToSkip + nFirstSegment + i]);
-        }
+        // both segments as block copies
+        const ElementType* src = newValues + nToSkip;
+        std::copy(src, src + nFirstSegment, array.begin() + start);
+        std::copy(src + nFirstSegment, src + n, array.begin());
 
         start = mod(start + n, length);
         isReset = false;
@@ -193,7 +187,7 @@ public:
                 linIndexToInsertAt = 0;
             }
 
-            array.insertMultiple(linIndexToInsertAt, newElement, numberOfTimesToInsertIt);
+            array.insert(array.begin() + linIndexToInsertAt, numberOfTimesToInsertIt, newElement);
 
             // move start to follow first element if it was moved and we're not inserting at 0
             if (linIndexToInsertAt <= start && indexToInsertAt > 0)
@@ -233,17 +227,17 @@ public:
             if (isReset)
             {
                 start = 0;
-                array.removeLast(howManyToRemove);
+                array.resize(length - howManyToRemove);
                 return;
             }
 
             // howManyToRemove < length and we can't move start.
 
-            int numRemoveFromStart = jmin(start, howManyToRemove);
+            int numRemoveFromStart = std::min(start, howManyToRemove);
             int numRemoveFromEnd = howManyToRemove - numRemoveFromStart;
 
-            array.removeLast(numRemoveFromEnd);
-            array.removeRange(start - numRemoveFromStart, numRemoveFromStart);
+            array.resize(length - numRemoveFromEnd);
+            array.erase(array.begin() + (start - numRemoveFromStart), array.begin() + start);
             start -= numRemoveFromStart;
         }
     }
@@ -257,11 +251,11 @@ private:
 
     static int mod(int x, int m)
     {
-        jassert(m > 0);
+        assert(m > 0);
         return (x % m + m) % m;
     }
 
-    Array<ElementType> array;
+    std::vector<ElementType> array;
     int start; // index of the start of the array
     bool isReset; // whether all elements are default
 };
@@ -0,0 +1,192 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CoherenceBands.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+static std::string trim(const std::string& s)
+{
+    size_t start = s.find_first_not_of(" \t");
+    if (start == std::string::npos)
+    {
+        return std::string();
+    }
+    return s.substr(start, s.find_last_not_of(" \t") - start + 1);
+}
+
+static std::string formatRange(double low, double high)
+{
+    std::ostringstream out;
+    out << low << "-" << high;
+    return out.str();
+}
+
+bool CoherenceBands::parse(const std::string& text, std::vector<CoherenceBand>& dest, std::string& error)
+{
+    std::vector<CoherenceBand> parsed;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        item = trim(item);
+        if (item.empty())
+        {
+            continue;
+        }
+
+        // the range is the last word; anything before it is the name
+        size_t space = item.find_last_of(" \t");
+        std::string range = space == std::string::npos ? item : item.substr(space + 1);
+
+        CoherenceBand band;
+        const char* start = range.c_str();
+        char* end;
+        band.low = std::strtod(start, &end);
+        bool valid = end != start && *end == '-';
+        if (valid)
+        {
+            start = end + 1;
+            band.high = std::strtod(start, &end);
+            valid = end != start && *end == '\0';
+        }
+        if (!valid || !(band.low >= 0) || !(band.high > band.low))
+        {
+            error = "\"" + item + "\" is not a band; expected [name] low-high, e.g. theta 4-8";
+            return false;
+        }
+
+        band.name = space == std::string::npos ? formatRange(band.low, band.high) : trim(item.substr(0, space));
+        if (band.name.size() > CoherenceBand::MAX_NAME_LENGTH || band.name.find('\0') != std::string::npos)
+        {
+            error = "Band name \"" + band.name + "\" is longer than "
+                + std::to_string(CoherenceBand::MAX_NAME_LENGTH) + " characters";
+            return false;
+        }
+        parsed.push_back(band);
+    }
+
+    dest.swap(parsed);
+    error.clear();
+    return true;
+}
+
+std::string CoherenceBands::toString(const std::vector<CoherenceBand>& bands)
+{
+    std::string text;
+    for (const CoherenceBand& band : bands)
+    {
+        std::string range = formatRange(band.low, band.high);
+        text += (text.empty() ? "" : ", ") + (band.name == range ? range : band.name + " " + range);
+    }
+    return text;
+}
+
+void CoherenceBands::setBands(const std::vector<CoherenceBand>& newBands)
+{
+    bands = newBands;
+    weights.clear();
+}
+
+void CoherenceBands::setFreqs(const std::vector<double>& freqs)
+{
+    int nFreqs = int(freqs.size());
+    weights.assign(bands.size(), Weights());
+    if (nFreqs == 0)
+    {
+        return;
+    }
+
+    // range each frequency stands for
+    std::vector<double> edges(nFreqs + 1);
+    for (int f = 1; f < nFreqs; ++f)
+    {
+        edges[f] = (freqs[f - 1] + freqs[f]) / 2;
+    }
+    // (a lone frequency stands for 1 Hz)
+    edges[0] = freqs[0] - (nFreqs > 1 ? edges[1] - freqs[0] : 0.5);
+    edges[nFreqs] = freqs[nFreqs - 1] + (nFreqs > 1 ? freqs[nFreqs - 1] - edges[nFreqs - 1] : 0.5);
+
+    for (size_t b = 0; b < bands.size(); ++b)
+    {
+        const CoherenceBand& band = bands[b];
+        Weights& w = weights[b];
+
+        std::vector<double> overlaps(nFreqs);
+        double total = 0;
+        for (int f = 0; f < nFreqs; ++f)
+        {
+            overlaps[f] = std::max(0.0, std::min(edges[f + 1], band.high) - std::max(edges[f], band.low));
+            total += overlaps[f];
+        }
+
+        if (total == 0)
+        {
+            // outside the frequencies: the closest one
+            double centre = (band.low + band.high) / 2;
+            int closest = int(std::min_element(freqs.begin(), freqs.end(), [=](double a, double b)
+            {
+                return std::abs(a - centre) < std::abs(b - centre);
+            }) - freqs.begin());
+            w.first = closest;
+            w.weights.assign(1, 1.0);
+            continue;
+        }
+
+        int first = 0;
+        while (overlaps[first] == 0)
+        {
+            ++first;
+        }
+        int last = nFreqs - 1;
+        while (overlaps[last] == 0)
+        {
+            --last;
+        }
+
+        w.first = first;
+        w.weights.resize(last - first + 1);
+        for (int f = first; f <= last; ++f)
+        {
+            w.weights[f - first] = overlaps[f] / total;
+        }
+    }
+}
+
+void CoherenceBands::reduce(const double* values, double* dest) const
+{
+    for (size_t b = 0; b < weights.size(); ++b)
+    {
+        const Weights& w = weights[b];
+        const double* bandValues = values + w.first;
+        double sum = 0;
+        for (size_t i = 0; i < w.weights.size(); ++i)
+        {
+            sum += w.weights[i] * bandValues[i];
+        }
+        dest[b] = sum;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COHERENCE_BANDS_H_INCLUDED
+#define COHERENCE_BANDS_H_INCLUDED
+
+/*
+
+Coherence Bands - named frequency bands (e.g. theta 4-8 Hz) and the weighted means that reduce
+coherence at each frequency of interest to one value per band. No JUCE dependency.
+
+Each frequency stands for the range halfway to its neighbours (the first and last extend as far
+on their outer side), and its weight in a band is how much of that range the band covers, so a
+band edge that falls on a frequency takes half of it and adjacent bands share it. A band that
+doesn't overlap the frequencies at all takes the closest one. Weights sum to 1.
+
+Bands are written as a comma-separated list of "[name] low-high", e.g.
+"theta 4-8, beta 13-30, gamma 30-40"; a band without a name is named after its range.
+
+*/
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct CoherenceBand
+{
+    static const size_t MAX_NAME_LENGTH = 15; // (stored in 16 bytes in recordings)
+
+    std::string name;
+    double low = 0;  // Hz
+    double high = 0;
+
+    bool operator==(const CoherenceBand& other) const
+    {
+        return name == other.name && low == other.low && high == other.high;
+    }
+};
+
+class CoherenceBands
+{
+public:
+    // Returns false (with a reason in error) if the text isn't a valid list of bands
+    static bool parse(const std::string& text, std::vector<CoherenceBand>& dest, std::string& error);
+    static std::string toString(const std::vector<CoherenceBand>& bands);
+
+    // Clears the weights until setFreqs is called
+    void setBands(const std::vector<CoherenceBand>& newBands);
+    const std::vector<CoherenceBand>& getBands() const { return bands; }
+    int getNumBands() const { return int(bands.size()); }
+
+    // Recalculates the weights for these frequencies (increasing)
+    void setFreqs(const std::vector<double>& freqs);
+
+    // Weighted mean of values (one per frequency) in each band, into dest (one per band)
+    void reduce(const double* values, double* dest) const;
+
+private:
+    std::vector<CoherenceBand> bands;
+
+    // each band's weights, from its first frequency on
+    struct Weights
+    {
+        int first;
+        std::vector<double> weights;
+    };
+
+    std::vector<Weights> weights;
+};
+
+#endif // COHERENCE_BANDS_H_INCLUDED
@@ -0,0 +1,279 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CoherenceBaseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+const char CoherenceBaseline::MAGIC[8] = { 'O', 'E', 'C', 'O', 'H', 'B', 'S', 'L' };
+
+// magic, version, 5 doubles, averageWindow, nFreqs, nPairs
+static const size_t FIXED_SIZE = 8 + 4 + 5 * 8 + 4 + 4 + 4;
+
+namespace
+{
+    template<typename T>
+    void writeValue(std::ostream& out, T value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(std::ostream& out, const std::vector<T>& values)
+    {
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    // Reads values from a buffer in order, failing (once and for all) if it runs out
+    class BlobReader
+    {
+    public:
+        BlobReader(const std::vector<char>& data)
+            : data  (data)
+            , pos   (0)
+            , failed(false)
+        {}
+
+        template<typename T>
+        T read()
+        {
+            T value = T();
+            readInto(&value, 1);
+            return value;
+        }
+
+        template<typename T>
+        void readInto(T* dest, size_t n)
+        {
+            size_t bytes = n * sizeof(T);
+            if (failed || bytes > data.size() - pos)
+            {
+                failed = true;
+                return;
+            }
+            std::memcpy(dest, data.data() + pos, bytes);
+            pos += bytes;
+        }
+
+        bool hasFailed() const { return failed; }
+        size_t getRemaining() const { return data.size() - pos; }
+
+    private:
+        const std::vector<char>& data;
+        size_t pos;
+        bool failed;
+    };
+}
+
+CoherenceBaseline::CoherenceBaseline() {}
+
+void CoherenceBaseline::swap(CoherenceBaseline& other)
+{
+    std::swap(layout, other.layout);
+    counts.swap(other.counts);
+    mean.swap(other.mean);
+    m2.swap(other.m2);
+    error.swap(other.error);
+}
+
+void CoherenceBaseline::reset(const CoherenceFileHeader& newLayout)
+{
+    layout = newLayout;
+    size_t nCells = layout.getValuesPerPlane();
+    counts.assign(layout.getNumPairs(), 0);
+    mean.assign(nCells, 0.0);
+    m2.assign(nCells, 0.0);
+}
+
+bool CoherenceBaseline::isCompatible(const CoherenceFileHeader& other) const
+{
+    return layout.sampleRate == other.sampleRate
+        && layout.segLen == other.segLen
+        && layout.winLen == other.winLen
+        && layout.stepLen == other.stepLen
+        && layout.alpha == other.alpha
+        && layout.averageWindow == other.averageWindow
+        && layout.freqs == other.freqs
+        && layout.pairs == other.pairs;
+}
+
+void CoherenceBaseline::addSegment(int pair, const double* coherence)
+{
+    int nFreqs = layout.getNumFreqs();
+    double n = double(++counts[pair]);
+    double* pairMean = &mean[getCell(pair, 0)];
+    double* pairM2 = &m2[getCell(pair, 0)];
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        double delta = coherence[f] - pairMean[f];
+        pairMean[f] += delta / n;
+        pairM2[f] += delta * (coherence[f] - pairMean[f]);
+    }
+}
+
+void CoherenceBaseline::getZScores(int pair, const double* coherence, double* dest) const
+{
+    int nFreqs = layout.getNumFreqs();
+    uint64_t n = counts[pair];
+    if (n < 2)
+    {
+        std::fill(dest, dest + nFreqs, 0.0);
+        return;
+    }
+
+    const double* pairMean = &mean[getCell(pair, 0)];
+    const double* pairM2 = &m2[getCell(pair, 0)];
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        double variance = pairM2[f] / double(n - 1);
+        dest[f] = variance > 0 ? (coherence[f] - pairMean[f]) / std::sqrt(variance) : 0.0;
+    }
+}
+
+uint64_t CoherenceBaseline::getMinSegments() const
+{
+    return counts.empty() ? 0 : *std::min_element(counts.begin(), counts.end());
+}
+
+double CoherenceBaseline::getStdDev(int pair, int freq) const
+{
+    uint64_t n = counts[pair];
+    return n < 2 ? 0.0 : std::sqrt(m2[getCell(pair, freq)] / double(n - 1));
+}
+
+bool CoherenceBaseline::save(const std::string& path)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        error = "Could not create " + path;
+        return false;
+    }
+
+    out.write(MAGIC, sizeof(MAGIC));
+    writeValue<uint32_t>(out, VERSION);
+    writeValue<double>(out, layout.sampleRate);
+    writeValue<double>(out, layout.segLen);
+    writeValue<double>(out, layout.winLen);
+    writeValue<double>(out, layout.stepLen);
+    writeValue<double>(out, layout.alpha);
+    writeValue<uint32_t>(out, layout.averageWindow);
+    writeValue<int32_t>(out, layout.getNumFreqs());
+    writeValue<int32_t>(out, layout.getNumPairs());
+    writeArray(out, layout.freqs);
+    for (const std::pair<int, int>& pair : layout.pairs)
+    {
+        writeValue<int32_t>(out, pair.first);
+        writeValue<int32_t>(out, pair.second);
+    }
+    writeArray(out, counts);
+    writeArray(out, mean);
+    writeArray(out, m2);
+
+    out.flush();
+    if (!out)
+    {
+        error = "Could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool CoherenceBaseline::load(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        error = "Could not open " + path;
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.size() < FIXED_SIZE || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+    {
+        error = path + " is not a coherence baseline";
+        return false;
+    }
+
+    BlobReader reader(data);
+    char magic[sizeof(MAGIC)];
+    reader.readInto(magic, sizeof(magic));
+    uint32_t version = reader.read<uint32_t>();
+    if (version != VERSION)
+    {
+        error = path + " has unsupported baseline version " + std::to_string(version);
+        return false;
+    }
+
+    CoherenceFileHeader newLayout;
+    newLayout.sampleRate = reader.read<double>();
+    newLayout.segLen = reader.read<double>();
+    newLayout.winLen = reader.read<double>();
+    newLayout.stepLen = reader.read<double>();
+    newLayout.alpha = reader.read<double>();
+    newLayout.averageWindow = reader.read<uint32_t>();
+    int32_t nFreqs = reader.read<int32_t>();
+    int32_t nPairs = reader.read<int32_t>();
+
+    // everything after the fixed part is sized by nFreqs and nPairs
+    uint64_t expected = uint64_t(std::max(nFreqs, 0)) * 8 + uint64_t(std::max(nPairs, 0)) * (2 * 4 + 8)
+        + uint64_t(std::max(nFreqs, 0)) * std::max(nPairs, 0) * 2 * 8;
+    if (nFreqs < 0 || nPairs < 0 || reader.getRemaining() != expected)
+    {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+
+    newLayout.freqs.resize(nFreqs);
+    reader.readInto(newLayout.freqs.data(), newLayout.freqs.size());
+    for (int pair = 0; pair < nPairs; ++pair)
+    {
+        int32_t chanX = reader.read<int32_t>();
+        int32_t chanY = reader.read<int32_t>();
+        newLayout.pairs.emplace_back(chanX, chanY);
+    }
+
+    size_t nCells = newLayout.getValuesPerPlane();
+    std::vector<uint64_t> newCounts(nPairs);
+    std::vector<double> newMean(nCells);
+    std::vector<double> newM2(nCells);
+    reader.readInto(newCounts.data(), newCounts.size());
+    reader.readInto(newMean.data(), newMean.size());
+    reader.readInto(newM2.data(), newM2.size());
+    if (reader.hasFailed())
+    {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+
+    layout = newLayout;
+    counts.swap(newCounts);
+    mean.swap(newMean);
+    m2.swap(newM2);
+    return true;
+}
@@ -0,0 +1,122 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COHERENCE_BASELINE_H_INCLUDED
+#define COHERENCE_BASELINE_H_INCLUDED
+
+/*
+
+Coherence Baseline - mean and variance of the coherence after each segment, for every channel
+pair and frequency, gathered during a baseline period so that later coherence can be shown as
+a z-score: (coherence - mean) / standard deviation. No JUCE dependency.
+
+Statistics are updated with Welford's algorithm (a running mean and sum of squared deviations),
+which is stable over any number of segments and needs no second pass. The layout (frequencies,
+channel pairs and the settings the coherence was calculated with) is kept in a
+CoherenceFileHeader, and a baseline only applies to coherence with the same layout.
+
+Baselines are saved as a small binary file, so they can be reused in later sessions. Since the
+full Welford state is saved, collection can also carry on after loading one. All values are
+little-endian:
+
+    char[8]     magic "OECOHBSL"
+    uint32      version
+    float64     sample rate (Hz)
+    float64     segment length (s)
+    float64     window length (s)
+    float64     step length (s)
+    float64     alpha
+    uint32      average window (segments)
+    int32       number of frequencies (nFreqs)
+    int32       number of channel pairs (nPairs)
+    float64     frequencies (Hz) [nFreqs]
+    int32       channel pairs (group 1 chan, group 2 chan; 0-based) [nPairs][2]
+    uint64      segments added [nPairs]
+    float64     mean [nPairs][nFreqs]
+    float64     sum of squared deviations from the mean [nPairs][nFreqs]
+
+*/
+
+#include "CoherenceFileFormat.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CoherenceBaseline
+{
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    CoherenceBaseline();
+
+    // Clears the statistics and sets the layout of the coherence that will be added
+    void reset(const CoherenceFileHeader& layout);
+
+    const CoherenceFileHeader& getLayout() const { return layout; }
+
+    // Exchanges contents without allocating, e.g. to replace a baseline under a lock
+    void swap(CoherenceBaseline& other);
+
+    // Whether coherence with the given layout can be added to or compared with this baseline
+    bool isCompatible(const CoherenceFileHeader& other) const;
+
+    int getNumFreqs() const { return layout.getNumFreqs(); }
+    int getNumPairs() const { return layout.getNumPairs(); }
+
+    // Adds one segment's coherence (nFreqs values) for a pair
+    void addSegment(int pair, const double* coherence);
+
+    // z-score of each of a pair's nFreqs coherence values; 0 where the baseline has fewer than
+    // 2 segments or no variance
+    void getZScores(int pair, const double* coherence, double* dest) const;
+
+    uint64_t getNumSegments(int pair) const { return counts[pair]; }
+    // Fewest segments added to any pair (0 if there are no pairs)
+    uint64_t getMinSegments() const;
+
+    double getMean(int pair, int freq) const { return mean[getCell(pair, freq)]; }
+    // Sample standard deviation
+    double getStdDev(int pair, int freq) const;
+
+    // Returns false (see getError) on failure
+    bool save(const std::string& path);
+    // Replaces the layout and statistics with those in the file. Returns false (see getError)
+    // and leaves the baseline as it was on failure.
+    bool load(const std::string& path);
+
+    const std::string& getError() const { return error; }
+
+private:
+    size_t getCell(int pair, int freq) const { return size_t(pair) * layout.getNumFreqs() + freq; }
+
+    CoherenceFileHeader layout;
+    std::vector<uint64_t> counts; // # pairs
+    std::vector<double> mean;     // # pairs x # freqs
+    std::vector<double> m2;       // # pairs x # freqs
+
+    std::string error;
+};
+
+#endif // COHERENCE_BASELINE_H_INCLUDED
@@ -0,0 +1,854 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CoherenceFileFormat.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+const char CoherenceFileHeader::MAGIC[8] = { 'O', 'E', 'C', 'O', 'H', 'B', 'I', 'N' };
+
+static const char CHUNK_MAGIC[4] = { 'C', 'H', 'N', 'K' };
+static const char INDEX_MAGIC[4] = { 'C', 'I', 'D', 'X' };
+static const char END_MAGIC[8] = { 'O', 'E', 'C', 'O', 'H', 'E', 'N', 'D' };
+
+// fixed part: magic, version, header size, 5 doubles, nFreqs, nPairs, recordsPerChunk, codec,
+// averageWindow (not in version 2), hasStdDev (not in versions 2 and 3), hasFreqValues and
+// nBands (only from version 5)
+static const uint32_t FIXED_HEADER_SIZE = 8 + 4 + 4 + 5 * 8 + 4 + 4 + 4 + 4 + 4 + 4 + 4 + 4;
+static const uint32_t FIXED_HEADER_SIZE_V4 = FIXED_HEADER_SIZE - 8;
+static const uint32_t FIXED_HEADER_SIZE_V3 = FIXED_HEADER_SIZE_V4 - 4;
+static const uint32_t FIXED_HEADER_SIZE_V2 = FIXED_HEADER_SIZE_V3 - 4;
+// low, high, name
+static const uint32_t BAND_NAME_SIZE = CoherenceBand::MAX_NAME_LENGTH + 1;
+static const uint32_t BAND_SIZE = 8 + 8 + BAND_NAME_SIZE;
+// magic, codec, nRecords, payload size, first and last timestamp
+static const uint64_t CHUNK_HEADER_SIZE = 4 + 4 + 4 + 4 + 8 + 8;
+// timestamp, segment index, flags
+static const uint64_t RECORD_PREFIX_SIZE = 8 + 4 + 4;
+static const uint64_t INDEX_ENTRY_SIZE = 8 + 8 + 8 + 8 + 4 + 4;
+static const uint64_t TRAILER_SIZE = 8 + 8;
+
+uint32_t CoherenceFileHeader::getHeaderSize() const
+{
+    return FIXED_HEADER_SIZE + uint32_t(freqs.size() * 8 + pairs.size() * 2 * 4 + bands.size() * BAND_SIZE);
+}
+
+template<typename T>
+static void writeValue(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeArray(std::ostream& out, const std::vector<T>& values)
+{
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+// reads a value from a possibly unaligned position in the mapped file
+template<typename T>
+static T readValue(const uint8_t* src)
+{
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+
+/********** XOR_RLE codec ************/
+
+// Encodes nRecords x nValues floats. dest is cleared first.
+static void encodeXorRle(const float* values, size_t nRecords, size_t nValues, std::vector<uint8_t>& dest)
+{
+    dest.clear();
+
+    size_t nWords = nRecords * nValues;
+    for (int plane = 0; plane < 4; ++plane)
+    {
+        int shift = plane * 8;
+        uint8_t zeroRun = 0;
+
+        for (size_t i = 0; i < nWords; ++i)
+        {
+            uint32_t word = readValue<uint32_t>(reinterpret_cast<const uint8_t*>(values + i));
+            if (i >= nValues)
+            {
+                word ^= readValue<uint32_t>(reinterpret_cast<const uint8_t*>(values + i - nValues));
+            }
+
+            uint8_t byte = uint8_t(word >> shift);
+            if (byte == 0)
+            {
+                if (++zeroRun == 255)
+                {
+                    dest.push_back(0);
+                    dest.push_back(zeroRun);
+                    zeroRun = 0;
+                }
+                continue;
+            }
+
+            if (zeroRun > 0)
+            {
+                dest.push_back(0);
+                dest.push_back(zeroRun);
+                zeroRun = 0;
+            }
+            dest.push_back(byte);
+        }
+
+        if (zeroRun > 0)
+        {
+            dest.push_back(0);
+            dest.push_back(zeroRun);
+        }
+    }
+}
+
+// Decodes into nRecords x nValues floats. Returns false if the input is malformed.
+static bool decodeXorRle(const uint8_t* src, size_t srcSize, size_t nRecords, size_t nValues, float* dest)
+{
+    size_t nWords = nRecords * nValues;
+    std::vector<uint32_t> words(nWords, 0);
+
+    size_t pos = 0;
+    for (int plane = 0; plane < 4; ++plane)
+    {
+        int shift = plane * 8;
+        size_t i = 0;
+        while (i < nWords)
+        {
+            if (pos >= srcSize)
+            {
+                return false;
+            }
+
+            uint8_t byte = src[pos++];
+            if (byte == 0)
+            {
+                if (pos >= srcSize)
+                {
+                    return false;
+                }
+                size_t run = src[pos++];
+                if (run == 0 || i + run > nWords)
+                {
+                    return false;
+                }
+                i += run; // zero bytes, nothing to set
+            }
+            else
+            {
+                words[i++] |= uint32_t(byte) << shift;
+            }
+        }
+    }
+
+    if (pos != srcSize)
+    {
+        return false;
+    }
+
+    // undo the XOR with the previous record
+    for (size_t i = nValues; i < nWords; ++i)
+    {
+        words[i] ^= words[i - nValues];
+    }
+
+    std::memcpy(dest, words.data(), nWords * sizeof(float));
+    return true;
+}
+
+
+/********** writer ************/
+
+CoherenceFileWriter::CoherenceFileWriter()
+    : valuesPerRecord   (0)
+    , numRecordsWritten (0)
+{}
+
+CoherenceFileWriter::~CoherenceFileWriter()
+{
+    close();
+}
+
+bool CoherenceFileWriter::open(const std::string& path, const CoherenceFileHeader& newHeader)
+{
+    close();
+
+    stream.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+    {
+        return false;
+    }
+
+    header = newHeader;
+    header.recordsPerChunk = std::max<uint32_t>(header.recordsPerChunk, 1);
+    valuesPerRecord = header.getValuesPerRecord();
+    numRecordsWritten = 0;
+    index.clear();
+
+    // allocate the chunk buffers up front
+    timestamps.clear();
+    timestamps.reserve(header.recordsPerChunk);
+    segmentIndices.clear();
+    segmentIndices.reserve(header.recordsPerChunk);
+    flags.clear();
+    flags.reserve(header.recordsPerChunk);
+    values.clear();
+    values.reserve(header.recordsPerChunk * valuesPerRecord);
+    encoded.reserve(header.recordsPerChunk * valuesPerRecord * sizeof(float));
+
+    stream.write(CoherenceFileHeader::MAGIC, sizeof(CoherenceFileHeader::MAGIC));
+    writeValue<uint32_t>(stream, CoherenceFileHeader::VERSION);
+    writeValue<uint32_t>(stream, header.getHeaderSize());
+    writeValue<double>(stream, header.sampleRate);
+    writeValue<double>(stream, header.segLen);
+    writeValue<double>(stream, header.winLen);
+    writeValue<double>(stream, header.stepLen);
+    writeValue<double>(stream, header.alpha);
+    writeValue<int32_t>(stream, header.getNumFreqs());
+    writeValue<int32_t>(stream, header.getNumPairs());
+    writeValue<uint32_t>(stream, header.recordsPerChunk);
+    writeValue<uint32_t>(stream, header.codec);
+    writeValue<uint32_t>(stream, header.averageWindow);
+    writeValue<uint32_t>(stream, header.hasStdDev ? 1 : 0);
+    writeValue<uint32_t>(stream, header.hasFreqValues ? 1 : 0);
+    writeValue<int32_t>(stream, header.getNumBands());
+
+    for (double freq : header.freqs)
+    {
+        writeValue<double>(stream, freq);
+    }
+
+    for (const auto& pair : header.pairs)
+    {
+        writeValue<int32_t>(stream, pair.first);
+        writeValue<int32_t>(stream, pair.second);
+    }
+
+    for (const CoherenceBand& band : header.bands)
+    {
+        writeValue<double>(stream, band.low);
+        writeValue<double>(stream, band.high);
+        char name[BAND_NAME_SIZE] = {};
+        band.name.copy(name, std::min(band.name.size(), sizeof(name) - 1));
+        stream.write(name, sizeof(name));
+    }
+
+    return bool(stream);
+}
+
+bool CoherenceFileWriter::writeRecord(int64_t timestamp, uint32_t segmentIndex, uint32_t recordFlags,
+    const float* recordValues)
+{
+    if (!stream.is_open())
+    {
+        return false;
+    }
+
+    timestamps.push_back(timestamp);
+    segmentIndices.push_back(segmentIndex);
+    flags.push_back(recordFlags);
+    values.insert(values.end(), recordValues, recordValues + valuesPerRecord);
+
+    if (timestamps.size() >= header.recordsPerChunk)
+    {
+        return writeChunk();
+    }
+
+    return bool(stream);
+}
+
+bool CoherenceFileWriter::writeChunk()
+{
+    uint32_t nRecords = uint32_t(timestamps.size());
+    if (nRecords == 0)
+    {
+        return bool(stream);
+    }
+
+    uint64_t rawValuesSize = values.size() * sizeof(float);
+    uint32_t codec = CoherenceFileHeader::NONE;
+
+    if (header.codec == CoherenceFileHeader::XOR_RLE)
+    {
+        encodeXorRle(values.data(), nRecords, valuesPerRecord, encoded);
+        if (encoded.size() < rawValuesSize)
+        {
+            codec = CoherenceFileHeader::XOR_RLE;
+        }
+    }
+
+    uint64_t valuesSize = codec == CoherenceFileHeader::NONE ? rawValuesSize : encoded.size();
+    uint64_t payloadSize = nRecords * RECORD_PREFIX_SIZE + valuesSize;
+
+    CoherenceChunkInfo info;
+    info.firstTimestamp = timestamps.front();
+    info.lastTimestamp = timestamps.back();
+    info.offset = uint64_t(stream.tellp());
+    info.firstRecord = numRecordsWritten;
+    info.numRecords = nRecords;
+    info.codec = codec;
+
+    stream.write(CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    writeValue<uint32_t>(stream, codec);
+    writeValue<uint32_t>(stream, nRecords);
+    writeValue<uint32_t>(stream, uint32_t(payloadSize));
+    writeValue<int64_t>(stream, info.firstTimestamp);
+    writeValue<int64_t>(stream, info.lastTimestamp);
+    writeArray(stream, timestamps);
+    writeArray(stream, segmentIndices);
+    writeArray(stream, flags);
+
+    if (codec == CoherenceFileHeader::NONE)
+    {
+        writeArray(stream, values);
+    }
+    else
+    {
+        writeArray(stream, encoded);
+    }
+
+    index.push_back(info);
+    numRecordsWritten += nRecords;
+
+    timestamps.clear();
+    segmentIndices.clear();
+    flags.clear();
+    values.clear();
+
+    return bool(stream);
+}
+
+void CoherenceFileWriter::flush()
+{
+    if (stream.is_open())
+    {
+        writeChunk();
+        stream.flush();
+    }
+}
+
+void CoherenceFileWriter::close()
+{
+    if (!stream.is_open())
+    {
+        return;
+    }
+
+    writeChunk();
+
+    uint64_t indexOffset = uint64_t(stream.tellp());
+    stream.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    writeValue<uint32_t>(stream, uint32_t(index.size()));
+    for (const CoherenceChunkInfo& info : index)
+    {
+        writeValue<int64_t>(stream, info.firstTimestamp);
+        writeValue<int64_t>(stream, info.lastTimestamp);
+        writeValue<uint64_t>(stream, info.offset);
+        writeValue<uint64_t>(stream, info.firstRecord);
+        writeValue<uint32_t>(stream, info.numRecords);
+        writeValue<uint32_t>(stream, info.codec);
+    }
+    writeValue<uint64_t>(stream, indexOffset);
+    stream.write(END_MAGIC, sizeof(END_MAGIC));
+
+    stream.close();
+    index.clear();
+}
+
+bool CoherenceFileWriter::isOpen() const
+{
+    return stream.is_open();
+}
+
+
+/********** reader ************/
+
+CoherenceFileReader::CoherenceFileReader()
+    : data          (nullptr)
+    , size          (0)
+    , numRecords    (0)
+    , indexRebuilt  (false)
+    , cachedChunk   (-1)
+{}
+
+CoherenceFileReader::~CoherenceFileReader()
+{
+    close();
+}
+
+bool CoherenceFileReader::open(const std::string& path)
+{
+    close();
+
+    mapping.reset(new MappedFile);
+    if (!mapping->open(path))
+    {
+        error = "Could not open " + path;
+        close();
+        return false;
+    }
+
+    data = mapping->getData();
+    size = mapping->getSize();
+
+    if (!parseHeader())
+    {
+        close();
+        return false;
+    }
+
+    if (!parseIndex())
+    {
+        // no (valid) index - the file wasn't closed properly
+        index.clear();
+        if (!rebuildIndex())
+        {
+            close();
+            return false;
+        }
+        indexRebuilt = true;
+    }
+
+    numRecords = 0;
+    for (const CoherenceChunkInfo& info : index)
+    {
+        numRecords += info.numRecords;
+    }
+
+    error.clear();
+    return true;
+}
+
+bool CoherenceFileReader::parseHeader()
+{
+    if (size < FIXED_HEADER_SIZE_V2 || std::memcmp(data, CoherenceFileHeader::MAGIC, 8) != 0)
+    {
+        error = "Not a coherence file";
+        return false;
+    }
+
+    const uint8_t* pos = data + 8;
+    uint32_t version = readValue<uint32_t>(pos);
+    if (version < CoherenceFileHeader::MIN_VERSION || version > CoherenceFileHeader::VERSION)
+    {
+        error = "Unsupported coherence file version " + std::to_string(version);
+        return false;
+    }
+
+    uint32_t headerSize = readValue<uint32_t>(pos + 4);
+    pos += 8;
+    header.sampleRate = readValue<double>(pos);
+    header.segLen = readValue<double>(pos + 8);
+    header.winLen = readValue<double>(pos + 16);
+    header.stepLen = readValue<double>(pos + 24);
+    header.alpha = readValue<double>(pos + 32);
+    pos += 40;
+    int32_t nFreqs = readValue<int32_t>(pos);
+    int32_t nPairs = readValue<int32_t>(pos + 4);
+    header.recordsPerChunk = readValue<uint32_t>(pos + 8);
+    header.codec = readValue<uint32_t>(pos + 12);
+    pos += 16;
+
+    uint32_t fixedSize = FIXED_HEADER_SIZE_V2;
+    header.averageWindow = 0;
+    header.hasStdDev = false;
+    header.hasFreqValues = true;
+    int32_t nBands = 0;
+    if (version >= 3 && size >= FIXED_HEADER_SIZE_V3)
+    {
+        header.averageWindow = readValue<uint32_t>(pos);
+        pos += 4;
+        fixedSize = FIXED_HEADER_SIZE_V3;
+    }
+    if (version >= 4 && size >= FIXED_HEADER_SIZE_V4)
+    {
+        header.hasStdDev = readValue<uint32_t>(pos) != 0;
+        pos += 4;
+        fixedSize = FIXED_HEADER_SIZE_V4;
+    }
+    if (version >= 5 && size >= FIXED_HEADER_SIZE)
+    {
+        header.hasFreqValues = readValue<uint32_t>(pos) != 0;
+        nBands = readValue<int32_t>(pos + 4);
+        pos += 8;
+        fixedSize = FIXED_HEADER_SIZE;
+    }
+
+    if (nFreqs < 0 || nPairs < 0 || nBands < 0 || headerSize > size
+        || headerSize != fixedSize + uint64_t(nFreqs) * 8 + uint64_t(nPairs) * 8 + uint64_t(nBands) * BAND_SIZE)
+    {
+        error = "Corrupt coherence file header";
+        return false;
+    }
+
+    header.freqs.resize(nFreqs);
+    for (int f = 0; f < nFreqs; ++f, pos += 8)
+    {
+        header.freqs[f] = readValue<double>(pos);
+    }
+
+    header.pairs.resize(nPairs);
+    for (int p = 0; p < nPairs; ++p, pos += 8)
+    {
+        header.pairs[p] = { readValue<int32_t>(pos), readValue<int32_t>(pos + 4) };
+    }
+
+    header.bands.resize(nBands);
+    for (int b = 0; b < nBands; ++b, pos += BAND_SIZE)
+    {
+        CoherenceBand& band = header.bands[b];
+        band.low = readValue<double>(pos);
+        band.high = readValue<double>(pos + 8);
+        const char* name = reinterpret_cast<const char*>(pos + 16);
+        band.name.assign(name, std::find(name, name + BAND_NAME_SIZE, '\0'));
+    }
+
+    return true;
+}
+
+bool CoherenceFileReader::parseIndex()
+{
+    // as stored, which depends on the version
+    uint64_t headerSize = readValue<uint32_t>(data + 12);
+    if (size < headerSize + TRAILER_SIZE || std::memcmp(data + size - 8, END_MAGIC, 8) != 0)
+    {
+        return false;
+    }
+
+    uint64_t indexOffset = readValue<uint64_t>(data + size - TRAILER_SIZE);
+    if (indexOffset < headerSize || indexOffset + 8 > size - TRAILER_SIZE
+        || std::memcmp(data + indexOffset, INDEX_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+
+    uint32_t nChunks = readValue<uint32_t>(data + indexOffset + 4);
+    if (indexOffset + 8 + nChunks * INDEX_ENTRY_SIZE != size - TRAILER_SIZE)
+    {
+        return false;
+    }
+
+    const uint8_t* pos = data + indexOffset + 8;
+    uint64_t expectedFirstRecord = 0;
+    index.resize(nChunks);
+    for (CoherenceChunkInfo& info : index)
+    {
+        info.firstTimestamp = readValue<int64_t>(pos);
+        info.lastTimestamp = readValue<int64_t>(pos + 8);
+        info.offset = readValue<uint64_t>(pos + 16);
+        info.firstRecord = readValue<uint64_t>(pos + 24);
+        info.numRecords = readValue<uint32_t>(pos + 32);
+        info.codec = readValue<uint32_t>(pos + 36);
+        pos += INDEX_ENTRY_SIZE;
+
+        // (a bad entry means the index can't be trusted; the chunks are scanned instead)
+        if (info.offset < headerSize || info.firstRecord != expectedFirstRecord
+            || !isValidChunk(info.offset, indexOffset, info.numRecords))
+        {
+            return false;
+        }
+        expectedFirstRecord += info.numRecords;
+    }
+
+    return true;
+}
+
+bool CoherenceFileReader::rebuildIndex()
+{
+    uint64_t offset = readValue<uint32_t>(data + 12); // header size, as stored
+    uint64_t firstRecord = 0;
+
+    while (offset + CHUNK_HEADER_SIZE <= size && std::memcmp(data + offset, CHUNK_MAGIC, 4) == 0)
+    {
+        const uint8_t* pos = data + offset;
+        CoherenceChunkInfo info;
+        info.codec = readValue<uint32_t>(pos + 4);
+        info.numRecords = readValue<uint32_t>(pos + 8);
+        uint64_t payloadSize = readValue<uint32_t>(pos + 12);
+        info.firstTimestamp = readValue<int64_t>(pos + 16);
+        info.lastTimestamp = readValue<int64_t>(pos + 24);
+        info.offset = offset;
+        info.firstRecord = firstRecord;
+
+        if (!isValidChunk(offset, size, info.numRecords))
+        {
+            break; // truncated (or corrupt) chunk: the file ends here
+        }
+
+        index.push_back(info);
+        firstRecord += info.numRecords;
+        offset += CHUNK_HEADER_SIZE + payloadSize;
+    }
+
+    return true;
+}
+
+bool CoherenceFileReader::isValidChunk(uint64_t offset, uint64_t end, uint32_t nRecords) const
+{
+    // (in this order, so no sum can overflow)
+    if (offset > end || end - offset < CHUNK_HEADER_SIZE || std::memcmp(data + offset, CHUNK_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+
+    const uint8_t* pos = data + offset;
+    uint64_t payloadSize = readValue<uint32_t>(pos + 12);
+    return readValue<uint32_t>(pos + 8) == nRecords
+        && payloadSize <= end - offset - CHUNK_HEADER_SIZE
+        && uint64_t(nRecords) * RECORD_PREFIX_SIZE <= payloadSize;
+}
+
+void CoherenceFileReader::close()
+{
+    mapping.reset();
+    data = nullptr;
+    size = 0;
+    header = CoherenceFileHeader();
+    index.clear();
+    numRecords = 0;
+    indexRebuilt = false;
+    cachedChunk = -1;
+    cachedValues.clear();
+}
+
+const CoherenceFileHeader& CoherenceFileReader::getHeader() const
+{
+    return header;
+}
+
+int64_t CoherenceFileReader::getNumRecords() const
+{
+    return numRecords;
+}
+
+int CoherenceFileReader::getNumChunks() const
+{
+    return int(index.size());
+}
+
+const CoherenceChunkInfo& CoherenceFileReader::getChunkInfo(int chunk) const
+{
+    return index[chunk];
+}
+
+bool CoherenceFileReader::wasIndexRebuilt() const
+{
+    return indexRebuilt;
+}
+
+int CoherenceFileReader::findChunk(int64_t record) const
+{
+    if (record < 0 || record >= numRecords)
+    {
+        return -1;
+    }
+
+    auto it = std::upper_bound(index.begin(), index.end(), uint64_t(record),
+        [](uint64_t rec, const CoherenceChunkInfo& info) { return rec < info.firstRecord; });
+    return int(it - index.begin()) - 1;
+}
+
+int64_t CoherenceFileReader::findRecord(int64_t timestamp) const
+{
+    // first chunk that ends at or after the timestamp
+    auto it = std::lower_bound(index.begin(), index.end(), timestamp,
+        [](const CoherenceChunkInfo& info, int64_t ts) { return info.lastTimestamp < ts; });
+
+    if (it == index.end())
+    {
+        return numRecords;
+    }
+
+    const uint8_t* pos = data + it->offset + CHUNK_HEADER_SIZE;
+    for (uint32_t i = 0; i < it->numRecords; ++i)
+    {
+        if (readValue<int64_t>(pos + i * 8) >= timestamp)
+        {
+            return int64_t(it->firstRecord + i);
+        }
+    }
+
+    return int64_t(it->firstRecord + it->numRecords);
+}
+
+const float* CoherenceFileReader::getChunkValues(int chunk)
+{
+    if (chunk == cachedChunk)
+    {
+        return cachedValues.data();
+    }
+
+    const CoherenceChunkInfo& info = index[chunk];
+    const uint8_t* chunkStart = data + info.offset;
+    if (std::memcmp(chunkStart, CHUNK_MAGIC, 4) != 0)
+    {
+        return nullptr;
+    }
+
+    uint64_t payloadSize = readValue<uint32_t>(chunkStart + 12);
+    uint64_t prefixSize = info.numRecords * RECORD_PREFIX_SIZE;
+    size_t nValues = header.getValuesPerRecord();
+    size_t totalValues = size_t(info.numRecords) * nValues;
+
+    if (info.offset + CHUNK_HEADER_SIZE + payloadSize > size || payloadSize < prefixSize)
+    {
+        return nullptr;
+    }
+
+    const uint8_t* src = chunkStart + CHUNK_HEADER_SIZE + prefixSize;
+    uint64_t srcSize = payloadSize - prefixSize;
+
+    cachedChunk = -1;
+    cachedValues.resize(totalValues);
+
+    if (info.codec == CoherenceFileHeader::NONE)
+    {
+        if (srcSize != totalValues * sizeof(float))
+        {
+            return nullptr;
+        }
+        std::memcpy(cachedValues.data(), src, size_t(srcSize));
+    }
+    else if (info.codec == CoherenceFileHeader::XOR_RLE)
+    {
+        if (!decodeXorRle(src, size_t(srcSize), info.numRecords, nValues, cachedValues.data()))
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    cachedChunk = chunk;
+    return cachedValues.data();
+}
+
+bool CoherenceFileReader::readRecord(int64_t record, CoherenceRecord& dest)
+{
+    int chunk = findChunk(record);
+    if (chunk < 0)
+    {
+        return false;
+    }
+
+    const float* chunkValues = getChunkValues(chunk);
+    if (chunkValues == nullptr)
+    {
+        error = "Corrupt chunk " + std::to_string(chunk);
+        return false;
+    }
+
+    const CoherenceChunkInfo& info = index[chunk];
+    size_t i = size_t(record - int64_t(info.firstRecord));
+    size_t nValues = header.getValuesPerRecord();
+
+    readRecordInfo(record, dest.timestamp, dest.segmentIndex, dest.flags);
+    dest.values.assign(chunkValues + i * nValues, chunkValues + (i + 1) * nValues);
+
+    return true;
+}
+
+bool CoherenceFileReader::readRecordInfo(int64_t record, int64_t& timestamp, uint32_t& segmentIndex,
+    uint32_t& flags) const
+{
+    int chunk = findChunk(record);
+    if (chunk < 0)
+    {
+        return false;
+    }
+
+    const CoherenceChunkInfo& info = index[chunk];
+    uint32_t i = uint32_t(record - int64_t(info.firstRecord));
+    const uint8_t* prefix = data + info.offset + CHUNK_HEADER_SIZE;
+
+    timestamp = readValue<int64_t>(prefix + i * 8);
+    segmentIndex = readValue<uint32_t>(prefix + info.numRecords * 8 + i * 4);
+    flags = readValue<uint32_t>(prefix + info.numRecords * 12 + i * 4);
+    return true;
+}
+
+bool CoherenceFileReader::readPair(int pair, int64_t firstRecord, int64_t endRecord,
+    std::vector<int64_t>& timestamps, std::vector<float>& dest, std::vector<float>* stdDest,
+    std::vector<float>* bandDest)
+{
+    if (pair < 0 || pair >= header.getNumPairs())
+    {
+        return false;
+    }
+
+    firstRecord = std::max<int64_t>(firstRecord, 0);
+    endRecord = std::min(endRecord, numRecords);
+
+    int nFreqs = header.hasFreqValues ? header.getNumFreqs() : 0;
+    int nBands = header.getNumBands();
+    size_t nValues = header.getValuesPerRecord();
+
+    for (int64_t record = firstRecord; record < endRecord;)
+    {
+        int chunk = findChunk(record);
+        const float* chunkValues = getChunkValues(chunk);
+        if (chunkValues == nullptr)
+        {
+            error = "Corrupt chunk " + std::to_string(chunk);
+            return false;
+        }
+
+        const CoherenceChunkInfo& info = index[chunk];
+        const uint8_t* chunkTimestamps = data + info.offset + CHUNK_HEADER_SIZE;
+        int64_t chunkEnd = std::min(endRecord, int64_t(info.firstRecord + info.numRecords));
+
+        for (; record < chunkEnd; ++record)
+        {
+            size_t i = size_t(record - int64_t(info.firstRecord));
+            timestamps.push_back(readValue<int64_t>(chunkTimestamps + i * 8));
+
+            const float* pairValues = chunkValues + i * nValues + size_t(pair) * nFreqs;
+            dest.insert(dest.end(), pairValues, pairValues + nFreqs);
+            if (stdDest != nullptr && header.hasStdDev)
+            {
+                const float* pairStdDevs = pairValues + size_t(nFreqs) * header.getNumPairs();
+                stdDest->insert(stdDest->end(), pairStdDevs, pairStdDevs + nFreqs);
+            }
+            if (bandDest != nullptr)
+            {
+                const float* pairBands = chunkValues + i * nValues + header.getBandOffset() + size_t(pair) * nBands;
+                bandDest->insert(bandDest->end(), pairBands, pairBands + nBands);
+            }
+        }
+    }
+
+    return true;
+}
+
+const std::string& CoherenceFileReader::getError() const
+{
+    return error;
+}
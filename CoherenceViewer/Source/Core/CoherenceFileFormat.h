@@ -0,0 +1,311 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COHERENCE_FILE_FORMAT_H_INCLUDED
+#define COHERENCE_FILE_FORMAT_H_INCLUDED
+
+/*
+Binary coherence recording format (.coh). This file has no JUCE dependency so that
+offline tools can read recordings without the GUI.
+
+The file is a fixed header followed by chunks of consecutive records, then an index of
+the chunks keyed by sample timestamp. The reader memory-maps the file and uses the index
+to go straight to the chunk holding a given time, so nothing before it has to be parsed.
+If the index is missing (the writer didn't get to close the file), the reader rebuilds it
+by walking the chunk headers.
+
+All values are little-endian.
+
+Header:
+    char[8]     magic "OECOHBIN"
+    uint32      format version
+    uint32      header size in bytes (first chunk starts at this offset)
+    float64     sample rate (Hz)
+    float64     segment length (s)
+    float64     window length (s)
+    float64     step length (s)
+    float64     alpha (0 = linear average)
+    int32       number of frequencies (nFreqs)
+    int32       number of channel pairs (nPairs)
+    uint32      maximum records per chunk
+    uint32      codec the writer was asked to use (see Codec)
+    uint32      average window (segments; 0 = weighted by alpha) [version 3 and later]
+    uint32      1 if records also hold the standard deviation over times, else 0 [version 4 and later]
+    uint32      1 if records hold the values at each frequency, else 0 [version 5 and later]
+    int32       number of frequency bands (nBands) [version 5 and later]
+    float64     frequencies (Hz) [nFreqs]
+    int32       channel pairs (group 1 chan, group 2 chan; 0-based, -1 if unknown) [nPairs][2]
+    bands [nBands] (version 5 and later):
+        float64     low edge (Hz)
+        float64     high edge (Hz)
+        char[16]    name, padded with zeros
+
+Chunk:
+    char[4]     magic "CHNK"
+    uint32      codec used for this chunk's coherence values
+    uint32      number of records (n)
+    uint32      payload size in bytes
+    int64       timestamp of first record
+    int64       timestamp of last record
+    payload:
+        int64       sample timestamp of the last sample of each segment [n]
+        uint32      segment index [n]
+        uint32      flags [n] (see Flags)
+        values, [n][values per record] float32 if codec is NONE, else encoded. Each record is
+        the coherence [nPairs][nFreqs], then (if the header says so) its standard deviation over
+        the times of interest [nPairs][nFreqs], then the coherence in each band [nPairs][nBands].
+        Without the values at each frequency, only the bands are stored.
+
+Index (after the last chunk):
+    char[4]     magic "CIDX"
+    uint32      number of chunks
+    entries:
+        int64   first timestamp
+        int64   last timestamp
+        uint64  file offset of the chunk
+        uint64  index of the chunk's first record in the file
+        uint32  number of records
+        uint32  codec
+    uint64      file offset of the index
+    char[8]     magic "OECOHEND"
+
+Codec XOR_RLE: each value's bits are XORed with the same value in the previous record of
+the chunk, the resulting words are split into byte planes (all first bytes, then all second
+bytes...) and runs of zero bytes are stored as a 0 followed by the run length (1-255).
+Coherence changes slowly between updates, so most sign/exponent bytes become zero runs.
+A chunk is stored uncompressed whenever encoding wouldn't make it smaller.
+*/
+
+#include "CoherenceBands.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class MappedFile;
+
+struct CoherenceFileHeader
+{
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 5;
+    static const uint32_t MIN_VERSION = 2; // oldest the reader accepts
+
+    enum Codec : uint32_t
+    {
+        NONE = 0,
+        XOR_RLE = 1
+    };
+
+    enum Flags : uint32_t
+    {
+        // timestamp was reconstructed rather than recorded (e.g. converted from a text file)
+        ESTIMATED_TIMESTAMP = 1 << 0
+    };
+
+    double sampleRate = 0;
+    double segLen = 0;
+    double winLen = 0;
+    double stepLen = 0;
+    double alpha = 0;
+    uint32_t averageWindow = 0; // average over the last n segments instead, if not 0
+    bool hasStdDev = false;     // records hold the standard deviation after the coherence
+    bool hasFreqValues = true;  // records hold values at each frequency, not just the bands
+
+    uint32_t recordsPerChunk = 16;
+    uint32_t codec = XOR_RLE;
+
+    std::vector<double> freqs;
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<CoherenceBand> bands;
+
+    int getNumFreqs() const { return int(freqs.size()); }
+    int getNumPairs() const { return int(pairs.size()); }
+    int getNumBands() const { return int(bands.size()); }
+
+    // number of coherence values at each frequency (nPairs x nFreqs)
+    size_t getValuesPerPlane() const { return freqs.size() * pairs.size(); }
+    // where the band coherence starts in each record (after any values at each frequency)
+    size_t getBandOffset() const { return hasFreqValues ? getValuesPerPlane() * (hasStdDev ? 2 : 1) : 0; }
+    // number of values in each record, including any standard deviations and bands
+    size_t getValuesPerRecord() const { return getBandOffset() + bands.size() * pairs.size(); }
+
+    // size of the serialized header, in bytes
+    uint32_t getHeaderSize() const;
+};
+
+struct CoherenceRecord
+{
+    int64_t timestamp = 0;
+    uint32_t segmentIndex = 0;
+    uint32_t flags = 0;
+    std::vector<float> values; // see CoherenceFileHeader::getValuesPerRecord
+
+    // only if the header's hasFreqValues is set
+    float getValue(int pair, int freq, int nFreqs) const
+    {
+        return values[size_t(pair) * nFreqs + freq];
+    }
+
+    // only if the header's hasFreqValues and hasStdDev are set
+    float getStdDev(int pair, int freq, int nFreqs, int nPairs) const
+    {
+        return values[size_t(nPairs + pair) * nFreqs + freq];
+    }
+
+    float getBandValue(int pair, int band, int nBands, size_t bandOffset) const
+    {
+        return values[bandOffset + size_t(pair) * nBands + band];
+    }
+};
+
+struct CoherenceChunkInfo
+{
+    int64_t firstTimestamp;
+    int64_t lastTimestamp;
+    uint64_t offset;
+    uint64_t firstRecord;
+    uint32_t numRecords;
+    uint32_t codec;
+};
+
+
+class CoherenceFileWriter
+{
+public:
+    CoherenceFileWriter();
+    ~CoherenceFileWriter();
+
+    // Creates (or truncates) the file and writes the header. Returns false on failure.
+    bool open(const std::string& path, const CoherenceFileHeader& header);
+
+    // Appends one record. values must hold header.getValuesPerRecord() floats.
+    // Records are buffered until a chunk is full.
+    bool writeRecord(int64_t timestamp, uint32_t segmentIndex, uint32_t flags, const float* values);
+
+    // Writes out the current (partial) chunk, if any, and flushes the stream.
+    void flush();
+
+    // Writes any partial chunk and the chunk index, then closes the file.
+    void close();
+
+    bool isOpen() const;
+
+private:
+    bool writeChunk();
+
+    std::ofstream stream;
+    CoherenceFileHeader header;
+    size_t valuesPerRecord;
+    uint64_t numRecordsWritten;
+
+    // current chunk
+    std::vector<int64_t> timestamps;
+    std::vector<uint32_t> segmentIndices;
+    std::vector<uint32_t> flags;
+    std::vector<float> values;
+    std::vector<uint8_t> encoded;
+
+    std::vector<CoherenceChunkInfo> index;
+
+    CoherenceFileWriter(const CoherenceFileWriter&) = delete;
+    CoherenceFileWriter& operator=(const CoherenceFileWriter&) = delete;
+};
+
+
+class CoherenceFileReader
+{
+public:
+    CoherenceFileReader();
+    ~CoherenceFileReader();
+
+    // Maps the file and parses the header and chunk index. Returns false (see getError) on failure.
+    bool open(const std::string& path);
+    void close();
+
+    const CoherenceFileHeader& getHeader() const;
+
+    int64_t getNumRecords() const;
+    int getNumChunks() const;
+    const CoherenceChunkInfo& getChunkInfo(int chunk) const;
+
+    // true if the file had no index (wasn't closed cleanly) and it was rebuilt on open
+    bool wasIndexRebuilt() const;
+
+    // Index of the first record with timestamp >= the given one (getNumRecords() if none).
+    int64_t findRecord(int64_t timestamp) const;
+
+    // Reads the record at the given index into dest. Returns false if out of range or corrupt.
+    bool readRecord(int64_t index, CoherenceRecord& dest);
+
+    // Reads just the timestamp, segment index and flags of a record (no decoding needed).
+    bool readRecordInfo(int64_t index, int64_t& timestamp, uint32_t& segmentIndex, uint32_t& flags) const;
+
+    // Reads the coherence of one channel pair for records [firstRecord, endRecord).
+    // Appends one timestamp per record to timestamps and nFreqs values per record to dest
+    // (if the file has them), likewise the standard deviations to stdDest if it's given and
+    // the file has them, and nBands values per record to bandDest if it's given.
+    bool readPair(int pair, int64_t firstRecord, int64_t endRecord, std::vector<int64_t>& timestamps,
+        std::vector<float>& dest, std::vector<float>* stdDest = nullptr, std::vector<float>* bandDest = nullptr);
+
+    const std::string& getError() const;
+
+private:
+
+    bool parseHeader();
+    bool parseIndex();
+    bool rebuildIndex();
+
+    // Whether a chunk header of nRecords records is at offset, with its record prefixes (from
+    // its own payload size) and payload ending by end. Every chunk in the index has been checked.
+    bool isValidChunk(uint64_t offset, uint64_t end, uint32_t nRecords) const;
+
+    // chunk containing the given record, or -1
+    int findChunk(int64_t record) const;
+
+    // Decodes (if needed) the values of a chunk and returns a pointer to
+    // [numRecords][valuesPerRecord] floats, or nullptr if the chunk is corrupt.
+    const float* getChunkValues(int chunk);
+
+    std::unique_ptr<MappedFile> mapping;
+    const uint8_t* data;
+    uint64_t size;
+
+    CoherenceFileHeader header;
+    std::vector<CoherenceChunkInfo> index;
+    int64_t numRecords;
+    bool indexRebuilt;
+
+    // last decoded chunk
+    int cachedChunk;
+    std::vector<float> cachedValues;
+
+    std::string error;
+
+    CoherenceFileReader(const CoherenceFileReader&) = delete;
+    CoherenceFileReader& operator=(const CoherenceFileReader&) = delete;
+};
+
+#endif // COHERENCE_FILE_FORMAT_H_INCLUDED
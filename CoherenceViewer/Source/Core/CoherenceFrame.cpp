@@ -0,0 +1,128 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CoherenceFrame.h"
+
+#include <algorithm>
+
+namespace
+{
+    void resizeRows(std::vector<std::vector<double>>& rows, int nRows, int nCols)
+    {
+        rows.resize(nRows);
+        for (std::vector<double>& row : rows)
+        {
+            row.resize(nCols);
+        }
+    }
+}
+
+CoherenceFrame::CoherenceFrame()
+    : nGroup1Chans  (0)
+    , nGroup2Chans  (0)
+    , isZScore      (false)
+    , hasJackknife  (false)
+{}
+
+void CoherenceFrame::resize(int nGroup1, int nGroup2, int nFreqs)
+{
+    nGroup1Chans = std::max(nGroup1, 0);
+    nGroup2Chans = std::max(nGroup2, 0);
+    nFreqs = std::max(nFreqs, 0);
+
+    resizeRows(coherence, nGroup1Chans * nGroup2Chans, nFreqs);
+    resizeRows(stdDev, nGroup1Chans * nGroup2Chans, nFreqs);
+    numAveraged.resize(nGroup1Chans * nGroup2Chans);
+    resizeRows(corrected, nGroup1Chans * nGroup2Chans, nFreqs);
+    resizeRows(ciLower, nGroup1Chans * nGroup2Chans, nFreqs);
+    resizeRows(ciUpper, nGroup1Chans * nGroup2Chans, nFreqs);
+    average.resize(nFreqs);
+    minimum.resize(nFreqs);
+    maximum.resize(nFreqs);
+    resizeRows(group1Average, nGroup1Chans, nFreqs);
+    resizeRows(group2Average, nGroup2Chans, nFreqs);
+}
+
+void CoherenceFrame::reduce()
+{
+    int nFreqs = getNumFreqs();
+    int nCombs = getNumCombinations();
+
+    std::fill(average.begin(), average.end(), 0.0);
+    for (std::vector<double>& row : group1Average)
+    {
+        std::fill(row.begin(), row.end(), 0.0);
+    }
+    for (std::vector<double>& row : group2Average)
+    {
+        std::fill(row.begin(), row.end(), 0.0);
+    }
+
+    if (nCombs == 0)
+    {
+        std::fill(minimum.begin(), minimum.end(), 0.0);
+        std::fill(maximum.begin(), maximum.end(), 0.0);
+        return;
+    }
+
+    minimum = coherence[0];
+    maximum = coherence[0];
+
+    // one pass over the combinations, adding each into every summary it belongs to
+    for (int itX = 0, comb = 0; itX < nGroup1Chans; ++itX)
+    {
+        double* group1Sum = group1Average[itX].data();
+        for (int itY = 0; itY < nGroup2Chans; ++itY, ++comb)
+        {
+            const double* coh = coherence[comb].data();
+            double* group2Sum = group2Average[itY].data();
+            for (int f = 0; f < nFreqs; ++f)
+            {
+                average[f] += coh[f];
+                group1Sum[f] += coh[f];
+                group2Sum[f] += coh[f];
+                minimum[f] = std::min(minimum[f], coh[f]);
+                maximum[f] = std::max(maximum[f], coh[f]);
+            }
+        }
+    }
+
+    for (double& sum : average)
+    {
+        sum /= nCombs;
+    }
+    for (std::vector<double>& row : group1Average)
+    {
+        for (double& sum : row)
+        {
+            sum /= nGroup2Chans;
+        }
+    }
+    for (std::vector<double>& row : group2Average)
+    {
+        for (double& sum : row)
+        {
+            sum /= nGroup1Chans;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COHERENCE_FRAME_H_INCLUDED
+#define COHERENCE_FRAME_H_INCLUDED
+
+/*
+
+Coherence Frame - the coherence of every combination after one segment, along with summaries
+across combinations, so that consumers (e.g. the canvas on the message thread) can show any of
+them without looping over every combination themselves. No JUCE dependency.
+
+Combinations are ordered group 1 channel major: comb = group1Index * nGroup2Chans + group2Index.
+The summaries are filled in by reduce(), on whichever thread publishes the frame.
+
+*/
+
+#include <vector>
+
+struct CoherenceFrame
+{
+    CoherenceFrame();
+
+    // Sizes everything (allocating only if it grows); contents are undefined until reduce()
+    void resize(int nGroup1Chans, int nGroup2Chans, int nFreqs);
+
+    // Fills in the summaries from coherence
+    void reduce();
+
+    int getNumFreqs() const { return int(average.size()); }
+    int getNumCombinations() const { return int(coherence.size()); }
+
+    int nGroup1Chans;
+    int nGroup2Chans;
+
+    std::vector<std::vector<double>> coherence; // # combinations x # freqs
+    bool isZScore; // coherence (and so the summaries) holds z-scores against a baseline
+
+    // # combinations x # freqs: standard deviation of the coherence over the times of interest
+    // in the segment (in coherence even when isZScore is set)
+    std::vector<std::vector<double>> stdDev;
+
+    // # combinations: effective number of segments in each combination's average (see
+    // CumulativeTFR::getEffectiveSegments)
+    std::vector<double> numAveraged;
+
+    // # combinations x # freqs, if hasJackknife: jackknife bias-corrected coherence and the
+    // bounds of its 95% confidence interval (in coherence even when isZScore is set)
+    bool hasJackknife;
+    std::vector<std::vector<double>> corrected;
+    std::vector<std::vector<double>> ciLower;
+    std::vector<std::vector<double>> ciUpper;
+
+    // # freqs each: mean, lowest and highest over all combinations
+    std::vector<double> average;
+    std::vector<double> minimum;
+    std::vector<double> maximum;
+
+    // # channels x # freqs: mean over the combinations each channel is part of
+    std::vector<std::vector<double>> group1Average;
+    std::vector<std::vector<double>> group2Average;
+};
+
+#endif // COHERENCE_FRAME_H_INCLUDED
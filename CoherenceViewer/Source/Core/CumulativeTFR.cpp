@@ -0,0 +1,500 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CumulativeTFR.h"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+static const double PI = 3.14159265358979323846;
+
+static double square(double x)
+{
+    return x * x;
+}
+
+// sum / n, or 0 for an empty sum
+template<typename T>
+static T averageOf(const T& sum, int n)
+{
+    return n > 0 ? sum / double(n) : T();
+}
+
+
+CumulativeTFR::CumulativeTFR(int ng1, int ng2, int nf, int nt, int Fs, float winLen, float stepLen, float freqStep,
+    int freqStart, double fftSec, double alpha, int averageWindow, int jackknifeGroups)
+    : nFreqs        (nf)
+    , Fs            (Fs)
+    , stepLen       (stepLen)
+    , nTimes        (nt)
+    , nfft          (int(fftSec * Fs))
+    , ifftBuffer    (nfft)
+    , trialSpectrum (nf * nt)
+    , alpha         (alpha)
+    , pxys          (averageWindow > 0 ? 0 : ng1 * ng2,
+                    vector<vector<ComplexWeightedAccum>>(nf,
+                    vector<ComplexWeightedAccum>(nt, ComplexWeightedAccum(alpha))))
+    , windowLen     (winLen)
+    , spectrumBuffer(ng1 + ng2, 
+                     vector<vector<std::complex<double>>>(nf,
+                     vector<std::complex<double>>(nt)))
+    , powBuffer     (averageWindow > 0 ? 0 : ng1 + ng2,
+                    vector<vector<RealWeightedAccum>>(nf,
+                    vector<RealWeightedAccum>(nt, RealWeightedAccum(alpha))))
+    , freqStep      (freqStep)
+    , freqStart     (freqStart)
+    , averageWindow (std::max(averageWindow, 0))
+{
+    if (this->averageWindow > 0)
+    {
+        pxyWindow.resize(ng1 * ng2 * nf * nt, this->averageWindow);
+        powWindow.resize((ng1 + ng2) * nf * nt, this->averageWindow);
+    }
+
+    // (the exponential average weights segments unequally, so has no jackknife)
+    if (jackknifeGroups > 0 && (this->averageWindow > 0 || alpha == 0))
+    {
+        pxyJack.resize(ng1 * ng2 * nf * nt, jackknifeGroups, this->averageWindow);
+        powJack.resize((ng1 + ng2) * nf * nt, jackknifeGroups, this->averageWindow);
+        groupCoherence.resize(jackknifeGroups);
+    }
+
+    weightSums.assign(ng1 * ng2, 0);
+    weightSqSums.assign(ng1 * ng2, 0);
+
+    // Create array of wavelets
+    generateWavelet();
+
+    // Trim time close to edge
+    trimTime = windowLen / 2;
+}
+
+void CumulativeTFR::addTrial(FFTArray& fftBuffer, int chanIt, TrialTimes* times)
+{
+    computeSpectrum(fftBuffer, ifftBuffer, trialSpectrum.data(), times);
+    addSpectrum(trialSpectrum.data(), chanIt);
+}
+
+void CumulativeTFR::computeSpectrum(FFTArray& fftBuffer, FFTArray& workBuffer, std::complex<double>* dest,
+    TrialTimes* times, const Subsample& subsample) const
+{
+    //// Execute fft ////
+    auto tStart = StageTimings::now();
+    fftBuffer.fftReal();
+    if (times)
+    {
+        times->fftUs += StageTimings::elapsedUs(tStart, StageTimings::now());
+    }
+
+    computeSpectrumFromFft(fftBuffer, workBuffer, dest, times, subsample);
+}
+
+void CumulativeTFR::computeSpectrumFromFft(const FFTArray& fftData, FFTArray& workBuffer,
+    std::complex<double>* dest, TrialTimes* times, const Subsample& subsample) const
+{
+    //// Use freqData to find generate spectrum ////
+	for (int freq = 0; freq < nFreqs; freq += subsample.freqStride)
+	{
+        convolve(fftData, freq, workBuffer, times);
+        sampleSpectrum(workBuffer, dest + freq * nTimes, subsample);
+	}
+}
+
+void CumulativeTFR::convolve(const FFTArray& fftData, int freq, FFTArray& workBuffer, TrialTimes* times) const
+{
+    auto tMultiply = StageTimings::now();
+    // Multiple fft data by wavelet
+    const vector<std::complex<double>>& wavelet = (*waveletArray)[freq];
+    for (int n = 0; n < nfft; n++)
+    {
+        workBuffer.set(n, fftData.getAsComplex(n) * wavelet[n]);
+    }
+    auto tIfft = StageTimings::now();
+    // Inverse FFT on data multiplied by wavelet
+    workBuffer.ifft();
+
+    if (times)
+    {
+        times->multiplyUs += StageTimings::elapsedUs(tMultiply, tIfft);
+        times->ifftUs += StageTimings::elapsedUs(tIfft, StageTimings::now());
+    }
+}
+
+void CumulativeTFR::sampleSpectrum(const FFTArray& convolved, std::complex<double>* dest,
+    const Subsample& subsample) const
+{
+    float nWindow = Fs * windowLen;
+    // Loop over time of interest
+    for (int t = 0; t < nTimes; t += subsample.timeStride)
+    {
+        int tIndex = int(((t * stepLen) + trimTime)  * Fs); // get index of time of interest
+        std::complex<double> complex = convolved.getAsComplex(tIndex);
+        complex *= sqrt(2.0 / nWindow) / double(nfft); // divide by nfft from matlab ifft
+                                                       // sqrt(2/nWindow) from ft_specest_mtmconvol.m 
+        dest[t] = complex;
+    }
+}
+
+void CumulativeTFR::addSpectrum(const std::complex<double>* spectrum, int chanIt, const Subsample& subsample)
+{
+    for (int freq = 0; freq < nFreqs; freq += subsample.freqStride)
+    {
+        for (int t = 0; t < nTimes; t += subsample.timeStride)
+        {
+            // Save convOutput for crss later
+            const std::complex<double>& complex = spectrum[freq * nTimes + t];
+            spectrumBuffer[chanIt][freq][t] = complex;
+            // Get power
+            double power = std::norm(complex);
+            int cell = getCell(chanIt, freq, t);
+            if (averageWindow > 0)
+            {
+                if (hasJackknife())
+                {
+                    powJack.addValue(cell, powWindow.toStored(power), powWindow.getOldest(cell));
+                }
+                powWindow.addValue(cell, power);
+            }
+            else
+            {
+                powBuffer[chanIt][freq][t].addValue(power);
+                if (hasJackknife())
+                {
+                    powJack.addValue(cell, power);
+                }
+            }
+        }
+    }
+}
+
+void CumulativeTFR::getMeanCoherence(int itX, int itY, double* meanDest, int comb, const Subsample& subsample,
+    double* stdDest)
+{
+    // Cross spectra
+    for (int f = 0; f < nFreqs; f += subsample.freqStride)
+    {
+        // Get crss from specturm of both chanX and chanY
+        for (int t = 0; t < nTimes; t += subsample.timeStride)
+        {
+            std::complex<double> crss = spectrumBuffer[itX][f][t] * std::conj(spectrumBuffer[itY][f][t]);
+            int cell = getCell(comb, f, t);
+            if (averageWindow > 0)
+            {
+                if (hasJackknife())
+                {
+                    pxyJack.addValue(cell, pxyWindow.toStored(crss), pxyWindow.getOldest(cell));
+                }
+                pxyWindow.addValue(cell, crss);
+            }
+            else
+            {
+                pxys[comb][f][t].addValue(crss);
+                if (hasJackknife())
+                {
+                    pxyJack.addValue(cell, crss);
+                }
+            }
+        }
+    }
+
+    // the newest segment has weight 1, and the exponential average decays the earlier ones
+    double decay = averageWindow > 0 ? 1 : 1 - alpha;
+    weightSums[comb] = 1 + decay * weightSums[comb];
+    weightSqSums[comb] = 1 + decay * decay * weightSqSums[comb];
+
+    getCurrentCoherence(itX, itY, meanDest, comb, subsample, stdDest);
+}
+
+double CumulativeTFR::getEffectiveSegments(int comb) const
+{
+    if (weightSqSums[comb] == 0)
+    {
+        return 0;
+    }
+    double effective = weightSums[comb] * weightSums[comb] / weightSqSums[comb];
+    return averageWindow > 0 ? std::min(effective, double(averageWindow)) : effective;
+}
+
+void CumulativeTFR::getCurrentCoherence(int itX, int itY, double* meanDest, int comb,
+    const Subsample& subsample, double* stdDest) const
+{
+    // Coherence (every frequency, since the skipped ones still have their earlier averages;
+    // only over the times being updated, so all frequencies cover the same times)
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        // compute coherence at each time
+        RealAccum coh;
+        int nTimesUsed = 0;
+
+        for (int t = 0; t < nTimes; t += subsample.timeStride, ++nTimesUsed)
+        {
+            coh.addValue(singleCoherence(getPow(itX, f, t), getPow(itY, f, t), getPxy(comb, f, t)));
+        }
+
+        meanDest[f] = coh.getAverage();
+        if (stdDest == nullptr)
+        {
+            continue;
+        }
+        else if (nTimesUsed < 2)
+        {
+            stdDest[f] = 0;
+        }
+        else
+        {
+            stdDest[f] = std::sqrt(coh.getVariance() * nTimesUsed / (nTimesUsed - 1));
+        }
+    }
+}
+
+void CumulativeTFR::getJackknifeCoherence(int itX, int itY, int comb, double* correctedDest,
+    double* lowerDest, double* upperDest, const Subsample& subsample)
+{
+    int nGroups = pxyJack.getNumGroups();
+
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        // coherence at each time from all the segments and without each group, averaged over
+        // the times the same way as getCurrentCoherence
+        double coherence = 0;
+        std::fill(groupCoherence.begin(), groupCoherence.end(), 0.0);
+        int nTimesUsed = 0;
+
+        for (int t = 0; t < nTimes; t += subsample.timeStride, ++nTimesUsed)
+        {
+            int pxyCell = getCell(comb, f, t);
+            int xCell = getCell(itX, f, t);
+            int yCell = getCell(itY, f, t);
+            const std::complex<double>* pxySums = pxyJack.getGroupSums(pxyCell);
+            const double* xSums = powJack.getGroupSums(xCell);
+            const double* ySums = powJack.getGroupSums(yCell);
+
+            std::complex<double> pxyTotal;
+            double xTotal = 0;
+            double yTotal = 0;
+            for (int g = 0; g < nGroups; ++g)
+            {
+                pxyTotal += pxySums[g];
+                xTotal += xSums[g];
+                yTotal += ySums[g];
+            }
+            int pxyCount = pxyJack.getCount(pxyCell);
+            int xCount = powJack.getCount(xCell);
+            int yCount = powJack.getCount(yCell);
+
+            double full = singleCoherence(averageOf(xTotal, xCount), averageOf(yTotal, yCount),
+                averageOf(pxyTotal, pxyCount));
+            coherence += full;
+
+            for (int g = 0; g < nGroups; ++g)
+            {
+                int pxyInGroup = pxyJack.getGroupCount(pxyCell, g);
+                if (pxyInGroup == 0)
+                {
+                    groupCoherence[g] += full;
+                    continue;
+                }
+                groupCoherence[g] += singleCoherence(
+                    averageOf(xTotal - xSums[g], xCount - powJack.getGroupCount(xCell, g)),
+                    averageOf(yTotal - ySums[g], yCount - powJack.getGroupCount(yCell, g)),
+                    averageOf(pxyTotal - pxySums[g], pxyCount - pxyInGroup));
+            }
+        }
+        coherence /= nTimesUsed;
+
+        // only groups with segments in them count (the first time of interest is updated by
+        // every segment, so has all of them)
+        int firstCell = getCell(comb, f, 0);
+        int nUsed = 0;
+        double meanWithout = 0;
+        for (int g = 0; g < nGroups; ++g)
+        {
+            groupCoherence[g] /= nTimesUsed;
+            if (pxyJack.getGroupCount(firstCell, g) > 0)
+            {
+                meanWithout += groupCoherence[g];
+                ++nUsed;
+            }
+        }
+
+        if (nUsed < 2)
+        {
+            correctedDest[f] = coherence;
+            lowerDest[f] = 0;
+            upperDest[f] = 1;
+            continue;
+        }
+
+        meanWithout /= nUsed;
+        double sumSq = 0;
+        for (int g = 0; g < nGroups; ++g)
+        {
+            if (pxyJack.getGroupCount(firstCell, g) > 0)
+            {
+                sumSq += square(groupCoherence[g] - meanWithout);
+            }
+        }
+
+        double corrected = nUsed * coherence - (nUsed - 1) * meanWithout;
+        double halfWidth = getT975(nUsed - 1) * std::sqrt(sumSq * (nUsed - 1) / nUsed);
+        correctedDest[f] = corrected;
+        lowerDest[f] = corrected - halfWidth;
+        upperDest[f] = corrected + halfWidth;
+    }
+}
+
+double CumulativeTFR::getT975(int degreesOfFreedom)
+{
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    const int tableSize = int(sizeof(table) / sizeof(table[0]));
+
+    int df = std::max(degreesOfFreedom, 1);
+    if (df <= tableSize)
+    {
+        return table[df - 1];
+    }
+
+    // Cornish-Fisher expansion about the normal quantile, good to 0.001 past the table
+    const double z = 1.959964;
+    return z + (z * z * z + z) / (4.0 * df) + (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96.0 * df * df);
+}
+
+
+// > Private Methods
+
+size_t CumulativeTFR::getAccumulatorMemory() const
+{
+    size_t bytes = pxyWindow.getMemorySize() + powWindow.getMemorySize()
+        + pxyJack.getMemorySize() + powJack.getMemorySize();
+    for (const auto& comb : pxys)
+    {
+        for (const auto& freq : comb)
+        {
+            bytes += freq.size() * sizeof(ComplexWeightedAccum);
+        }
+    }
+    for (const auto& chan : powBuffer)
+    {
+        for (const auto& freq : chan)
+        {
+            bytes += freq.size() * sizeof(RealWeightedAccum);
+        }
+    }
+    return bytes;
+}
+
+double CumulativeTFR::singleCoherence(double pxx, double pyy, std::complex<double> pxy)
+{
+    // 0 rather than NaN for a value that hasn't had any data yet
+    double denominator = pxx * pyy;
+    return denominator > 0 ? std::norm(pxy) / denominator : 0;
+}
+
+
+void CumulativeTFR::generateWavelet()
+{
+    // only kept while some TFR is using them, since they can be large
+    static std::map<std::tuple<int, int, float, int, int, float>, std::weak_ptr<const WaveletBank>> cache;
+    static std::mutex cacheMutex;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto& cached = cache[std::make_tuple(nfft, Fs, windowLen, nFreqs, freqStart, freqStep)];
+    waveletArray = cached.lock();
+    if (!waveletArray)
+    {
+        waveletArray = std::make_shared<const WaveletBank>(
+            makeWavelets(nfft, Fs, windowLen, nFreqs, freqStart, freqStep));
+        cached = waveletArray;
+    }
+}
+
+CumulativeTFR::WaveletBank CumulativeTFR::makeWavelets(int nfft, int Fs, float windowLen, int nFreqs,
+    int freqStart, float freqStep)
+{
+    std::vector<double> hann(nfft);
+    std::vector<double> sinWave(nfft);
+	std::vector<double> cosWave(nfft);
+    
+    WaveletBank wavelets(nFreqs, vector<std::complex<double>>(nfft));
+
+    // Hann window
+
+    float nSampWindow = Fs * windowLen;
+    for (int position = 0; position < nfft; position++)
+    {
+        //// Hann Window //// = sin^2(PI*n/N) where N=length of window
+        // Create first half hann function
+        if (position <= nSampWindow / 2)
+        {
+            // Shifted by one half cycle (pi/2)
+            hann[position] = square(std::sin(PI*position / nSampWindow + (PI/2.0))); 
+        }
+        // Pad with zeroes
+        else if (position <= (nfft - nSampWindow / 2)) 
+        {
+            hann[position] = 0;
+        }
+        // Finish off hann function
+        else
+        {
+            // Move start of wave to nfft - windowSize/2
+            float hannPosition = position - (nfft - nSampWindow / 2);
+            hann[position] = square(std::sin(hannPosition*PI / nSampWindow));
+        }
+    }
+
+    // Wavelet
+    float freqNormalized = freqStart;
+    FFTArray fftWaveletBuffer(nfft);
+    for (int freq = 0; freq < nFreqs; freq++)
+    {
+        for (int position = 0; position < nfft; position++)
+        {
+            // Make sin and cos wave.
+            sinWave[position] = std::sin(position * freqNormalized * (2*PI) / Fs);
+            cosWave[position] = std::cos(position * freqNormalized * (2*PI) / Fs);
+        }
+        freqNormalized += freqStep;
+
+		//// Wavelet ////
+		// Put into fft input array
+		for (int position = 0; position < nfft; position++)
+		{
+            fftWaveletBuffer.set(position, std::complex<double>(cosWave.at(position) * hann.at(position), sinWave.at(position) * hann.at(position)));
+        }
+		
+		fftWaveletBuffer.fftComplex();
+
+		// Save fft output for use later
+        for (int i = 0; i < nfft; i++)
+        {
+            wavelets[freq][i] = fftWaveletBuffer.getAsComplex(i);
+        }
+    }
+
+    return wavelets;
+}
@@ -0,0 +1,297 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CUMULATIVE_TFR_H_INCLUDED
+#define CUMULATIVE_TFR_H_INCLUDED
+
+#include "FFTArray.h"
+#include "JackknifeAccum.h"
+#include "SlidingWindowAccum.h"
+#include "StageTimings.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <complex>
+
+class CumulativeTFR
+{
+    // shorten some things
+    template<typename T>
+    using vector = std::vector<T>;
+
+    // mean and variance of a series of values
+    struct RealAccum
+    {
+        RealAccum()
+            : count (0)
+            , sum   (0)
+            , sumSq (0)
+        {}
+
+        void addValue(double x)
+        {
+            ++count;
+            sum += x;
+            sumSq += x * x;
+        }
+
+        double getAverage() const
+        {
+            return count > 0 ? sum / count : 0;
+        }
+
+        double getVariance() const
+        {
+            return count > 0 ? std::max(0.0, sumSq / count - getAverage() * getAverage()) : 0;
+        }
+
+    private:
+        size_t count;
+        double sum;
+        double sumSq;
+    };
+
+    struct ComplexWeightedAccum
+    {
+        ComplexWeightedAccum(double alpha)
+            : count (0)
+            , sum   (0, 0)
+            , alpha (alpha)
+        {}
+
+        std::complex<double> getAverage() const
+        {
+            return count > 0 ? sum / (double)count : std::complex<double>();
+        }
+
+        void addValue(std::complex<double> x)
+        {
+            sum = x + (1 - alpha) * sum; // Maybe worried about intitial value skewing results..? Could be why its so high always.
+            count = 1 + (1 - alpha) * count;
+        }
+
+    private:
+        std::complex<double> sum;
+        size_t count;
+
+        const double alpha;
+    };
+
+
+    struct RealWeightedAccum
+    {
+        RealWeightedAccum(double alpha)
+            : count (0)
+            , sum   (0)
+            , alpha (alpha)
+        {}
+
+        double getAverage() const
+        {
+            return count > 0 ? sum / (double)count : double();
+        }
+
+        void addValue(double x)
+        {
+            sum = x + (1 - alpha) * sum;
+            count = 1 + (1 - alpha) * count;
+        }
+
+    private:
+        double sum;
+        size_t count;
+
+        const double alpha;
+    };
+
+public:
+    // time spent in each part of addTrial, in microseconds
+    struct TrialTimes
+    {
+        double fftUs = 0;
+        double multiplyUs = 0;
+        double ifftUs = 0;
+    };
+
+    // Which times and frequencies of interest a segment updates, to trade resolution for speed
+    // when the calculation can't keep up. The others keep their averages from earlier segments.
+    struct Subsample
+    {
+        Subsample(int timeStride = 1, int freqStride = 1)
+            : timeStride(timeStride)
+            , freqStride(freqStride)
+        {}
+
+        int timeStride; // every n-th time of interest
+        int freqStride; // every n-th frequency
+
+        bool isFull() const { return timeStride == 1 && freqStride == 1; }
+    };
+
+    // With averageWindow > 0, coherence is averaged over the last averageWindow segments
+    // (a boxcar) and alpha is ignored; otherwise over all segments, weighted by alpha.
+    // With jackknifeGroups > 0 (and a linear or last-N average), the sums are also kept in that
+    // many groups for getJackknifeCoherence.
+    CumulativeTFR(int ng1, int ng2, int nf, int nt, int Fs,
+        float winLen = 2, float stepLen = 0.1, float freqStep = 0.25,
+        int freqStart = 1, double fftSec = 10.0, double alpha = 0, int averageWindow = 0,
+        int jackknifeGroups = 0);
+
+    // Handle a new buffer of data. Preform FFT and create pxxs, pyys.
+    // If times is given, adds the time spent in each part to it.
+    void addTrial(FFTArray& fftBuffer, int chan, TrialTimes* times = nullptr);
+
+    // addTrial in two steps, so that segments can be transformed in parallel and then added
+    // in order. computeSpectrum doesn't change the TFR, so it can be called from any thread;
+    // it overwrites fftBuffer and uses workBuffer (getNfft() long) for the inverse FFTs.
+    // dest gets getSpectrumSize() values, frequency-major.
+    // With a subsample, only the values it includes are computed (the rest of dest is left as is),
+    // and the same subsample must be passed to addSpectrum and getMeanCoherence.
+    void computeSpectrum(FFTArray& fftBuffer, FFTArray& workBuffer, std::complex<double>* dest,
+        TrialTimes* times = nullptr, const Subsample& subsample = Subsample()) const;
+    // Same as computeSpectrum on a segment that has already been through fftReal.
+    void computeSpectrumFromFft(const FFTArray& fftData, FFTArray& workBuffer, std::complex<double>* dest,
+        TrialTimes* times = nullptr, const Subsample& subsample = Subsample()) const;
+
+    // computeSpectrumFromFft for a single frequency, in two steps: convolve leaves the segment
+    // filtered by the frequency's wavelet in workBuffer, and sampleSpectrum takes this TFR's
+    // nTimes values from the result. TFRs with the same wavelets (same segment length, window
+    // and frequencies) can sample one convolution, e.g. to try several step lengths.
+    void convolve(const FFTArray& fftData, int freq, FFTArray& workBuffer, TrialTimes* times = nullptr) const;
+    void sampleSpectrum(const FFTArray& convolved, std::complex<double>* dest,
+        const Subsample& subsample = Subsample()) const;
+    bool hasSameWavelets(const CumulativeTFR& other) const { return waveletArray == other.waveletArray; }
+    void addSpectrum(const std::complex<double>* spectrum, int chan, const Subsample& subsample = Subsample());
+
+    int getNfft() const { return nfft; }
+    int getNumTimes() const { return nTimes; }
+    int getSpectrumSize() const { return nFreqs * nTimes; }
+    int getAverageWindow() const { return averageWindow; }
+
+    // Bytes held by the cross-spectrum and power averages
+    size_t getAccumulatorMemory() const;
+
+    // Function to get coherence between two channels. meanDest gets the coherence at each
+    // frequency (the mean over the times of interest), and stdDest, if given, its standard
+    // deviation over those times.
+    void getMeanCoherence(int chanX, int chanY, double* meanDest, int comb,
+        const Subsample& subsample = Subsample(), double* stdDest = nullptr);
+
+    // Coherence from the averages as they are, without adding the latest spectra, for a
+    // combination that is being skipped
+    void getCurrentCoherence(int chanX, int chanY, double* meanDest, int comb,
+        const Subsample& subsample = Subsample(), double* stdDest = nullptr) const;
+
+    bool hasJackknife() const { return pxyJack.getNumGroups() > 0; }
+
+    // Effective number of segments in a combination's average, (sum of weights)^2 / sum of
+    // squared weights: the number of segments for a linear or last-N average. The bias of
+    // coherence with no true relationship is about 1 / this.
+    double getEffectiveSegments(int comb) const;
+
+    // Jackknife of the current coherence, leaving out each group of segments in turn (with no
+    // more segments than groups, each segment): the bias-corrected coherence at each frequency
+    // and the bounds of its 95% confidence interval, neither clamped to [0, 1]. With fewer than
+    // 2 segments, the coherence itself and an interval of [0, 1].
+    void getJackknifeCoherence(int chanX, int chanY, int comb, double* correctedDest,
+        double* lowerDest, double* upperDest, const Subsample& subsample = Subsample());
+
+    // 97.5th percentile of Student's t distribution
+    static double getT975(int degreesOfFreedom);
+    
+private:
+    // # frequencies x nfft
+    using WaveletBank = vector<vector<std::complex<double>>>;
+
+	// Get the wavelets to multiply the channel spectrum by. TFRs with the same parameters
+    // share one set, which is generated when the first of them is created.
+    void generateWavelet();
+    static WaveletBank makeWavelets(int nfft, int Fs, float windowLen, int nFreqs, int freqStart, float freqStep);
+
+    const int nFreqs;
+    const int Fs;
+    const int nTimes;
+    const int nfft;
+    int segmentLen;
+    float windowLen;
+    float stepLen;
+
+    float freqStep;
+    int freqStart;
+    int freqEnd;
+
+    float trimTime; // half the window, in seconds
+
+    // # channels x # frequencies x # times
+	vector<vector<vector<std::complex<double>>>> spectrumBuffer;
+    std::shared_ptr<const WaveletBank> waveletArray;
+
+    FFTArray ifftBuffer;
+    vector<std::complex<double>> trialSpectrum; // addTrial's output from computeSpectrum
+
+    // For exponential average
+    double alpha;
+    // Store cross-spectra : # channel combinations x # frequencies x # times
+    vector<vector<vector<ComplexWeightedAccum>>> pxys; 
+    // Store power : # channels x # frequencies x # times
+    vector<vector<vector<RealWeightedAccum>>> powBuffer;
+
+    // For the average over the last averageWindow segments, in place of pxys and powBuffer
+    // (which are left empty). Cells are in the same order, flattened.
+    int averageWindow;
+    SlidingWindowAccum<std::complex<double>, std::complex<float>> pxyWindow;
+    SlidingWindowAccum<double, float> powWindow;
+
+    // # combinations: sums of the weights and squared weights of the segments in the average
+    // (for getEffectiveSegments)
+    vector<double> weightSums;
+    vector<double> weightSqSums;
+
+    // Sums split into groups of segments for the jackknife (empty without one), in the same
+    // order as pxyWindow and powWindow. They use the same values as the average, so in the
+    // sliding window they are rounded to single precision first.
+    JackknifeAccum<std::complex<double>> pxyJack;
+    JackknifeAccum<double> powJack;
+    vector<double> groupCoherence; // getJackknifeCoherence's coherence without each group
+
+    int getCell(int chanOrComb, int freq, int t) const { return (chanOrComb * nFreqs + freq) * nTimes + t; }
+
+    // Average cross-spectrum and power, from whichever accumulators are in use
+    std::complex<double> getPxy(int comb, int freq, int t) const
+    {
+        return averageWindow > 0 ? pxyWindow.getAverage(getCell(comb, freq, t)) : pxys[comb][freq][t].getAverage();
+    }
+    double getPow(int chan, int freq, int t) const
+    {
+        return averageWindow > 0 ? powWindow.getAverage(getCell(chan, freq, t)) : powBuffer[chan][freq][t].getAverage();
+    }
+
+    // calculate a single magnitude-squared coherence from cross spectrum and auto-power values
+    static double singleCoherence(double pxx, double pyy, std::complex<double> pxy);
+    
+    CumulativeTFR(const CumulativeTFR&) = delete;
+    CumulativeTFR& operator=(const CumulativeTFR&) = delete;
+};
+
+#endif // CUMULATIVE_TFR_H_INCLUDED
\ No newline at end of file
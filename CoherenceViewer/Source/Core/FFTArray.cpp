@@ -0,0 +1,431 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "FFTArray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef COHERENCE_USE_FFTW
+#include <fftw3.h>
+#endif
+
+namespace
+{
+    std::mutex planMutex; // guards the plan cache and (with FFTW) the planner
+
+#ifndef COHERENCE_USE_FFTW
+    bool isPowerOf2(int n)
+    {
+        return n > 0 && (n & (n - 1)) == 0;
+    }
+#endif
+
+    std::complex<double>* allocComplex(int n)
+    {
+#ifdef COHERENCE_USE_FFTW
+        // aligned the same way as the buffers the plans were made with
+        auto p = reinterpret_cast<std::complex<double>*>(fftw_malloc(sizeof(fftw_complex) * n));
+#else
+        auto p = new std::complex<double>[n];
+#endif
+        std::fill(p, p + n, std::complex<double>());
+        return p;
+    }
+
+    void freeComplex(std::complex<double>* p)
+    {
+#ifdef COHERENCE_USE_FFTW
+        fftw_free(p);
+#else
+        delete[] p;
+#endif
+    }
+}
+
+#ifdef COHERENCE_USE_FFTW
+
+struct FFTArray::Plans
+{
+    explicit Plans(int n)
+    {
+        // FFTW_MEASURE overwrites the arrays while planning, so plan on scratch buffers
+        // and execute on each array's own (identically aligned) buffers later.
+        double* realIn = fftw_alloc_real(n);
+        fftw_complex* complexOut = fftw_alloc_complex(n);
+
+        r2c = fftw_plan_dft_r2c_1d(n, realIn, complexOut, FFTW_MEASURE);
+        forward = fftw_plan_dft_1d(n, complexOut, complexOut, FFTW_FORWARD, FFTW_MEASURE);
+        backward = fftw_plan_dft_1d(n, complexOut, complexOut, FFTW_BACKWARD, FFTW_MEASURE);
+
+        fftw_free(realIn);
+        fftw_free(complexOut);
+    }
+
+    fftw_plan r2c;
+    fftw_plan forward;
+    fftw_plan backward;
+};
+
+#else
+
+struct FFTArray::Plans
+{
+    explicit Plans(int n)
+        : convLength(0)
+    {
+        if (isPowerOf2(n))
+        {
+            twiddles = makeTwiddles(n);
+            return;
+        }
+
+        // Bluestein: DFT as a convolution with a chirp, done with power-of-2 FFTs
+        convLength = 1;
+        while (convLength < 2 * n - 1)
+        {
+            convLength <<= 1;
+        }
+        twiddles = makeTwiddles(convLength);
+
+        chirp.resize(n);
+        for (int k = 0; k < n; ++k)
+        {
+            // k^2 mod 2n keeps the angle small, so large k don't lose precision
+            uint64_t k2 = (uint64_t(k) * uint64_t(k)) % (2 * uint64_t(n));
+            chirp[k] = std::polar(1.0, -PI * double(k2) / n);
+        }
+
+        chirpFilter.assign(convLength, std::complex<double>());
+        chirpFilter[0] = std::conj(chirp[0]);
+        for (int k = 1; k < n; ++k)
+        {
+            chirpFilter[k] = chirpFilter[convLength - k] = std::conj(chirp[k]);
+        }
+        radix2(chirpFilter.data(), convLength, false);
+    }
+
+    // in-place power-of-2 FFT of length twiddles.size() * 2
+    void radix2(std::complex<double>* x, int n, bool inverse) const
+    {
+        // bit reversal permutation
+        for (int i = 1, j = 0; i < n; ++i)
+        {
+            int bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+            {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j)
+            {
+                std::swap(x[i], x[j]);
+            }
+        }
+
+        for (int len = 2; len <= n; len <<= 1)
+        {
+            int half = len / 2;
+            int step = n / len;
+            for (int i = 0; i < n; i += len)
+            {
+                for (int j = 0; j < half; ++j)
+                {
+                    std::complex<double> w = inverse ? std::conj(twiddles[j * step]) : twiddles[j * step];
+                    std::complex<double> u = x[i + j];
+                    std::complex<double> v = x[i + j + half] * w;
+                    x[i + j] = u + v;
+                    x[i + j + half] = u - v;
+                }
+            }
+        }
+    }
+
+    // forward DFT of any length, using work (convLength elements) for Bluestein
+    void forward(std::complex<double>* x, int n, std::complex<double>* work) const
+    {
+        if (convLength == 0)
+        {
+            radix2(x, n, false);
+            return;
+        }
+
+        for (int k = 0; k < n; ++k)
+        {
+            work[k] = x[k] * chirp[k];
+        }
+        std::fill(work + n, work + convLength, std::complex<double>());
+
+        radix2(work, convLength, false);
+        for (int k = 0; k < convLength; ++k)
+        {
+            work[k] *= chirpFilter[k];
+        }
+        radix2(work, convLength, true);
+
+        double scale = 1.0 / convLength;
+        for (int k = 0; k < n; ++k)
+        {
+            x[k] = work[k] * chirp[k] * scale;
+        }
+    }
+
+    static std::vector<std::complex<double>> makeTwiddles(int n)
+    {
+        std::vector<std::complex<double>> w(n / 2);
+        for (int k = 0; k < n / 2; ++k)
+        {
+            w[k] = std::polar(1.0, -2 * PI * k / n);
+        }
+        return w;
+    }
+
+    static constexpr double PI = 3.14159265358979323846;
+
+    int convLength; // 0 if the length is a power of 2
+    std::vector<std::complex<double>> twiddles;
+    std::vector<std::complex<double>> chirp;
+    std::vector<std::complex<double>> chirpFilter; // FFT of the conjugate chirp
+};
+
+constexpr double FFTArray::Plans::PI;
+
+#endif // COHERENCE_USE_FFTW
+
+namespace
+{
+    // one set of plans per length, shared by all arrays and never freed
+    std::shared_ptr<const FFTArray::Plans> getPlans(int length)
+    {
+        static std::map<int, std::shared_ptr<const FFTArray::Plans>> cache;
+
+        std::lock_guard<std::mutex> lock(planMutex);
+        auto& plans = cache[length];
+        if (!plans)
+        {
+            plans = std::make_shared<const FFTArray::Plans>(length);
+        }
+        return plans;
+    }
+}
+
+FFTArray::FFTArray(int n)
+    : length        (0)
+    , data          (nullptr)
+    , realScratch   (nullptr)
+    , workScratch   (nullptr)
+{
+    allocate(n);
+}
+
+FFTArray::FFTArray(const FFTArray& other)
+    : FFTArray(other.length)
+{
+    std::copy(other.data, other.data + length, data);
+}
+
+FFTArray::FFTArray(FFTArray&& other) noexcept
+    : length        (other.length)
+    , data          (other.data)
+    , realScratch   (other.realScratch)
+    , workScratch   (other.workScratch)
+    , plans         (std::move(other.plans))
+{
+    other.length = 0;
+    other.data = nullptr;
+    other.realScratch = nullptr;
+    other.workScratch = nullptr;
+}
+
+FFTArray::~FFTArray()
+{
+    release();
+}
+
+FFTArray& FFTArray::operator=(const FFTArray& other)
+{
+    if (this != &other)
+    {
+        if (length != other.length)
+        {
+            release();
+            allocate(other.length);
+        }
+        std::copy(other.data, other.data + length, data);
+    }
+    return *this;
+}
+
+FFTArray& FFTArray::operator=(FFTArray&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        length = other.length;
+        data = other.data;
+        realScratch = other.realScratch;
+        workScratch = other.workScratch;
+        plans = std::move(other.plans);
+
+        other.length = 0;
+        other.data = nullptr;
+        other.realScratch = nullptr;
+        other.workScratch = nullptr;
+    }
+    return *this;
+}
+
+void FFTArray::resize(int newLength)
+{
+    release();
+    allocate(newLength);
+}
+
+void FFTArray::allocate(int newLength)
+{
+    length = std::max(newLength, 0);
+    if (length == 0)
+    {
+        return;
+    }
+
+    data = allocComplex(length);
+    plans = getPlans(length);
+
+#ifdef COHERENCE_USE_FFTW
+    realScratch = fftw_alloc_real(length);
+#else
+    if (plans->convLength > 0)
+    {
+        workScratch = allocComplex(plans->convLength);
+    }
+#endif
+}
+
+void FFTArray::release()
+{
+    freeComplex(data);
+    freeComplex(workScratch);
+#ifdef COHERENCE_USE_FFTW
+    fftw_free(realScratch);
+#endif
+    data = nullptr;
+    realScratch = nullptr;
+    workScratch = nullptr;
+    plans.reset();
+    length = 0;
+}
+
+size_t FFTArray::getMemorySize() const
+{
+    size_t bytes = size_t(length) * sizeof(std::complex<double>);
+#ifdef COHERENCE_USE_FFTW
+    bytes += size_t(length) * sizeof(double);
+#else
+    if (workScratch != nullptr)
+    {
+        bytes += size_t(plans->convLength) * sizeof(std::complex<double>);
+    }
+#endif
+    return bytes;
+}
+
+void FFTArray::fftReal()
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+#ifdef COHERENCE_USE_FFTW
+    for (int i = 0; i < length; ++i)
+    {
+        realScratch[i] = data[i].real();
+    }
+    fftw_execute_dft_r2c(plans->r2c, realScratch, reinterpret_cast<fftw_complex*>(data));
+
+    // r2c only fills in the non-negative frequencies; the rest are their conjugates
+    for (int k = length / 2 + 1; k < length; ++k)
+    {
+        data[k] = std::conj(data[length - k]);
+    }
+#else
+    for (int i = 0; i < length; ++i)
+    {
+        data[i].imag(0);
+    }
+    plans->forward(data, length, workScratch);
+#endif
+}
+
+void FFTArray::fftComplex()
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+#ifdef COHERENCE_USE_FFTW
+    auto p = reinterpret_cast<fftw_complex*>(data);
+    fftw_execute_dft(plans->forward, p, p);
+#else
+    plans->forward(data, length, workScratch);
+#endif
+}
+
+void FFTArray::ifft()
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+#ifdef COHERENCE_USE_FFTW
+    auto p = reinterpret_cast<fftw_complex*>(data);
+    fftw_execute_dft(plans->backward, p, p);
+#else
+    // ifft(x) = conj(fft(conj(x)))
+    for (int i = 0; i < length; ++i)
+    {
+        data[i] = std::conj(data[i]);
+    }
+    plans->forward(data, length, workScratch);
+    for (int i = 0; i < length; ++i)
+    {
+        data[i] = std::conj(data[i]);
+    }
+#endif
+}
+
+const char* FFTArray::getBackendName()
+{
+#ifdef COHERENCE_USE_FFTW
+    return "FFTW";
+#else
+    return "built-in";
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef FFT_ARRAY_H_INCLUDED
+#define FFT_ARRAY_H_INCLUDED
+
+/*
+
+FFT Array - a complex array that can be transformed in place, in the style of the Open Ephys
+FFTW wrapper but without depending on it or on JUCE.
+
+When built with COHERENCE_USE_FFTW, transforms use FFTW. Plans are made once per length and
+kind on scratch buffers (under a lock, since the FFTW planner isn't thread-safe) and shared by
+every array of that length, so any number of arrays can transform concurrently and planning
+never touches their data. Otherwise a built-in FFT is used: radix-2 for powers of 2, and
+Bluestein's algorithm (on top of radix-2) for other lengths.
+
+Transforms are unnormalized, like FFTW: ifft(fft(x)) = length * x.
+
+*/
+
+#include <complex>
+#include <memory>
+
+class FFTArray
+{
+public:
+    FFTArray(int length = 0);
+    FFTArray(const FFTArray& other);
+    FFTArray(FFTArray&& other) noexcept;
+    ~FFTArray();
+
+    FFTArray& operator=(const FFTArray& other);
+    FFTArray& operator=(FFTArray&& other) noexcept;
+
+    // Changes the length; contents are zeroed.
+    void resize(int newLength);
+
+    int getLength() const { return length; }
+
+    // Bytes allocated for the contents and transform scratch space
+    size_t getMemorySize() const;
+
+    void set(int i, double value) { data[i] = value; }
+    void set(int i, std::complex<double> value) { data[i] = value; }
+
+    double getAsReal(int i) const { return data[i].real(); }
+    std::complex<double> getAsComplex(int i) const { return data[i]; }
+
+    std::complex<double>* getComplexPointer() { return data; }
+    const std::complex<double>* getComplexPointer() const { return data; }
+
+    // Forward transform of the real parts (imaginary parts are ignored). Unlike a plain
+    // real-to-complex FFT, the whole (conjugate-symmetric) spectrum is filled in.
+    void fftReal();
+
+    // Forward transform of the complex contents
+    void fftComplex();
+
+    // Inverse transform (unnormalized)
+    void ifft();
+
+    // "FFTW" or "built-in"
+    static const char* getBackendName();
+
+    struct Plans;
+
+private:
+    void allocate(int newLength);
+    void release();
+
+    int length;
+    std::complex<double>* data;
+    double* realScratch; // input of the real transform (FFTW only)
+    std::complex<double>* workScratch; // Bluestein convolution buffer (built-in only)
+
+    std::shared_ptr<const Plans> plans;
+};
+
+#endif // FFT_ARRAY_H_INCLUDED
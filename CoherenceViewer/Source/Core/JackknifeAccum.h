@@ -0,0 +1,120 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef JACKKNIFE_ACCUM_H_INCLUDED
+#define JACKKNIFE_ACCUM_H_INCLUDED
+
+/*
+
+Jackknife Accumulator - sums of the values added to each of a set of cells, split into a fixed
+number of groups, so that an average leaving out any one group can be had without going back
+over the values. No JUCE dependency.
+
+Values go to the groups in turn (the i-th value added to a cell to group i % numGroups), so
+while a cell has at most numGroups values, each group holds one and leaving out a group leaves
+out a single value. With a window length, only the last windowLength values count (as in
+SlidingWindowAccum): each add must also pass the value that drops out of the window, which is
+subtracted from the group it went to.
+
+Each cell's group sums are together in one block; counts aren't stored, since they follow from
+the number of values added.
+
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template<typename T>
+class JackknifeAccum
+{
+public:
+    JackknifeAccum(int numCells = 0, int numGroups = 0, int windowLength = 0)
+    {
+        resize(numCells, numGroups, windowLength);
+    }
+
+    // Clears everything. A window length of 0 keeps every value.
+    void resize(int numCells, int newNumGroups, int newWindowLength = 0)
+    {
+        numGroups = std::max(newNumGroups, 0);
+        windowLength = std::max(newWindowLength, 0);
+        numAdded.assign(numGroups > 0 ? std::max(numCells, 0) : 0, 0);
+        sums.assign(numAdded.size() * numGroups, T());
+    }
+
+    int getNumCells() const { return int(numAdded.size()); }
+    int getNumGroups() const { return numGroups; }
+
+    size_t getMemorySize() const
+    {
+        return numAdded.size() * sizeof(uint32_t) + sums.size() * sizeof(T);
+    }
+
+    // With a window, dropped must be the value added windowLength values before x (ignored
+    // until that many have been added)
+    void addValue(int cell, const T& x, const T& dropped = T())
+    {
+        T* cellSums = &sums[size_t(cell) * numGroups];
+        uint32_t& n = numAdded[cell];
+        if (windowLength > 0 && n >= uint32_t(windowLength))
+        {
+            cellSums[(n - windowLength) % numGroups] -= dropped;
+        }
+        cellSums[n % numGroups] += x;
+        ++n;
+    }
+
+    // numGroups sums, in group order
+    const T* getGroupSums(int cell) const { return &sums[size_t(cell) * numGroups]; }
+
+    // Number of values in one of the cell's groups
+    int getGroupCount(int cell, int group) const
+    {
+        uint32_t n = numAdded[cell];
+        uint32_t first = windowLength > 0 && n > uint32_t(windowLength) ? n - windowLength : 0;
+        return int(countBelow(n, group) - countBelow(first, group));
+    }
+
+    // Number of values in the cell (all groups)
+    int getCount(int cell) const
+    {
+        uint32_t n = numAdded[cell];
+        return int(windowLength > 0 ? std::min(n, uint32_t(windowLength)) : n);
+    }
+
+private:
+    // how many of the first n values went to the group
+    uint32_t countBelow(uint32_t n, int group) const
+    {
+        return n > uint32_t(group) ? (n - group - 1) / numGroups + 1 : 0;
+    }
+
+    int numGroups;
+    int windowLength;
+    std::vector<uint32_t> numAdded; // # cells
+    std::vector<T> sums;            // # cells x # groups
+};
+
+#endif // JACKKNIFE_ACCUM_H_INCLUDED
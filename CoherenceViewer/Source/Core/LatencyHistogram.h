@@ -0,0 +1,134 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef LATENCY_HISTOGRAM_H_INCLUDED
+#define LATENCY_HISTOGRAM_H_INCLUDED
+
+/*
+
+Latency Histogram - fixed-width bins of latencies in milliseconds, with an overflow bin for
+anything past the last one. One thread adds samples (without locking or allocating) while
+others read counts and percentiles, e.g. to draw them in the GUI. Readers may see a sample
+counted in one statistic before another, which is fine for display.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram(double binWidthMs = 1, int numBins = 500)
+        : binWidth  (binWidthMs)
+        , bins      (numBins + 1) // + overflow
+        , count     (0)
+        , sumUs     (0)
+        , maxUs     (0)
+    {
+        reset();
+    }
+
+    // Not thread-safe with add(); call while nothing is being measured.
+    void reset()
+    {
+        for (auto& bin : bins)
+        {
+            bin.store(0, std::memory_order_relaxed);
+        }
+        count = 0;
+        sumUs = 0;
+        maxUs = 0;
+    }
+
+    // Writer thread only
+    void add(double latencyMs)
+    {
+        latencyMs = std::max(latencyMs, 0.0);
+        int bin = std::min(int(latencyMs / binWidth), getNumBins());
+        bins[bin].fetch_add(1, std::memory_order_relaxed);
+
+        int64_t us = int64_t(latencyMs * 1000);
+        sumUs.store(sumUs.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+        if (us > maxUs.load(std::memory_order_relaxed))
+        {
+            maxUs.store(us, std::memory_order_relaxed);
+        }
+        count.fetch_add(1, std::memory_order_release);
+    }
+
+    double getBinWidth() const { return binWidth; }
+
+    // number of regular bins (not counting overflow)
+    int getNumBins() const { return int(bins.size()) - 1; }
+
+    // bin == getNumBins() is the overflow bin
+    uint32_t getBinCount(int bin) const { return bins[bin].load(std::memory_order_relaxed); }
+
+    uint32_t getCount() const { return count.load(std::memory_order_acquire); }
+
+    double getMean() const
+    {
+        uint32_t n = getCount();
+        return n > 0 ? sumUs.load(std::memory_order_relaxed) / 1000.0 / n : 0;
+    }
+
+    double getMax() const { return maxUs.load(std::memory_order_relaxed) / 1000.0; }
+
+    // Upper edge of the bin holding the given fraction (0-1) of samples, or the max
+    // if that falls in the overflow bin.
+    double getPercentile(double fraction) const
+    {
+        uint32_t n = getCount();
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        uint64_t target = uint64_t(std::max(1.0, fraction * n + 0.5));
+        uint64_t cumulative = 0;
+        for (int bin = 0; bin < getNumBins(); ++bin)
+        {
+            cumulative += getBinCount(bin);
+            if (cumulative >= target)
+            {
+                return (bin + 1) * binWidth;
+            }
+        }
+        return getMax();
+    }
+
+private:
+    const double binWidth;
+    std::vector<std::atomic<uint32_t>> bins;
+    std::atomic<uint32_t> count;
+    std::atomic<int64_t> sumUs;
+    std::atomic<int64_t> maxUs;
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+};
+
+#endif // LATENCY_HISTOGRAM_H_INCLUDED
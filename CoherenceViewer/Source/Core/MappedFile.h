@@ -0,0 +1,63 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+/*
+
+Mapped File - a whole file mapped read-only into memory (mmap, or a file mapping on Windows),
+so that large recordings can be read without copying them.
+
+*/
+
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Returns false if the file can't be opened or mapped. An empty file has no data.
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* getData() const { return data; }
+    uint64_t getSize() const { return size; }
+
+private:
+    const uint8_t* data;
+    uint64_t size;
+
+#ifdef _WIN32
+    void* file;    // HANDLE
+    void* mapping; // HANDLE
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif // MAPPED_FILE_H_INCLUDED
@@ -0,0 +1,588 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2018 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MULTI_READER_SYNCHRONIZER_H_INCLUDED
+#define MULTI_READER_SYNCHRONIZER_H_INCLUDED
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+* MultiReaderSynchronizer is AtomicSynchronizer (see AtomicSynchronizer.h) for one writer and
+* up to a fixed number of readers, each of which gets the latest update independently of the
+* others, without copying. For N readers, N + 2 instances of the shared data are allocated
+* upfront: one being written, the latest update, and one for each reader to hold on to.
+*
+* Each slot has a count of readers using it. Pushing an update publishes the writer's slot as
+* the latest (one atomic store of the slot index together with an update number) and picks
+* any other slot no reader is using as the next one to write to. This never waits and can't
+* fail: each reader holds at most one slot, so with N + 2 slots there is always a free one.
+* A reader pulls by counting itself into the latest slot and checking that it's still the
+* latest; if the writer pushed in between, it tries again with the newer one. Since the
+* update number is part of the published value, a slot that was reused and published again
+* can't be mistaken for the one the reader saw.
+*
+* The interface follows AtomicSynchronizer/AtomicallyShared:
+*
+*  - MultiReaderShared<T> holds the data. Its constructor takes the maximum number of readers
+*    followed by the arguments for constructing each T. map() runs a function on every copy
+*    while there are no readers or writers.
+*
+*  - Write through a MultiReaderWritePtr<T> (only one can be valid at a time), and call
+*    pushUpdate() to publish what was written and move on to a fresh slot, which holds
+*    whatever was written to it before and may need clearing.
+*
+*  - Read through a MultiReaderReadPtr<T>; up to the maximum number can be valid at once (any
+*    more are invalid). Each starts at the latest update and keeps reading it until pullUpdate()
+*    moves it to the newest one. As with AtomicScopedReadPtr, it's also invalid until something
+*    has been pushed, so check isValid().
+*
+*  - Each reader has its own hasUpdate(), getVersion() (number of the update it's reading,
+*    counting from 1) and getNumSkipped() (updates pushed while it held an older one that it
+*    never saw). A reader that's created when needed, rather than kept, can remember the
+*    version it last read and check hasUpdateSince(version) on the shared object first.
+*
+*  - reset() goes back to nothing having been pushed, with no readers or writers.
+*
+*  - Using a MultiReaderSynchronizer directly, as with AtomicSynchronizer, gives indices
+*    (0 to N + 1) instead of pointers: ScopedWriteIndex, ScopedReadIndex and ScopedLockout.
+*/
+
+class MultiReaderSynchronizer
+{
+public:
+    class ScopedWriteIndex
+    {
+    public:
+        explicit ScopedWriteIndex(MultiReaderSynchronizer& o)
+            : owner(&o)
+            , valid(o.checkoutWriter())
+        {
+            if (!valid)
+            {
+                owner = nullptr;
+            }
+        }
+
+        ScopedWriteIndex(const ScopedWriteIndex&) = delete;
+        ScopedWriteIndex& operator=(const ScopedWriteIndex&) = delete;
+
+        ~ScopedWriteIndex()
+        {
+            if (valid)
+            {
+                owner->returnWriter();
+            }
+        }
+
+        // publish the current slot and move to a free one
+        void pushUpdate()
+        {
+            if (valid)
+            {
+                owner->pushWrite();
+            }
+        }
+
+        operator int() const
+        {
+            if (valid)
+            {
+                return owner->writerIndex;
+            }
+            return -1;
+        }
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+    private:
+        MultiReaderSynchronizer* owner;
+        const bool valid;
+    };
+
+
+    class ScopedReadIndex
+    {
+    public:
+        explicit ScopedReadIndex(MultiReaderSynchronizer& o)
+            : owner     (&o)
+            , valid     (o.checkoutReader())
+            , index     (-1)
+            , version   (0)
+            , numSkipped(0)
+        {
+            if (valid)
+            {
+                pullUpdate();
+            }
+            else
+            {
+                owner = nullptr;
+            }
+        }
+
+        ScopedReadIndex(const ScopedReadIndex&) = delete;
+        ScopedReadIndex& operator=(const ScopedReadIndex&) = delete;
+
+        ~ScopedReadIndex()
+        {
+            if (valid)
+            {
+                owner->releaseSlot(index);
+                owner->returnReader();
+            }
+        }
+
+        // move to the latest update, if it's newer than the one being read
+        void pullUpdate()
+        {
+            if (valid)
+            {
+                owner->acquireLatest(index, version, numSkipped);
+            }
+        }
+
+        bool hasUpdate() const
+        {
+            return valid && owner->hasUpdateSince(version);
+        }
+
+        operator int() const
+        {
+            return valid ? index : -1;
+        }
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+        // number of the update being read, counting from 1 (0 if none)
+        uint64_t getVersion() const
+        {
+            return version;
+        }
+
+        uint64_t getNumSkipped() const
+        {
+            return numSkipped;
+        }
+
+    private:
+        MultiReaderSynchronizer* owner;
+        const bool valid;
+        int index;
+        uint64_t version;
+        uint64_t numSkipped;
+    };
+
+
+    // Registers as the writer and every reader, so none can exist while it's held.
+    class ScopedLockout
+    {
+    public:
+        explicit ScopedLockout(MultiReaderSynchronizer& o)
+            : owner         (&o)
+            , hasReadLock   (o.checkoutAllReaders())
+            , hasWriteLock  (o.checkoutWriter())
+            , valid         (hasReadLock && hasWriteLock)
+        {}
+
+        ~ScopedLockout()
+        {
+            if (hasReadLock)
+            {
+                owner->returnAllReaders();
+            }
+
+            if (hasWriteLock)
+            {
+                owner->returnWriter();
+            }
+        }
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+    private:
+        MultiReaderSynchronizer* owner;
+        const bool hasReadLock;
+        const bool hasWriteLock;
+        const bool valid;
+    };
+
+
+    explicit MultiReaderSynchronizer(int maxReaders)
+        : maxReaders    (maxReaders > 0 ? maxReaders : 1)
+        , numSlots      (this->maxReaders + 2)
+        , refCounts     (new std::atomic<int>[numSlots])
+        , nWriters      (0)
+        , nReaders      (0)
+    {
+        reset();
+    }
+
+    MultiReaderSynchronizer(const MultiReaderSynchronizer&) = delete;
+    MultiReaderSynchronizer& operator=(const MultiReaderSynchronizer&) = delete;
+
+    int getMaxReaders() const
+    {
+        return maxReaders;
+    }
+
+    int getNumSlots() const
+    {
+        return numSlots;
+    }
+
+    // Back to nothing having been pushed. Returns false (and does nothing) if there are
+    // readers or writers.
+    bool reset()
+    {
+        ScopedLockout lock(*this);
+        if (!lock.isValid())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < numSlots; ++i)
+        {
+            refCounts[i] = 0;
+        }
+        latest = 0;
+        writerIndex = 0;
+        writerVersion = 0;
+        return true;
+    }
+
+    // Updates pushed since the last reset (any thread)
+    uint64_t getNumPushed() const
+    {
+        return latest.load() >> INDEX_BITS;
+    }
+
+    // Whether anything newer than the given update has been pushed (any thread)
+    bool hasUpdateSince(uint64_t version) const
+    {
+        return getNumPushed() != version;
+    }
+
+private:
+    // latest packs the update number above the slot index
+    static const int INDEX_BITS = 16;
+    static const uint64_t INDEX_MASK = (uint64_t(1) << INDEX_BITS) - 1;
+
+    bool checkoutWriter()
+    {
+        int currWriters = 0;
+        return nWriters.compare_exchange_strong(currWriters, 1, std::memory_order_relaxed);
+    }
+
+    void returnWriter()
+    {
+        nWriters = 0;
+    }
+
+    bool checkoutReader()
+    {
+        int currReaders = nReaders.load(std::memory_order_relaxed);
+        while (currReaders < maxReaders)
+        {
+            if (nReaders.compare_exchange_weak(currReaders, currReaders + 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void returnReader()
+    {
+        nReaders.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // takes every reader place, so no reader can check out
+    bool checkoutAllReaders()
+    {
+        int currReaders = 0;
+        return nReaders.compare_exchange_strong(currReaders, maxReaders, std::memory_order_relaxed);
+    }
+
+    void returnAllReaders()
+    {
+        nReaders = 0;
+    }
+
+    // should only be called by the writer
+    void pushWrite()
+    {
+        // The reference counts and latest use sequentially consistent operations: either a
+        // reader's increment comes first and the search below skips its slot, or this store
+        // comes first and the reader sees that its slot isn't the latest any more.
+        latest = (++writerVersion << INDEX_BITS) | uint64_t(writerIndex);
+
+        // any slot but the one just published that no reader is using
+        for (int i = 1; i < numSlots; ++i)
+        {
+            int candidate = (writerIndex + i) % numSlots;
+            if (refCounts[candidate] == 0)
+            {
+                writerIndex = candidate;
+                return;
+            }
+        }
+
+        // each reader holds at most one slot, so this can't happen
+        assert(false);
+    }
+
+    // should only be called by a reader, with its current slot (or -1) and version
+    void acquireLatest(int& index, uint64_t& version, uint64_t& numSkipped)
+    {
+        uint64_t current = latest;
+        if (current == 0 || (current >> INDEX_BITS) == version)
+        {
+            return; // nothing new
+        }
+
+        // let go of the old slot first, so a reader never holds two
+        releaseSlot(index);
+        index = -1;
+
+        while (true)
+        {
+            int candidate = int(current & INDEX_MASK);
+            ++refCounts[candidate];
+            uint64_t check = latest;
+            if (check == current)
+            {
+                break;
+            }
+            --refCounts[candidate];
+            current = check;
+        }
+
+        uint64_t newVersion = current >> INDEX_BITS;
+        if (version != 0)
+        {
+            numSkipped += newVersion - version - 1;
+        }
+        index = int(current & INDEX_MASK);
+        version = newVersion;
+    }
+
+    void releaseSlot(int index)
+    {
+        if (index != -1)
+        {
+            --refCounts[index];
+        }
+    }
+
+    const int maxReaders;
+    const int numSlots;
+
+    std::unique_ptr<std::atomic<int>[]> refCounts; // readers using each slot
+    std::atomic<uint64_t> latest; // (update number << INDEX_BITS) | slot, or 0 before the first push
+
+    int writerIndex;        // slot the writer may currently be writing to
+    uint64_t writerVersion; // updates pushed (writer only)
+
+    std::atomic<int> nWriters;
+    std::atomic<int> nReaders;
+};
+
+
+// class to actually hold data controlled by a MultiReaderSynchronizer
+template<typename T>
+class MultiReaderShared
+{
+public:
+    template<typename... Args>
+    MultiReaderShared(int maxReaders, Args&&... args)
+        : sync(maxReaders)
+    {
+        for (int i = 0; i < sync.getNumSlots(); ++i)
+        {
+            data.emplace_back(args...);
+        }
+    }
+
+    bool reset()
+    {
+        return sync.reset();
+    }
+
+    // Call a function on each underlying data member. Requires that no readers or writers
+    // exist; returns false if this condition is unmet, true otherwise.
+    bool map(std::function<void(T&)> f)
+    {
+        MultiReaderSynchronizer::ScopedLockout lock(sync);
+        if (!lock.isValid())
+        {
+            return false;
+        }
+
+        for (T& obj : data)
+        {
+            f(obj);
+        }
+
+        return true;
+    }
+
+    int getMaxReaders() const
+    {
+        return sync.getMaxReaders();
+    }
+
+    uint64_t getNumPushed() const
+    {
+        return sync.getNumPushed();
+    }
+
+    bool hasUpdateSince(uint64_t version) const
+    {
+        return sync.hasUpdateSince(version);
+    }
+
+
+    class ScopedWritePtr
+    {
+    public:
+        ScopedWritePtr(MultiReaderShared<T>& o)
+            : owner(&o)
+            , ind(o.sync)
+            , valid(ind.isValid())
+        {}
+
+        void pushUpdate()
+        {
+            ind.pushUpdate();
+        }
+
+        T& operator*()
+        {
+            if (!valid)
+            {
+                assert(false);
+                std::abort();
+            }
+            return owner->data[ind];
+        }
+
+        T* operator->()
+        {
+            return &(operator*());
+        }
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+    private:
+        MultiReaderShared<T>* owner;
+        MultiReaderSynchronizer::ScopedWriteIndex ind;
+        const bool valid;
+    };
+
+    class ScopedReadPtr
+    {
+    public:
+        ScopedReadPtr(MultiReaderShared<T>& o)
+            : owner(&o)
+            , ind(o.sync)
+            , valid(ind != -1)
+        {}
+
+        void pullUpdate()
+        {
+            ind.pullUpdate();
+            valid = ind != -1;
+        }
+
+        bool hasUpdate() const
+        {
+            return ind.hasUpdate();
+        }
+
+        uint64_t getVersion() const
+        {
+            return ind.getVersion();
+        }
+
+        uint64_t getNumSkipped() const
+        {
+            return ind.getNumSkipped();
+        }
+
+        const T& operator*() const
+        {
+            if (!valid)
+            {
+                assert(false);
+                std::abort();
+            }
+            return owner->data[ind];
+        }
+
+        const T* operator->() const
+        {
+            return &(operator*());
+        }
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+    private:
+        MultiReaderShared<T>* owner;
+        MultiReaderSynchronizer::ScopedReadIndex ind;
+        bool valid;
+    };
+
+private:
+    std::vector<T> data;
+    MultiReaderSynchronizer sync;
+};
+
+template<typename T>
+using MultiReaderWritePtr = typename MultiReaderShared<T>::ScopedWritePtr;
+
+template<typename T>
+using MultiReaderReadPtr = typename MultiReaderShared<T>::ScopedReadPtr;
+
+#endif // MULTI_READER_SYNCHRONIZER_H_INCLUDED
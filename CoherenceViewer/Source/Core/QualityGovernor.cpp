@@ -0,0 +1,139 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "QualityGovernor.h"
+
+#include <algorithm>
+
+constexpr double QualityGovernor::RESTORE_MARGIN;
+
+QualityGovernor::QualityGovernor(double threshold)
+    : threshold     (threshold)
+    , level         (FULL_QUALITY)
+    , numChanges    (0)
+{
+    reset();
+}
+
+void QualityGovernor::reset()
+{
+    level = FULL_QUALITY;
+    numChanges = 0;
+    costRatio.fill(0.5);
+    lastRealTimeFactor = 0;
+    measureCost = false;
+    numUnderRestore = 0;
+}
+
+bool QualityGovernor::addSegment(double realTimeFactor, int segmentLevel, int64_t timestamp, Change& change)
+{
+    int current = getLevel();
+    if (segmentLevel != current)
+    {
+        return false;
+    }
+
+    if (measureCost)
+    {
+        measureCost = false;
+        if (lastRealTimeFactor > 0)
+        {
+            // a step that didn't save anything (e.g. every pair is in use) still counts as a small
+            // saving, so that the level above can be estimated
+            costRatio[current] = std::min(std::max(realTimeFactor / lastRealTimeFactor, 0.01), 0.95);
+        }
+    }
+
+    if (realTimeFactor > threshold)
+    {
+        numUnderRestore = 0;
+        if (current + 1 < NUM_LEVELS)
+        {
+            lastRealTimeFactor = realTimeFactor;
+            measureCost = true;
+            setLevel(current + 1, realTimeFactor, timestamp, change);
+            return true;
+        }
+        return false;
+    }
+
+    if (current == FULL_QUALITY)
+    {
+        return false;
+    }
+
+    double estimateAbove = realTimeFactor / costRatio[current];
+    if (estimateAbove >= threshold * RESTORE_MARGIN)
+    {
+        numUnderRestore = 0;
+        return false;
+    }
+
+    if (++numUnderRestore < RESTORE_SEGMENTS)
+    {
+        return false;
+    }
+
+    numUnderRestore = 0;
+    setLevel(current - 1, realTimeFactor, timestamp, change);
+    return true;
+}
+
+const char* QualityGovernor::getLevelName(int level)
+{
+    switch (level)
+    {
+    case FULL_QUALITY:      return "full quality";
+    case COARSE_TIMES:      return "every other time";
+    case HALF_FREQS:        return "every other time and frequency";
+    case USED_PAIRS_ONLY:   return "every other time and frequency, used pairs only";
+    default:                return "unknown";
+    }
+}
+
+CumulativeTFR::Subsample QualityGovernor::getSubsample(int level)
+{
+    CumulativeTFR::Subsample subsample;
+    if (level >= COARSE_TIMES)
+    {
+        subsample.timeStride = 2;
+    }
+    if (level >= HALF_FREQS)
+    {
+        subsample.freqStride = 2;
+    }
+    return subsample;
+}
+
+// > Private Methods
+
+void QualityGovernor::setLevel(int newLevel, double realTimeFactor, int64_t timestamp, Change& change)
+{
+    change.fromLevel = getLevel();
+    change.toLevel = newLevel;
+    change.realTimeFactor = realTimeFactor;
+    change.timestamp = timestamp;
+
+    level.store(newLevel, std::memory_order_release);
+    numChanges.fetch_add(1, std::memory_order_relaxed);
+}
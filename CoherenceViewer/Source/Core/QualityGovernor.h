@@ -0,0 +1,112 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef QUALITY_GOVERNOR_H_INCLUDED
+#define QUALITY_GOVERNOR_H_INCLUDED
+
+/*
+
+Quality Governor - lowers the resolution of the coherence calculation while it can't keep up
+with the data, and raises it again once there's headroom. No JUCE dependency.
+
+Each segment's real-time factor (compute time / segment duration) is fed in from the last
+stage of the pipeline, along with the level it was computed at. A segment above the threshold
+steps down one level; the levels cut cost in a fixed order, each keeping the reductions of the
+ones before. Stepping back up waits until several segments in a row would have been comfortably
+under the threshold at the level above, estimated from how much the last step down saved, so
+that the level doesn't bounce between two settings.
+
+addSegment() must be called from one thread; getLevel() and setThreshold() from any.
+
+*/
+
+#include "CumulativeTFR.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class QualityGovernor
+{
+public:
+    enum Level
+    {
+        FULL_QUALITY,
+        COARSE_TIMES,       // every other time of interest (twice the step length)
+        HALF_FREQS,         // and every other frequency, the rest holding their last values
+        USED_PAIRS_ONLY,    // and only the combinations that are displayed or feed an output
+        NUM_LEVELS
+    };
+
+    struct Change
+    {
+        int fromLevel;
+        int toLevel;
+        double realTimeFactor;  // of the segment that caused it
+        int64_t timestamp;      // of that segment's last sample
+    };
+
+    explicit QualityGovernor(double threshold = 0.8);
+
+    // Back to full quality; not while addSegment() may be called.
+    void reset();
+
+    void setThreshold(double realTimeFactor) { threshold = realTimeFactor; }
+    double getThreshold() const { return threshold; }
+
+    int getLevel() const { return level.load(std::memory_order_acquire); }
+    uint64_t getNumChanges() const { return numChanges.load(std::memory_order_relaxed); }
+
+    // Adds the real-time factor of a segment computed at segmentLevel. Returns true and fills
+    // change if the level changes. Segments computed before the last change are ignored.
+    bool addSegment(double realTimeFactor, int segmentLevel, int64_t timestamp, Change& change);
+
+    static const char* getLevelName(int level);
+
+    // Which times and frequencies the TFR updates at a level
+    static CumulativeTFR::Subsample getSubsample(int level);
+
+    // consecutive segments needed before stepping back up
+    static const int RESTORE_SEGMENTS = 5;
+    // fraction of the threshold the level above has to be estimated to stay under
+    static constexpr double RESTORE_MARGIN = 0.75;
+
+private:
+    void setLevel(int newLevel, double realTimeFactor, int64_t timestamp, Change& change);
+
+    std::atomic<double> threshold;
+    std::atomic<int> level;
+    std::atomic<uint64_t> numChanges;
+
+    // real-time factor at each level relative to the one above, measured on the first segment
+    // after stepping down (assumed to halve until then)
+    std::array<double, NUM_LEVELS> costRatio;
+    double lastRealTimeFactor;  // the segment that caused the last step down
+    bool measureCost;           // next segment at the current level measures its cost ratio
+    int numUnderRestore;
+
+    QualityGovernor(const QualityGovernor&) = delete;
+    QualityGovernor& operator=(const QualityGovernor&) = delete;
+};
+
+#endif // QUALITY_GOVERNOR_H_INCLUDED
@@ -0,0 +1,161 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SAMPLE_RING_H_INCLUDED
+#define SAMPLE_RING_H_INCLUDED
+
+/*
+
+Sample Ring - the last N values of a stream (samples, or rows of a history), for when speed
+matters more than CircularArray's flexibility (inserting and removing in the middle).
+
+Storage is rounded up to a power of 2 so that indices wrap with a mask instead of a modulo,
+and values are copied in and out in at most two memcpys. getSpan() gives the two contiguous
+pieces of any range, to read in place without copying. Index 0 is the oldest of the last N
+values; until N have been enqueued, the oldest ones are zeros.
+
+Not thread-safe; only for trivially copyable types.
+
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+template<typename T>
+class SampleRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SampleRing copies values with memcpy");
+
+public:
+    // A range as (up to) two contiguous pieces, in order; valid until the next enqueue
+    struct Span
+    {
+        const T* first;
+        int nFirst;
+        const T* second;
+        int nSecond;    // 0 unless the range wraps
+
+        int size() const { return nFirst + nSecond; }
+    };
+
+    explicit SampleRing(int length = 0)
+    {
+        resize(length);
+    }
+
+    // Changes the length, clearing all values
+    void resize(int newLength)
+    {
+        length = std::max(newLength, 0);
+        size_t capacity = 1;
+        while (capacity < size_t(length))
+        {
+            capacity <<= 1;
+        }
+        data.assign(capacity, T());
+        mask = capacity - 1;
+        numEnqueued = 0;
+    }
+
+    // Sets every value to zero, keeping the length
+    void reset()
+    {
+        std::fill(data.begin(), data.end(), T());
+        numEnqueued = 0;
+    }
+
+    int size() const { return length; }
+    int getCapacity() const { return int(data.size()); }
+
+    // Values enqueued since the last resize or reset
+    uint64_t getNumEnqueued() const { return numEnqueued; }
+
+    void enqueue(T value)
+    {
+        data[numEnqueued & mask] = value;
+        ++numEnqueued;
+    }
+
+    // Adds n values; if n is more than the length, only the last length of them are kept
+    void enqueueArray(const T* values, int n)
+    {
+        if (length == 0 || n <= 0)
+        {
+            return;
+        }
+
+        int nToSkip = std::max(0, n - length);
+        values += nToSkip;
+        numEnqueued += nToSkip;
+        n -= nToSkip;
+
+        size_t first = size_t(numEnqueued & mask);
+        size_t nFirst = std::min(size_t(n), data.size() - first);
+        std::memcpy(&data[first], values, nFirst * sizeof(T));
+        std::memcpy(data.data(), values + nFirst, (n - nFirst) * sizeof(T));
+        numEnqueued += n;
+    }
+
+    T operator[](int index) const
+    {
+        assert(index >= 0 && index < length);
+        return data[getPosition(index)];
+    }
+
+    // numberOfElements values starting at index, which must all be within the length
+    Span getSpan(int index, int numberOfElements) const
+    {
+        assert(index >= 0 && numberOfElements >= 0 && index + numberOfElements <= length);
+        size_t first = getPosition(index);
+        int nFirst = int(std::min(size_t(numberOfElements), data.size() - first));
+        Span span = { data.data() + first, nFirst, data.data(), numberOfElements - nFirst };
+        return span;
+    }
+
+    // Copies numberOfElements values starting at index into a contiguous destination
+    void copyOut(int index, int numberOfElements, T* dest) const
+    {
+        Span span = getSpan(index, numberOfElements);
+        std::memcpy(dest, span.first, span.nFirst * sizeof(T));
+        std::memcpy(dest + span.nFirst, span.second, span.nSecond * sizeof(T));
+    }
+
+private:
+    size_t getPosition(int index) const
+    {
+        // (unsigned arithmetic wraps by a multiple of the capacity, so this also works
+        // before length values have been enqueued)
+        return size_t((numEnqueued - uint64_t(length) + uint64_t(index)) & mask);
+    }
+
+    std::vector<T> data;
+    uint64_t mask;
+    uint64_t numEnqueued;
+    int length;
+};
+
+#endif // SAMPLE_RING_H_INCLUDED
@@ -0,0 +1,170 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Segmenter.h"
+
+#include <algorithm>
+#include <cmath>
+
+Segmenter::Segmenter()
+{
+    reset(0, 0, 0, 0);
+}
+
+void Segmenter::reset(int nc, int seg, int wait, double artifactThreshold)
+{
+    nChans = std::max(nc, 0);
+    segSamples = std::max(seg, 0);
+    waitSamples = std::max(wait, 0);
+    threshold = artifactThreshold;
+
+    nAdded = 0;
+    waitRemaining = 0;
+    nConsumed = 0;
+
+    lastSample.assign(nChans, 0.0f);
+    hasLastSample = false;
+    buffers.assign(nChans, nullptr);
+
+    numSegments = 0;
+    numArtifacts = 0;
+    numDiscardedSamples = 0;
+}
+
+void Segmenter::addBlock(const float* const* data, int nSamples, int64_t firstTimestamp, SegmentSink& sink)
+{
+    if (nChans == 0 || segSamples == 0 || nSamples <= 0)
+    {
+        return;
+    }
+
+    updateBuffers(sink);
+
+    int pos = 0;
+    while (pos < nSamples)
+    {
+        if (waitRemaining > 0)
+        {
+            // let the signals settle after an artifact, restarting the wait if there's another
+            int end = pos + std::min(waitRemaining, nSamples - pos);
+            int artifact = findArtifact(data, pos, end);
+            if (artifact < end)
+            {
+                ++numArtifacts;
+                waitRemaining = waitSamples;
+                pos = artifact + 1;
+            }
+            else
+            {
+                waitRemaining -= end - pos;
+                pos = end;
+            }
+            continue;
+        }
+
+        int end = pos + std::min(segSamples - nAdded, nSamples - pos);
+        int artifact = findArtifact(data, pos, end);
+
+        for (int chan = 0; chan < nChans; ++chan)
+        {
+            FFTArray* buffer = buffers[chan];
+            if (buffer != nullptr)
+            {
+                for (int n = pos; n < artifact; ++n)
+                {
+                    buffer->set(nAdded + n - pos, double(data[chan][n]));
+                }
+            }
+        }
+        nAdded += artifact - pos;
+
+        if (artifact < end)
+        {
+            // Large change. Most likely an artifact. Discard the segment and wait.
+            ++numArtifacts;
+            numDiscardedSamples += nAdded + 1;
+            nAdded = 0;
+            waitRemaining = waitSamples;
+            pos = artifact + 1;
+            continue;
+        }
+
+        pos = end;
+        if (nAdded == segSamples)
+        {
+            sink.segmentComplete(nConsumed + end - segSamples, firstTimestamp + end - 1);
+            ++numSegments;
+            nAdded = 0;
+            updateBuffers(sink);
+        }
+    }
+
+    nConsumed += nSamples;
+}
+
+double Segmenter::getNumDiscarded() const
+{
+    return segSamples > 0 ? double(numDiscardedSamples) / segSamples : 0;
+}
+
+int Segmenter::findArtifact(const float* const* data, int start, int end)
+{
+    if (start >= end)
+    {
+        return end;
+    }
+
+    int stop = end;
+    for (int chan = 0; chan < nChans; ++chan)
+    {
+        const float* x = data[chan];
+        float prev = hasLastSample ? lastSample[chan] : x[start];
+        for (int n = start; n < stop; ++n)
+        {
+            if (std::abs(x[n] - prev) > threshold)
+            {
+                stop = n;
+                break;
+            }
+            prev = x[n];
+        }
+    }
+
+    // the artifact sample itself is the reference for the next one
+    int last = std::min(stop, end - 1);
+    for (int chan = 0; chan < nChans; ++chan)
+    {
+        lastSample[chan] = data[chan][last];
+    }
+    hasLastSample = true;
+
+    return stop;
+}
+
+void Segmenter::updateBuffers(SegmentSink& sink)
+{
+    for (int chan = 0; chan < nChans; ++chan)
+    {
+        buffers[chan] = sink.getSegmentBuffer(chan);
+    }
+}
@@ -0,0 +1,104 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SEGMENTER_H_INCLUDED
+#define SEGMENTER_H_INCLUDED
+
+/*
+
+Segmenter - cuts continuous multichannel data into segments for the TFR, dropping segments
+with artifacts. Used by CoherenceNode on incoming buffers and by the offline tools on
+recorded data, so both see exactly the same segments.
+
+Samples are copied into the sink's buffers until a segment is full. If any channel jumps by
+more than the artifact threshold from one sample to the next, the partial segment is
+discarded and nothing is collected until the data has stayed free of artifacts for the wait
+period. Segments don't depend on how the data is split into blocks.
+
+*/
+
+#include "FFTArray.h"
+
+#include <cstdint>
+#include <vector>
+
+class SegmentSink
+{
+public:
+    virtual ~SegmentSink() {}
+
+    // Buffer (at least segment length) to write the given channel's samples to, or nullptr to
+    // only keep track of where segments are. Asked for at the start of each block and after
+    // each completed segment, and must hold the samples written so far.
+    virtual FFTArray* getSegmentBuffer(int chan) = 0;
+
+    // Called when a segment is full. startSample counts samples since the segmenter was reset.
+    virtual void segmentComplete(int64_t startSample, int64_t lastTimestamp) = 0;
+};
+
+class Segmenter
+{
+public:
+    Segmenter();
+
+    // Clears all state, including the counts.
+    void reset(int nChans, int segSamples, int waitSamples, double artifactThreshold);
+
+    void setArtifactThreshold(double artifactThreshold) { threshold = artifactThreshold; }
+
+    // Adds a block of nSamples samples on each channel; data[chan] is the channel's block.
+    // firstTimestamp is the timestamp of the first sample.
+    void addBlock(const float* const* data, int nSamples, int64_t firstTimestamp, SegmentSink& sink);
+
+    int64_t getNumSegments() const { return numSegments; }
+    int64_t getNumArtifacts() const { return numArtifacts; }
+
+    // Samples thrown away from partial segments, in units of segments
+    double getNumDiscarded() const;
+
+private:
+    // First sample in [start, end) where any channel jumps from the previous sample, or end.
+    // Updates lastSample up to (and including) that sample.
+    int findArtifact(const float* const* data, int start, int end);
+
+    void updateBuffers(SegmentSink& sink);
+
+    int nChans;
+    int segSamples;
+    int waitSamples;
+    double threshold;
+
+    int nAdded;         // samples in the current segment
+    int waitRemaining;  // samples left to wait after an artifact
+    int64_t nConsumed;  // samples since reset
+
+    std::vector<float> lastSample;
+    bool hasLastSample;
+    std::vector<FFTArray*> buffers;
+
+    int64_t numSegments;
+    int64_t numArtifacts;
+    int64_t numDiscardedSamples;
+};
+
+#endif // SEGMENTER_H_INCLUDED
@@ -0,0 +1,146 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SLIDING_WINDOW_ACCUM_H_INCLUDED
+#define SLIDING_WINDOW_ACCUM_H_INCLUDED
+
+/*
+
+Sliding Window Accumulator - the exact mean of the last N values added to each of a set of
+cells (e.g. every channel x frequency x time of a TFR), for a boxcar average over the last N
+segments. No JUCE dependency.
+
+Each cell keeps a running sum: a new value is added and the one it pushes out of the window is
+subtracted. Values are stored in single precision (Stored) to halve the memory, which is N
+times that of a plain running average; the sum adds and subtracts exactly the stored values,
+so rounding in the stored values doesn't accumulate. What's left (double rounding in the sum)
+is bounded by re-summing each cell's window from scratch every RESUM_WINDOWS windows' worth
+of values.
+
+All cells' windows are in one block, each cell's N values together, so an add touches one
+small contiguous range and there is no per-cell allocation.
+
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template<typename T, typename Stored>
+class SlidingWindowAccum
+{
+public:
+    static const int RESUM_WINDOWS = 16;
+
+    SlidingWindowAccum(int numCells = 0, int windowLength = 1)
+    {
+        resize(numCells, windowLength);
+    }
+
+    // Clears everything
+    void resize(int numCells, int newWindowLength)
+    {
+        windowLength = std::max(newWindowLength, 1);
+        cells.assign(std::max(numCells, 0), Cell());
+        values.assign(cells.size() * windowLength, Stored());
+    }
+
+    int getNumCells() const { return int(cells.size()); }
+    int getWindowLength() const { return windowLength; }
+
+    size_t getMemorySize() const
+    {
+        return cells.size() * sizeof(Cell) + values.size() * sizeof(Stored);
+    }
+
+    void addValue(int cell, const T& x)
+    {
+        Cell& c = cells[cell];
+        Stored* window = &values[size_t(cell) * windowLength];
+
+        Stored stored = Stored(x);
+        if (c.count == uint32_t(windowLength))
+        {
+            c.sum -= T(window[c.next]);
+        }
+        else
+        {
+            ++c.count;
+        }
+        window[c.next] = stored;
+        c.sum += T(stored);
+        c.next = c.next + 1 < uint32_t(windowLength) ? c.next + 1 : 0;
+
+        if (++c.sinceResum >= uint32_t(RESUM_WINDOWS) * windowLength)
+        {
+            c.sum = T();
+            for (uint32_t i = 0; i < c.count; ++i)
+            {
+                c.sum += T(window[i]);
+            }
+            c.sinceResum = 0;
+        }
+    }
+
+    T getAverage(int cell) const
+    {
+        const Cell& c = cells[cell];
+        return c.count > 0 ? c.sum / double(c.count) : T();
+    }
+
+    // Values currently in the cell's window (less than the window length until it fills)
+    int getCount(int cell) const { return int(cells[cell].count); }
+
+    // The value the next addValue will push out of the cell's window (T() until it's full)
+    T getOldest(int cell) const
+    {
+        const Cell& c = cells[cell];
+        return c.count == uint32_t(windowLength) ? T(values[size_t(cell) * windowLength + c.next]) : T();
+    }
+
+    // x as the window stores it
+    static T toStored(const T& x) { return T(Stored(x)); }
+
+private:
+    struct Cell
+    {
+        Cell()
+            : sum       ()
+            , next      (0)
+            , count     (0)
+            , sinceResum(0)
+        {}
+
+        T sum;
+        uint32_t next;          // where the next value goes (the oldest, once full)
+        uint32_t count;
+        uint32_t sinceResum;    // values added since the sum was last recomputed
+    };
+
+    int windowLength;
+    std::vector<Cell> cells;
+    std::vector<Stored> values; // # cells x window length
+};
+
+#endif // SLIDING_WINDOW_ACCUM_H_INCLUDED
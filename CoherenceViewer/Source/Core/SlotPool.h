@@ -0,0 +1,160 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SLOT_POOL_H_INCLUDED
+#define SLOT_POOL_H_INCLUDED
+
+/*
+
+Slot Pool - a fixed set of preallocated objects that threads take and give back by index,
+without locks or allocation, so that large buffers can be handed from one thread to another
+by passing an int (e.g. through an atomic or a SlotQueue<int>) instead of being copied.
+
+Free slots are kept on a lock-free stack. The head carries a count of changes along with the
+top index, so a thread that was interrupted between reading the head and replacing it can't
+be fooled by the same index having been taken and given back in the meantime. acquire() never
+waits: it returns -1 if every slot is in use.
+
+*/
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+template<typename T>
+class SlotPool
+{
+public:
+    explicit SlotPool(int size = 0)
+    {
+        resize(size);
+    }
+
+    // The following must only be called while no slot is in use by another thread.
+
+    // Contents of existing slots are kept; all slots become free.
+    void resize(int size)
+    {
+        slots.resize(size > 0 ? size : 0);
+        next.reset(new std::atomic<int>[slots.size()]);
+        releaseAll();
+    }
+
+    void releaseAll()
+    {
+        int size = getSize();
+        for (int i = 0; i < size; ++i)
+        {
+            next[i] = i + 1 < size ? i + 1 : -1;
+        }
+        head = makeHead(0, size > 0 ? 0 : -1);
+        numFree = size;
+    }
+
+    // Call f(T&) on every slot, e.g. to size them
+    template<typename F>
+    void map(F f)
+    {
+        for (T& slot : slots)
+        {
+            f(slot);
+        }
+    }
+
+    // Any thread
+
+    int getSize() const { return int(slots.size()); }
+
+    // May be out of date as soon as it's returned
+    int getNumFree() const { return numFree.load(std::memory_order_relaxed); }
+
+    // Index of a free slot, which now belongs to the caller, or -1 if there are none
+    int acquire()
+    {
+        uint64_t oldHead = head.load(std::memory_order_acquire);
+        while (true)
+        {
+            int index = getIndex(oldHead);
+            if (index == -1)
+            {
+                return -1;
+            }
+            uint64_t newHead = makeHead(getTag(oldHead) + 1, next[index].load(std::memory_order_relaxed));
+            if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                numFree.fetch_sub(1, std::memory_order_relaxed);
+                return index;
+            }
+        }
+    }
+
+    // Gives back a slot from acquire()
+    void release(int index)
+    {
+        assert(index >= 0 && index < getSize());
+        uint64_t oldHead = head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            next[index].store(getIndex(oldHead), std::memory_order_relaxed);
+            uint64_t newHead = makeHead(getTag(oldHead) + 1, index);
+            if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_release, std::memory_order_relaxed))
+            {
+                numFree.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // Only by the thread that acquired the slot (or anyone, while the pool isn't in use)
+    T& operator[](int index) { return slots[index]; }
+    const T& operator[](int index) const { return slots[index]; }
+
+private:
+    // head packs a change count above (top index + 1), so that 0 is an empty stack
+    static uint64_t makeHead(uint32_t tag, int index)
+    {
+        return (uint64_t(tag) << 32) | uint32_t(index + 1);
+    }
+
+    static uint32_t getTag(uint64_t h)
+    {
+        return uint32_t(h >> 32);
+    }
+
+    static int getIndex(uint64_t h)
+    {
+        return int(uint32_t(h)) - 1;
+    }
+
+    std::vector<T> slots;
+    std::unique_ptr<std::atomic<int>[]> next; // free slot below each free slot, or -1
+    std::atomic<uint64_t> head;
+    std::atomic<int> numFree;
+
+    SlotPool(const SlotPool&) = delete;
+    SlotPool& operator=(const SlotPool&) = delete;
+};
+
+#endif // SLOT_POOL_H_INCLUDED
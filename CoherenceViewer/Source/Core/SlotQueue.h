@@ -0,0 +1,135 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SLOT_QUEUE_H_INCLUDED
+#define SLOT_QUEUE_H_INCLUDED
+
+/*
+
+Slot Queue - a bounded FIFO of preallocated objects between one writer thread and one
+reader thread, without locks or allocation.
+
+Unlike AtomicallyShared, which always hands the reader the latest update and lets older ones
+be overwritten, every slot that is written is read, in order. The writer fills the slot from
+getWriteSlot() in place and releases it with finishWrite(); the reader does the same with
+getReadSlot() and finishRead(). When the queue is full (or empty), getWriteSlot() (or
+getReadSlot()) returns nullptr and it's up to the caller to wait, retry or give up.
+
+*/
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+template<typename T>
+class SlotQueue
+{
+public:
+    explicit SlotQueue(int capacity = 0)
+        : slots     (capacity > 0 ? capacity : 0)
+        , writeCount(0)
+        , readCount (0)
+    {}
+
+    // The following must only be called while there is no reader or writer.
+
+    void resize(int capacity)
+    {
+        slots.resize(capacity > 0 ? capacity : 0);
+        clear();
+    }
+
+    // Discards everything queued (slot contents are left as they are)
+    void clear()
+    {
+        writeCount = 0;
+        readCount = 0;
+    }
+
+    // Call f(T&) on every slot, e.g. to size them
+    template<typename F>
+    void map(F f)
+    {
+        for (T& slot : slots)
+        {
+            f(slot);
+        }
+    }
+
+    // Any thread
+
+    int getCapacity() const { return int(slots.size()); }
+
+    // Number of slots written and not yet read
+    int getNumReady() const
+    {
+        return int(writeCount.load(std::memory_order_acquire) - readCount.load(std::memory_order_acquire));
+    }
+
+    // Writer
+
+    T* getWriteSlot()
+    {
+        uint64_t written = writeCount.load(std::memory_order_relaxed);
+        if (slots.empty() || written - readCount.load(std::memory_order_acquire) >= slots.size())
+        {
+            return nullptr;
+        }
+        return &slots[written % slots.size()];
+    }
+
+    void finishWrite()
+    {
+        assert(getNumReady() < getCapacity());
+        writeCount.fetch_add(1, std::memory_order_release);
+    }
+
+    // Reader
+
+    T* getReadSlot()
+    {
+        uint64_t read = readCount.load(std::memory_order_relaxed);
+        if (writeCount.load(std::memory_order_acquire) == read)
+        {
+            return nullptr;
+        }
+        return &slots[read % slots.size()];
+    }
+
+    void finishRead()
+    {
+        assert(getNumReady() > 0);
+        readCount.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    std::vector<T> slots;
+    std::atomic<uint64_t> writeCount; // total slots written
+    std::atomic<uint64_t> readCount;  // total slots read
+
+    SlotQueue(const SlotQueue&) = delete;
+    SlotQueue& operator=(const SlotQueue&) = delete;
+};
+
+#endif // SLOT_QUEUE_H_INCLUDED
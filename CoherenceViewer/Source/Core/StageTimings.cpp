@@ -0,0 +1,175 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "StageTimings.h"
+
+#include <algorithm>
+#include <fstream>
+
+/************ TimingRing ****************/
+
+TimingRing::TimingRing()
+    : count (0)
+{
+    reset();
+}
+
+void TimingRing::add(double microseconds)
+{
+    uint64_t n = count.load(std::memory_order_relaxed);
+    values[n & (CAPACITY - 1)].store(float(microseconds), std::memory_order_relaxed);
+    count.store(n + 1, std::memory_order_release);
+}
+
+void TimingRing::reset()
+{
+    for (auto& value : values)
+    {
+        value.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_release);
+}
+
+uint64_t TimingRing::getCount() const
+{
+    return count.load(std::memory_order_acquire);
+}
+
+void TimingRing::getSnapshot(std::vector<double>& dest) const
+{
+    uint64_t n = getCount();
+    uint64_t numValid = std::min<uint64_t>(n, CAPACITY);
+
+    dest.resize(size_t(numValid));
+    for (uint64_t i = 0; i < numValid; ++i)
+    {
+        uint64_t index = n - numValid + i;
+        dest[size_t(i)] = values[index & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    }
+}
+
+/************ TimingStats ****************/
+
+TimingStats TimingStats::fromRing(const TimingRing& ring)
+{
+    TimingStats stats;
+    stats.count = ring.getCount();
+
+    std::vector<double> durations;
+    ring.getSnapshot(durations);
+    stats.numSamples = int(durations.size());
+    if (durations.empty())
+    {
+        return stats;
+    }
+
+    std::sort(durations.begin(), durations.end());
+
+    double sum = 0;
+    for (double d : durations)
+    {
+        sum += d;
+    }
+
+    // nearest rank, converted to ms
+    auto percentile = [&](double fraction)
+    {
+        size_t rank = size_t(std::max(1.0, fraction * durations.size() + 0.5));
+        return durations[std::min(rank, durations.size()) - 1] / 1000;
+    };
+
+    stats.mean = sum / durations.size() / 1000;
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = durations.back() / 1000;
+    return stats;
+}
+
+/************ StageTimings ****************/
+
+const char* StageTimings::getStageName(int stage)
+{
+    switch (stage)
+    {
+    case INGEST:            return "Ingest";
+    case FFT:               return "FFT";
+    case WAVELET_MULTIPLY:  return "Wavelet multiply";
+    case IFFT:              return "IFFT";
+    case CROSS_SPECTRA:     return "Cross-spectra";
+    case PUBLISH:           return "Publish";
+    case SEGMENT_TOTAL:     return "Segment total";
+    case END_TO_END:        return "End to end";
+    case RECORD:            return "Record";
+    default:                return "";
+    }
+}
+
+void StageTimings::reset()
+{
+    for (auto& ring : rings)
+    {
+        ring.reset();
+    }
+}
+
+double StageTimings::getRealTimeFactor(double segmentComputeMs, double segmentSeconds)
+{
+    return segmentSeconds > 0 ? segmentComputeMs / 1000 / segmentSeconds : 0;
+}
+
+bool StageTimings::writeCsv(const std::string& path, double segmentSeconds) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    out << "stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    for (int stage = 0; stage < NUM_STAGES; ++stage)
+    {
+        TimingStats stats = TimingStats::fromRing(rings[stage]);
+        out << getStageName(stage) << "," << stats.count << "," << stats.mean << "," << stats.p50 << ","
+            << stats.p95 << "," << stats.p99 << "," << stats.max << "\n";
+    }
+
+    TimingStats segmentStats = TimingStats::fromRing(rings[SEGMENT_TOTAL]);
+    out << "Real-time factor (p50 / p95)," << segmentStats.count << ",,"
+        << getRealTimeFactor(segmentStats.p50, segmentSeconds) << ","
+        << getRealTimeFactor(segmentStats.p95, segmentSeconds) << ",,\n";
+
+    out << "\nstage,index,duration_ms\n";
+    std::vector<double> durations;
+    for (int stage = 0; stage < NUM_STAGES; ++stage)
+    {
+        rings[stage].getSnapshot(durations);
+        uint64_t firstIndex = rings[stage].getCount() - durations.size();
+        for (size_t i = 0; i < durations.size(); ++i)
+        {
+            out << getStageName(stage) << "," << firstIndex + i << "," << durations[i] / 1000 << "\n";
+        }
+    }
+
+    return bool(out);
+}
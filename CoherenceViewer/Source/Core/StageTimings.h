@@ -0,0 +1,154 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef STAGE_TIMINGS_H_INCLUDED
+#define STAGE_TIMINGS_H_INCLUDED
+
+/*
+
+Stage Timings - how long each stage of the coherence pipeline takes, for finding out where
+time goes and whether the calculation keeps up with the data. No JUCE dependency.
+
+Each stage keeps its most recent durations in a TimingRing. A ring has exactly one writer
+(the thread that runs that stage) which never locks or allocates; any other thread can take
+a snapshot and compute percentiles from it. A snapshot taken while the writer wraps around
+may mix in a newer value, which doesn't matter for statistics.
+
+*/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TimingRing
+{
+public:
+    static const int CAPACITY = 1024; // power of 2
+
+    TimingRing();
+
+    // Writer thread only
+    void add(double microseconds);
+
+    // Not thread-safe with add(); call while the stage isn't running.
+    void reset();
+
+    // total number of durations added since reset (may exceed CAPACITY)
+    uint64_t getCount() const;
+
+    // Copies the most recent durations (up to CAPACITY), oldest first, in microseconds
+    void getSnapshot(std::vector<double>& dest) const;
+
+private:
+    std::array<std::atomic<float>, CAPACITY> values;
+    std::atomic<uint64_t> count;
+
+    TimingRing(const TimingRing&) = delete;
+    TimingRing& operator=(const TimingRing&) = delete;
+};
+
+// Percentiles etc. of a snapshot, in milliseconds
+struct TimingStats
+{
+    uint64_t count = 0; // total, not just in the snapshot
+    int numSamples = 0; // in the snapshot
+    double mean = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+
+    static TimingStats fromRing(const TimingRing& ring);
+};
+
+class StageTimings
+{
+public:
+    enum Stage
+    {
+        INGEST,             // copying one input buffer into the segment (processing thread)
+        FFT,                // forward FFT of each channel's segment (transform stage)
+        WAVELET_MULTIPLY,   // spectrum x wavelet, for all frequencies
+        IFFT,               // inverse FFTs and sampling the times of interest
+        CROSS_SPECTRA,      // running averages, cross-spectra and coherence (accumulate stage)
+        PUBLISH,            // band outputs, trigger, recorder hand-off and display update (publish stage)
+        SEGMENT_TOTAL,      // FFT through PUBLISH for one segment, not counting waits between stages
+        END_TO_END,         // last sample of a segment arriving to its coherence being published
+        RECORD,             // writing queued updates to disk (recorder thread)
+        NUM_STAGES
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static Clock::time_point now() { return Clock::now(); }
+
+    static double elapsedUs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    static const char* getStageName(int stage);
+
+    TimingRing& operator[](int stage) { return rings[stage]; }
+    const TimingRing& operator[](int stage) const { return rings[stage]; }
+
+    void reset();
+
+    // Real-time factor: segment compute time / segment duration. Below 1, the calculation
+    // keeps up even without overlapping segments; above 1, it depends on the slowest stage.
+    static double getRealTimeFactor(double segmentComputeMs, double segmentSeconds);
+
+    // Writes every duration currently held as stage,index,duration_ms rows, preceded by
+    // summary rows (stage,count,mean,p50,p95,p99,max) under a separate header line.
+    bool writeCsv(const std::string& path, double segmentSeconds) const;
+
+private:
+    std::array<TimingRing, NUM_STAGES> rings;
+};
+
+// Adds the time from construction to destruction to a ring
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(TimingRing& r)
+        : ring  (r)
+        , start (StageTimings::now())
+    {}
+
+    ~ScopedStageTimer()
+    {
+        ring.add(StageTimings::elapsedUs(start, StageTimings::now()));
+    }
+
+private:
+    TimingRing& ring;
+    const StageTimings::Clock::time_point start;
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+};
+
+#endif // STAGE_TIMINGS_H_INCLUDED
@@ -0,0 +1,185 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SurrogateCoherence.h"
+
+#include <algorithm>
+#include <cmath>
+
+SurrogateCoherence::SurrogateCoherence()
+{
+    resize(0, 0, 0, 0, 0);
+}
+
+void SurrogateCoherence::resize(int nGroup1Chans, int nGroup2Chans, int newNFreqs, int newNTimes,
+    int newStoreSize)
+{
+    nGroup1 = std::max(nGroup1Chans, 0);
+    nGroup2 = std::max(nGroup2Chans, 0);
+    nChans = nGroup1 + nGroup2;
+    nFreqs = std::max(newNFreqs, 0);
+    nTimes = std::max(newNTimes, 0);
+    spectrumSize = nFreqs * nTimes;
+    storeSize = std::max(newStoreSize, 0);
+
+    store.assign(size_t(storeSize) * nChans * spectrumSize, std::complex<float>());
+    nStored = 0;
+    nextSegment = 0;
+
+    nRoundSegments = 0;
+    powerSums.assign(size_t(nChans) * spectrumSize, 0.0);
+    surrogates.assign(size_t(std::max(storeSize - 1, 0)) * nGroup1 * nGroup2 * nFreqs, 0.0);
+    sorted.reserve(std::max(storeSize - 1, 0));
+}
+
+void SurrogateCoherence::addSegment(const std::vector<std::vector<std::complex<double>>>& spectra)
+{
+    if (storeSize == 0)
+    {
+        return;
+    }
+
+    for (int chan = 0; chan < nChans; ++chan)
+    {
+        const std::complex<double>* src = spectra[chan].data();
+        std::complex<float>* dest = &store[(size_t(nextSegment) * nChans + chan) * spectrumSize];
+        for (int i = 0; i < spectrumSize; ++i)
+        {
+            dest[i] = std::complex<float>(src[i]);
+        }
+    }
+
+    nextSegment = nextSegment + 1 < storeSize ? nextSegment + 1 : 0;
+    nStored = std::min(nStored + 1, storeSize);
+}
+
+int SurrogateCoherence::beginRound()
+{
+    // (a circular shift pairs the same segments whatever order they are stored in)
+    nRoundSegments = nStored;
+
+    std::fill(powerSums.begin(), powerSums.end(), 0.0);
+    for (int seg = 0; seg < nRoundSegments; ++seg)
+    {
+        for (int chan = 0; chan < nChans; ++chan)
+        {
+            const std::complex<float>* spectrum = getSpectrum(seg, chan);
+            double* sums = &powerSums[size_t(chan) * spectrumSize];
+            for (int i = 0; i < spectrumSize; ++i)
+            {
+                sums[i] += std::norm(std::complex<double>(spectrum[i]));
+            }
+        }
+    }
+
+    return std::max(nRoundSegments - 1, 0);
+}
+
+void SurrogateCoherence::computeShifts(int firstShift, int endShift)
+{
+    int nPairs = nGroup1 * nGroup2;
+    std::vector<std::complex<double>> crossSums(nTimes);
+
+    for (int shift = std::max(firstShift, 1); shift < std::min(endShift, nRoundSegments); ++shift)
+    {
+        double* dest = &surrogates[size_t(shift - 1) * nPairs * nFreqs];
+        for (int itX = 0, pair = 0; itX < nGroup1; ++itX)
+        {
+            for (int itY = 0; itY < nGroup2; ++itY, ++pair)
+            {
+                int chanY = nGroup1 + itY;
+                for (int f = 0; f < nFreqs; ++f)
+                {
+                    std::fill(crossSums.begin(), crossSums.end(), std::complex<double>());
+                    for (int seg = 0; seg < nRoundSegments; ++seg)
+                    {
+                        int shifted = (seg + shift) % nRoundSegments;
+                        const std::complex<float>* x = getSpectrum(seg, itX) + f * nTimes;
+                        const std::complex<float>* y = getSpectrum(shifted, chanY) + f * nTimes;
+                        for (int t = 0; t < nTimes; ++t)
+                        {
+                            crossSums[t] += std::complex<double>(x[t]) * std::conj(std::complex<double>(y[t]));
+                        }
+                    }
+
+                    // mean over the times of coherence from the sums (the counts cancel)
+                    const double* powX = &powerSums[size_t(itX) * spectrumSize + f * nTimes];
+                    const double* powY = &powerSums[size_t(chanY) * spectrumSize + f * nTimes];
+                    double coherence = 0;
+                    for (int t = 0; t < nTimes; ++t)
+                    {
+                        double denominator = powX[t] * powY[t];
+                        coherence += denominator > 0 ? std::norm(crossSums[t]) / denominator : 0;
+                    }
+                    dest[pair * nFreqs + f] = nTimes > 0 ? coherence / nTimes : 0;
+                }
+            }
+        }
+    }
+}
+
+void SurrogateCoherence::getThresholds(double percentile, std::vector<std::vector<double>>& dest)
+{
+    int nPairs = nGroup1 * nGroup2;
+    int nShifts = std::max(nRoundSegments - 1, 0);
+    dest.resize(nPairs);
+
+    // nearest rank
+    int rank = int(std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100 * nShifts)) - 1;
+    rank = std::min(std::max(rank, 0), nShifts - 1);
+
+    for (int pair = 0; pair < nPairs; ++pair)
+    {
+        dest[pair].resize(nFreqs);
+        for (int f = 0; f < nFreqs; ++f)
+        {
+            if (nShifts == 0)
+            {
+                dest[pair][f] = 1;
+                continue;
+            }
+
+            sorted.clear();
+            for (int shift = 1; shift <= nShifts; ++shift)
+            {
+                sorted.push_back(surrogates[(size_t(shift - 1) * nPairs + pair) * nFreqs + f]);
+            }
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            dest[pair][f] = sorted[rank];
+        }
+    }
+}
+
+double SurrogateCoherence::scaleThreshold(double threshold, int fromSegments, double toSegments)
+{
+    if (fromSegments <= 0 || toSegments <= 0)
+    {
+        return threshold;
+    }
+    return std::min(threshold * fromSegments / toSegments, 1.0);
+}
+
+size_t SurrogateCoherence::getMemorySize() const
+{
+    return store.size() * sizeof(std::complex<float>) + (powerSums.size() + surrogates.size()) * sizeof(double);
+}
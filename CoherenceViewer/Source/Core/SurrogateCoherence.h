@@ -0,0 +1,113 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SURROGATE_COHERENCE_H_INCLUDED
+#define SURROGATE_COHERENCE_H_INCLUDED
+
+/*
+
+Surrogate Coherence - a null distribution of coherence for every channel pair and frequency, to
+tell which values are higher than chance. No JUCE dependency.
+
+The spectra (as CumulativeTFR::computeSpectrum gives them) of the last few segments are kept in
+a bounded store. A surrogate pairs each stored segment of a group 1 channel with the segment
+shift places later (circularly) of a group 2 channel: each channel's spectrum is unchanged, but
+any real phase relationship between them is gone. Its coherence is calculated the same way as
+CumulativeTFR's linear average (mean over the times of interest), so with n stored segments
+there are n - 1 surrogates, each an estimate from n segments.
+
+A round works on the store as it is: beginRound sums the power, computeShifts calculates the
+surrogates for a range of shifts (different ranges can be calculated on different threads at
+once), and getThresholds takes a percentile of them. The store must not be changed during a
+round. Spectra are stored in single precision.
+
+Without a true relationship, coherence from K segments is about 1/K times a distribution that
+hardly depends on K (each estimate is a sum of K independent terms), so a threshold from n
+segments is compared with an average over K (e.g. a linear average over more segments than are
+stored) after scaleThreshold. It's exact for K = n, the last-N average with the store covering
+the window.
+
+*/
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class SurrogateCoherence
+{
+public:
+    SurrogateCoherence();
+
+    // Clears everything; storeSize is the number of segments kept
+    void resize(int nGroup1Chans, int nGroup2Chans, int nFreqs, int nTimes, int storeSize);
+
+    int getStoreSize() const { return storeSize; }
+    int getNumStored() const { return nStored; }
+
+    // Copies one segment's spectra (# channels x (# freqs * # times), group 1 first), replacing
+    // the oldest once the store is full
+    void addSegment(const std::vector<std::vector<std::complex<double>>>& spectra);
+
+    // Starts a round over the stored segments; returns the number of shifts (1 to the result)
+    int beginRound();
+
+    // Calculates the surrogates for shifts [firstShift, endShift)
+    void computeShifts(int firstShift, int endShift);
+
+    // percentile (0 - 100) of each pair's surrogates at each frequency, # pairs x # freqs
+    void getThresholds(double percentile, std::vector<std::vector<double>>& dest);
+    // Segments the current (or last) round is over
+    int getNumRoundSegments() const { return nRoundSegments; }
+
+    // A threshold from fromSegments segments, for coherence averaged over toSegments (see
+    // CumulativeTFR::getEffectiveSegments)
+    static double scaleThreshold(double threshold, int fromSegments, double toSegments);
+
+    size_t getMemorySize() const;
+
+private:
+    const std::complex<float>* getSpectrum(int segment, int chan) const
+    {
+        return &store[(size_t(segment) * nChans + chan) * spectrumSize];
+    }
+
+    int nGroup1;
+    int nGroup2;
+    int nChans;
+    int nFreqs;
+    int nTimes;
+    int spectrumSize; // # freqs x # times
+    int storeSize;
+
+    std::vector<std::complex<float>> store; // # segments x # channels x # freqs x # times
+    int nStored;
+    int nextSegment; // where the next one goes
+
+    // the current round
+    int nRoundSegments;
+    std::vector<double> powerSums;  // # channels x # freqs x # times
+    std::vector<double> surrogates; // # shifts x # pairs x # freqs
+    std::vector<double> sorted;     // getThresholds' values at one pair and frequency
+};
+
+#endif // SURROGATE_COHERENCE_H_INCLUDED
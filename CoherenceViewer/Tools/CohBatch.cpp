@@ -0,0 +1,690 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_batch - calculate coherence over a recording as fast as possible, with the same
+segmenting, artifact rejection and TFR as the plugin, and write a .coh file.
+
+Usage:
+    coh_batch <continuous.dat or raw file> --group1 <c1,...> --group2 <c1,...> [options]
+
+    --group1 <c1,c2,...>    group 1 channels (1-based, as in the GUI)
+    --group2 <c1,c2,...>    group 2 channels
+    --seg <s,...>           segment length (default 4)
+    --win <s,...>           window length (default 2)
+    --step <s,...>          step length (default 0.1)
+    --freq-start <Hz>       first frequency (default 1)
+    --freq-end <Hz>         last frequency (default 40)
+    --alpha <a>             alpha (default 0: linear average)
+    --window <n>            average over the last n segments only (default 0: all)
+    --bands <list>          also record the coherence in each band, e.g. "theta 4-8, beta 13-30"
+    --bands-only            record only the bands, not the values at each frequency
+    --artifact <uV>         artifact threshold (default 3000)
+    --threads <n>           worker threads (default: all cores)
+    --out <file>            output file (default SEG<seg>_WIN<win>.coh, or sweep.csv for a sweep)
+    --no-compression        store all chunks uncompressed
+
+    Input layout, taken from structure.oebin and timestamps.npy for a continuous.dat:
+    --format <int16|float32>    sample format (default int16, or float32 for .f32 files)
+    --channels <n>              number of interleaved channels
+    --fs <Hz>                   sample rate
+    --bit-volts <uV>            microvolts per int16 step (default 0.195; float32 default 1)
+    --first-timestamp <n>       timestamp of the first sample (default 0)
+
+Segments are found in one pass over the data. They're then transformed in parallel, in
+batches, with every (segment, channel) pair a separate task, and added to the running
+averages in order, so the output matches the plugin's regardless of the number of threads.
+
+Sweep: giving more than one segment, window or step length evaluates every combination over
+the same data and writes one CSV table instead of a .coh file: a row per combination and
+channel pair, with the number of segments used and the final coherence at each frequency.
+Combinations with the same segment length share their segments and forward FFTs, and those
+that also have the same window share wavelets and convolutions, so extra step lengths are
+almost free.
+*/
+
+#include "CoherenceBands.h"
+#include "CoherenceFileFormat.h"
+#include "CumulativeTFR.h"
+#include "RecordingSource.h"
+#include "Segmenter.h"
+#include "StageTimings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int SEGMENTER_BLOCK = 8192;
+    const int SEGMENTS_PER_THREAD = 4; // per batch
+
+    struct SegmentPosition
+    {
+        int64_t startSample;
+        int64_t lastSample;
+    };
+
+    // Only records where segments are; the data is read again from the file when needed
+    class PositionSink : public SegmentSink
+    {
+    public:
+        explicit PositionSink(std::vector<SegmentPosition>& positions)
+            : positions(positions)
+        {}
+
+        FFTArray* getSegmentBuffer(int) override
+        {
+            return nullptr;
+        }
+
+        void segmentComplete(int64_t startSample, int64_t lastTimestamp) override
+        {
+            // timestamps passed to the segmenter are sample numbers
+            positions.push_back({ startSample, lastTimestamp });
+        }
+
+    private:
+        std::vector<SegmentPosition>& positions;
+    };
+
+    // One set of parameters and its TFR
+    struct Combination
+    {
+        double segLen;
+        float winLen;
+        float stepLen;
+        std::unique_ptr<CumulativeTFR> tfr;
+
+        // spectra of the current batch, [segment * nChans + chan]
+        std::vector<std::vector<std::complex<double>>> spectra;
+
+        // latest coherence and its standard deviation over the times of interest, [pair][freq]
+        std::vector<std::vector<double>> coherence;
+        std::vector<std::vector<double>> stdDev;
+        int numAdded = 0;
+    };
+
+    // Combinations with the same segment length, and so the same segments
+    struct SegmentGroup
+    {
+        double segLen;
+        int segSamples;
+        Segmenter segmenter;
+        std::vector<SegmentPosition> segments;
+
+        // indices of combinations, grouped by the wavelets they use
+        std::vector<std::vector<int>> waveletSets;
+    };
+
+    // Runs task(thread, index) for each index in [0, nTasks) on up to nThreads threads
+    template<typename Task>
+    void parallelFor(int nThreads, int nTasks, Task task)
+    {
+        std::atomic<int> nextTask(0);
+        auto work = [&](int thread)
+        {
+            for (int index = nextTask++; index < nTasks; index = nextTask++)
+            {
+                task(thread, index);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 1; t < std::min(nThreads, nTasks); ++t)
+        {
+            threads.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::vector<int> parseChannelList(const std::string& list)
+    {
+        std::vector<int> channels;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (!item.empty())
+            {
+                channels.push_back(std::atoi(item.c_str()) - 1);
+            }
+        }
+        return channels;
+    }
+
+    std::vector<double> parseList(const std::string& list)
+    {
+        std::vector<double> values;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (!item.empty())
+            {
+                values.push_back(std::atof(item.c_str()));
+            }
+        }
+        return values;
+    }
+
+    std::vector<SegmentPosition> findSegments(const RecordingSource& source, const std::vector<int>& channels,
+        int segSamples, double artifactThreshold, Segmenter& segmenter)
+    {
+        int nChans = int(channels.size());
+        segmenter.reset(nChans, segSamples, int(source.getInfo().sampleRate), artifactThreshold);
+
+        std::vector<std::vector<float>> block(nChans, std::vector<float>(SEGMENTER_BLOCK));
+        std::vector<const float*> pointers(nChans);
+        for (int c = 0; c < nChans; ++c)
+        {
+            pointers[c] = block[c].data();
+        }
+
+        std::vector<SegmentPosition> positions;
+        PositionSink sink(positions);
+        for (int64_t start = 0; start < source.getNumSamples(); start += SEGMENTER_BLOCK)
+        {
+            int n = int(std::min<int64_t>(SEGMENTER_BLOCK, source.getNumSamples() - start));
+            for (int c = 0; c < nChans; ++c)
+            {
+                source.read(channels[c], start, n, block[c].data());
+            }
+            segmenter.addBlock(pointers.data(), n, start, sink);
+        }
+        return positions;
+    }
+
+    std::string formatSeconds(double s)
+    {
+        std::ostringstream ss;
+        ss << s;
+        return ss.str();
+    }
+
+    bool writeTable(const std::string& path, const std::vector<Combination>& combinations,
+        const std::vector<SegmentGroup>& groups, const CoherenceFileHeader& header)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+
+        out << "seg,win,step,segments,artifacts,discarded,chan_x,chan_y";
+        for (double freq : header.freqs)
+        {
+            out << ',' << freq;
+        }
+        out << '\n';
+
+        for (const SegmentGroup& group : groups)
+        {
+            for (const std::vector<int>& waveletSet : group.waveletSets)
+            {
+                for (int index : waveletSet)
+                {
+                    const Combination& combination = combinations[index];
+                    for (int pair = 0; pair < header.getNumPairs(); ++pair)
+                    {
+                        out << combination.segLen << ',' << combination.winLen << ',' << combination.stepLen << ','
+                            << combination.numAdded << ',' << group.segmenter.getNumArtifacts() << ','
+                            << group.segmenter.getNumDiscarded() << ',' << header.pairs[pair].first + 1 << ','
+                            << header.pairs[pair].second + 1;
+
+                        // empty if there were no segments
+                        for (int f = 0; f < header.getNumFreqs(); ++f)
+                        {
+                            out << ',';
+                            if (combination.numAdded > 0)
+                            {
+                                out << combination.coherence[pair][f];
+                            }
+                        }
+                        out << '\n';
+                    }
+                }
+            }
+        }
+        return bool(out);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <continuous.dat or raw file> --group1 list --group2 list"
+            " [--seg s,...] [--win s,...] [--step s,...] [--freq-start Hz] [--freq-end Hz] [--alpha a]"
+            " [--window n] [--artifact uV] [--threads n] [--out file] [--no-compression] [--format int16|float32]"
+            " [--channels n] [--fs Hz] [--bit-volts uV] [--first-timestamp n]" << std::endl;
+        return 1;
+    }
+
+    std::string inPath = argv[1];
+    std::string outPath;
+    RecordingInfo requested;
+    std::vector<int> group1, group2;
+    std::vector<double> segLens = { 4 };
+    std::vector<double> winLens = { 2 };
+    std::vector<double> stepLens = { 0.1 };
+    int freqStart = 1;
+    int freqEnd = 40;
+    double alpha = 0;
+    int averageWindow = 0;
+    double artifactThreshold = 3000;
+    int nThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t codec = CoherenceFileHeader::XOR_RLE;
+    std::vector<CoherenceBand> bandList;
+    bool bandsOnly = false;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--no-compression")
+        {
+            codec = CoherenceFileHeader::NONE;
+        }
+        else if (arg == "--bands-only")
+        {
+            bandsOnly = true;
+        }
+        else if (!hasValue)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        else if (arg == "--group1")             { group1 = parseChannelList(argv[++i]); }
+        else if (arg == "--group2")             { group2 = parseChannelList(argv[++i]); }
+        else if (arg == "--seg")                { segLens = parseList(argv[++i]); }
+        else if (arg == "--win")                { winLens = parseList(argv[++i]); }
+        else if (arg == "--step")               { stepLens = parseList(argv[++i]); }
+        else if (arg == "--freq-start")         { freqStart = std::atoi(argv[++i]); }
+        else if (arg == "--freq-end")           { freqEnd = std::atoi(argv[++i]); }
+        else if (arg == "--alpha")              { alpha = std::atof(argv[++i]); }
+        else if (arg == "--window")             { averageWindow = std::max(0, std::atoi(argv[++i])); }
+        else if (arg == "--artifact")           { artifactThreshold = std::atof(argv[++i]); }
+        else if (arg == "--threads")            { nThreads = std::max(1, std::atoi(argv[++i])); }
+        else if (arg == "--out")                { outPath = argv[++i]; }
+        else if (arg == "--channels")           { requested.numChannels = std::atoi(argv[++i]); }
+        else if (arg == "--fs")                 { requested.sampleRate = std::atof(argv[++i]); }
+        else if (arg == "--bit-volts")          { requested.bitVolts.assign(1, std::atof(argv[++i])); }
+        else if (arg == "--first-timestamp")    { requested.firstTimestamp = std::atoll(argv[++i]); }
+        else if (arg == "--bands")
+        {
+            std::string error;
+            if (!CoherenceBands::parse(argv[++i], bandList, error))
+            {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--format")
+        {
+            std::string format = argv[++i];
+            if (format == "int16")          { requested.format = RecordingInfo::INT16; }
+            else if (format == "float32")   { requested.format = RecordingInfo::FLOAT32; }
+            else
+            {
+                std::cerr << "Unknown format " << format << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    RecordingSource source;
+    if (!source.open(inPath, requested))
+    {
+        std::cerr << source.getError() << std::endl;
+        return 1;
+    }
+    const RecordingInfo& info = source.getInfo();
+
+    // TFR order: group 1 then group 2
+    std::vector<int> channels = group1;
+    channels.insert(channels.end(), group2.begin(), group2.end());
+    if (group1.empty() || group2.empty())
+    {
+        std::cerr << "Both --group1 and --group2 are needed" << std::endl;
+        return 1;
+    }
+    for (int chan : channels)
+    {
+        if (chan < 0 || chan >= info.numChannels)
+        {
+            std::cerr << "Channel " << chan + 1 << " is not in the recording (" << info.numChannels
+                << " channels)" << std::endl;
+            return 1;
+        }
+    }
+    if (segLens.empty() || winLens.empty() || stepLens.empty() || freqEnd < freqStart)
+    {
+        std::cerr << "Invalid segment, window, step or frequency range" << std::endl;
+        return 1;
+    }
+    if (bandsOnly && bandList.empty())
+    {
+        std::cerr << "--bands-only needs --bands" << std::endl;
+        return 1;
+    }
+
+    bool isSweep = segLens.size() * winLens.size() * stepLens.size() > 1;
+    int Fs = int(info.sampleRate);
+    int nFreqs = freqEnd - freqStart + 1;
+    int ng1 = int(group1.size());
+    int ng2 = int(group2.size());
+    int nChans = ng1 + ng2;
+    int batchSize = nThreads * SEGMENTS_PER_THREAD;
+
+    CoherenceFileHeader header;
+    header.sampleRate = info.sampleRate;
+    header.alpha = alpha;
+    header.averageWindow = averageWindow;
+    header.hasStdDev = true;
+    header.hasFreqValues = !bandsOnly;
+    header.bands = bandList;
+    header.codec = codec;
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        header.freqs.push_back(freqStart + f);
+    }
+
+    CoherenceBands bands;
+    bands.setBands(bandList);
+    bands.setFreqs(header.freqs);
+    std::vector<double> bandCoherence(bands.getNumBands());
+    for (int itX = 0; itX < ng1; ++itX)
+    {
+        for (int itY = 0; itY < ng2; ++itY)
+        {
+            header.pairs.emplace_back(group1[itX], group2[itY]);
+        }
+    }
+
+    // Set up every combination, grouped by segment length and then by wavelets
+    std::vector<Combination> combinations;
+    std::vector<SegmentGroup> groups;
+    combinations.reserve(segLens.size() * winLens.size() * stepLens.size());
+    for (double segLen : segLens)
+    {
+        groups.emplace_back();
+        SegmentGroup& group = groups.back();
+        group.segLen = segLen;
+        group.segSamples = int(segLen * Fs);
+
+        for (double win : winLens)
+        {
+            for (double step : stepLens)
+            {
+                float winLen = float(win);
+                float stepLen = float(step);
+                if (winLen <= 0 || stepLen <= 0 || winLen > segLen)
+                {
+                    std::cerr << "Skipping seg " << segLen << " win " << winLen << " step " << stepLen
+                        << ": invalid" << std::endl;
+                    continue;
+                }
+
+                // same as CoherenceNode::resetTFR
+                int nSamplesWin = int(winLen * Fs);
+                int nTimes = int((segLen * Fs - nSamplesWin) / Fs * (1 / stepLen)) + 1;
+
+                int index = int(combinations.size());
+                combinations.emplace_back();
+                Combination& combination = combinations.back();
+                combination.segLen = segLen;
+                combination.winLen = winLen;
+                combination.stepLen = stepLen;
+                combination.tfr.reset(new CumulativeTFR(ng1, ng2, nFreqs, nTimes, Fs, winLen, stepLen, 1,
+                    freqStart, segLen, alpha, averageWindow));
+                combination.spectra.assign(size_t(batchSize) * nChans,
+                    std::vector<std::complex<double>>(combination.tfr->getSpectrumSize()));
+                combination.coherence.assign(ng1 * ng2, std::vector<double>(nFreqs));
+                combination.stdDev.assign(ng1 * ng2, std::vector<double>(nFreqs));
+
+                auto waveletSet = std::find_if(group.waveletSets.begin(), group.waveletSets.end(),
+                    [&](const std::vector<int>& set)
+                    {
+                        return combinations[set.front()].tfr->hasSameWavelets(*combination.tfr);
+                    });
+                if (waveletSet == group.waveletSets.end())
+                {
+                    group.waveletSets.push_back({ index });
+                }
+                else
+                {
+                    waveletSet->push_back(index);
+                }
+            }
+        }
+
+        if (group.waveletSets.empty())
+        {
+            groups.pop_back();
+        }
+    }
+    if (combinations.empty())
+    {
+        std::cerr << "No valid combination of segment, window and step length" << std::endl;
+        return 1;
+    }
+
+    CoherenceFileWriter writer;
+    if (!isSweep)
+    {
+        const Combination& combination = combinations.front();
+        header.segLen = combination.segLen;
+        header.winLen = combination.winLen;
+        header.stepLen = combination.stepLen;
+        if (outPath.empty())
+        {
+            outPath = "SEG" + formatSeconds(combination.segLen) + "_WIN" + formatSeconds(combination.winLen) + ".coh";
+        }
+        if (!writer.open(outPath, header))
+        {
+            std::cerr << "Could not create " << outPath << std::endl;
+            return 1;
+        }
+    }
+    else if (outPath.empty())
+    {
+        outPath = "sweep.csv";
+    }
+
+    std::cout << info.numChannels << " channels, " << source.getNumSamples() << " samples at " << info.sampleRate
+        << " Hz (" << source.getNumSamples() / info.sampleRate << " s)" << std::endl;
+    if (isSweep)
+    {
+        std::cout << combinations.size() << " combinations" << std::endl;
+    }
+
+    auto tStart = StageTimings::now();
+
+    parallelFor(nThreads, int(groups.size()), [&](int, int g)
+    {
+        groups[g].segments = findSegments(source, channels, groups[g].segSamples, artifactThreshold,
+            groups[g].segmenter);
+    });
+
+    std::vector<FFTArray> buffers(nThreads);
+    std::vector<FFTArray> workBuffers(nThreads);
+    std::vector<float> record(header.getValuesPerRecord());
+    int64_t totalSegments = 0;
+    int64_t doneSegments = 0;
+    for (const SegmentGroup& group : groups)
+    {
+        totalSegments += group.segments.size();
+    }
+
+    bool writeFailed = false;
+    int lastPercent = -1;
+    for (SegmentGroup& group : groups)
+    {
+        if (isSweep)
+        {
+            std::cout << "seg " << group.segLen << ": ";
+        }
+        std::cout << group.segments.size() << " segments, " << group.segmenter.getNumArtifacts() << " artifacts ("
+            << group.segmenter.getNumDiscarded() << " segments discarded)" << std::endl;
+
+        int nfft = combinations[group.waveletSets.front().front()].tfr->getNfft();
+        for (int t = 0; t < nThreads; ++t)
+        {
+            buffers[t].resize(nfft);
+            workBuffers[t].resize(nfft);
+        }
+
+        std::vector<int> groupCombinations;
+        for (const std::vector<int>& waveletSet : group.waveletSets)
+        {
+            groupCombinations.insert(groupCombinations.end(), waveletSet.begin(), waveletSet.end());
+        }
+
+        int nSegments = int(group.segments.size());
+        for (int batchStart = 0; batchStart < nSegments && !writeFailed; batchStart += batchSize)
+        {
+            int nInBatch = std::min(batchSize, nSegments - batchStart);
+
+            // Forward FFT once per (segment, channel), and convolve once per set of wavelets
+            parallelFor(nThreads, nInBatch * nChans, [&](int thread, int task)
+            {
+                const SegmentPosition& segment = group.segments[batchStart + task / nChans];
+                int chan = task % nChans;
+                FFTArray& buffer = buffers[thread];
+                FFTArray& workBuffer = workBuffers[thread];
+
+                source.read(channels[chan], segment.startSample, group.segSamples, buffer);
+                buffer.fftReal();
+
+                for (const std::vector<int>& waveletSet : group.waveletSets)
+                {
+                    const CumulativeTFR& lead = *combinations[waveletSet.front()].tfr;
+                    for (int freq = 0; freq < nFreqs; ++freq)
+                    {
+                        lead.convolve(buffer, freq, workBuffer);
+                        for (int index : waveletSet)
+                        {
+                            Combination& combination = combinations[index];
+                            combination.tfr->sampleSpectrum(workBuffer,
+                                combination.spectra[task].data() + freq * combination.tfr->getNumTimes());
+                        }
+                    }
+                }
+            });
+
+            // Add to the running averages in order, as the plugin's calculation thread does.
+            // Combinations are independent, so they're done in parallel.
+            parallelFor(nThreads, int(groupCombinations.size()), [&](int, int c)
+            {
+                Combination& combination = combinations[groupCombinations[c]];
+                for (int s = 0; s < nInBatch; ++s)
+                {
+                    for (int chan = 0; chan < nChans; ++chan)
+                    {
+                        combination.tfr->addSpectrum(combination.spectra[size_t(s) * nChans + chan].data(), chan);
+                    }
+
+                    for (int itX = 0, comb = 0; itX < ng1; ++itX)
+                    {
+                        for (int itY = 0; itY < ng2; ++itY, ++comb)
+                        {
+                            combination.tfr->getMeanCoherence(itX, itY + ng1, combination.coherence[comb].data(), comb,
+                                CumulativeTFR::Subsample(), combination.stdDev[comb].data());
+                        }
+                    }
+                    ++combination.numAdded;
+
+                    if (isSweep || writeFailed)
+                    {
+                        continue;
+                    }
+
+                    // only one combination, so only one thread writes
+                    int nBands = bands.getNumBands();
+                    for (int comb = 0; comb < ng1 * ng2; ++comb)
+                    {
+                        if (header.hasFreqValues)
+                        {
+                            std::copy(combination.coherence[comb].begin(), combination.coherence[comb].end(),
+                                record.begin() + size_t(comb) * nFreqs);
+                            std::copy(combination.stdDev[comb].begin(), combination.stdDev[comb].end(),
+                                record.begin() + header.getValuesPerPlane() + size_t(comb) * nFreqs);
+                        }
+                        bands.reduce(combination.coherence[comb].data(), bandCoherence.data());
+                        std::copy(bandCoherence.begin(), bandCoherence.end(),
+                            record.begin() + header.getBandOffset() + size_t(comb) * nBands);
+                    }
+
+                    int index = batchStart + s;
+                    if (!writer.writeRecord(source.getTimestamp(group.segments[index].lastSample), uint32_t(index), 0,
+                        record.data()))
+                    {
+                        writeFailed = true;
+                    }
+                }
+            });
+
+            doneSegments += nInBatch;
+            int percent = int(100.0 * doneSegments / totalSegments);
+            if (percent / 10 != lastPercent / 10)
+            {
+                std::cout << percent << "%" << std::endl;
+                lastPercent = percent;
+            }
+        }
+    }
+
+    if (isSweep ? !writeTable(outPath, combinations, groups, header) : writeFailed)
+    {
+        std::cerr << "Failed to write to " << outPath << std::endl;
+        return 1;
+    }
+    writer.close();
+
+    double seconds = StageTimings::elapsedUs(tStart, StageTimings::now()) / 1e6;
+    double recordingSeconds = source.getNumSamples() / info.sampleRate;
+    std::cout << "Wrote " << (isSweep ? std::to_string(combinations.size()) + " combinations"
+        : std::to_string(combinations.front().numAdded) + " records") << " to " << outPath << " in " << seconds
+        << " s (" << (seconds > 0 ? recordingSeconds / seconds : 0) << "x real time, " << nThreads << " threads)"
+        << std::endl;
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_convert - convert a text coherence file written by older versions of the plugin
+(SEG<seg>_WIN<win>.txt) to the binary .coh format.
+
+The text files hold one line per channel combination ("c1,c2,...,cN,") for each update,
+with a blank line between updates. They don't store parameters, channels or timestamps,
+so these are taken from the options below (segment and window length default to the
+values in the file name). Timestamps are reconstructed as the end of each segment,
+assuming no segments were discarded, and flagged as estimated.
+
+Usage:
+    coh_convert <in.txt> <out.coh> [options]
+
+    --fs <Hz>               sample rate (default 0: timestamps count segments instead of samples)
+    --seg <s>               segment length
+    --win <s>               window length
+    --step <s>              step length (default 0.1)
+    --alpha <a>             alpha (default 0)
+    --freq-start <Hz>       first frequency (default 1)
+    --freq-step <Hz>        frequency step (default 1)
+    --group1 <c1,c2,...>    group 1 channels (1-based, as in the GUI)
+    --group2 <c1,c2,...>    group 2 channels
+    --no-compression        store all chunks uncompressed
+*/
+
+#include "CoherenceFileFormat.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<int> parseChannelList(const std::string& list)
+{
+    std::vector<int> channels;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            channels.push_back(std::atoi(item.c_str()) - 1);
+        }
+    }
+    return channels;
+}
+
+static std::vector<float> parseLine(const std::string& line)
+{
+    std::vector<float> values;
+    std::stringstream ss(line);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.find_first_not_of(" \t\r") != std::string::npos)
+        {
+            values.push_back(std::strtof(item.c_str(), nullptr));
+        }
+    }
+    return values;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <in.txt> <out.coh> [--fs Hz] [--seg s] [--win s] [--step s]"
+            " [--alpha a] [--freq-start Hz] [--freq-step Hz] [--group1 list] [--group2 list] [--no-compression]"
+            << std::endl;
+        return 1;
+    }
+
+    std::string inPath = argv[1];
+    std::string outPath = argv[2];
+
+    CoherenceFileHeader header;
+    header.stepLen = 0.1;
+    double freqStart = 1;
+    double freqStep = 1;
+    std::vector<int> group1, group2;
+
+    // defaults from the file name written by the plugin
+    std::smatch match;
+    if (std::regex_search(inPath, match, std::regex("SEG([0-9.]+)_WIN([0-9.]+)")))
+    {
+        header.segLen = std::atof(match[1].str().c_str());
+        header.winLen = std::atof(match[2].str().c_str());
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--no-compression")
+        {
+            header.codec = CoherenceFileHeader::NONE;
+        }
+        else if (!hasValue)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        else if (arg == "--fs")         { header.sampleRate = std::atof(argv[++i]); }
+        else if (arg == "--seg")        { header.segLen = std::atof(argv[++i]); }
+        else if (arg == "--win")        { header.winLen = std::atof(argv[++i]); }
+        else if (arg == "--step")       { header.stepLen = std::atof(argv[++i]); }
+        else if (arg == "--alpha")      { header.alpha = std::atof(argv[++i]); }
+        else if (arg == "--freq-start") { freqStart = std::atof(argv[++i]); }
+        else if (arg == "--freq-step")  { freqStep = std::atof(argv[++i]); }
+        else if (arg == "--group1")     { group1 = parseChannelList(argv[++i]); }
+        else if (arg == "--group2")     { group2 = parseChannelList(argv[++i]); }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream in(inPath);
+    if (!in)
+    {
+        std::cerr << "Could not open " << inPath << std::endl;
+        return 1;
+    }
+
+    // read all updates; each is a block of lines separated by blank lines
+    std::vector<std::vector<std::vector<float>>> updates;
+    std::vector<std::vector<float>> block;
+    std::string line;
+    while (true)
+    {
+        bool more = bool(std::getline(in, line));
+        std::vector<float> values = more ? parseLine(line) : std::vector<float>();
+
+        if (values.empty())
+        {
+            if (!block.empty())
+            {
+                updates.push_back(std::move(block));
+                block.clear();
+            }
+            if (!more)
+            {
+                break;
+            }
+            continue;
+        }
+
+        block.push_back(std::move(values));
+    }
+
+    if (updates.empty())
+    {
+        std::cerr << "No coherence found in " << inPath << std::endl;
+        return 1;
+    }
+
+    int nPairs = int(updates[0].size());
+    int nFreqs = int(updates[0][0].size());
+
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        header.freqs.push_back(freqStart + f * freqStep);
+    }
+
+    if (group1.size() * group2.size() == size_t(nPairs))
+    {
+        for (int chanX : group1)
+        {
+            for (int chanY : group2)
+            {
+                header.pairs.emplace_back(chanX, chanY);
+            }
+        }
+    }
+    else
+    {
+        if (!group1.empty() || !group2.empty())
+        {
+            std::cerr << "Warning: groups don't match the " << nPairs
+                << " combinations in the file; channels will be unknown" << std::endl;
+        }
+        header.pairs.assign(nPairs, std::make_pair(-1, -1));
+    }
+
+    CoherenceFileWriter writer;
+    if (!writer.open(outPath, header))
+    {
+        std::cerr << "Could not open " << outPath << " for writing" << std::endl;
+        return 1;
+    }
+
+    double samplesPerSegment = header.sampleRate > 0 ? header.segLen * header.sampleRate : 1;
+    std::vector<float> values(header.getValuesPerRecord());
+    int nSkipped = 0;
+
+    for (size_t u = 0; u < updates.size(); ++u)
+    {
+        const auto& update = updates[u];
+        bool complete = int(update.size()) == nPairs;
+        for (int pair = 0; complete && pair < nPairs; ++pair)
+        {
+            complete = int(update[pair].size()) == nFreqs;
+        }
+
+        if (!complete)
+        {
+            // e.g. the last update if recording stopped while it was being written
+            ++nSkipped;
+            continue;
+        }
+
+        for (int pair = 0; pair < nPairs; ++pair)
+        {
+            std::copy(update[pair].begin(), update[pair].end(), values.begin() + size_t(pair) * nFreqs);
+        }
+
+        int64_t timestamp = int64_t(std::llround((u + 1) * samplesPerSegment)) - 1;
+        writer.writeRecord(timestamp, uint32_t(u), CoherenceFileHeader::ESTIMATED_TIMESTAMP, values.data());
+    }
+
+    writer.close();
+
+    std::cout << "Converted " << updates.size() - nSkipped << " updates (" << nPairs << " pairs x "
+        << nFreqs << " frequencies)";
+    if (nSkipped > 0)
+    {
+        std::cout << ", skipped " << nSkipped << " incomplete";
+    }
+    std::cout << std::endl;
+
+    return 0;
+}
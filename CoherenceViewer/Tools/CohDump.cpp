@@ -0,0 +1,256 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_dump - print the contents of a binary coherence recording (.coh).
+
+Usage:
+    coh_dump <file.coh> [options]
+
+    With no options, prints the header and a summary of the chunks.
+
+    --csv               print records as CSV, one line per channel pair:
+                        timestamp,segment,chanX,chanY,<coherence at each frequency>
+                        followed, if recorded, by its standard deviation at each frequency
+                        and the coherence in each band (recordings may hold only the bands)
+    --pair <n>          only print the n-th channel pair (0-based, in header order)
+    --from <timestamp>  start at the first record at or after this sample timestamp
+    --to <timestamp>    stop before the first record at or after this sample timestamp
+*/
+
+#include "CoherenceFileFormat.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+
+static void printHeader(const CoherenceFileReader& reader)
+{
+    const CoherenceFileHeader& header = reader.getHeader();
+
+    std::cout << "Sample rate:     " << header.sampleRate << " Hz\n"
+              << "Segment length:  " << header.segLen << " s\n"
+              << "Window length:   " << header.winLen << " s\n"
+              << "Step length:     " << header.stepLen << " s\n"
+              << "Alpha:           " << header.alpha << "\n"
+              << "Average window:  " << (header.averageWindow > 0
+                  ? std::to_string(header.averageWindow) + " segments" : std::string("all (weighted by alpha)")) << "\n"
+              << "Std deviations:  " << (header.hasStdDev ? "recorded" : "not recorded") << "\n"
+              << "Frequencies:     " << header.getNumFreqs();
+
+    if (header.getNumFreqs() > 0)
+    {
+        std::cout << " (" << header.freqs.front() << " - " << header.freqs.back() << " Hz)";
+    }
+    if (!header.hasFreqValues)
+    {
+        std::cout << ", only bands recorded";
+    }
+
+    std::cout << "\nBands:           " << (header.getNumBands() > 0 ? CoherenceBands::toString(header.bands) : "none")
+              << "\nChannel pairs:   " << header.getNumPairs() << "\n"
+              << "Records:         " << reader.getNumRecords() << "\n"
+              << "Chunks:          " << reader.getNumChunks()
+              << (reader.wasIndexRebuilt() ? " (index rebuilt; file was not closed cleanly)" : "") << "\n";
+
+    int nCompressed = 0;
+    for (int c = 0; c < reader.getNumChunks(); ++c)
+    {
+        if (reader.getChunkInfo(c).codec != CoherenceFileHeader::NONE)
+        {
+            ++nCompressed;
+        }
+    }
+    std::cout << "Compressed:      " << nCompressed << " of " << reader.getNumChunks() << " chunks\n";
+
+    if (reader.getNumChunks() > 0)
+    {
+        std::cout << "Timestamps:      " << reader.getChunkInfo(0).firstTimestamp << " - "
+            << reader.getChunkInfo(reader.getNumChunks() - 1).lastTimestamp << "\n";
+    }
+}
+
+// Channel numbers are 1-based in the GUI; a negative index (e.g. from coh_convert, when the
+// original channels aren't known) is printed as "?"
+static std::string channelName(int chan)
+{
+    return chan < 0 ? "?" : std::to_string(chan + 1);
+}
+
+static void printPairRow(const CoherenceFileHeader& header, int pair, int64_t timestamp,
+    uint32_t segmentIndex, const float* values, const float* stdDevs, const float* bands)
+{
+    std::cout << timestamp << "," << segmentIndex << ","
+        << channelName(header.pairs[pair].first) << "," << channelName(header.pairs[pair].second);
+
+    for (int f = 0; values != nullptr && f < header.getNumFreqs(); ++f)
+    {
+        std::cout << "," << values[f];
+    }
+    for (int f = 0; stdDevs != nullptr && f < header.getNumFreqs(); ++f)
+    {
+        std::cout << "," << stdDevs[f];
+    }
+    for (int b = 0; b < header.getNumBands(); ++b)
+    {
+        std::cout << "," << bands[b];
+    }
+    std::cout << "\n";
+}
+
+static bool printCsv(CoherenceFileReader& reader, int onlyPair, int64_t from, int64_t to)
+{
+    const CoherenceFileHeader& header = reader.getHeader();
+    int nFreqs = header.getNumFreqs();
+    int nBands = header.getNumBands();
+    bool hasFreqValues = header.hasFreqValues;
+    bool hasStdDev = hasFreqValues && header.hasStdDev;
+
+    int64_t firstRecord = reader.findRecord(from);
+    int64_t endRecord = reader.findRecord(to);
+
+    std::cout << "timestamp,segment,chanX,chanY";
+    for (size_t f = 0; hasFreqValues && f < header.freqs.size(); ++f)
+    {
+        std::cout << "," << header.freqs[f];
+    }
+    for (size_t f = 0; hasStdDev && f < header.freqs.size(); ++f)
+    {
+        std::cout << ",sd " << header.freqs[f];
+    }
+    for (const CoherenceBand& band : header.bands)
+    {
+        std::cout << "," << band.name;
+    }
+    std::cout << "\n";
+
+    if (onlyPair >= 0)
+    {
+        // only touches the chunks in range, and only copies out one pair
+        std::vector<int64_t> timestamps;
+        std::vector<float> values;
+        std::vector<float> stdDevs;
+        std::vector<float> bands;
+        if (!reader.readPair(onlyPair, firstRecord, endRecord, timestamps, values, &stdDevs, &bands))
+        {
+            std::cerr << reader.getError() << std::endl;
+            return false;
+        }
+
+        for (size_t i = 0; i < timestamps.size(); ++i)
+        {
+            int64_t timestamp;
+            uint32_t segmentIndex, flags;
+            reader.readRecordInfo(firstRecord + int64_t(i), timestamp, segmentIndex, flags);
+            printPairRow(header, onlyPair, timestamps[i], segmentIndex,
+                hasFreqValues ? &values[i * nFreqs] : nullptr, hasStdDev ? &stdDevs[i * nFreqs] : nullptr,
+                bands.data() + i * nBands);
+        }
+        return true;
+    }
+
+    CoherenceRecord record;
+    for (int64_t i = firstRecord; i < endRecord; ++i)
+    {
+        if (!reader.readRecord(i, record))
+        {
+            std::cerr << "Failed to read record " << i << ": " << reader.getError() << std::endl;
+            return false;
+        }
+
+        for (int pair = 0; pair < header.getNumPairs(); ++pair)
+        {
+            printPairRow(header, pair, record.timestamp, record.segmentIndex,
+                hasFreqValues ? &record.values[size_t(pair) * nFreqs] : nullptr,
+                hasStdDev ? &record.values[(size_t(header.getNumPairs()) + pair) * nFreqs] : nullptr,
+                record.values.data() + header.getBandOffset() + size_t(pair) * nBands);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <file.coh> [--csv] [--pair n] [--from ts] [--to ts]" << std::endl;
+        return 1;
+    }
+
+    bool csv = false;
+    int pair = -1;
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--csv")
+        {
+            csv = true;
+        }
+        else if (arg == "--pair" && hasValue)
+        {
+            pair = std::atoi(argv[++i]);
+        }
+        else if (arg == "--from" && hasValue)
+        {
+            from = std::atoll(argv[++i]);
+        }
+        else if (arg == "--to" && hasValue)
+        {
+            to = std::atoll(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    CoherenceFileReader reader;
+    if (!reader.open(argv[1]))
+    {
+        std::cerr << reader.getError() << std::endl;
+        return 1;
+    }
+
+    if (pair >= reader.getHeader().getNumPairs())
+    {
+        std::cerr << "File only has " << reader.getHeader().getNumPairs() << " pairs" << std::endl;
+        return 1;
+    }
+
+    if (!csv)
+    {
+        printHeader(reader);
+        return 0;
+    }
+
+    return printCsv(reader, pair, from, to) ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RecordingSource.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+namespace
+{
+    std::string getDirectory(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    std::string getFileName(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    bool endsWith(const std::string& s, const std::string& suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    bool readTextFile(const std::string& path, std::string& dest)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        dest = ss.str();
+        return true;
+    }
+
+    // First number following "key": in text, or def
+    double findNumber(const std::string& text, const std::string& key, double def)
+    {
+        std::smatch match;
+        if (std::regex_search(text, match, std::regex("\"" + key + "\"\\s*:\\s*([-+0-9.eE]+)")))
+        {
+            return std::atof(match[1].str().c_str());
+        }
+        return def;
+    }
+}
+
+RecordingSource::RecordingSource()
+    : numSamples    (0)
+    , timestamps    (nullptr)
+{}
+
+bool RecordingSource::open(const std::string& path, const RecordingInfo& requested)
+{
+    info = requested;
+    timestamps = nullptr;
+    timestampFile.close();
+
+    if (!file.open(path))
+    {
+        error = "Could not open " + path;
+        return false;
+    }
+
+    bool isOpenEphys = getFileName(path) == "continuous.dat";
+    if (isOpenEphys)
+    {
+        if (info.format == RecordingInfo::UNKNOWN)
+        {
+            info.format = RecordingInfo::INT16;
+        }
+
+        // fills in whatever wasn't given; fine if it's missing
+        readStructure(path);
+
+        if (info.firstTimestamp < 0)
+        {
+            openTimestamps(getDirectory(path) + "/timestamps.npy");
+        }
+    }
+
+    if (info.format == RecordingInfo::UNKNOWN)
+    {
+        info.format = endsWith(path, ".f32") || endsWith(path, ".float") ? RecordingInfo::FLOAT32 : RecordingInfo::INT16;
+    }
+    if (info.bitVolts.empty())
+    {
+        // Open Ephys default for headstage channels
+        info.bitVolts.push_back(info.format == RecordingInfo::INT16 ? 0.195 : 1.0);
+    }
+    if (info.firstTimestamp < 0)
+    {
+        info.firstTimestamp = 0;
+    }
+
+    if (info.numChannels <= 0)
+    {
+        error = "Number of channels unknown (use --channels)";
+        return false;
+    }
+    if (info.sampleRate <= 0)
+    {
+        error = "Sample rate unknown (use --fs)";
+        return false;
+    }
+
+    size_t bytesPerSample = info.format == RecordingInfo::INT16 ? sizeof(int16_t) : sizeof(float);
+    numSamples = int64_t(file.getSize() / (bytesPerSample * info.numChannels));
+
+    size_t timestampBytes = timestamps != nullptr ? size_t(timestampFile.getSize() - (timestamps - timestampFile.getData())) : 0;
+    if (timestamps != nullptr && int64_t(timestampBytes / sizeof(int64_t)) < numSamples)
+    {
+        // shorter than the data, so it can't be the right file
+        timestamps = nullptr;
+    }
+
+    return true;
+}
+
+int64_t RecordingSource::getTimestamp(int64_t sample) const
+{
+    if (timestamps != nullptr)
+    {
+        int64_t ts;
+        std::memcpy(&ts, timestamps + sample * sizeof(int64_t), sizeof(ts));
+        return ts;
+    }
+    return info.firstTimestamp + sample;
+}
+
+template<typename Store>
+void RecordingSource::readWith(int chan, int64_t start, int n, Store store) const
+{
+    double scale = getBitVolts(chan);
+    size_t stride = size_t(info.numChannels);
+
+    if (info.format == RecordingInfo::INT16)
+    {
+        const uint8_t* p = file.getData() + (size_t(start) * stride + chan) * sizeof(int16_t);
+        for (int i = 0; i < n; ++i, p += stride * sizeof(int16_t))
+        {
+            int16_t x;
+            std::memcpy(&x, p, sizeof(x));
+            store(i, x * scale);
+        }
+    }
+    else
+    {
+        const uint8_t* p = file.getData() + (size_t(start) * stride + chan) * sizeof(float);
+        for (int i = 0; i < n; ++i, p += stride * sizeof(float))
+        {
+            float x;
+            std::memcpy(&x, p, sizeof(x));
+            store(i, x * scale);
+        }
+    }
+}
+
+void RecordingSource::read(int chan, int64_t start, int n, float* dest) const
+{
+    readWith(chan, start, n, [dest](int i, double x) { dest[i] = float(x); });
+}
+
+void RecordingSource::read(int chan, int64_t start, int n, FFTArray& dest) const
+{
+    // through float, as the plugin receives it
+    readWith(chan, start, n, [&dest](int i, double x) { dest.set(i, double(float(x))); });
+}
+
+double RecordingSource::getBitVolts(int chan) const
+{
+    return size_t(chan) < info.bitVolts.size() ? info.bitVolts[chan] : info.bitVolts.back();
+}
+
+bool RecordingSource::readStructure(const std::string& datPath)
+{
+    // <recording>/continuous/<stream folder>/continuous.dat
+    std::string streamDir = getDirectory(datPath);
+    std::string streamName = getFileName(streamDir);
+    std::string recordingDir = getDirectory(getDirectory(streamDir));
+
+    std::string text;
+    if (!readTextFile(recordingDir + "/structure.oebin", text))
+    {
+        return false;
+    }
+
+    // find this stream's entry: from its folder_name to the next one
+    size_t entryStart = text.find("\"folder_name\"");
+    std::smatch match;
+    std::regex folderRegex("\"folder_name\"\\s*:\\s*\"" + std::regex_replace(streamName,
+        std::regex("[.^$|()\\[\\]{}*+?\\\\]"), "\\$&") + "/?\"");
+    if (std::regex_search(text, match, folderRegex))
+    {
+        entryStart = size_t(match.position(0));
+    }
+    if (entryStart == std::string::npos)
+    {
+        return false;
+    }
+    size_t entryEnd = text.find("\"folder_name\"", entryStart + 1);
+    std::string entry = text.substr(entryStart, entryEnd == std::string::npos ? std::string::npos : entryEnd - entryStart);
+
+    if (info.sampleRate <= 0)
+    {
+        info.sampleRate = findNumber(entry, "sample_rate", 0);
+    }
+    if (info.numChannels <= 0)
+    {
+        info.numChannels = int(findNumber(entry, "num_channels", 0));
+    }
+    if (info.bitVolts.empty())
+    {
+        std::regex bitVoltsRegex("\"bit_volts\"\\s*:\\s*([-+0-9.eE]+)");
+        for (std::sregex_iterator it(entry.begin(), entry.end(), bitVoltsRegex), end; it != end; ++it)
+        {
+            info.bitVolts.push_back(std::atof((*it)[1].str().c_str()));
+        }
+    }
+    return true;
+}
+
+bool RecordingSource::openTimestamps(const std::string& npyPath)
+{
+    if (!timestampFile.open(npyPath) || timestampFile.getSize() < 10)
+    {
+        return false;
+    }
+
+    // .npy: magic, version, header length, then a text header describing the array
+    const uint8_t* data = timestampFile.getData();
+    if (std::memcmp(data, "\x93NUMPY", 6) != 0)
+    {
+        return false;
+    }
+
+    size_t headerLen, dataStart;
+    if (data[6] == 1)
+    {
+        headerLen = size_t(data[8]) | size_t(data[9]) << 8;
+        dataStart = 10 + headerLen;
+    }
+    else
+    {
+        if (timestampFile.getSize() < 12)
+        {
+            return false;
+        }
+        headerLen = size_t(data[8]) | size_t(data[9]) << 8 | size_t(data[10]) << 16 | size_t(data[11]) << 24;
+        dataStart = 12 + headerLen;
+    }
+    if (dataStart > timestampFile.getSize())
+    {
+        return false;
+    }
+
+    std::string header(reinterpret_cast<const char*>(data) + dataStart - headerLen, headerLen);
+    if (header.find("<i8") == std::string::npos || header.find("'fortran_order': True") != std::string::npos)
+    {
+        return false;
+    }
+
+    timestamps = data + dataStart;
+    if (timestampFile.getSize() >= dataStart + sizeof(int64_t))
+    {
+        int64_t first;
+        std::memcpy(&first, timestamps, sizeof(first));
+        info.firstTimestamp = first;
+    }
+    return true;
+}
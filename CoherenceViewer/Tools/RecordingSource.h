@@ -0,0 +1,103 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RECORDING_SOURCE_H_INCLUDED
+#define RECORDING_SOURCE_H_INCLUDED
+
+/*
+
+Recording Source - memory-mapped, interleaved continuous data for the offline tools.
+
+Reads Open Ephys flat binary recordings (continuous.dat: int16 samples, interleaved by
+channel) or any raw interleaved int16 or float32 file. For a continuous.dat, the channel
+count, sample rate and bitVolts are taken from the recording's structure.oebin and sample
+timestamps from the timestamps.npy next to it, unless given explicitly. Samples are returned
+in microvolts (int16 values times bitVolts), like the data the plugin sees.
+
+*/
+
+#include "FFTArray.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct RecordingInfo
+{
+    enum Format
+    {
+        UNKNOWN,
+        INT16,
+        FLOAT32
+    };
+
+    // zero/empty fields are filled in by RecordingSource::open where possible
+    Format format = UNKNOWN;
+    int numChannels = 0;
+    double sampleRate = 0;
+    std::vector<double> bitVolts; // per channel, or a single value for all
+    int64_t firstTimestamp = -1;  // -1: from timestamps.npy if there is one, otherwise 0
+};
+
+class RecordingSource
+{
+public:
+    RecordingSource();
+
+    // Returns false (see getError) if the file can't be opened or its layout is unknown
+    bool open(const std::string& path, const RecordingInfo& requested);
+
+    const RecordingInfo& getInfo() const { return info; }
+    int64_t getNumSamples() const { return numSamples; }
+
+    // Timestamp of a sample, from timestamps.npy if it was found
+    int64_t getTimestamp(int64_t sample) const;
+
+    // Copy n samples of a channel starting at start, in microvolts
+    void read(int chan, int64_t start, int n, float* dest) const;
+    void read(int chan, int64_t start, int n, FFTArray& dest) const;
+
+    const std::string& getError() const { return error; }
+
+private:
+    bool readStructure(const std::string& datPath);
+    bool openTimestamps(const std::string& npyPath);
+
+    // calls store(i, value) for each sample
+    template<typename Store>
+    void readWith(int chan, int64_t start, int n, Store store) const;
+
+    double getBitVolts(int chan) const;
+
+    MappedFile file;
+    RecordingInfo info;
+    int64_t numSamples;
+
+    MappedFile timestampFile;
+    const uint8_t* timestamps; // numSamples int64s, or nullptr
+
+    std::string error;
+};
+
+#endif // RECORDING_SOURCE_H_INCLUDED
@@ -0,0 +1,569 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_accuracy - check coherence engines against synthetic signals with known coherence.
+
+Usage:
+    coh_accuracy [options]
+
+    --segments <n>      segments per scenario (default 200)
+    --seed <n>          random seed (default 1)
+    --verbose           print the coherence at every frequency
+
+For each scenario (see makeScenarios) and each engine (see makeEngines), the final mean
+coherence at every frequency must:
+    - match ReferenceCoherence (naive DFT) to within REFERENCE_TOLERANCE,
+    - be within ANALYTIC_SDS standard deviations (plus ANALYTIC_MARGIN) of the expected
+      coherence at each component's frequency, after adding the expected bias of an estimate
+      from this many segments,
+    - stay below OFF_BAND_LIMIT away from the components.
+
+The average over the last few segments (CumulativeTFR's averageWindow) is also checked against
+ReferenceCoherence run on just those segments, to within WINDOW_TOLERANCE (looser, since the
+window keeps its values in single precision).
+
+CumulativeTFR's jackknife (bias-corrected coherence and confidence interval) is checked, for
+the linear and last-N averages, against one done by brute force: a TFR run on the segments
+without each group in turn. The segment counts are chosen so that groups hold one or more
+segments and some values have dropped out of the window.
+
+CoherenceBands is checked on a linear ramp over the frequencies, whose weighted mean in each band
+(BANDS) must be the ramp at the band's centre, or at the closest frequency for a band outside
+them, to within BAND_TOLERANCE.
+
+SurrogateCoherence's thresholds, from the last SURROGATE_SEGMENTS segments, must be below the
+coherence over the same segments at each component, and above it at all but
+SURROGATE_FALSE_POSITIVES of the frequencies away from the components. With more segments than
+that, the thresholds scaled to the linear average over all of them (scaleThreshold) must on average
+be within SURROGATE_SCALE_TOLERANCE of thresholds from surrogates over all of them, away from the
+components.
+
+Prints a line per check and exits with status 1 if any fail. A new engine (e.g. one in
+single precision, or batched over channels) is checked by adding it to makeEngines; if it
+needs looser tolerances, that should be a decision made here, not in the engine.
+*/
+
+#include "CoherenceBands.h"
+#include "CumulativeTFR.h"
+#include "FFTArray.h"
+#include "ReferenceCoherence.h"
+#include "SurrogateCoherence.h"
+#include "SyntheticSignals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const double REFERENCE_TOLERANCE = 1e-6;
+    const double ANALYTIC_SDS = 3;
+    const double ANALYTIC_MARGIN = 0.01;
+    const double OFF_BAND_LIMIT = 0.05;
+    const double WINDOW_TOLERANCE = 1e-4;
+    const int WINDOW_DIVISOR = 4; // window is this fraction of the segments
+    const double JACKKNIFE_TOLERANCE = 1e-6;
+    const int JACKKNIFE_GROUPS = 10;
+    const int JACKKNIFE_SEGMENTS = 15;  // linear average
+    const int JACKKNIFE_WINDOW = 12;    // last-N average, after JACKKNIFE_SEGMENTS + 5 segments
+    const int SURROGATE_SEGMENTS = 64;
+    const double SURROGATE_PERCENTILE = 95;
+    const double SURROGATE_FALSE_POSITIVES = 0.2; // fraction of off-band frequencies
+    const double SURROGATE_SCALE_TOLERANCE = 0.15;  // of the mean ratio
+    const char* const BANDS = "theta 4-8, alpha 8-13, beta 13-30, gamma 30-40, 50-60";
+    const double BAND_TOLERANCE = 1e-9;
+
+    const float STEP_LEN = 0.1f;
+    const int FREQ_START = 1;
+    const int N_FREQS = 40;
+
+    struct Scenario
+    {
+        std::string name;
+        SyntheticSpec spec;
+    };
+
+    // Runs one segment after another through an engine; returns the final mean coherence
+    // between the two channels at each frequency
+    typedef std::function<std::vector<double>(const SyntheticPair&, int nTimes)> EngineFunction;
+
+    struct Engine
+    {
+        std::string name;
+        EngineFunction run;
+    };
+
+    int getNumTimes(const SyntheticSpec& spec)
+    {
+        // same as CoherenceNode::resetTFR
+        int nSamplesWin = int(spec.winLen * spec.fs);
+        return int((spec.segLen * spec.fs - nSamplesWin) / spec.fs * (1 / STEP_LEN)) + 1;
+    }
+
+    std::vector<Scenario> makeScenarios(int nSegments, unsigned seed)
+    {
+        std::vector<Scenario> scenarios;
+        auto add = [&](const std::string& name, std::vector<SyntheticComponent> components,
+            double winLen, double noiseExponent)
+        {
+            Scenario s;
+            s.name = name;
+            s.spec.winLen = winLen;
+            s.spec.noiseExponent = noiseExponent;
+            s.spec.nSegments = nSegments;
+            s.spec.seed = seed + unsigned(scenarios.size());
+            s.spec.components = components;
+            scenarios.push_back(s);
+        };
+
+        //  freq, SNR, jitter SD, lag
+        add("phase-locked, SNR 10",         { { 10, 10, 0,   0.5 } },                    2,   1);
+        add("jitter 0.5 rad, SNR 10",       { { 10, 10, 0.5, 0 } },                      2,   1);
+        add("jitter 1 rad, SNR 3",          { { 20, 3,  1,   1 } },                      2,   1);
+        add("two components",               { { 8,  5,  0.3, 0 }, { 30, 2, 0.8, 2 } },   2,   1);
+        add("white noise, 1.5 s window",    { { 15, 4,  0.4, 0.3 } },                    1.5, 0);
+        add("noise only",                   {},                                          2,   1);
+        return scenarios;
+    }
+
+    CumulativeTFR* makeTFR(const SyntheticPair& pair, int nTimes, int averageWindow, int jackknifeGroups = 0)
+    {
+        const SyntheticSpec& spec = pair.getSpec();
+        return new CumulativeTFR(1, 1, N_FREQS, nTimes, int(spec.fs), float(spec.winLen), STEP_LEN,
+            1, FREQ_START, spec.segLen, 0, averageWindow, jackknifeGroups);
+    }
+
+    // Runs segments [first, end) through a TFR, except those in skipGroup (seg % JACKKNIFE_GROUPS);
+    // returns the mean coherence after the last
+    std::vector<double> addSegments(CumulativeTFR& tfr, const SyntheticPair& pair, int first, int end,
+        int skipGroup = -1)
+    {
+        FFTArray buffer(pair.getSegmentLength());
+        std::vector<double> coherence(N_FREQS);
+        for (int seg = first; seg < end; ++seg)
+        {
+            if (seg % JACKKNIFE_GROUPS == skipGroup)
+            {
+                continue;
+            }
+            for (int chan = 0; chan < 2; ++chan)
+            {
+                const std::vector<double>& data = pair.getSegment(chan, seg);
+                for (int n = 0; n < pair.getSegmentLength(); ++n)
+                {
+                    buffer.set(n, data[n]);
+                }
+                tfr.addTrial(buffer, chan);
+            }
+            tfr.getMeanCoherence(0, 1, coherence.data(), 0);
+        }
+        return coherence;
+    }
+
+    // Runs every segment through a CumulativeTFR, averaging over all of them (averageWindow 0)
+    // or the last averageWindow
+    std::vector<double> runTFR(const SyntheticPair& pair, int nTimes, int averageWindow)
+    {
+        std::unique_ptr<CumulativeTFR> tfr(makeTFR(pair, nTimes, averageWindow));
+        return addSegments(*tfr, pair, 0, pair.getNumSegments());
+    }
+
+    // Largest difference between CumulativeTFR's jackknife after segments [0, end), averaged over
+    // all of them (averageWindow 0) or the last averageWindow, and the same done by brute force
+    double checkJackknife(const SyntheticPair& pair, int nTimes, int end, int averageWindow)
+    {
+        std::unique_ptr<CumulativeTFR> tfr(makeTFR(pair, nTimes, averageWindow, JACKKNIFE_GROUPS));
+        addSegments(*tfr, pair, 0, end);
+        std::vector<double> corrected(N_FREQS), lower(N_FREQS), upper(N_FREQS);
+        tfr->getJackknifeCoherence(0, 1, 0, corrected.data(), lower.data(), upper.data());
+
+        // coherence with all the averaged segments, and without each group that has any
+        int first = averageWindow > 0 ? std::max(0, end - averageWindow) : 0;
+        std::unique_ptr<CumulativeTFR> all(makeTFR(pair, nTimes, 0));
+        std::vector<double> coherence = addSegments(*all, pair, first, end);
+
+        std::vector<std::vector<double>> without;
+        for (int group = 0; group < JACKKNIFE_GROUPS; ++group)
+        {
+            bool hasSegments = false;
+            for (int seg = first; seg < end; ++seg)
+            {
+                hasSegments |= seg % JACKKNIFE_GROUPS == group;
+            }
+            if (hasSegments)
+            {
+                std::unique_ptr<CumulativeTFR> leftOut(makeTFR(pair, nTimes, 0));
+                without.push_back(addSegments(*leftOut, pair, first, end, group));
+            }
+        }
+
+        int n = int(without.size());
+        double maxDiff = 0;
+        for (int f = 0; f < N_FREQS; ++f)
+        {
+            double mean = 0;
+            for (const std::vector<double>& coh : without)
+            {
+                mean += coh[f] / n;
+            }
+            double sumSq = 0;
+            for (const std::vector<double>& coh : without)
+            {
+                sumSq += (coh[f] - mean) * (coh[f] - mean);
+            }
+            double expected = n * coherence[f] - (n - 1) * mean;
+            double halfWidth = CumulativeTFR::getT975(n - 1) * std::sqrt(sumSq * (n - 1) / n);
+
+            maxDiff = std::max(maxDiff, std::abs(corrected[f] - expected));
+            maxDiff = std::max(maxDiff, std::abs(lower[f] - (expected - halfWidth)));
+            maxDiff = std::max(maxDiff, std::abs(upper[f] - (expected + halfWidth)));
+        }
+        return maxDiff;
+    }
+
+    std::vector<Engine> makeEngines()
+    {
+        std::vector<Engine> engines;
+
+        engines.push_back({ std::string("CumulativeTFR (") + FFTArray::getBackendName() + ")",
+            [](const SyntheticPair& pair, int nTimes)
+        {
+            return runTFR(pair, nTimes, 0);
+        } });
+
+        return engines;
+    }
+
+    // Reference coherence over the segments from firstSegment on
+    std::vector<double> runReference(const SyntheticPair& pair, int nTimes, int firstSegment = 0)
+    {
+        const SyntheticSpec& spec = pair.getSpec();
+        ReferenceCoherence ref(2, N_FREQS, nTimes, int(spec.fs), float(spec.winLen), STEP_LEN,
+            1, FREQ_START, spec.segLen);
+
+        std::vector<double> coherence(N_FREQS);
+        for (int seg = firstSegment; seg < pair.getNumSegments(); ++seg)
+        {
+            ref.addTrial(pair.getSegment(0, seg), 0);
+            ref.addTrial(pair.getSegment(1, seg), 1);
+            ref.getMeanCoherence(0, 1, coherence.data());
+        }
+        return coherence;
+    }
+
+    double getFreq(int f)
+    {
+        return FREQ_START + f;
+    }
+
+    bool isNearComponent(const SyntheticSpec& spec, int f)
+    {
+        bool nearComponent = false;
+        for (const SyntheticComponent& comp : spec.components)
+        {
+            // main lobe of the Hann wavelet, plus a margin
+            nearComponent |= std::abs(getFreq(f) - comp.freq) <= 2 / spec.winLen + 1;
+        }
+        return nearComponent;
+    }
+
+    // Surrogate thresholds from the last n segments; coherence gets the coherence averaged the
+    // given way (see makeTFR) and nAveraged its effective number of segments
+    std::vector<double> runSurrogates(const SyntheticPair& pair, int nTimes, int n, int averageWindow,
+        std::vector<double>& coherence, double& nAveraged)
+    {
+        std::unique_ptr<CumulativeTFR> tfr(makeTFR(pair, nTimes, averageWindow));
+        SurrogateCoherence surrogate;
+        surrogate.resize(1, 1, N_FREQS, nTimes, n);
+
+        FFTArray buffer(pair.getSegmentLength());
+        FFTArray work(tfr->getNfft());
+        std::vector<std::vector<std::complex<double>>> spectra(2,
+            std::vector<std::complex<double>>(tfr->getSpectrumSize()));
+        coherence.assign(N_FREQS, 0);
+        for (int seg = 0; seg < pair.getNumSegments(); ++seg)
+        {
+            for (int chan = 0; chan < 2; ++chan)
+            {
+                const std::vector<double>& data = pair.getSegment(chan, seg);
+                for (int i = 0; i < pair.getSegmentLength(); ++i)
+                {
+                    buffer.set(i, data[i]);
+                }
+                tfr->computeSpectrum(buffer, work, spectra[chan].data());
+                tfr->addSpectrum(spectra[chan].data(), chan);
+            }
+            tfr->getMeanCoherence(0, 1, coherence.data(), 0);
+            surrogate.addSegment(spectra);
+        }
+
+        // (in two ranges, as two threads would)
+        int nShifts = surrogate.beginRound();
+        surrogate.computeShifts(1, nShifts / 2 + 1);
+        surrogate.computeShifts(nShifts / 2 + 1, nShifts + 1);
+        std::vector<std::vector<double>> thresholds;
+        surrogate.getThresholds(SURROGATE_PERCENTILE, thresholds);
+        nAveraged = tfr->getEffectiveSegments(0);
+        return thresholds[0];
+    }
+
+    // Approximate expected value of a magnitude-squared coherence estimate from nTrials
+    // independent trials, for true coherence c
+    // Largest difference of the bands' means of a ramp from the expected values, or -1 if
+    // BANDS doesn't parse back to the same text
+    double checkBands()
+    {
+        std::vector<CoherenceBand> bandList;
+        std::string error;
+        if (!CoherenceBands::parse(BANDS, bandList, error) || CoherenceBands::toString(bandList) != BANDS)
+        {
+            return -1;
+        }
+
+        std::vector<double> freqs(N_FREQS);
+        for (int f = 0; f < N_FREQS; ++f)
+        {
+            freqs[f] = getFreq(f);
+        }
+        CoherenceBands bands;
+        bands.setBands(bandList);
+        bands.setFreqs(freqs);
+
+        // the ramp's value is the frequency
+        std::vector<double> means(bands.getNumBands());
+        bands.reduce(freqs.data(), means.data());
+
+        double maxDiff = 0;
+        for (int b = 0; b < bands.getNumBands(); ++b)
+        {
+            double centre = (bandList[b].low + bandList[b].high) / 2;
+            double expected = std::min(std::max(centre, freqs.front()), freqs.back());
+            maxDiff = std::max(maxDiff, std::abs(means[b] - expected));
+        }
+        return maxDiff;
+    }
+
+    double getBiasedExpectation(double c, int nTrials)
+    {
+        return c + (1 - c) * (1 - c) / nTrials;
+    }
+
+    // Approximate SD of the same estimate (Carter, 1987), ignoring the averaging over times
+    double getEstimateSd(double c, int nTrials)
+    {
+        return (1 - c) * std::sqrt(2 * c / nTrials);
+    }
+
+    bool report(bool ok, const std::string& what)
+    {
+        std::cout << (ok ? "  pass  " : "  FAIL  ") << what << std::endl;
+        return ok;
+    }
+
+    std::string format(double x, int precision = 4)
+    {
+        std::ostringstream ss;
+        ss << std::setprecision(precision) << x;
+        return ss.str();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int nSegments = 200;
+    unsigned seed = 1;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--verbose")
+        {
+            verbose = true;
+        }
+        else if (arg == "--segments" && i + 1 < argc)
+        {
+            nSegments = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = unsigned(std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--segments n] [--seed n] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Engine> engines = makeEngines();
+    int nFailed = 0;
+
+    double bandDiff = checkBands();
+    nFailed += !report(bandDiff >= 0 && bandDiff <= BAND_TOLERANCE, bandDiff < 0
+        ? std::string("Bands: \"") + BANDS + "\" doesn't parse back to itself"
+        : "Bands: max difference of a ramp's band means from the band centres " + format(bandDiff, 3));
+
+    for (const Scenario& scenario : makeScenarios(nSegments, seed))
+    {
+        std::cout << scenario.name << std::endl;
+
+        SyntheticPair pair(scenario.spec);
+        int nTimes = getNumTimes(scenario.spec);
+        std::vector<double> reference = runReference(pair, nTimes);
+
+        for (const Engine& engine : engines)
+        {
+            std::vector<double> coherence = engine.run(pair, nTimes);
+            std::string prefix = engine.name + ": ";
+
+            double maxDiff = 0;
+            for (int f = 0; f < N_FREQS; ++f)
+            {
+                maxDiff = std::max(maxDiff, std::abs(coherence[f] - reference[f]));
+            }
+            nFailed += !report(maxDiff <= REFERENCE_TOLERANCE,
+                prefix + "max difference from reference " + format(maxDiff, 3));
+
+            double maxOffBand = 0;
+            int maxOffBandFreq = 0;
+            for (int f = 0; f < N_FREQS; ++f)
+            {
+                if (!isNearComponent(scenario.spec, f) && coherence[f] > maxOffBand)
+                {
+                    maxOffBand = coherence[f];
+                    maxOffBandFreq = int(getFreq(f));
+                }
+            }
+            nFailed += !report(maxOffBand <= OFF_BAND_LIMIT, prefix + "max off-band coherence "
+                + format(maxOffBand) + " at " + std::to_string(maxOffBandFreq) + " Hz");
+
+            for (size_t c = 0; c < scenario.spec.components.size(); ++c)
+            {
+                const SyntheticComponent& comp = scenario.spec.components[c];
+                int f = int(std::lround(comp.freq)) - FREQ_START;
+                double trueCoherence = pair.getExpectedCoherence(int(c));
+                double expected = getBiasedExpectation(trueCoherence, nSegments);
+                double tolerance = ANALYTIC_SDS * getEstimateSd(trueCoherence, nSegments) + ANALYTIC_MARGIN;
+                nFailed += !report(std::abs(coherence[f] - expected) <= tolerance,
+                    prefix + "coherence at " + format(comp.freq) + " Hz " + format(coherence[f])
+                    + ", expected " + format(expected) + " +/- " + format(tolerance, 2));
+            }
+
+            if (verbose)
+            {
+                for (int f = 0; f < N_FREQS; ++f)
+                {
+                    std::cout << "        " << std::setw(3) << getFreq(f) << " Hz  " << format(coherence[f])
+                        << "  (reference " << format(reference[f]) << ")" << std::endl;
+                }
+            }
+        }
+
+        int window = std::max(1, nSegments / WINDOW_DIVISOR);
+        std::vector<double> windowed = runTFR(pair, nTimes, window);
+        std::vector<double> windowReference = runReference(pair, nTimes, nSegments - window);
+        double maxDiff = 0;
+        for (int f = 0; f < N_FREQS; ++f)
+        {
+            maxDiff = std::max(maxDiff, std::abs(windowed[f] - windowReference[f]));
+        }
+        nFailed += !report(maxDiff <= WINDOW_TOLERANCE, "CumulativeTFR, last " + std::to_string(window)
+            + " segments: max difference from reference " + format(maxDiff, 3));
+
+        int jackknifeEnd = std::min(nSegments, JACKKNIFE_SEGMENTS);
+        maxDiff = checkJackknife(pair, nTimes, jackknifeEnd, 0);
+        nFailed += !report(maxDiff <= JACKKNIFE_TOLERANCE, "CumulativeTFR jackknife, "
+            + std::to_string(jackknifeEnd) + " segments: max difference from brute force " + format(maxDiff, 3));
+
+        jackknifeEnd = std::min(nSegments, JACKKNIFE_SEGMENTS + 5);
+        maxDiff = checkJackknife(pair, nTimes, jackknifeEnd, JACKKNIFE_WINDOW);
+        nFailed += !report(maxDiff <= JACKKNIFE_TOLERANCE, "CumulativeTFR jackknife, last "
+            + std::to_string(JACKKNIFE_WINDOW) + " of " + std::to_string(jackknifeEnd)
+            + " segments: max difference from brute force " + format(maxDiff, 3));
+
+        int nSurrogateSegments = std::min(nSegments, SURROGATE_SEGMENTS);
+        std::vector<double> surrogateCoherence;
+        double nAveraged;
+        std::vector<double> thresholds = runSurrogates(pair, nTimes, nSurrogateSegments, nSurrogateSegments,
+            surrogateCoherence, nAveraged);
+        std::string surrogatePrefix = "Surrogates, last " + std::to_string(nSurrogateSegments) + " segments: ";
+        for (const SyntheticComponent& comp : scenario.spec.components)
+        {
+            int f = int(std::lround(comp.freq)) - FREQ_START;
+            nFailed += !report(surrogateCoherence[f] > thresholds[f], surrogatePrefix + "coherence at "
+                + format(comp.freq) + " Hz " + format(surrogateCoherence[f]) + ", threshold " + format(thresholds[f]));
+        }
+        int nOffBand = 0;
+        int nOverThreshold = 0;
+        for (int f = 0; f < N_FREQS; ++f)
+        {
+            if (!isNearComponent(scenario.spec, f))
+            {
+                ++nOffBand;
+                nOverThreshold += surrogateCoherence[f] > thresholds[f];
+            }
+        }
+        nFailed += !report(nOverThreshold <= SURROGATE_FALSE_POSITIVES * nOffBand, surrogatePrefix
+            + std::to_string(nOverThreshold) + " of " + std::to_string(nOffBand)
+            + " off-band frequencies over the threshold");
+
+        if (nSegments > SURROGATE_SEGMENTS)
+        {
+            // the linear average over every segment, against thresholds from the last
+            // SURROGATE_SEGMENTS scaled to its segments and from surrogates over all of them
+            std::vector<double> linearCoherence;
+            std::vector<double> storeThresholds = runSurrogates(pair, nTimes, SURROGATE_SEGMENTS, 0,
+                linearCoherence, nAveraged);
+            std::vector<double> fullThresholds = runSurrogates(pair, nTimes, nSegments, 0, linearCoherence, nAveraged);
+
+            // (the mean ratio, since each percentile of a few dozen surrogates is noisy)
+            double scaledRatio = 0;
+            double unscaledRatio = 0;
+            for (int f = 0; f < N_FREQS; ++f)
+            {
+                if (!isNearComponent(scenario.spec, f))
+                {
+                    double scaled = SurrogateCoherence::scaleThreshold(storeThresholds[f], SURROGATE_SEGMENTS, nAveraged);
+                    scaledRatio += scaled / fullThresholds[f] / nOffBand;
+                    unscaledRatio += storeThresholds[f] / fullThresholds[f] / nOffBand;
+                }
+            }
+            nFailed += !report(std::abs(scaledRatio - 1) <= SURROGATE_SCALE_TOLERANCE, "Surrogates, last "
+                + std::to_string(SURROGATE_SEGMENTS) + " scaled to a linear average over "
+                + std::to_string(std::lround(nAveraged)) + ": off-band thresholds " + format(scaledRatio, 3)
+                + " times those of surrogates over all of them (unscaled " + format(unscaledRatio, 3) + ")");
+        }
+    }
+
+    std::cout << (nFailed == 0 ? "All checks passed" : std::to_string(nFailed) + " checks failed") << std::endl;
+    return nFailed == 0 ? 0 : 1;
+}
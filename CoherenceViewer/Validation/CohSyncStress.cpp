@@ -0,0 +1,337 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+coh_sync_stress - hammer the lock-free hand-offs between threads and check that no reader ever
+sees a partly written update.
+
+Usage:
+    coh_sync_stress [options]
+
+    --seconds <s>       how long to run each check (default 2)
+    --readers <n>       readers for MultiReaderShared (default 3)
+    --size <n>          values in each update (default 4096)
+
+The writer fills every value of an update with its update number and pushes it as fast as it
+can; each reader pulls as fast as it can and checks that every value it reads is the same and
+matches the number of the update it's reading, twice, with a pause in between so that a writer
+reusing a slot too early would be caught. Update numbers must never go backwards for any reader.
+Checks AtomicallyShared (one reader), MultiReaderShared (--readers readers, plus one too many,
+which must be refused) and SlotPool, used the way the node hands segments over: the writer fills
+a slot and swaps it in as the latest, giving back the one it replaced, and the reader takes the
+latest and gives it back when done. Every slot must be free again at the end. Prints a line per check and exits with status 1 if any fail.
+*/
+
+#include "AtomicSynchronizer.h"
+#include "MultiReaderSynchronizer.h"
+#include "SlotPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Update = std::vector<uint64_t>;
+    using Clock = std::chrono::steady_clock;
+
+    struct ReaderResult
+    {
+        uint64_t numReads = 0;
+        uint64_t numTorn = 0;      // values that didn't match the update number
+        uint64_t numBackwards = 0; // update numbers lower than the last one read
+        uint64_t numSkipped = 0;
+    };
+
+    // Writes updates 1, 2, 3... until told to stop; returns how many were pushed
+    template<typename WritePtr>
+    uint64_t runWriter(WritePtr& writer, const std::atomic<bool>& stop)
+    {
+        uint64_t number = 0;
+        while (!stop)
+        {
+            ++number;
+            std::fill(writer->begin(), writer->end(), number);
+            writer.pushUpdate();
+        }
+        return number;
+    }
+
+    // Counts values in the update that aren't the expected number
+    uint64_t countTorn(const Update& update, uint64_t number)
+    {
+        return uint64_t(std::count_if(update.begin(), update.end(),
+            [=](uint64_t value) { return value != number; }));
+    }
+
+    // Reads with a pointer that's been checked out; getNumber gives the number of the update
+    // the pointer holds from its contents or the synchronizer
+    template<typename ReadPtr, typename GetNumber>
+    void runReader(ReadPtr& reader, const std::atomic<bool>& stop, GetNumber getNumber, ReaderResult& result)
+    {
+        uint64_t last = 0;
+        while (!stop)
+        {
+            reader.pullUpdate();
+            if (!reader.isValid())
+            {
+                continue;
+            }
+
+            const Update& update = *reader;
+            uint64_t number = getNumber(reader);
+            result.numTorn += countTorn(update, number);
+            std::this_thread::yield();
+            result.numTorn += countTorn(update, number);
+
+            result.numBackwards += number < last;
+            last = number;
+            ++result.numReads;
+        }
+    }
+
+    bool report(bool ok, const std::string& what)
+    {
+        std::cout << (ok ? "  pass  " : "  FAIL  ") << what << std::endl;
+        return ok;
+    }
+
+    int checkResults(const std::string& name, uint64_t numPushed, const std::vector<ReaderResult>& results)
+    {
+        int nFailed = 0;
+        for (size_t r = 0; r < results.size(); ++r)
+        {
+            const ReaderResult& result = results[r];
+            std::string prefix = name + " reader " + std::to_string(r + 1) + ": ";
+            nFailed += !report(result.numReads > 0, prefix + std::to_string(result.numReads) + " reads of "
+                + std::to_string(numPushed) + " updates (" + std::to_string(result.numSkipped) + " skipped)");
+            nFailed += !report(result.numTorn == 0, prefix + std::to_string(result.numTorn) + " torn values");
+            nFailed += !report(result.numBackwards == 0, prefix + std::to_string(result.numBackwards)
+                + " reads older than the one before");
+        }
+        return nFailed;
+    }
+
+    int checkAtomicallyShared(double seconds, int size)
+    {
+        AtomicallyShared<Update> shared(size, 0);
+        std::atomic<bool> stop(false);
+        std::vector<ReaderResult> results(1);
+        uint64_t numPushed = 0;
+
+        std::thread writerThread([&]
+        {
+            AtomicScopedWritePtr<Update> writer(shared);
+            numPushed = runWriter(writer, stop);
+        });
+        std::thread readerThread([&]
+        {
+            AtomicScopedReadPtr<Update> reader(shared);
+            // the contents are the only record of which update this is
+            runReader(reader, stop, [](AtomicScopedReadPtr<Update>& r) { return r->front(); }, results[0]);
+        });
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        writerThread.join();
+        readerThread.join();
+
+        results[0].numSkipped = shared.getNumDropped();
+        return checkResults("AtomicallyShared", numPushed, results);
+    }
+
+    int checkMultiReaderShared(double seconds, int size, int nReaders)
+    {
+        MultiReaderShared<Update> shared(nReaders, size, 0);
+        std::atomic<bool> stop(false);
+        std::atomic<int> numReady(0);
+        std::vector<ReaderResult> results(nReaders);
+        uint64_t numPushed = 0;
+        int nFailed = 0;
+
+        std::thread writerThread([&]
+        {
+            MultiReaderWritePtr<Update> writer(shared);
+            numPushed = runWriter(writer, stop);
+        });
+
+        std::vector<std::thread> readerThreads;
+        for (int r = 0; r < nReaders; ++r)
+        {
+            readerThreads.emplace_back([&, r]
+            {
+                MultiReaderReadPtr<Update> reader(shared);
+                ++numReady;
+                runReader(reader, stop, [](MultiReaderReadPtr<Update>& p) { return p.getVersion(); }, results[r]);
+                results[r].numSkipped = reader.getNumSkipped();
+            });
+        }
+
+        // every reader place is taken now, so one more must be refused
+        while (numReady < nReaders)
+        {
+            std::this_thread::yield();
+        }
+        {
+            MultiReaderReadPtr<Update> extra(shared);
+            nFailed += !report(!extra.isValid(), "MultiReaderShared: reader " + std::to_string(nReaders + 1)
+                + " of " + std::to_string(nReaders) + " refused");
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        writerThread.join();
+        for (std::thread& t : readerThreads)
+        {
+            t.join();
+        }
+
+        nFailed += checkResults("MultiReaderShared", numPushed, results);
+        nFailed += !report(shared.getNumPushed() == numPushed, "MultiReaderShared: "
+            + std::to_string(shared.getNumPushed()) + " updates counted");
+        return nFailed;
+    }
+
+    int checkSlotPool(double seconds, int size)
+    {
+        const int poolSize = 3; // the smallest the node allows
+        SlotPool<Update> pool(poolSize);
+        pool.map([=](Update& slot) { slot.assign(size, 0); });
+
+        std::atomic<int> latest(-1);
+        std::atomic<bool> stop(false);
+        std::vector<ReaderResult> results(1);
+        uint64_t numPushed = 0;
+        uint64_t numEmpty = 0; // times the writer found no free slot
+        int nFailed = 0;
+
+        std::thread writerThread([&]
+        {
+            uint64_t number = 0;
+            while (!stop)
+            {
+                int slot = pool.acquire();
+                if (slot == -1)
+                {
+                    ++numEmpty;
+                    std::this_thread::yield();
+                    continue;
+                }
+                ++number;
+                std::fill(pool[slot].begin(), pool[slot].end(), number);
+                int replaced = latest.exchange(slot);
+                if (replaced != -1)
+                {
+                    pool.release(replaced);
+                    ++results[0].numSkipped;
+                }
+            }
+            numPushed = number;
+        });
+        std::thread readerThread([&]
+        {
+            ReaderResult& result = results[0];
+            uint64_t last = 0;
+            while (!stop)
+            {
+                int slot = latest.exchange(-1);
+                if (slot == -1)
+                {
+                    continue;
+                }
+
+                const Update& update = pool[slot];
+                uint64_t number = update.front();
+                result.numTorn += countTorn(update, number);
+                std::this_thread::yield();
+                result.numTorn += countTorn(update, number);
+
+                result.numBackwards += number < last;
+                last = number;
+                ++result.numReads;
+                pool.release(slot);
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        writerThread.join();
+        readerThread.join();
+
+        nFailed += checkResults("SlotPool", numPushed, results);
+
+        int waiting = latest.exchange(-1);
+        if (waiting != -1)
+        {
+            pool.release(waiting);
+        }
+        nFailed += !report(numEmpty == 0, "SlotPool: writer found no free slot " + std::to_string(numEmpty)
+            + " times");
+        nFailed += !report(pool.getNumFree() == poolSize, "SlotPool: " + std::to_string(pool.getNumFree())
+            + " of " + std::to_string(poolSize) + " slots free at the end");
+        return nFailed;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = 2;
+    int nReaders = 3;
+    int size = 4096;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc)
+        {
+            seconds = std::max(0.01, std::atof(argv[++i]));
+        }
+        else if (arg == "--readers" && i + 1 < argc)
+        {
+            nReaders = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            size = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--seconds s] [--readers n] [--size n]" << std::endl;
+            return 1;
+        }
+    }
+
+    int nFailed = 0;
+    nFailed += checkAtomicallyShared(seconds, size);
+    nFailed += checkMultiReaderShared(seconds, size, nReaders);
+    nFailed += checkSlotPool(seconds, size);
+
+    std::cout << (nFailed == 0 ? "All checks passed" : std::to_string(nFailed) + " checks failed") << std::endl;
+    return nFailed == 0 ? 0 : 1;
+}
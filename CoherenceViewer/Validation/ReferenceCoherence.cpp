@@ -0,0 +1,153 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ReferenceCoherence.h"
+
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+ReferenceCoherence::ReferenceCoherence(int nChans, int nf, int nt, int fs, float winLen, float step,
+    float freqStep, int freqStart, double segLen)
+    : nFreqs    (nf)
+    , nTimes    (nt)
+    , Fs        (fs)
+    , nfft      (int(segLen * fs))
+    , stepLen   (step)
+    , trimTime  (winLen / 2)
+    , twiddles  (nfft)
+    , spectra   (nChans, std::vector<std::vector<std::complex<double>>>(nf,
+                 std::vector<std::complex<double>>(nt)))
+    , powerSums (nChans, std::vector<std::vector<double>>(nf, std::vector<double>(nt)))
+    , nTrials   (nChans)
+{
+    for (int k = 0; k < nfft; ++k)
+    {
+        twiddles[k] = std::polar(1.0, -2 * PI * k / nfft);
+    }
+
+    // Hann window of winLen centred on sample 0, wrapping around the end of the segment
+    float nWindow = Fs * winLen;
+    std::vector<double> hann(nfft, 0.0);
+    for (int n = 0; n < nfft; ++n)
+    {
+        double offset = n <= nfft / 2 ? n : n - nfft;
+        if (std::abs(offset) <= nWindow / 2)
+        {
+            double c = std::cos(PI * offset / nWindow);
+            hann[n] = c * c;
+        }
+    }
+
+    waveletSpectra.assign(nFreqs, std::vector<std::complex<double>>(nfft));
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        double freq = freqStart + f * freqStep;
+        std::vector<std::complex<double>> wavelet(nfft);
+        for (int n = 0; n < nfft; ++n)
+        {
+            wavelet[n] = hann[n] * std::polar(1.0, 2 * PI * freq * n / Fs);
+        }
+
+        for (int k = 0; k < nfft; ++k)
+        {
+            std::complex<double> sum;
+            for (int n = 0; n < nfft; ++n)
+            {
+                sum += wavelet[n] * twiddle(k, n, false);
+            }
+            waveletSpectra[f][k] = sum;
+        }
+    }
+
+    // same float arithmetic as CumulativeTFR, so both pick the same samples
+    for (int t = 0; t < nTimes; ++t)
+    {
+        timeIndices.push_back(int(((t * stepLen) + trimTime) * Fs));
+    }
+}
+
+void ReferenceCoherence::addTrial(const std::vector<double>& segment, int chan)
+{
+    std::vector<std::complex<double>> spectrum(nfft);
+    for (int k = 0; k < nfft; ++k)
+    {
+        std::complex<double> sum;
+        for (int n = 0; n < nfft; ++n)
+        {
+            sum += segment[n] * twiddle(k, n, false);
+        }
+        spectrum[k] = sum;
+    }
+
+    float nWindow = Fs * (2 * trimTime);
+    double scale = std::sqrt(2.0 / nWindow) / nfft;
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        for (int t = 0; t < nTimes; ++t)
+        {
+            // inverse DFT of the product, at this time only
+            std::complex<double> sum;
+            for (int k = 0; k < nfft; ++k)
+            {
+                sum += spectrum[k] * waveletSpectra[f][k] * twiddle(k, timeIndices[t], true);
+            }
+            sum *= scale;
+
+            spectra[chan][f][t] = sum;
+            powerSums[chan][f][t] += std::norm(sum);
+        }
+    }
+    ++nTrials[chan];
+}
+
+void ReferenceCoherence::getMeanCoherence(int chanX, int chanY, double* meanDest)
+{
+    CrossSums& cross = crossSums[std::make_pair(chanX, chanY)];
+    if (cross.sums.empty())
+    {
+        cross.sums.assign(nFreqs, std::vector<std::complex<double>>(nTimes));
+    }
+    ++cross.count;
+
+    for (int f = 0; f < nFreqs; ++f)
+    {
+        double sum = 0;
+        for (int t = 0; t < nTimes; ++t)
+        {
+            cross.sums[f][t] += spectra[chanX][f][t] * std::conj(spectra[chanY][f][t]);
+
+            double pxx = powerSums[chanX][f][t] / nTrials[chanX];
+            double pyy = powerSums[chanY][f][t] / nTrials[chanY];
+            std::complex<double> pxy = cross.sums[f][t] / double(cross.count);
+            sum += std::norm(pxy) / (pxx * pyy);
+        }
+        meanDest[f] = nTimes > 0 ? sum / nTimes : 0;
+    }
+}
+
+std::complex<double> ReferenceCoherence::twiddle(long long k, long long n, bool inverse) const
+{
+    std::complex<double> w = twiddles[(k * n) % nfft];
+    return inverse ? std::conj(w) : w;
+}
@@ -0,0 +1,83 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef REFERENCE_COHERENCE_H_INCLUDED
+#define REFERENCE_COHERENCE_H_INCLUDED
+
+/*
+
+Reference Coherence - the calculation CumulativeTFR does, written as plainly as possible so
+that faster implementations can be checked against it.
+
+Spectra come from a naive O(N^2) DFT (with a table of twiddle factors, but no FFT), and the
+inverse transform is only evaluated at the analysis times. Power and cross-spectra are plain
+sums over trials, the same as CumulativeTFR with alpha = 0. Slow: keep segments to a few
+thousand samples.
+
+*/
+
+#include <complex>
+#include <map>
+#include <utility>
+#include <vector>
+
+class ReferenceCoherence
+{
+public:
+    ReferenceCoherence(int nChans, int nFreqs, int nTimes, int Fs, float winLen, float stepLen,
+        float freqStep, int freqStart, double segLen);
+
+    void addTrial(const std::vector<double>& segment, int chan);
+
+    // Adds the current trial's cross-spectrum for the pair, then writes the mean coherence over
+    // the analysis times at each frequency
+    void getMeanCoherence(int chanX, int chanY, double* meanDest);
+
+private:
+    std::complex<double> twiddle(long long k, long long n, bool inverse) const;
+
+    const int nFreqs;
+    const int nTimes;
+    const int Fs;
+    const int nfft;
+    const float stepLen;
+    const float trimTime;
+
+    std::vector<std::complex<double>> twiddles; // exp(-2 pi i k / nfft)
+    std::vector<std::vector<std::complex<double>>> waveletSpectra; // # frequencies x nfft
+    std::vector<int> timeIndices;
+
+    // # channels x # frequencies x # times
+    std::vector<std::vector<std::vector<std::complex<double>>>> spectra;
+    std::vector<std::vector<std::vector<double>>> powerSums;
+    std::vector<int> nTrials;
+
+    struct CrossSums
+    {
+        std::vector<std::vector<std::complex<double>>> sums; // # frequencies x # times
+        int count = 0;
+    };
+    std::map<std::pair<int, int>, CrossSums> crossSums;
+};
+
+#endif // REFERENCE_COHERENCE_H_INCLUDED
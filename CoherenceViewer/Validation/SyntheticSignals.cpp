@@ -0,0 +1,210 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SyntheticSignals.h"
+
+#include "FFTArray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+
+static const double PI = 3.14159265358979323846;
+
+SyntheticSpec::SyntheticSpec()
+    : fs            (250)
+    , segLen        (4)
+    , winLen        (2)
+    , nSegments     (200)
+    , noise         (true)
+    , noiseExponent (1)
+    , seed          (1)
+{}
+
+SyntheticPair::SyntheticPair(const SyntheticSpec& s)
+    : spec      (s)
+    , segLength (int(s.segLen * s.fs))
+{
+    int nComps = int(spec.components.size());
+    std::mt19937 gen(spec.seed);
+    std::uniform_real_distribution<double> phaseDist(0, 2 * PI);
+
+    // each component on its own, at unit amplitude
+    typedef std::vector<std::vector<double>> Segments;
+    std::vector<Segments> compSegments[2];
+    for (int chan = 0; chan < 2; ++chan)
+    {
+        compSegments[chan].assign(nComps, Segments(spec.nSegments, std::vector<double>(segLength)));
+    }
+
+    for (int c = 0; c < nComps; ++c)
+    {
+        const SyntheticComponent& comp = spec.components[c];
+        std::normal_distribution<double> jitterDist(0, comp.jitterSd > 0 ? comp.jitterSd : 1);
+
+        for (int seg = 0; seg < spec.nSegments; ++seg)
+        {
+            double phase = phaseDist(gen);
+            double jitter = comp.jitterSd > 0 ? jitterDist(gen) : 0;
+            for (int n = 0; n < segLength; ++n)
+            {
+                double arg = 2 * PI * comp.freq * n / spec.fs + phase;
+                compSegments[0][c][seg][n] = std::cos(arg);
+                compSegments[1][c][seg][n] = std::cos(arg - comp.lag + jitter);
+            }
+        }
+    }
+
+    Segments noise[2];
+    for (int chan = 0; chan < 2; ++chan)
+    {
+        noise[chan].assign(spec.nSegments, std::vector<double>(segLength));
+        if (spec.noise)
+        {
+            generateNoise(noise[chan], spec.seed * 2 + chan + 1);
+        }
+    }
+
+    std::vector<double> amplitudes(nComps, 1.0);
+    if (spec.noise && nComps > 0)
+    {
+        // scale each channel's noise to set the first component's SNR...
+        const SyntheticComponent& first = spec.components[0];
+        double signalPower = getBandPower(compSegments[0][0], first.freq, spec.fs, spec.winLen);
+        for (int chan = 0; chan < 2; ++chan)
+        {
+            double noisePower = getBandPower(noise[chan], first.freq, spec.fs, spec.winLen);
+            double scale = std::sqrt(signalPower / (first.snr * noisePower));
+            for (std::vector<double>& seg : noise[chan])
+            {
+                for (double& x : seg)
+                {
+                    x *= scale;
+                }
+            }
+        }
+
+        // ...and the amplitude of the others to set theirs
+        for (int c = 1; c < nComps; ++c)
+        {
+            const SyntheticComponent& comp = spec.components[c];
+            double noisePower = (getBandPower(noise[0], comp.freq, spec.fs, spec.winLen)
+                + getBandPower(noise[1], comp.freq, spec.fs, spec.winLen)) / 2;
+            double compPower = getBandPower(compSegments[0][c], comp.freq, spec.fs, spec.winLen);
+            amplitudes[c] = std::sqrt(comp.snr * noisePower / compPower);
+        }
+    }
+
+    for (int chan = 0; chan < 2; ++chan)
+    {
+        segments[chan] = noise[chan];
+        for (int c = 0; c < nComps; ++c)
+        {
+            for (int seg = 0; seg < spec.nSegments; ++seg)
+            {
+                for (int n = 0; n < segLength; ++n)
+                {
+                    segments[chan][seg][n] += amplitudes[c] * compSegments[chan][c][seg][n];
+                }
+            }
+        }
+    }
+}
+
+const std::vector<double>& SyntheticPair::getSegment(int chan, int segment) const
+{
+    return segments[chan][segment];
+}
+
+double SyntheticPair::getExpectedCoherence(int component) const
+{
+    const SyntheticComponent& comp = spec.components[component];
+    double snrFactor = spec.noise ? comp.snr / (1 + comp.snr) : 1;
+    return snrFactor * snrFactor * std::exp(-comp.jitterSd * comp.jitterSd);
+}
+
+double SyntheticPair::getBandPower(const std::vector<std::vector<double>>& segs,
+    double freq, double fs, double winLen)
+{
+    int half = int(winLen * fs / 2);
+    double nWindow = winLen * fs;
+
+    // Hann wavelet centred on 0
+    std::vector<std::complex<double>> wavelet(2 * half + 1);
+    for (int m = -half; m <= half; ++m)
+    {
+        double hann = std::cos(PI * m / nWindow);
+        wavelet[m + half] = std::polar(hann * hann, 2 * PI * freq * m / fs);
+    }
+
+    double sum = 0;
+    long count = 0;
+    for (const std::vector<double>& seg : segs)
+    {
+        int n = int(seg.size());
+        int step = std::max(1, int(0.1 * fs));
+        for (int centre = half; centre + half < n; centre += step)
+        {
+            std::complex<double> y;
+            for (int m = -half; m <= half; ++m)
+            {
+                y += seg[centre - m] * wavelet[m + half];
+            }
+            sum += std::norm(y);
+            ++count;
+        }
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+void SyntheticPair::generateNoise(std::vector<std::vector<double>>& dest, unsigned seed) const
+{
+    // random phases and Gaussian amplitudes with a 1/f^exponent power spectrum
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(0, 1);
+
+    FFTArray buffer(segLength);
+    for (std::vector<double>& seg : dest)
+    {
+        buffer.resize(segLength);
+        for (int k = 1; k <= segLength / 2; ++k)
+        {
+            double freq = k * spec.fs / segLength;
+            double amplitude = std::pow(freq, -spec.noiseExponent / 2);
+            std::complex<double> value(dist(gen) * amplitude, dist(gen) * amplitude);
+            if (2 * k == segLength)
+            {
+                value = value.real() * std::sqrt(2.0); // Nyquist bin is real
+            }
+            buffer.set(k, value);
+            buffer.set(segLength - k, std::conj(value));
+        }
+        buffer.ifft();
+
+        for (int n = 0; n < segLength; ++n)
+        {
+            seg[n] = buffer.getAsReal(n);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2019 Translational NeuroEngineering Laboratory
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SYNTHETIC_SIGNALS_H_INCLUDED
+#define SYNTHETIC_SIGNALS_H_INCLUDED
+
+/*
+
+Synthetic Pair - two channels with a known coherence spectrum, for checking the engine.
+
+Each channel is a sum of sinusoids shared by both channels plus independent 1/f^exponent
+(pink by default) noise. In each segment the sinusoids start at a random phase, and the
+second channel's copy is shifted by a constant lag plus a normally distributed jitter that's
+drawn again for every segment.
+
+The SNR of a component is the ratio of sinusoid to noise power seen through the same Hann
+wavelet the engine uses, at the component's frequency. With that definition, the expected
+magnitude-squared coherence at the frequency is
+
+    (SNR / (1 + SNR))^2 * exp(-jitterSd^2)
+
+(the second factor is |E[exp(i * jitter)]|^2), plus the positive bias of an estimate made
+from a finite number of segments.
+
+*/
+
+#include <vector>
+
+struct SyntheticComponent
+{
+    double freq;     // Hz
+    double snr;      // in the analysis band around freq
+    double jitterSd; // SD of the phase jitter between channels, in radians
+    double lag;      // constant phase lag of the second channel, in radians
+};
+
+struct SyntheticSpec
+{
+    SyntheticSpec();
+
+    double fs;
+    double segLen;
+    double winLen;   // length of the wavelet the SNR is measured with
+    int nSegments;
+    bool noise;
+    double noiseExponent; // noise power goes as 1/f^noiseExponent; 0 is white, 1 is pink
+    unsigned seed;
+    std::vector<SyntheticComponent> components;
+};
+
+class SyntheticPair
+{
+public:
+    explicit SyntheticPair(const SyntheticSpec& spec);
+
+    const SyntheticSpec& getSpec() const { return spec; }
+
+    int getNumSegments() const { return spec.nSegments; }
+    int getSegmentLength() const { return segLength; }
+
+    // chan is 0 or 1
+    const std::vector<double>& getSegment(int chan, int segment) const;
+
+    // Coherence of the underlying processes at the component's frequency, without estimation bias
+    double getExpectedCoherence(int component) const;
+
+    // Mean power through a Hann wavelet of length winLen at freq, over the analysis times of
+    // every segment. Only ratios of these are meaningful.
+    static double getBandPower(const std::vector<std::vector<double>>& segments,
+        double freq, double fs, double winLen);
+
+private:
+    void generateNoise(std::vector<std::vector<double>>& dest, unsigned seed) const;
+
+    SyntheticSpec spec;
+    int segLength;
+
+    std::vector<std::vector<double>> segments[2];
+};
+
+#endif // SYNTHETIC_SIGNALS_H_INCLUDED